@@ -5,101 +5,126 @@
 
 #include "_Base64.h"
 
-#if (defined(__AVR__))
-#include <avr/pgmspace.h>
-#else
-#include <pgmspace.h>
-#endif
+// Base64 character tables
+const char _Base64::base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                       "abcdefghijklmnopqrstuvwxyz"
+                                       "0123456789+/";
+const char _Base64::urlSafeAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                        "abcdefghijklmnopqrstuvwxyz"
+                                        "0123456789-_";
 
-// Base64 character table
-const char PROGMEM _Base64::base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                               "abcdefghijklmnopqrstuvwxyz"
-                                               "0123456789+/";
+// Character -> 6-bit value for both alphabets. 0x40 marks '=', 0xff an invalid character.
+#define XX 0xff
+const uint8_t _Base64::decodeTable[256] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, 62, XX, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, 0x40, XX, XX,
+    XX, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, 63,
+    XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+};
+#undef XX
 
-// Base64 encode methods
-String _Base64::encode(const uint8_t *input, size_t inputLength)
-{
-    std::vector<char> output((inputLength + 2 - ((inputLength + 2) % 3)) / 3 * 4 + 1);
-    int i = 0, j = 0;
-    int encLen = 0;
-    unsigned char bytes3[3];
-    unsigned char bytes4[4];
+#define BASE64_PAD 0x40
+#define BASE64_INVALID 0xff
 
-    while (inputLength--)
+// Encodes whole 3-byte groups one 24-bit word at a time, then the padded tail
+static size_t encodeBlocks(const char *alphabet, const uint8_t *input, size_t inputLength, char *output)
+{
+    char *start = output;
+    const uint8_t *end = input + inputLength - inputLength % 3;
+    while (input < end)
     {
-        bytes3[i++] = *(input++);
-        if (i == 3)
-        {
-            bytes3To4(bytes4, bytes3);
-            for (i = 0; i < 4; i++)
-            {
-                output[encLen++] = pgm_read_byte(&base64Alphabet[bytes4[i]]);
-            }
-            i = 0;
-        }
+        uint32_t word = ((uint32_t)input[0] << 16) | ((uint32_t)input[1] << 8) | input[2];
+        output[0] = alphabet[word >> 18];
+        output[1] = alphabet[(word >> 12) & 0x3f];
+        output[2] = alphabet[(word >> 6) & 0x3f];
+        output[3] = alphabet[word & 0x3f];
+        input += 3;
+        output += 4;
     }
 
-    if (i)
+    size_t rest = inputLength % 3;
+    if (rest)
     {
-        for (j = i; j < 3; j++)
+        uint32_t word = (uint32_t)input[0] << 16;
+        if (rest == 2)
         {
-            bytes3[j] = '\0';
-        }
-        bytes3To4(bytes4, bytes3);
-        for (j = 0; j < i + 1; j++)
-        {
-            output[encLen++] = pgm_read_byte(&base64Alphabet[bytes4[j]]);
-        }
-        while ((i++ < 3))
-        {
-            output[encLen++] = '=';
+            word |= (uint32_t)input[1] << 8;
         }
+        output[0] = alphabet[word >> 18];
+        output[1] = alphabet[(word >> 12) & 0x3f];
+        output[2] = rest == 2 ? alphabet[(word >> 6) & 0x3f] : '=';
+        output[3] = '=';
+        output += 4;
     }
-    output[encLen] = '\0';
-    return String(output.data());
+    *output = '\0';
+    return output - start;
 }
 
-std::vector<uint8_t> _Base64::encodeToVector(const uint8_t *input, size_t inputLength)
+template <bool UrlSafe>
+size_t _Base64::encodeTo(const uint8_t *input, size_t inputLength, char *output)
 {
-    std::vector<uint8_t> output((inputLength + 2 - ((inputLength + 2) % 3)) / 3 * 4);
-    int i = 0, j = 0;
-    int encLen = 0;
-    unsigned char bytes3[3];
-    unsigned char bytes4[4];
+    return encodeBlocks(UrlSafe ? urlSafeAlphabet : base64Alphabet, input, inputLength, output);
+}
 
-    while (inputLength--)
-    {
-        bytes3[i++] = *(input++);
-        if (i == 3)
-        {
-            bytes3To4(bytes4, bytes3);
-            for (i = 0; i < 4; i++)
-            {
-                output[encLen++] = pgm_read_byte(&base64Alphabet[bytes4[i]]);
-            }
-            i = 0;
-        }
-    }
+template size_t _Base64::encodeTo<false>(const uint8_t *input, size_t inputLength, char *output);
+template size_t _Base64::encodeTo<true>(const uint8_t *input, size_t inputLength, char *output);
+
+int _Base64::decodeTo(const char *input, size_t inputLength, uint8_t *output)
+{
+    Base64Decoder decoder;
+    int written = decoder.update(input, inputLength, output);
+    written += decoder.finish(output + written);
+    return decoder.failed() ? -1 : written;
+}
 
-    if (i)
+template <bool UrlSafe>
+String _Base64::encodeWith(const uint8_t *input, size_t inputLength)
+{
+    String output;
+    output.reserve(encodedLength(inputLength));
+    // Encode 48-byte chunks on the stack and append; the String allocates once in reserve()
+    char chunk[64 + 1];
+    while (inputLength > 0)
     {
-        for (j = i; j < 3; j++)
-        {
-            bytes3[j] = '\0';
-        }
-        bytes3To4(bytes4, bytes3);
-        for (j = 0; j < i + 1; j++)
-        {
-            output[encLen++] = pgm_read_byte(&base64Alphabet[bytes4[j]]);
-        }
-        while ((i++ < 3))
-        {
-            output[encLen++] = '=';
-        }
+        size_t length = inputLength < 48 ? inputLength : 48;
+        output.concat(chunk, encodeTo<UrlSafe>(input, length, chunk));
+        input += length;
+        inputLength -= length;
     }
     return output;
 }
 
+template <bool UrlSafe>
+std::vector<uint8_t> _Base64::encodeToVectorWith(const uint8_t *input, size_t inputLength)
+{
+    std::vector<uint8_t> output(encodedLength(inputLength) + 1);
+    output.resize(encodeTo<UrlSafe>(input, inputLength, (char *)output.data()));
+    return output;
+}
+
+// Base64 encode methods
+String _Base64::encode(const uint8_t *input, size_t inputLength)
+{
+    return encodeWith<false>(input, inputLength);
+}
+
+std::vector<uint8_t> _Base64::encodeToVector(const uint8_t *input, size_t inputLength)
+{
+    return encodeToVectorWith<false>(input, inputLength);
+}
+
 String _Base64::encode(const String &inputString)
 {
     return encode((const uint8_t *)inputString.c_str(), inputString.length());
@@ -112,10 +137,7 @@ std::vector<uint8_t> _Base64::encodeToVector(const String &inputString)
 
 String _Base64::urlSafeEncode(const uint8_t *input, size_t inputLength)
 {
-    String encodedString = encode(input, inputLength);
-    encodedString.replace('+', '-');
-    encodedString.replace('/', '_');
-    return encodedString;
+    return encodeWith<true>(input, inputLength);
 }
 
 String _Base64::urlSafeEncode(const String &inputString)
@@ -125,19 +147,7 @@ String _Base64::urlSafeEncode(const String &inputString)
 
 std::vector<uint8_t> _Base64::urlSafeEncodeToVector(const uint8_t *input, size_t inputLength)
 {
-    std::vector<uint8_t> encodedVector = encodeToVector(input, inputLength);
-    for (auto &ch : encodedVector)
-    {
-        if (ch == '+')
-        {
-            ch = '-';
-        }
-        else if (ch == '/')
-        {
-            ch = '_';
-        }
-    }
-    return encodedVector;
+    return encodeToVectorWith<true>(input, inputLength);
 }
 
 std::vector<uint8_t> _Base64::urlSafeEncodeToVector(const String &inputString)
@@ -145,56 +155,15 @@ std::vector<uint8_t> _Base64::urlSafeEncodeToVector(const String &inputString)
     return urlSafeEncodeToVector((const uint8_t *)inputString.c_str(), inputString.length());
 }
 
-// Base64 decode methods
+// Base64 decode methods. Both alphabets are accepted; decoding stops at '='.
+// An invalid character ends decoding and the bytes decoded so far are returned.
 std::vector<uint8_t> _Base64::decode(const String &input)
 {
-    int inputLength = input.length();
-    std::vector<uint8_t> output((6 * inputLength) / 8 + 1);
-    int i = 0, j = 0;
-    int decLen = 0;
-    unsigned char bytes3[3];
-    unsigned char bytes4[4];
-
-    const char *inputPtr = input.c_str();
-    while (inputLength--)
-    {
-        if (*inputPtr == '=')
-        {
-            break;
-        }
-        bytes4[i++] = *(inputPtr++);
-        if (i == 4)
-        {
-            for (i = 0; i < 4; i++)
-            {
-                bytes4[i] = lookupBase64(bytes4[i]);
-            }
-            bytes4To3(bytes3, bytes4);
-            for (i = 0; i < 3; i++)
-            {
-                output[decLen++] = bytes3[i];
-            }
-            i = 0;
-        }
-    }
-
-    if (i)
-    {
-        for (j = i; j < 4; j++)
-        {
-            bytes4[j] = '\0';
-        }
-        for (j = 0; j < 4; j++)
-        {
-            bytes4[j] = lookupBase64(bytes4[j]);
-        }
-        bytes4To3(bytes3, bytes4);
-        for (j = 0; j < i - 1; j++)
-        {
-            output[decLen++] = bytes3[j];
-        }
-    }
-    output.resize(decLen);
+    std::vector<uint8_t> output(decodedMaxLength(input.length()));
+    Base64Decoder decoder;
+    int written = decoder.update(input.c_str(), input.length(), output.data());
+    written += decoder.finish(output.data() + written);
+    output.resize(written);
     return output;
 }
 
@@ -202,6 +171,7 @@ String _Base64::decodeToString(const String &inputString)
 {
     std::vector<uint8_t> decodedVector = decode(inputString);
     String result;
+    result.reserve(decodedVector.size());
     for (auto byte : decodedVector)
     {
         result += (char)byte;
@@ -211,51 +181,105 @@ String _Base64::decodeToString(const String &inputString)
 
 std::vector<uint8_t> _Base64::urlSafeDecode(const String &inputString)
 {
-    String tempString = inputString;
-    tempString.replace('-', '+');
-    tempString.replace('_', '/');
-    return decode(tempString);
+    return decode(inputString);
 }
 
 String _Base64::urlSafeDecodeToString(const String &inputString)
 {
-    std::vector<uint8_t> decodedVector = decode(inputString);
-    String result;
-    for (auto byte : decodedVector)
+    return decodeToString(inputString);
+}
+
+// Incremental encoder
+size_t Base64Encoder::update(const uint8_t *input, size_t length, char *output)
+{
+    const char *alphabet = urlSafe ? _Base64::urlSafeAlphabet : _Base64::base64Alphabet;
+    size_t written = 0;
+
+    // Complete the partial group left over from the previous chunk first
+    if (carryLength > 0)
     {
-        result += (char)byte;
+        while (carryLength < 3 && length > 0)
+        {
+            carry[carryLength++] = *input++;
+            length--;
+        }
+        if (carryLength < 3)
+        {
+            output[0] = '\0';
+            return 0;
+        }
+        written = encodeBlocks(alphabet, carry, 3, output);
+        carryLength = 0;
     }
-    return result;
+
+    size_t whole = length - length % 3;
+    written += encodeBlocks(alphabet, input, whole, output + written);
+    for (size_t i = whole; i < length; i++)
+    {
+        carry[carryLength++] = input[i];
+    }
+    return written;
 }
 
-// Helper methods
-void _Base64::bytes3To4(unsigned char *output, const unsigned char *input)
+size_t Base64Encoder::finish(char *output)
 {
-    output[0] = (input[0] & 0xfc) >> 2;
-    output[1] = ((input[0] & 0x03) << 4) + ((input[1] & 0xf0) >> 4);
-    output[2] = ((input[1] & 0x0f) << 2) + ((input[2] & 0xc0) >> 6);
-    output[3] = (input[2] & 0x3f);
+    const char *alphabet = urlSafe ? _Base64::urlSafeAlphabet : _Base64::base64Alphabet;
+    size_t written = encodeBlocks(alphabet, carry, carryLength, output);
+    carryLength = 0;
+    return written;
 }
 
-void _Base64::bytes4To3(unsigned char *output, const unsigned char *input)
+// Incremental decoder. An invalid character stops decoding and sets the error flag;
+// the bytes decoded before it are still returned.
+int Base64Decoder::update(const char *input, size_t length, uint8_t *output)
 {
-    output[0] = (input[0] << 2) + ((input[1] & 0x30) >> 4);
-    output[1] = ((input[1] & 0xf) << 4) + ((input[2] & 0x3c) >> 2);
-    output[2] = ((input[2] & 0x3) << 6) + input[3];
+    uint8_t *start = output;
+    for (size_t i = 0; i < length && !done && !error; i++)
+    {
+        uint8_t value = _Base64::decodeTable[(uint8_t)input[i]];
+        if (value == BASE64_PAD)
+        {
+            done = true;
+            break;
+        }
+        if (value == BASE64_INVALID)
+        {
+            error = true;
+            break;
+        }
+        carry[carryLength++] = value;
+
+        // Emit one 24-bit word per 4 characters
+        if (carryLength == 4)
+        {
+            uint32_t word = ((uint32_t)carry[0] << 18) | ((uint32_t)carry[1] << 12) | ((uint32_t)carry[2] << 6) | carry[3];
+            output[0] = word >> 16;
+            output[1] = word >> 8;
+            output[2] = word;
+            output += 3;
+            carryLength = 0;
+        }
+    }
+    return output - start;
 }
 
-unsigned char _Base64::lookupBase64(char character)
+int Base64Decoder::finish(uint8_t *output)
 {
-    if (character >= 'A' && character <= 'Z')
-        return character - 'A';
-    if (character >= 'a' && character <= 'z')
-        return character - 71;
-    if (character >= '0' && character <= '9')
-        return character + 4;
-    if (character == '+')
-        return 62;
-    if (character == '/')
-        return 63;
-    return -1;
+    int written = 0;
+    if (!error && carryLength == 1)
+    {
+        // A single trailing character cannot form a byte
+        error = true;
+    }
+    if (!error && carryLength >= 2)
+    {
+        output[written++] = (carry[0] << 2) | (carry[1] >> 4);
+    }
+    if (!error && carryLength == 3)
+    {
+        output[written++] = (carry[1] << 4) | (carry[2] >> 2);
+    }
+    carryLength = 0;
+    done = false;
+    return written;
 }
-
@@ -32,13 +32,72 @@ public:
     static std::vector<uint8_t> urlSafeDecode(const String &inputString);
     static String urlSafeDecodeToString(const String &inputString);
 
+    // Caller-buffer methods. Output is written directly, nothing is allocated.
+
+    // Length of the padded encoding of inputLength bytes (without terminator)
+    static constexpr size_t encodedLength(size_t inputLength) { return (inputLength + 2) / 3 * 4; }
+    // Upper bound of the decoded length of inputLength characters
+    static constexpr size_t decodedMaxLength(size_t inputLength) { return (inputLength + 3) / 4 * 3; }
+
+    // Encodes into output (encodedLength(inputLength) + 1 bytes, NUL-terminated).
+    // UrlSafe selects the "-_" alphabet at compile time. Returns the number of characters written.
+    template <bool UrlSafe>
+    static size_t encodeTo(const uint8_t *input, size_t inputLength, char *output);
+
+    // Decodes either alphabet into output (decodedMaxLength(inputLength) bytes).
+    // Stops at the first '='. Returns the number of bytes written, or -1 on an invalid character.
+    static int decodeTo(const char *input, size_t inputLength, uint8_t *output);
 
 private:
-    static void bytes3To4(unsigned char *output, const unsigned char *input);
-    static void bytes4To3(unsigned char *output, const unsigned char *input);
-    static unsigned char lookupBase64(char character);
+    friend class Base64Encoder;
+    friend class Base64Decoder;
 
     static const char base64Alphabet[];
+    static const char urlSafeAlphabet[];
+    static const uint8_t decodeTable[256];
+
+    template <bool UrlSafe>
+    static std::vector<uint8_t> encodeToVectorWith(const uint8_t *input, size_t inputLength);
+    template <bool UrlSafe>
+    static String encodeWith(const uint8_t *input, size_t inputLength);
+};
+
+/**
+ * Incremental encoder for inputs that arrive in chunks.
+ * update() writes at most encodedLength(carry + length) characters,
+ * finish() writes at most 4 characters plus the terminator.
+ */
+class Base64Encoder
+{
+public:
+    explicit Base64Encoder(bool urlSafe = false) : urlSafe(urlSafe) {}
+
+    size_t update(const uint8_t *input, size_t length, char *output);
+    size_t finish(char *output);
+
+private:
+    bool urlSafe;
+    uint8_t carry[3];
+    uint8_t carryLength = 0;
+};
+
+/**
+ * Incremental decoder for inputs that arrive in chunks. Accepts both alphabets.
+ * update() writes at most decodedMaxLength(carry + length) bytes, finish() at most 2 bytes.
+ * An invalid character stops decoding; failed() then returns true.
+ */
+class Base64Decoder
+{
+public:
+    int update(const char *input, size_t length, uint8_t *output);
+    int finish(uint8_t *output);
+    bool failed() const { return error; }
+
+private:
+    uint8_t carry[4];
+    uint8_t carryLength = 0;
+    bool done = false; // padding seen, the rest is ignored
+    bool error = false;
 };
 
 #endif // _BASE64_H_
@@ -36,7 +36,9 @@ Camera::Camera()
         .pixel_format = PIXFORMAT_JPEG,
         .frame_size = FRAMESIZE_QVGA,
         .jpeg_quality = 10,
-        .fb_count = 1,
+        .fb_count = CAMERA_FB_COUNT,
+        .fb_location = CAMERA_FB_IN_PSRAM,
+        .grab_mode = CAMERA_GRAB_LATEST,
     };
 }
 
@@ -54,7 +56,7 @@ esp_err_t Camera::init()
     esp_err_t err = esp_camera_init(&config);
     if (err != ESP_OK)
     {
-        logger.error("相机初始化失败", "camera");
+        LOG_ERROR(CAMERA, "相机初始化失败");
         return err;
     }
 
@@ -64,7 +66,7 @@ esp_err_t Camera::init()
         // Camera initialized
     }
 
-    logger.info("相机初始化成功", "camera");
+    LOG_INFO(CAMERA, "相机初始化成功");
     return ESP_OK;
 }
 
@@ -82,14 +84,33 @@ camera_fb_t *Camera::capture()
     camera_fb_t *fb = esp_camera_fb_get();
     if (!fb)
     {
-        logger.error("获取图像失败", "camera");
+        LOG_ERROR(CAMERA, "获取图像失败");
         return nullptr;
     }
 
-    logger.info("获取图像成功", "camera");
+    LOG_INFO(CAMERA, "获取图像成功");
     return fb;
 }
 
+/**
+ * ### 捕获图像并返回帧句柄
+ * 
+ * 从摄像头模块捕获一帧图像，并包装为引用计数的帧句柄，
+ * 最后一个持有者释放句柄时帧缓冲区自动归还驱动。
+ * 
+ * #### 参数
+ * 
+ * - `timestamp`：拍摄时间戳（毫秒）
+ * 
+ * #### 返回
+ * 
+ * - FrameHandle：帧句柄，如果捕获失败，则返回空句柄
+ */
+FrameHandle Camera::captureFrame(uint_fast64_t timestamp)
+{
+    return FrameHandle::wrap(capture(), timestamp);
+}
+
 /**
  * ### 返回图像帧缓冲区
  * 
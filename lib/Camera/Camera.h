@@ -11,6 +11,7 @@
 #include <Arduino.h>
 #include <esp_camera.h>
 #include "Logger.h"
+#include "FrameHandle.h"
 
 extern Logger logger; ///< 外部定义的日志记录器对象
 
@@ -32,6 +33,8 @@ extern Logger logger; ///< 外部定义的日志记录器对象
 #define HREF_GPIO_NUM 23    ///< 摄像头模块的 HREF 信号 GPIO 引脚
 #define PCLK_GPIO_NUM 22    ///< 摄像头模块的像素时钟 GPIO 引脚
 
+#define CAMERA_FB_COUNT 2   ///< 驱动帧缓冲区数量，应用同时持有全部缓冲区时驱动无法出帧
+
 /**
  * ### 摄像头控制类
  * 
@@ -46,6 +49,7 @@ extern Logger logger; ///< 外部定义的日志记录器对象
  * - `Camera()`：构造函数
  * - `init()`：初始化摄像头模块
  * - `capture()`：捕获图像
+ * - `captureFrame(timestamp)`：捕获图像并返回帧句柄
  * 
  */
 class Camera {
@@ -79,6 +83,21 @@ public:
      */
     camera_fb_t* capture();
 
+    /**
+     * ### 捕获图像并返回帧句柄
+     * 
+     * 捕获图像帧并包装为引用计数的帧句柄，多个消费者可以共享同一帧而无需复制 JPEG 数据。
+     * 
+     * #### 参数
+     * 
+     * - `timestamp`：拍摄时间戳（毫秒）
+     * 
+     * #### 返回
+     * 
+     * - FrameHandle：帧句柄，捕获失败时为空
+     */
+    FrameHandle captureFrame(uint_fast64_t timestamp);
+
     /**
      * ### 返回图像帧缓冲区
      * 
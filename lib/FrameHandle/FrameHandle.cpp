@@ -0,0 +1,167 @@
+/**
+ * @file FrameHandle.cpp
+ * @author 稀饭
+ * @brief 实现了 FrameHandle 类的引用计数与帧缓冲区归还。
+ */
+
+#include "FrameHandle.h"
+
+static std::atomic<uint32_t> pinnedFrames(0); ///< 尚未归还驱动的帧数
+
+FrameHandle::FrameHandle() : block(nullptr) {}
+
+FrameHandle::FrameHandle(const FrameHandle &other) : block(other.block)
+{
+    if (block)
+    {
+        block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameHandle::FrameHandle(FrameHandle &&other) noexcept : block(other.block)
+{
+    other.block = nullptr;
+}
+
+FrameHandle &FrameHandle::operator=(const FrameHandle &other)
+{
+    if (this != &other)
+    {
+        FrameHandle copy(other);
+        reset();
+        block = copy.detach();
+    }
+    return *this;
+}
+
+FrameHandle &FrameHandle::operator=(FrameHandle &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        block = other.block;
+        other.block = nullptr;
+    }
+    return *this;
+}
+
+FrameHandle::~FrameHandle()
+{
+    reset();
+}
+
+FrameHandle FrameHandle::wrap(camera_fb_t *fb, uint_fast64_t timestamp)
+{
+    if (!fb)
+    {
+        return FrameHandle();
+    }
+    FrameBlock *block = new (std::nothrow) FrameBlock;
+    if (!block)
+    {
+        esp_camera_fb_return(fb);
+        return FrameHandle();
+    }
+    block->fb = fb;
+    block->ownedBuf = nullptr;
+    block->ownedLen = 0;
+    block->timestamp = timestamp;
+    block->refs.store(1, std::memory_order_relaxed);
+    pinnedFrames.fetch_add(1, std::memory_order_relaxed);
+    return FrameHandle(block);
+}
+
+FrameHandle FrameHandle::copyOf(const FrameHandle &frame)
+{
+    if (!frame)
+    {
+        return FrameHandle();
+    }
+    uint8_t *buf = (uint8_t *)ps_malloc(frame.length());
+    if (!buf)
+    {
+        return FrameHandle();
+    }
+    FrameBlock *block = new (std::nothrow) FrameBlock;
+    if (!block)
+    {
+        free(buf);
+        return FrameHandle();
+    }
+    memcpy(buf, frame.data(), frame.length());
+    block->fb = nullptr;
+    block->ownedBuf = buf;
+    block->ownedLen = frame.length();
+    block->timestamp = frame.timestamp();
+    block->refs.store(1, std::memory_order_relaxed);
+    return FrameHandle(block);
+}
+
+FrameHandle FrameHandle::adopt(FrameBlock *block)
+{
+    return FrameHandle(block);
+}
+
+FrameBlock *FrameHandle::detach()
+{
+    FrameBlock *detached = block;
+    block = nullptr;
+    return detached;
+}
+
+/**
+ * ### 释放引用
+ *
+ * 最后一个引用释放时把帧缓冲区归还驱动（或释放副本）并删除控制块。
+ */
+void FrameHandle::reset()
+{
+    if (!block)
+    {
+        return;
+    }
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        if (block->fb)
+        {
+            esp_camera_fb_return(block->fb);
+            pinnedFrames.fetch_sub(1, std::memory_order_relaxed);
+        }
+        free(block->ownedBuf);
+        delete block;
+    }
+    block = nullptr;
+}
+
+const uint8_t *FrameHandle::data() const
+{
+    if (!block)
+    {
+        return nullptr;
+    }
+    return block->fb ? block->fb->buf : block->ownedBuf;
+}
+
+size_t FrameHandle::length() const
+{
+    if (!block)
+    {
+        return 0;
+    }
+    return block->fb ? block->fb->len : block->ownedLen;
+}
+
+uint_fast64_t FrameHandle::timestamp() const
+{
+    return block ? block->timestamp : 0;
+}
+
+uint32_t FrameHandle::useCount() const
+{
+    return block ? block->refs.load(std::memory_order_relaxed) : 0;
+}
+
+uint32_t FrameHandle::pinnedCount()
+{
+    return pinnedFrames.load(std::memory_order_relaxed);
+}
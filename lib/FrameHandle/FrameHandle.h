@@ -0,0 +1,115 @@
+/**
+ * @file FrameHandle.h
+ * @author 稀饭
+ * @brief 定义了 FrameHandle 类，以引用计数的方式在多个消费者之间共享同一个帧缓冲区。
+ */
+
+#ifndef FRAME_HANDLE_H
+#define FRAME_HANDLE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <esp_camera.h>
+
+/**
+ * ### 帧控制块
+ *
+ * 由所有 FrameHandle 共享，引用计数归零时把帧缓冲区归还驱动。
+ */
+struct FrameBlock
+{
+    camera_fb_t *fb;            ///< 驱动的帧缓冲区，为空时数据位于 ownedBuf
+    uint8_t *ownedBuf;          ///< 自有的 JPEG 副本（溢出到 PSRAM 时使用）
+    size_t ownedLen;            ///< 副本长度
+    uint_fast64_t timestamp;    ///< 拍摄时间戳（毫秒）
+    std::atomic<uint32_t> refs; ///< 引用计数
+};
+
+/**
+ * ### 帧句柄
+ *
+ * 包装驱动的帧缓冲区，拷贝句柄只增加引用计数而不复制 JPEG 数据，
+ * 最后一个句柄释放时自动调用 `esp_camera_fb_return`。
+ *
+ * #### 方法
+ *
+ * - `wrap(fb, timestamp)`：接管一个驱动帧缓冲区
+ * - `copyOf(frame)`：把帧复制到 PSRAM，得到不占用驱动缓冲区的独立句柄
+ * - `data()` / `length()` / `timestamp()`：访问帧数据
+ * - `useCount()`：当前引用数
+ * - `pinnedCount()`：仍占用驱动缓冲区的帧数
+ * - `reset()`：释放本句柄持有的引用
+ * - `detach()` / `adopt(block)`：把引用转换为裸指针以便放入 FreeRTOS 队列，再转换回来
+ */
+class FrameHandle
+{
+public:
+    FrameHandle();
+    FrameHandle(const FrameHandle &other);
+    FrameHandle(FrameHandle &&other) noexcept;
+    FrameHandle &operator=(const FrameHandle &other);
+    FrameHandle &operator=(FrameHandle &&other) noexcept;
+    ~FrameHandle();
+
+    /**
+     * ### 接管驱动帧缓冲区
+     *
+     * #### 参数
+     *
+     * - `fb`：`esp_camera_fb_get` 返回的帧缓冲区
+     * - `timestamp`：拍摄时间戳（毫秒）
+     *
+     * #### 返回
+     *
+     * - FrameHandle：引用数为 1 的句柄，`fb` 为空或分配失败时返回空句柄
+     */
+    static FrameHandle wrap(camera_fb_t *fb, uint_fast64_t timestamp);
+
+    /**
+     * ### 复制帧
+     *
+     * 把 JPEG 复制到 PSRAM 并返回新的句柄，原句柄可随即释放以尽快归还驱动缓冲区。
+     *
+     * #### 返回
+     *
+     * - FrameHandle：独立的句柄，内存不足时返回空句柄
+     */
+    static FrameHandle copyOf(const FrameHandle &frame);
+
+    /**
+     * ### 从裸指针恢复句柄
+     *
+     * 接管 `detach()` 交出的引用，不增加引用计数。
+     */
+    static FrameHandle adopt(FrameBlock *block);
+
+    /**
+     * ### 交出引用
+     *
+     * 返回控制块指针并把本句柄置空，引用计数不变，必须由 `adopt()` 接回。
+     */
+    FrameBlock *detach();
+
+    void reset();
+
+    /**
+     * ### 仍占用驱动缓冲区的帧数
+     *
+     * 统计所有尚未归还驱动的 `wrap()` 帧，PSRAM 副本不计入。
+     */
+    static uint32_t pinnedCount();
+
+    const uint8_t *data() const;
+    size_t length() const;
+    uint_fast64_t timestamp() const;
+    uint32_t useCount() const;
+    explicit operator bool() const { return block != nullptr; }
+
+private:
+    explicit FrameHandle(FrameBlock *block) : block(block) {}
+
+    FrameBlock *block; ///< 共享的控制块
+};
+
+#endif // FRAME_HANDLE_H
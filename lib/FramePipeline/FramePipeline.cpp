@@ -0,0 +1,239 @@
+/**
+ * @file FramePipeline.cpp
+ * @author 稀饭
+ * @brief 实现了 FramePipeline 类，包括各级任务的主循环与运行统计。
+ */
+
+#include "FramePipeline.h"
+
+/**
+ * ### 启动流水线
+ *
+ * 创建上传队列，并把拍照任务放在核心 1，上传任务放在与 WiFi 协议栈相同的核心 0。
+ * 写卡任务由 `SdCardManager::startWriter()` 单独启动。
+ *
+ * #### 参数
+ *
+ * - `captureIntervalMs`：两次拍照之间的最小间隔（毫秒）
+ *
+ * #### 返回
+ *
+ * - bool：队列与任务全部创建成功返回 true
+ */
+bool FramePipeline::begin(uint32_t captureIntervalMs)
+{
+    this->captureIntervalMs = captureIntervalMs;
+    uploadQueue = xQueueCreate(PIPELINE_QUEUE_LENGTH, sizeof(PipelineFrame));
+    if (!uploadQueue)
+    {
+        LOG_ERROR(PIPELINE, "流水线队列创建失败");
+        return false;
+    }
+
+    startMs = millis();
+    bool ok = xTaskCreatePinnedToCore(FramePipeline::captureTask, "capture", PIPELINE_CAPTURE_STACK_SIZE, this, 3, nullptr, 1) == pdPASS;
+    ok = ok && xTaskCreatePinnedToCore(FramePipeline::uploadTask, "uploader", PIPELINE_UPLOAD_STACK_SIZE, this, 2, nullptr, 0) == pdPASS;
+    if (!ok)
+    {
+        LOG_ERROR(PIPELINE, "流水线任务创建失败");
+        return false;
+    }
+
+    LOG_INFO(PIPELINE, "流水线启动成功");
+    return true;
+}
+
+/**
+ * ### 获取运行统计
+ */
+PipelineStats FramePipeline::getStats()
+{
+    PipelineStats stats;
+    stats.captured = captured;
+    stats.saved = sdcardManager.getWriterStats().written;
+    stats.uploaded = uploaded;
+    stats.failed = failed;
+    stats.dropped = dropped;
+    stats.elapsedMs = millis() - startMs;
+    return stats;
+}
+
+/**
+ * ### 获取持续上传帧率
+ */
+float FramePipeline::getFps()
+{
+    uint32_t elapsed = millis() - startMs;
+    if (elapsed == 0)
+    {
+        return 0;
+    }
+    return uploaded * 1000.0f / elapsed;
+}
+
+void FramePipeline::captureTask(void *arg)
+{
+    static_cast<FramePipeline *>(arg)->captureLoop();
+}
+
+void FramePipeline::uploadTask(void *arg)
+{
+    static_cast<FramePipeline *>(arg)->uploadLoop();
+}
+
+/**
+ * ### 拍照任务主循环
+ *
+ * 拍照后把帧句柄分别交给写卡和上传任务，各自持有一个引用。
+ * 下游已占满驱动缓冲区配额时改为投递 PSRAM 副本，否则排队的帧会让驱动无缓冲区可用，
+ * 下一次拍照要等到超时（约 4 秒）才返回。
+ * 写卡队列已满时由写卡任务的策略决定丢弃或溢出，上传队列已满时记入离线上传队列
+ * （只放入内存，由上传任务写卡），拍照任务本身从不阻塞在下游，也不读写内存卡。
+ */
+void FramePipeline::captureLoop()
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;)
+    {
+        FrameHandle frame = camera.captureFrame(timeManager.getTimestamp());
+        if (frame && FrameHandle::pinnedCount() > PIPELINE_MAX_PINNED_FRAMES)
+        {
+            frame = FrameHandle::copyOf(frame);
+            if (!frame)
+            {
+                LOG_WARNING(PIPELINE, "PSRAM 不足，当前帧丢弃");
+                dropped++;
+            }
+        }
+        if (frame)
+        {
+            captured++;
+            bool onCard = sdcardManager.submit(frame);
+            if (!onCard)
+            {
+                LOG_WARNING(PIPELINE, "写卡队列已满，当前帧不写卡");
+            }
+            if (!dispatch(frame, onCard))
+            {
+                LOG_WARNING(PIPELINE, "上传队列已满，当前帧不上传");
+                if (onCard)
+                {
+                    uploadBacklog.enqueue(frame.timestamp(), imageName(frame.timestamp()));
+                }
+            }
+        }
+        frame.reset();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(captureIntervalMs));
+    }
+}
+
+/**
+ * ### 上传任务主循环
+ *
+ * 上传到七牛云后通过物模型属性上报图片地址，上传失败且已交给写卡任务的帧记入离线上传队列。
+ * 队列空闲时顺带刷新即将过期的上传凭证，补传离线队列中的积压帧，并定期上报时间同步状态。
+ */
+void FramePipeline::uploadLoop()
+{
+    PipelineFrame item;
+    for (;;)
+    {
+        if (xQueueReceive(uploadQueue, &item, pdMS_TO_TICKS(PIPELINE_IDLE_MS)) != pdTRUE)
+        {
+            qiniuClient.maintain();
+            uploadBacklog.drain();
+            reportStatus();
+            continue;
+        }
+        FrameHandle frame = FrameHandle::adopt(item.block);
+        String name = imageName(frame.timestamp());
+        String url;
+        if (frame.length() > PIPELINE_RESUMABLE_THRESHOLD)
+        {
+            url = resumableUploader.uploadBuffer(name, frame.data(), frame.length());
+        }
+        else
+        {
+            url = qiniuClient.uploadImage(name, frame);
+        }
+        uint_fast64_t timestamp = frame.timestamp();
+        frame.reset();
+        if (url != "")
+        {
+            uploaded++;
+            iotManager.sendProperty("img", url);
+        }
+        else
+        {
+            failed++;
+            iotManager.sendProperty("img", "error");
+            if (item.onCard)
+            {
+                uploadBacklog.enqueue(timestamp, name);
+            }
+            else
+            {
+                LOG_WARNING(PIPELINE, "上传失败的帧未写卡，无法补传: %s", name.c_str());
+            }
+        }
+
+        if (uxQueueMessagesWaiting(uploadQueue) == 0)
+        {
+            uploadBacklog.drain();
+        }
+    }
+}
+
+/**
+ * ### 生成七牛对象名
+ */
+String FramePipeline::imageName(uint_fast64_t timestamp)
+{
+    return String(QINIU_KEY_PREFIX) + String(timestamp) + ".jpg";
+}
+
+/**
+ * ### 向上传队列投递一个帧引用
+ *
+ * #### 参数
+ *
+ * - `frame`：帧句柄，投递的是新增的一个引用
+ * - `onCard`：写卡任务是否接收了该帧
+ *
+ * #### 返回
+ *
+ * - bool：投递成功返回 true；队列已满时释放该引用并计入丢弃数
+ */
+bool FramePipeline::dispatch(const FrameHandle &frame, bool onCard)
+{
+    FrameHandle ref = frame;
+    PipelineFrame item = {ref.detach(), onCard};
+    if (xQueueSend(uploadQueue, &item, 0) == pdTRUE)
+    {
+        return true;
+    }
+    FrameHandle::adopt(item.block).reset();
+    dropped++;
+    return false;
+}
+
+/**
+ * ### 上报时间同步与 WiFi 状态
+ *
+ * 属性队列只允许一个生产者，因此与图片地址一样由上传任务上报。
+ */
+void FramePipeline::reportStatus()
+{
+    if (lastStatusReportMs != 0 && millis() - lastStatusReportMs < PIPELINE_STATUS_REPORT_MS)
+    {
+        return;
+    }
+    lastStatusReportMs = millis() | 1;
+    TimeSyncStats stats = timeManager.getSyncStats();
+    iotManager.sendProperty("timeSyncAge", (int)timeManager.getSyncAge());
+    iotManager.sendProperty("timeDriftPpm", stats.driftPpm);
+    WifiStats wifi = wifiManager.getStats();
+    iotManager.sendProperty("wifiRssi", (int)wifi.rssi);
+    iotManager.sendProperty("wifiUploadKbps", (int)wifi.uploadKbps);
+    iotManager.sendProperty("wifiRoams", (int)wifi.roams);
+}
@@ -0,0 +1,132 @@
+/**
+ * @file FramePipeline.h
+ * @author 稀饭
+ * @brief 定义了 FramePipeline 类，将拍照、写卡、上传拆分为独立任务组成的流水线。
+ */
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "Camera.h"
+#include "FrameHandle.h"
+#include "SdCardManager.h"
+#include "QiniuClient.h"
+#include "ResumableUploader.h"
+#include "UploadBacklog.h"
+#include "IoTManager.h"
+#include "Logger.h"
+#include "TimeManager.h"
+#include "WifiManager.h"
+
+extern Camera camera;
+extern SdCardManager sdcardManager;
+extern QiniuClient qiniuClient;
+extern ResumableUploader resumableUploader;
+extern UploadBacklog uploadBacklog;
+extern IoTManager iotManager;
+extern Logger logger;
+extern TimeManager timeManager;
+extern WifiManager wifiManager;
+
+#define PIPELINE_QUEUE_LENGTH 3          ///< 每级队列可缓存的帧数（超出驱动缓冲区配额的帧以 PSRAM 副本排队）
+#define PIPELINE_MAX_PINNED_FRAMES (CAMERA_FB_COUNT - 1) ///< 下游最多同时占用的驱动缓冲区数，至少留一个给驱动出帧
+#define PIPELINE_CAPTURE_STACK_SIZE 4096 ///< 拍照任务栈大小
+#define PIPELINE_UPLOAD_STACK_SIZE 8192  ///< 上传任务栈大小
+#define PIPELINE_IDLE_MS 1000            ///< 上传任务空闲多久后执行维护工作
+#define PIPELINE_RESUMABLE_THRESHOLD (2 * RESUMABLE_PART_SIZE) ///< 超过该大小的帧改用分片上传；不足两片时分片上传只会多出初始化与合并请求，且无法并发
+#define PIPELINE_STATUS_REPORT_MS 600000   ///< 上报时间同步与 WiFi 状态的间隔
+
+/**
+ * ### 流水线运行统计
+ */
+struct PipelineStats
+{
+    uint32_t captured;  ///< 已拍摄帧数
+    uint32_t saved;     ///< 已写入内存卡的帧数
+    uint32_t uploaded;  ///< 已上传成功的帧数
+    uint32_t failed;    ///< 上传失败的帧数
+    uint32_t dropped;   ///< 因消费者队列已满而未送达的帧数
+    uint32_t elapsedMs; ///< 流水线运行时间
+};
+
+/**
+ * ### 上传队列元素
+ */
+struct PipelineFrame
+{
+    FrameBlock *block; ///< 帧引用，由上传任务接管
+    bool onCard;       ///< 写卡任务是否接收了该帧，未写卡的帧上传失败后无法补传
+};
+
+/**
+ * ### 图像处理流水线
+ *
+ * 拍照、写卡、上传分别运行在独立的 FreeRTOS 任务中，拍照任务把同一帧的引用
+ * 分别交给 SdCardManager 的后台写卡任务和上传队列，两者并行消费同一个驱动缓冲区，
+ * 上一帧还在写卡或上传时拍照任务可以继续使用另一个驱动缓冲区。
+ * 下游已占用 `PIPELINE_MAX_PINNED_FRAMES` 个驱动缓冲区时，新帧先复制到 PSRAM
+ * 并立即归还驱动，保证 `esp_camera_fb_get` 始终有空闲缓冲区可用。
+ *
+ * #### 方法
+ *
+ * - `begin(captureIntervalMs)`：创建队列与任务，启动流水线
+ * - `getStats()`：获取运行统计
+ * - `getFps()`：获取持续上传帧率
+ */
+class FramePipeline
+{
+public:
+    /**
+     * ### 启动流水线
+     *
+     * #### 参数
+     *
+     * - `captureIntervalMs`：两次拍照之间的最小间隔（毫秒）
+     *
+     * #### 返回
+     *
+     * - bool：队列与任务全部创建成功返回 true
+     */
+    bool begin(uint32_t captureIntervalMs);
+
+    /**
+     * ### 获取运行统计
+     */
+    PipelineStats getStats();
+
+    /**
+     * ### 获取持续上传帧率
+     *
+     * #### 返回
+     *
+     * - float：自启动以来平均每秒上传成功的帧数
+     */
+    float getFps();
+
+private:
+    QueueHandle_t uploadQueue = nullptr; ///< 拍照 -> 上传，元素为 PipelineFrame
+    uint32_t captureIntervalMs = 1000;
+    uint32_t startMs = 0;
+
+    volatile uint32_t captured = 0;
+    volatile uint32_t uploaded = 0;
+    volatile uint32_t failed = 0;
+    volatile uint32_t dropped = 0;
+    uint32_t lastStatusReportMs = 0;
+
+    static void captureTask(void *arg);
+    static void uploadTask(void *arg);
+
+    void captureLoop();
+    void uploadLoop();
+
+    bool dispatch(const FrameHandle &frame, bool onCard);
+    void reportStatus();
+    static String imageName(uint_fast64_t timestamp);
+};
+
+#endif // FRAME_PIPELINE_H
@@ -0,0 +1,227 @@
+#include "AlinkWriter.h"
+#include <stdarg.h>
+
+AlinkWriter::AlinkWriter(char *buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity)
+{
+    buffer[0] = '\0';
+    fields[0] = 0;
+}
+
+void AlinkWriter::begin(const char *id, const char *method)
+{
+    writeHead(id, method);
+    // 外层对象与 params 对象各占一层
+    openObject();
+    headOverflow = overflow;
+}
+
+void AlinkWriter::begin(const char *id, const char *method, const char *params)
+{
+    writeHead(id, method);
+    write(params, strlen(params));
+}
+
+void AlinkWriter::writeHead(const char *id, const char *method)
+{
+    position = 0;
+    depth = 1;
+    fields[depth] = 0;
+    overflow = false;
+    write("{\"id\":", 6);
+    writeEscaped(id);
+    write(",\"version\":\"1.0\",\"method\":", 26);
+    writeEscaped(method);
+    write(",\"params\":", 10);
+    headOverflow = overflow;
+}
+
+// 为 depth 个尚未写入的 '}' 与结尾 0 预留空间
+bool AlinkWriter::write(const char *data, size_t length)
+{
+    if (overflow || position + length + depth + 1 > capacity)
+    {
+        overflow = true;
+        return false;
+    }
+    memcpy(buffer + position, data, length);
+    position += length;
+    return true;
+}
+
+// 写入 '{' 并进入下一层，同时为这一层的 '}' 预留空间
+bool AlinkWriter::openObject()
+{
+    depth++;
+    if (!write("{", 1))
+    {
+        depth--;
+        return false;
+    }
+    fields[depth] = 0;
+    return true;
+}
+
+bool AlinkWriter::writeEscaped(const char *value)
+{
+    if (!write("\"", 1))
+    {
+        return false;
+    }
+    for (const char *p = value; *p; p++)
+    {
+        char c = *p;
+        if (c == '"' || c == '\\')
+        {
+            char escaped[2] = {'\\', c};
+            write(escaped, 2);
+        }
+        else if ((uint8_t)c < 0x20)
+        {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            write(escaped, 6);
+        }
+        else
+        {
+            write(&c, 1);
+        }
+    }
+    return write("\"", 1);
+}
+
+bool AlinkWriter::writeKey(const char *key)
+{
+    if (fields[depth] > 0)
+    {
+        write(",", 1);
+    }
+    writeEscaped(key);
+    write(":", 1);
+    fields[depth]++;
+    return !overflow;
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, const char *value)
+{
+    if (writeKey(key))
+    {
+        writeEscaped(value);
+    }
+    return *this;
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, int value)
+{
+    return addNumber(key, "%d", value);
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, long value)
+{
+    return addNumber(key, "%ld", value);
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, unsigned long value)
+{
+    return addNumber(key, "%lu", value);
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, float value)
+{
+    return add(key, (double)value);
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, double value)
+{
+    // JSON 没有 NaN / Infinity
+    if (!isfinite(value))
+    {
+        return addRaw(key, "null", 4);
+    }
+    return addNumber(key, "%.2f", value);
+}
+
+AlinkWriter &AlinkWriter::add(const char *key, bool value)
+{
+    return value ? addRaw(key, "true", 4) : addRaw(key, "false", 5);
+}
+
+AlinkWriter &AlinkWriter::addRaw(const char *key, const char *json, size_t length)
+{
+    if (writeKey(key))
+    {
+        write(json, length);
+    }
+    return *this;
+}
+
+AlinkWriter &AlinkWriter::addNumber(const char *key, const char *format, ...)
+{
+    char number[32];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(number, sizeof(number), format, args);
+    va_end(args);
+    if (length < 0 || length >= (int)sizeof(number))
+    {
+        overflow = true;
+        return *this;
+    }
+    return addRaw(key, number, length);
+}
+
+AlinkWriter &AlinkWriter::beginObject(const char *key)
+{
+    if (depth >= MAX_DEPTH)
+    {
+        overflow = true;
+        return *this;
+    }
+    if (writeKey(key))
+    {
+        openObject();
+    }
+    return *this;
+}
+
+AlinkWriter &AlinkWriter::endObject()
+{
+    // params 与外层对象由 finish() 闭合
+    if (depth > 2)
+    {
+        depth--;
+        buffer[position++] = '}';
+    }
+    return *this;
+}
+
+void AlinkWriter::rewind(size_t mark)
+{
+    // 只用于撤销当前对象中最后写入的一个字段
+    if (mark < position && fields[depth] > 0)
+    {
+        fields[depth]--;
+    }
+    position = mark;
+    overflow = headOverflow;
+}
+
+bool AlinkWriter::finish()
+{
+    // write() 保证了闭合括号的空间，这里仍逐个检查，放不下时宁可失败也不越界
+    while (depth > 0 && position + 1 < capacity)
+    {
+        buffer[position++] = '}';
+        depth--;
+    }
+    if (depth > 0)
+    {
+        overflow = true;
+        depth = 0;
+    }
+    if (position < capacity)
+    {
+        buffer[position] = '\0';
+    }
+    return !overflow;
+}
@@ -0,0 +1,95 @@
+#ifndef ALINK_WRITER_H
+#define ALINK_WRITER_H
+
+#include <Arduino.h>
+
+/**
+ * @class AlinkWriter
+ * @brief 直接向调用方提供的缓冲区写入 Alink 消息，不分配内存。
+ *
+ * 生成 `{"id":"…","version":"1.0","method":"…","params":{…}}` 形式的消息。
+ * 写入时始终为尚未闭合的括号预留空间，因此任何时候调用 finish() 都能得到完整的 JSON；
+ * 空间不足时写入失败并置溢出标志，可用 mark()/rewind() 撤销最后一个属性。
+ * 值的类型由重载决定，不支持的类型在编译期报错。
+ */
+class AlinkWriter {
+public:
+    /**
+     * @param buffer 输出缓冲区。
+     * @param capacity 缓冲区大小（含结尾 0）。
+     */
+    AlinkWriter(char *buffer, size_t capacity);
+
+    /**
+     * @brief 开始一条新消息，写入 id、version、method，并打开 params 对象。
+     * @param id 消息 id。
+     * @param method Alink 方法名，例如 thing.event.property.post。
+     */
+    void begin(const char *id, const char *method);
+
+    /**
+     * @brief 开始一条 params 已序列化好的消息，params 原样写入，之后只需调用 finish()。
+     * @param id 消息 id。
+     * @param method Alink 方法名。
+     * @param params params 的 JSON 文本。
+     */
+    void begin(const char *id, const char *method, const char *params);
+
+    AlinkWriter &add(const char *key, const char *value);
+    AlinkWriter &add(const char *key, int value);
+    AlinkWriter &add(const char *key, long value);
+    AlinkWriter &add(const char *key, unsigned long value);
+    AlinkWriter &add(const char *key, float value);
+    AlinkWriter &add(const char *key, double value);
+    AlinkWriter &add(const char *key, bool value);
+    template <typename T>
+    AlinkWriter &add(const char *key, T value) = delete; // 其他类型需显式转换
+
+    /**
+     * @brief 写入一个已序列化好的 JSON 值（数字、对象等），原样输出。
+     */
+    AlinkWriter &addRaw(const char *key, const char *json, size_t length);
+
+    /**
+     * @brief 打开一个嵌套对象，之后的 add() 写入该对象，直到 endObject()。
+     */
+    AlinkWriter &beginObject(const char *key);
+    AlinkWriter &endObject();
+
+    /**
+     * @brief 记录当前位置，配合 rewind() 撤销之后写入的内容。
+     */
+    size_t mark() const { return position; }
+    void rewind(size_t mark);
+
+    /**
+     * @brief 闭合所有打开的对象并以 0 结尾。
+     * @return 未发生溢出返回 true。
+     */
+    bool finish();
+
+    const char *c_str() const { return buffer; }
+    size_t length() const { return position; }
+    bool overflowed() const { return overflow; }
+    bool empty() const { return fields[depth] == 0; } // 当前对象中还没有字段
+
+private:
+    static const uint8_t MAX_DEPTH = 6;
+
+    char *buffer;
+    size_t capacity;
+    size_t position = 0;
+    uint8_t depth = 0;              // 当前打开的对象层数
+    uint16_t fields[MAX_DEPTH + 1]; // 每一层已写入的字段数，用于决定是否写逗号
+    bool overflow = false;
+    bool headOverflow = false; // 消息头本身放不下，rewind() 不能清除
+
+    bool write(const char *data, size_t length);
+    bool openObject();
+    bool writeEscaped(const char *value);
+    bool writeKey(const char *key);
+    void writeHead(const char *id, const char *method);
+    AlinkWriter &addNumber(const char *key, const char *format, ...);
+};
+
+#endif // ALINK_WRITER_H
@@ -0,0 +1,140 @@
+#include "CallbackIndex.h"
+
+// FNV-1a
+uint32_t CallbackIndex::hashKey(const char *key, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool CallbackIndex::isWildcard(const String &key)
+{
+    return key.indexOf('+') >= 0 || key.indexOf('#') >= 0;
+}
+
+void CallbackIndex::bind(const String &key, callbackFunction callbackFn)
+{
+    std::vector<CallbackEntry> &entries = isWildcard(key) ? wildcards : exact;
+    for (auto &entry : entries)
+    {
+        if (entry.key == key)
+        {
+            entry.callbackFn = callbackFn;
+            return;
+        }
+    }
+    entries.push_back({key, hashKey(key.c_str(), key.length()), callbackFn});
+    rebuild();
+}
+
+bool CallbackIndex::unbind(const String &key)
+{
+    std::vector<CallbackEntry> &entries = isWildcard(key) ? wildcards : exact;
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->key == key)
+        {
+            entries.erase(it);
+            rebuild();
+            return true;
+        }
+    }
+    return false;
+}
+
+// 表长取不小于 2 倍条目数的 2 的幂，保证线性探测总能遇到空位
+void CallbackIndex::rebuild()
+{
+    size_t capacity = 8;
+    while (capacity < exact.size() * 2)
+    {
+        capacity <<= 1;
+    }
+    buckets.assign(capacity, -1);
+    for (size_t i = 0; i < exact.size(); i++)
+    {
+        size_t slot = exact[i].hash & (capacity - 1);
+        while (buckets[slot] >= 0)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        buckets[slot] = (int16_t)i;
+    }
+}
+
+callbackFunction CallbackIndex::find(const char *key, size_t length) const
+{
+    if (exact.empty())
+    {
+        return nullptr;
+    }
+    uint32_t hash = hashKey(key, length);
+    size_t mask = buckets.size() - 1;
+    for (size_t slot = hash & mask; buckets[slot] >= 0; slot = (slot + 1) & mask)
+    {
+        const CallbackEntry &entry = exact[buckets[slot]];
+        if (entry.hash == hash && entry.key.length() == length && memcmp(entry.key.c_str(), key, length) == 0)
+        {
+            return entry.callbackFn;
+        }
+    }
+    return nullptr;
+}
+
+size_t CallbackIndex::dispatchTopic(const char *topic, JsonVariant jsonVariant) const
+{
+    size_t called = 0;
+    callbackFunction callbackFn = find(topic, strlen(topic));
+    if (callbackFn)
+    {
+        callbackFn(jsonVariant);
+        called++;
+    }
+    for (const auto &entry : wildcards)
+    {
+        if (topicMatches(entry.key.c_str(), topic))
+        {
+            entry.callbackFn(jsonVariant);
+            called++;
+        }
+    }
+    return called;
+}
+
+// `+` 匹配单个层级，`#` 匹配其后的所有层级（包括父层级本身）
+bool CallbackIndex::topicMatches(const char *filter, const char *topic)
+{
+    while (*filter)
+    {
+        if (*filter == '#')
+        {
+            return true;
+        }
+        if (*filter == '+')
+        {
+            while (*topic && *topic != '/')
+            {
+                topic++;
+            }
+            filter++;
+            continue;
+        }
+        if (*topic == '\0')
+        {
+            // "a/#" 同时匹配 "a"
+            return filter[0] == '/' && filter[1] == '#' && filter[2] == '\0';
+        }
+        if (*filter != *topic)
+        {
+            return false;
+        }
+        filter++;
+        topic++;
+    }
+    return *topic == '\0';
+}
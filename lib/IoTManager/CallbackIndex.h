@@ -0,0 +1,73 @@
+#ifndef CALLBACK_INDEX_H
+#define CALLBACK_INDEX_H
+
+#include <vector>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+typedef void (*callbackFunction)(JsonVariant);
+
+struct CallbackEntry {
+    String key;
+    uint32_t hash;
+    callbackFunction callbackFn;
+};
+
+/**
+ * @class CallbackIndex
+ * @brief 回调函数的分发索引。
+ *
+ * 精确的属性名和主题放在开放寻址哈希表中，查找时直接使用收到的字符串指针和长度，不构造临时 String；
+ * 含 MQTT `+`/`#` 通配符的主题过滤器单独保存，只在精确查找之外逐个匹配。
+ * 索引在绑定和解绑时重建，分发路径上不分配内存。
+ */
+class CallbackIndex {
+public:
+    /**
+     * @brief 绑定回调函数，同一个键重复绑定时替换原有回调。
+     * @param key 属性名、主题或主题过滤器。
+     * @param callbackFn 回调函数。
+     */
+    void bind(const String &key, callbackFunction callbackFn);
+
+    /**
+     * @brief 解除绑定。
+     * @param key 绑定时使用的键。
+     * @return 找到并移除返回 true。
+     */
+    bool unbind(const String &key);
+
+    /**
+     * @brief 精确查找。
+     * @param key 键的起始地址，不要求以 0 结尾。
+     * @param length 键的长度。
+     * @return 找到返回回调函数，否则返回 nullptr。
+     */
+    callbackFunction find(const char *key, size_t length) const;
+
+    /**
+     * @brief 把主题分发给精确匹配和所有匹配的通配符过滤器。
+     * @param topic 收到的主题。
+     * @param jsonVariant 消息内容。
+     * @return 调用的回调数量。
+     */
+    size_t dispatchTopic(const char *topic, JsonVariant jsonVariant) const;
+
+    /**
+     * @brief 判断主题是否匹配 MQTT 主题过滤器。
+     */
+    static bool topicMatches(const char *filter, const char *topic);
+
+    size_t size() const { return exact.size() + wildcards.size(); }
+
+private:
+    std::vector<CallbackEntry> exact;     // 精确键
+    std::vector<CallbackEntry> wildcards; // 含通配符的主题过滤器
+    std::vector<int16_t> buckets;         // 开放寻址表，保存 exact 的下标，-1 表示空
+
+    static uint32_t hashKey(const char *key, size_t length);
+    static bool isWildcard(const String &key);
+    void rebuild();
+};
+
+#endif // CALLBACK_INDEX_H
@@ -0,0 +1,213 @@
+#include "DeliveryWindow.h"
+#include <algorithm>
+#include <esp_system.h>
+
+void DeliveryWindow::begin()
+{
+    if (!mutex)
+    {
+        mutex = xSemaphoreCreateMutex();
+        // 随机起点，避免重启后与平台上尚未过期的 id 重复
+        nextId = esp_random() & 0x7fffffff;
+    }
+}
+
+InFlightMessage *DeliveryWindow::reserve(const char *topic)
+{
+    if (!mutex || strlen(topic) >= DELIVERY_TOPIC_SIZE)
+    {
+        return nullptr;
+    }
+    InFlightMessage *message = nullptr;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto &slot : slots)
+    {
+        if (slot.state == DELIVERY_FREE)
+        {
+            message = &slot;
+            message->state = DELIVERY_RESERVED;
+            message->id = ++nextId;
+            message->attempts = 0;
+            message->length = 0;
+            strcpy(message->topic, topic);
+            break;
+        }
+    }
+    if (!message)
+    {
+        stats.windowFull++;
+    }
+    xSemaphoreGive(mutex);
+    return message;
+}
+
+// 调用方需持有互斥量。未连接时的失败不计入发送次数，其他失败与成功一样计入；
+// 发送次数用尽且本次失败时放弃消息
+bool DeliveryWindow::publish(InFlightMessage &message)
+{
+    message.lastSentMs = millis();
+    bool success = mqttClient.publish(message.topic, (const uint8_t *)message.payload, message.length, false);
+    if (success || mqttClient.connected())
+    {
+        message.attempts++;
+    }
+    if (!success && message.attempts >= DELIVERY_MAX_ATTEMPTS)
+    {
+        expire(message);
+    }
+    return success;
+}
+
+// 调用方需持有互斥量
+void DeliveryWindow::expire(InFlightMessage &message)
+{
+    LOG_ERROR(MQTT, "消息 %lu 发送 %u 次仍未成功，已放弃: %s", (unsigned long)message.id, (unsigned)message.attempts,
+              message.topic);
+    message.state = DELIVERY_FREE;
+    stats.expired++;
+}
+
+bool DeliveryWindow::send(InFlightMessage *message, size_t length)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    message->length = length;
+    message->state = DELIVERY_IN_FLIGHT;
+    message->firstSentMs = millis();
+    bool success = publish(*message);
+    xSemaphoreGive(mutex);
+    return success;
+}
+
+void DeliveryWindow::cancel(InFlightMessage *message)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    message->state = DELIVERY_FREE;
+    xSemaphoreGive(mutex);
+}
+
+bool DeliveryWindow::acknowledge(uint32_t id, int code)
+{
+    if (!mutex)
+    {
+        return false;
+    }
+    bool found = false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto &slot : slots)
+    {
+        if (slot.state == DELIVERY_IN_FLIGHT && slot.id == id)
+        {
+            found = true;
+            slot.state = DELIVERY_FREE;
+            if (code == 200)
+            {
+                stats.acked++;
+                recordLatency(millis() - slot.firstSentMs);
+            }
+            else
+            {
+                stats.rejected++;
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+    return found;
+}
+
+void DeliveryWindow::retransmitAll()
+{
+    if (!mutex)
+    {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto &slot : slots)
+    {
+        if (slot.state == DELIVERY_IN_FLIGHT && mqttClient.connected())
+        {
+            if (slot.attempts > 0)
+            {
+                stats.retransmits++;
+            }
+            publish(slot);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void DeliveryWindow::retransmitExpired()
+{
+    if (!mutex)
+    {
+        return;
+    }
+    uint32_t now = millis();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto &slot : slots)
+    {
+        if (slot.state != DELIVERY_IN_FLIGHT || now - slot.lastSentMs < DELIVERY_ACK_TIMEOUT_MS)
+        {
+            continue;
+        }
+        if (slot.attempts >= DELIVERY_MAX_ATTEMPTS)
+        {
+            expire(slot);
+            continue;
+        }
+        // 断线期间不消耗重发次数，交给重连后的 retransmitAll()
+        if (mqttClient.connected())
+        {
+            stats.retransmits++;
+            publish(slot);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+size_t DeliveryWindow::available()
+{
+    size_t count = 0;
+    for (auto &slot : slots)
+    {
+        if (slot.state == DELIVERY_FREE)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void DeliveryWindow::recordLatency(uint32_t ms)
+{
+    latencies[latencyCount % DELIVERY_LATENCY_SAMPLES] = ms;
+    latencyCount++;
+}
+
+DeliveryStats DeliveryWindow::getStats()
+{
+    uint32_t samples[DELIVERY_LATENCY_SAMPLES];
+    size_t count;
+    DeliveryStats result;
+    if (mutex)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+    }
+    result = stats;
+    result.inFlight = DELIVERY_WINDOW_SIZE - available();
+    count = std::min(latencyCount, (size_t)DELIVERY_LATENCY_SAMPLES);
+    memcpy(samples, latencies, count * sizeof(uint32_t));
+    if (mutex)
+    {
+        xSemaphoreGive(mutex);
+    }
+
+    if (count > 0)
+    {
+        std::sort(samples, samples + count);
+        result.p50Ms = samples[(count - 1) * 50 / 100];
+        result.p90Ms = samples[(count - 1) * 90 / 100];
+        result.p99Ms = samples[(count - 1) * 99 / 100];
+    }
+    return result;
+}
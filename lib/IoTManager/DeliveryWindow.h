@@ -0,0 +1,129 @@
+#ifndef DELIVERY_WINDOW_H
+#define DELIVERY_WINDOW_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "Logger.h"
+
+extern PubSubClient mqttClient;
+extern Logger logger;
+
+#define DELIVERY_WINDOW_SIZE 4         // 同时等待应答的消息数上限
+#define DELIVERY_PAYLOAD_SIZE 1024     // 单条消息负载上限（含结尾 0）
+#define DELIVERY_TOPIC_SIZE 128        // 主题长度上限（含结尾 0）
+#define DELIVERY_ACK_TIMEOUT_MS 10000  // 超过该时长未收到应答则重发
+#define DELIVERY_MAX_ATTEMPTS 4        // 最多发送次数（含首次），之后放弃
+#define DELIVERY_LATENCY_SAMPLES 32    // 用于计算应答延迟分位数的样本数
+
+enum DeliveryState : uint8_t {
+    DELIVERY_FREE,     // 空闲
+    DELIVERY_RESERVED, // 已分配 id，正在写入负载
+    DELIVERY_IN_FLIGHT // 已发送，等待应答
+};
+
+struct InFlightMessage {
+    DeliveryState state = DELIVERY_FREE;
+    uint8_t attempts = 0;      // 已发送次数
+    uint32_t id = 0;           // Alink 消息 id
+    uint32_t firstSentMs = 0;  // 首次发送时间
+    uint32_t lastSentMs = 0;   // 最近一次发送时间
+    size_t length = 0;
+    char topic[DELIVERY_TOPIC_SIZE];
+    char payload[DELIVERY_PAYLOAD_SIZE];
+};
+
+struct DeliveryStats {
+    size_t inFlight = 0;      // 当前等待应答的消息数
+    uint32_t acked = 0;       // 收到成功应答的消息数
+    uint32_t rejected = 0;    // 收到错误应答的消息数（平台已收到，不重发）
+    uint32_t retransmits = 0; // 重发次数
+    uint32_t expired = 0;     // 重发次数用尽后放弃的消息数
+    uint32_t windowFull = 0;  // 窗口已满无法发送的次数
+    uint32_t p50Ms = 0;       // 最近样本的应答延迟分位数
+    uint32_t p90Ms = 0;
+    uint32_t p99Ms = 0;
+};
+
+/**
+ * @class DeliveryWindow
+ * @brief 基于 Alink `_reply` 应答的可靠投递窗口。
+ *
+ * PubSubClient 只能以 QoS 0 发布，因此按 QoS 1 的语义在应用层实现：每条消息带唯一 id 保留在窗口中，
+ * 收到相同 id 的 `_reply` 后释放；超时未应答则重发，重新连接后立即重发所有未应答的消息。
+ * 未连接时发布失败不消耗发送次数；已连接仍发布失败（例如超出发布缓冲区）计入发送次数，
+ * 次数用尽后放弃，避免发不出去的消息一直占住槽位。
+ * 窗口已满时不再接收新消息，由调用方保留待发数据（背压）。
+ * 属性、事件、应答分别在不同任务中处理，窗口状态由互斥量保护。
+ */
+class DeliveryWindow {
+public:
+    /**
+     * @brief 创建互斥量并初始化消息 id 序列。
+     */
+    void begin();
+
+    /**
+     * @brief 分配一个窗口槽位和新的消息 id，调用方随后写入 payload 并调用 send() 或 cancel()。
+     * @param topic 发布主题。
+     * @return 窗口已满或主题过长时返回 nullptr。
+     */
+    InFlightMessage *reserve(const char *topic);
+
+    /**
+     * @brief 发布已写好负载的消息并开始等待应答。未连接时发布失败，消息保留到重连后重发；
+     * 发送次数用尽时放弃消息并释放槽位。
+     * @param message reserve() 得到的槽位，返回后不能再访问。
+     * @param length 负载长度。
+     * @return 本次发布成功返回 true。
+     */
+    bool send(InFlightMessage *message, size_t length);
+
+    /**
+     * @brief 放弃 reserve() 得到的槽位。
+     */
+    void cancel(InFlightMessage *message);
+
+    /**
+     * @brief 处理一条 `_reply` 应答。
+     * @param id 应答中的消息 id。
+     * @param code 应答码，200 表示成功。
+     * @return id 在窗口中返回 true。
+     */
+    bool acknowledge(uint32_t id, int code);
+
+    /**
+     * @brief 重发所有未应答的消息，在重新连接后调用。
+     */
+    void retransmitAll();
+
+    /**
+     * @brief 重发超时未应答的消息，放弃重发次数用尽的消息。
+     */
+    void retransmitExpired();
+
+    /**
+     * @brief 当前空闲槽位数。
+     */
+    size_t available();
+
+    /**
+     * @brief 获取投递统计。
+     */
+    DeliveryStats getStats();
+
+private:
+    InFlightMessage slots[DELIVERY_WINDOW_SIZE];
+    SemaphoreHandle_t mutex = nullptr;
+    uint32_t nextId = 0;
+    DeliveryStats stats;
+    uint32_t latencies[DELIVERY_LATENCY_SAMPLES];
+    size_t latencyCount = 0;
+
+    bool publish(InFlightMessage &message);
+    void expire(InFlightMessage &message);
+    void recordLatency(uint32_t ms);
+};
+
+#endif // DELIVERY_WINDOW_H
@@ -1,7 +1,10 @@
 #include "IoTManager.h"
+#include "esp_timer.h"
 
 IoTManager* IoTManager::instance = nullptr;
 
+static_assert(DELIVERY_PAYLOAD_SIZE >= MAX_BUFFER_SIZE, "delivery slots must hold a full MQTT payload");
+
 IoTManager::IoTManager(String productKey, String deviceName, String deviceSecret, String hostUrl, u_short port)
     : productKey(productKey),
       deviceName(deviceName),
@@ -24,56 +27,44 @@ IoTManager::IoTManager(String productKey, String deviceName, String deviceSecret
     snprintf(topicBuffer, MAX_TOPIC_SIZE, ALINK_TOPIC_EVENT, productKey.c_str(), deviceName.c_str());
     this->topicEvent = String(topicBuffer);
 
-    snprintf(topicBuffer, MAX_TOPIC_SIZE, ALINK_TOPIC_USER, productKey.c_str(), deviceName.c_str());
+    // 自定义主题只生成前缀，后缀由 publishUser/subscribeUser 拼接
+    snprintf(topicBuffer, MAX_TOPIC_SIZE, ALINK_TOPIC_USER, productKey.c_str(), deviceName.c_str(), "");
     this->topicUser = String(topicBuffer);
 
+    snprintf(topicBuffer, MAX_TOPIC_SIZE, ALINK_TOPIC_REPLY, productKey.c_str(), deviceName.c_str());
+    this->topicReply = String(topicBuffer);
+
+    snprintf(topicBuffer, MAX_TOPIC_SIZE, ALINK_TOPIC_NTP_REQUEST, productKey.c_str(), deviceName.c_str());
+    this->topicNtpRequest = String(topicBuffer);
+
+    snprintf(topicBuffer, MAX_TOPIC_SIZE, ALINK_TOPIC_NTP_RESPONSE, productKey.c_str(), deviceName.c_str());
+    this->topicNtpResponse = String(topicBuffer);
+
     delete[] topicBuffer;  // 释放动态分配的缓冲区
 }
 
 String IoTManager::sign(const char *plaintext)
 {
-   
-
-   // 转换字符串到 C 样式的 char 数组
-    const char *key = deviceSecret.c_str();
-    size_t keySize = deviceSecret.length();
-    uint8_t *sign = new uint8_t[32]; // SHA-256 produces a 32-byte hash
-
-    // 初始化 mbedTLS HMAC 上下文
-    mbedtls_md_context_t ctx;
-    const mbedtls_md_info_t *md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
-
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, md_info, 1);
-
-    // 开始 HMAC 计算
-    mbedtls_md_hmac_starts(&ctx, (const unsigned char *)key, keySize);
-
-    // 输入数据进行 HMAC 计算
-    mbedtls_md_hmac_update(&ctx, (const unsigned char *)plaintext, strlen(plaintext));
-
-    // 完成 HMAC 计算并获取结果
-    mbedtls_md_hmac_finish(&ctx, sign);
-
-    // 释放 mbedTLS HMAC 上下文
-    mbedtls_md_free(&ctx);
-
-    // 将 HMAC 签名转换为十六进制字符串
-    char hexSign[32 * 2 + 1];
-    for (int i = 0; i < 32; i++) {
-        sprintf(&hexSign[i * 2], "%02x", sign[i]);
+    // 密钥块只在第一次签名时派生
+    if (!deviceMac.keyed())
+    {
+        deviceMac.setKey(deviceSecret);
     }
-    hexSign[32 * 2] = '\0';
-
-    // 清理内存
-    delete[] sign;
-
-    String result = String(hexSign);
-    return result;
+    char hexSign[SHA256HMAC_SIZE * 2 + 1];
+    if (!deviceMac.signHex(plaintext, hexSign))
+    {
+        return "";
+    }
+    return String(hexSign);
 }
 
-bool IoTManager::connect()
+void IoTManager::refreshCredentials()
 {
+    bool synced = timeManager.isSynced();
+    if (credentialsAtMs != 0 && millis() - credentialsAtMs < MQTT_CREDENTIAL_TTL_MS && credentialsSynced == synced)
+    {
+        return;
+    }
     String timestamp = String(timeManager.getTimestamp());
     char clientIdBuffer[256];
     snprintf(clientIdBuffer, sizeof(clientIdBuffer), "%s|securemode=2,signmethod=hmacsha256,timestamp=%s|", briefId.c_str(), timestamp.c_str());
@@ -83,38 +74,238 @@ bool IoTManager::connect()
     snprintf(plainTextBuffer, sizeof(plainTextBuffer), "clientId%sdeviceName%sproductKey%s%s%s",
              briefId.c_str(), deviceName.c_str(), productKey.c_str(), "timestamp", timestamp.c_str());
     this->password = sign(plainTextBuffer);
+    credentialsAtMs = millis() | 1;
+    credentialsSynced = synced;
+    connectionStats.signatures++;
+}
+
+bool IoTManager::connect()
+{
+    delivery.begin();
     mqttClient.setServer(hostUrl.c_str(), port);
     mqttClient.setBufferSize(MAX_BUFFER_SIZE);
     mqttClient.setKeepAlive(KEEP_ALIVE_INTERVAL);
+    mqttClient.setSocketTimeout(MQTT_HANDSHAKE_TIMEOUT);
     mqttClient.setClient(wifiClient);
     mqttClient.setCallback(IoTManager::mqttCallback);
-    mqttClient.connect(clientId.c_str(), username.c_str(), password.c_str());
-    if (mqttClient.connected())
+
+    if (state == MQTT_STATE_STOPPED)
     {
-        logger.info("MQTT连接成功", "MQTT");
-        connectionCheckTicker.attach(CONNECTION_CHECK_INTERVAL, IoTManager::checkConnectionCallback);
-        queueCheckTicker.attach(MESSAGE_QUEUE_CHECK_INTERVAL, IoTManager::checkMessageQueueCallback);
+        state = MQTT_STATE_BACKOFF;
+        nextAttemptMs = millis();
+        disconnectedAtMs = millis();
+        queueCheckedMs = millis();
     }
-    else
+
+    // 建立 TCP 连接与 MQTT 握手各推进一步
+    checkConnection();
+    checkConnection();
+    return state == MQTT_STATE_CONNECTED;
+}
+
+bool IoTManager::openSocket()
+{
+    if (brokerAddress == IPAddress() || consecutiveFailures % MQTT_DNS_RETRY_FAILURES == MQTT_DNS_RETRY_FAILURES - 1)
     {
-        logError();
+        IPAddress resolved;
+        if (!WiFi.hostByName(hostUrl.c_str(), resolved))
+        {
+            LOG_ERROR(MQTT, "MQTT代理域名解析失败: %s", hostUrl.c_str());
+            return brokerAddress != IPAddress() && wifiClient.connect(brokerAddress, port, MQTT_TCP_CONNECT_TIMEOUT_MS);
+        }
+        brokerAddress = resolved;
     }
-    return mqttClient.connected();
+    return wifiClient.connect(brokerAddress, port, MQTT_TCP_CONNECT_TIMEOUT_MS);
 }
 
 void IoTManager::checkConnection()
 {
-    if (!mqttClient.connected())
+    switch (state)
     {
+    case MQTT_STATE_STOPPED:
+        return;
+
+    case MQTT_STATE_CONNECTED:
+        if (!mqttClient.connected())
+        {
+            logError();
+            LOG_INFO(MQTT, "MQTT连接断开，尝试重新连接……");
+            onDisconnected();
+        }
+        return;
+
+    case MQTT_STATE_BACKOFF:
+        if (WiFi.status() != WL_CONNECTED || (int32_t)(millis() - nextAttemptMs) < 0)
+        {
+            return;
+        }
+        // 签名包含时间戳，首选 SNTP 时先等待同步，超过 MQTT_TIME_WAIT_MS 仍未同步则照常连接并通过 MQTT 校时；
+        // 首选 MQTT 时直接连接
+        if (!timeManager.isSynced() && timeManager.getPrimarySource() == TIME_SOURCE_SNTP &&
+            millis() - disconnectedAtMs < MQTT_TIME_WAIT_MS)
+        {
+            return;
+        }
+        connectionStats.attempts++;
+        if (!openSocket())
+        {
+            LOG_WARNING(MQTT, "MQTT代理TCP连接失败");
+            scheduleRetry();
+            return;
+        }
+        state = MQTT_STATE_HANDSHAKE;
+        return;
+
+    case MQTT_STATE_HANDSHAKE:
+        // TCP 已连接，PubSubClient 只发送 CONNECT 并等待 CONNACK
+        refreshCredentials();
+        if (mqttClient.connect(clientId.c_str(), username.c_str(), password.c_str()))
+        {
+            onConnected();
+            return;
+        }
         logError();
-        logger.info("MQTT连接断开，尝试重新连接……", "MQTT");
-        connect();
+        if (mqttClient.state() == MQTT_CONNECT_BAD_CREDENTIALS || mqttClient.state() == MQTT_CONNECT_UNAUTHORIZED)
+        {
+            credentialsAtMs = 0;
+        }
+        wifiClient.stop();
+        scheduleRetry();
+        return;
+    }
+}
+
+void IoTManager::onConnected()
+{
+    state = MQTT_STATE_CONNECTED;
+    consecutiveFailures = 0;
+    uint32_t outageMs = millis() - disconnectedAtMs;
+    connectionStats.disconnectedMs += outageMs;
+    // 除首次连接外都计为重连
+    if (connectionStats.attempts - connectionStats.failures > 1)
+    {
+        connectionStats.reconnects++;
+        connectionStats.lastReconnectMs = outageMs;
+        connectionStats.maxReconnectMs = max(connectionStats.maxReconnectMs, outageMs);
+    }
+    LOG_INFO(MQTT, "MQTT连接成功，断开 %lu ms", (unsigned long)outageMs);
+
+    // 订阅属性与事件上报的应答、校时应答和所有已绑定的主题，并重发断线前未收到应答的消息
+    mqttClient.subscribe(topicReply.c_str());
+    mqttClient.subscribe(topicNtpResponse.c_str());
+    ntpRequestedMs = 0;
+    for (const auto &subscription : subscriptions)
+    {
+        mqttClient.subscribe(subscription.topic.c_str(), subscription.qos);
+    }
+    delivery.retransmitAll();
+}
+
+void IoTManager::onDisconnected()
+{
+    state = MQTT_STATE_BACKOFF;
+    disconnectedAtMs = millis();
+    nextAttemptMs = millis();
+    wifiClient.stop();
+}
+
+void IoTManager::scheduleRetry()
+{
+    state = MQTT_STATE_BACKOFF;
+    connectionStats.failures++;
+    consecutiveFailures++;
+    uint32_t delayMs = MQTT_BACKOFF_BASE_MS << min(consecutiveFailures - 1, (uint32_t)6);
+    delayMs = min(delayMs, (uint32_t)MQTT_BACKOFF_MAX_MS);
+    // 在 [delay/2, delay] 之间随机，避免大量设备同时重连
+    nextAttemptMs = millis() + delayMs / 2 + esp_random() % (delayMs / 2 + 1);
+}
+
+MqttConnectionStats IoTManager::getConnectionStats()
+{
+    MqttConnectionStats stats = connectionStats;
+    if (state != MQTT_STATE_CONNECTED && state != MQTT_STATE_STOPPED)
+    {
+        stats.disconnectedMs += millis() - disconnectedAtMs;
+    }
+    return stats;
+}
+
+void IoTManager::onNetworkChange(bool up)
+{
+    if (state == MQTT_STATE_STOPPED)
+    {
+        return;
+    }
+    if (!up)
+    {
+        // 不必等 keepalive 超时才发现连接已断开
+        if (state != MQTT_STATE_BACKOFF)
+        {
+            LOG_INFO(MQTT, "WiFi 断开，MQTT 等待网络恢复");
+            onDisconnected();
+        }
+        return;
+    }
+    if (state == MQTT_STATE_BACKOFF)
+    {
+        // 失败多半是网络不可用造成的，网络恢复后不再等待退避
+        consecutiveFailures = 0;
+        nextAttemptMs = millis();
     }
 }
 
 void IoTManager::loop()
 {
-    mqttClient.loop();
+    checkConnection();
+    if (state == MQTT_STATE_CONNECTED)
+    {
+        mqttClient.loop();
+        if (timeManager.needsNetworkTime() && (ntpRequestedMs == 0 || millis() - ntpRequestedMs >= MQTT_NTP_RETRY_MS))
+        {
+            requestNetworkTime();
+        }
+    }
+    // 属性发送与重发都在这里进行，与连接、订阅、校时共用同一个任务，mqttClient 不会被并发使用
+    if (state != MQTT_STATE_STOPPED && millis() - queueCheckedMs >= MESSAGE_QUEUE_CHECK_INTERVAL_MS)
+    {
+        queueCheckedMs = millis();
+        checkMessageQueue();
+    }
+}
+
+void IoTManager::requestNetworkTime()
+{
+    char payload[48];
+    ntpSendMs = esp_timer_get_time() / 1000;
+    snprintf(payload, sizeof(payload), "{\"deviceSendTime\":\"%lld\"}", (long long)ntpSendMs);
+    mqttClient.publish(topicNtpRequest.c_str(), payload);
+    ntpRequestedMs = millis() | 1;
+}
+
+// 平台返回的时间可能是字符串也可能是数字
+static int64_t alinkTime(JsonVariant value)
+{
+    if (value.is<const char *>())
+    {
+        return strtoll(value.as<const char *>(), nullptr, 10);
+    }
+    return (int64_t)value.as<double>();
+}
+
+/**
+ * 只接受最近一次请求的应答：重试之前的请求或重复投递的应答会带着过期的往返时间，直接丢弃。
+ */
+void IoTManager::processNtpResponse(JsonVariant jsonVariant, int64_t receivedMs)
+{
+    int64_t deviceSendMs = alinkTime(jsonVariant["deviceSendTime"]);
+    if (ntpSendMs < 0 || deviceSendMs != ntpSendMs)
+    {
+        LOG_WARNING(MQTT, "丢弃与当前请求不匹配的校时应答");
+        return;
+    }
+    ntpSendMs = -1;
+    timeManager.applyNetworkTime(alinkTime(jsonVariant["serverRecvTime"]), alinkTime(jsonVariant["serverSendTime"]),
+                                 deviceSendMs, receivedMs);
 }
 
 bool IoTManager::publish(String topic, String payload, bool retained)
@@ -150,68 +341,166 @@ bool IoTManager::unsubscribeUser(String topicSuffix)
 
 bool IoTManager::subscribe(String topic, uint8_t qos, callbackFunction fp)
 {
-    bool ret = false;
-    if (mqttClient.subscribe(topic.c_str(), qos))
+    if (!bindData(topic, fp))
+    {
+        return false;
+    }
+    bool recorded = false;
+    for (auto &subscription : subscriptions)
     {
-        ret = true;
-        bindData(topic, fp);
-        logger.info("订阅: " + topic, "MQTT");
+        if (subscription.topic == topic)
+        {
+            subscription.qos = qos;
+            recorded = true;
+        }
+    }
+    if (!recorded)
+    {
+        subscriptions.push_back({topic, qos});
+    }
+
+    // 未连接时只记录，连接成功后统一订阅
+    if (state != MQTT_STATE_CONNECTED)
+    {
+        LOG_INFO(MQTT, "待连接后订阅: %s", topic.c_str());
+        return true;
+    }
+    bool ret = mqttClient.subscribe(topic.c_str(), qos);
+    if (ret)
+    {
+        LOG_INFO(MQTT, "订阅: %s", topic.c_str());
     }
     return ret;
 }
 
+bool IoTManager::subscribe(String topic, callbackFunction fp)
+{
+    return subscribe(topic, 0, fp);
+}
+
 bool IoTManager::unsubscribe(String topic)
 {
-    bool ret = false;
-    if (mqttClient.unsubscribe(topic.c_str()))
+    for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it)
+    {
+        if (it->topic == topic)
+        {
+            subscriptions.erase(it);
+            break;
+        }
+    }
+    unbindData(topic);
+    if (state != MQTT_STATE_CONNECTED)
     {
-        ret = true;
-        unbindData(topic);
-        logger.info("取消订阅: " + topic, "MQTT");
+        return true;
+    }
+    bool ret = mqttClient.unsubscribe(topic.c_str());
+    if (ret)
+    {
+        LOG_INFO(MQTT, "取消订阅: %s", topic.c_str());
     }
     return ret;
 }
 
 void IoTManager::sendProperty(String key, String value)
 {
-    PropertyMessage msg = {key, value};
-    messageQueue.push_back(msg);
+    enqueueProperty(key.c_str(), value.c_str(), PROPERTY_STRING);
 }
 
 void IoTManager::sendProperty(String key, int value)
 {
-    PropertyMessage msg = {key, String(value)};
-    messageQueue.push_back(msg);
+    char number[16];
+    snprintf(number, sizeof(number), "%d", value);
+    enqueueProperty(key.c_str(), number, PROPERTY_NUMBER);
 }
 void IoTManager::sendProperty(String key, float value)
 {
-    PropertyMessage msg = {key, String(value)};
-    messageQueue.push_back(msg);
+    sendProperty(key, (double)value);
 }
 
 void IoTManager::sendProperty(String key, double value)
 {
-    PropertyMessage msg = {key, String(value)};
-    messageQueue.push_back(msg);
+    // JSON 没有 NaN / Infinity，按 null 上报
+    char number[32];
+    if (isfinite(value))
+    {
+        snprintf(number, sizeof(number), "%.2f", value);
+    }
+    else
+    {
+        strcpy(number, "null");
+    }
+    enqueueProperty(key.c_str(), number, PROPERTY_NUMBER);
 }
+
+bool IoTManager::enqueueProperty(const char *key, const char *value, PropertyType type)
+{
+    if (strlen(key) >= PROPERTY_KEY_SIZE || strlen(value) >= PROPERTY_VALUE_SIZE)
+    {
+        // 截断会上报错误的值（例如不完整的图片地址），直接拒绝
+        rejectedProperties++;
+        LOG_ERROR(MQTT, "属性过长，已丢弃: %s", key);
+        return false;
+    }
+
+    // 队列已满时丢弃新属性，已排队的属性按顺序保留
+    PropertyMessage *slot = messageQueue.claim();
+    if (!slot)
+    {
+        LOG_WARNING(MQTT, "属性队列已满，已丢弃: %s", key);
+        return false;
+    }
+    slot->type = type;
+    strcpy(slot->key, key);
+    strcpy(slot->value, value);
+    messageQueue.commit();
+    return true;
+}
+
+PropertyQueueStats IoTManager::getQueueStats()
+{
+    PropertyQueueStats stats;
+    stats.depth = messageQueue.size();
+    stats.highWater = messageQueue.highWaterMark();
+    stats.overflows = messageQueue.overflows();
+    stats.rejected = rejectedProperties;
+    return stats;
+}
+
 void IoTManager::sendEvent(String eventId, String parameters)
 {
     char topicPath[156];
     snprintf(topicPath, sizeof(topicPath), "%s/%s/post", topicEvent.c_str(), eventId.c_str());
 
-    char jsonPayload[1024];
-    snprintf(jsonPayload, sizeof(jsonPayload), ALINK_EVENT_BODY_FORMAT, parameters.c_str(), eventId.c_str());
+    InFlightMessage *message = delivery.reserve(topicPath);
+    if (!message)
+    {
+        LOG_ERROR(MQTT, "投递窗口已满，事件未发送: %s", eventId.c_str());
+        return;
+    }
 
-    logger.info("发送事件 " + String(topicPath) + " " + String(jsonPayload), "MQTT");
+    char method[96];
+    char id[12];
+    snprintf(method, sizeof(method), ALINK_METHOD_EVENT_POST, eventId.c_str());
+    snprintf(id, sizeof(id), "%lu", (unsigned long)message->id);
+    AlinkWriter writer(message->payload, MAX_BUFFER_SIZE - MQTT_PUBLISH_OVERHEAD - strlen(topicPath));
+    writer.begin(id, method, parameters.c_str());
+    if (!writer.finish())
+    {
+        delivery.cancel(message);
+        LOG_ERROR(MQTT, "MQTT事件过长，无法发送: %s", eventId.c_str());
+        return;
+    }
 
-    bool publishSuccess = mqttClient.publish(topicPath, jsonPayload);
-    if (publishSuccess)
+    // 发送后槽位可能随应答立即被释放复用，负载在发送前记录
+    uint32_t messageId = message->id;
+    LOG_INFO(MQTT, "发送事件 %s %s", topicPath, writer.c_str());
+    if (delivery.send(message, writer.length()))
     {
-        logger.info("MQTT事件发送成功: " + String(jsonPayload), "MQTT");
+        LOG_INFO(MQTT, "MQTT事件发送成功: %lu", (unsigned long)messageId);
     }
     else
     {
-        logger.error("MQTT事件发送失败: " + String(jsonPayload), "MQTT");
+        LOG_ERROR(MQTT, "MQTT事件发送失败，等待重发: %lu", (unsigned long)messageId);
     }
 }
 
@@ -222,39 +511,16 @@ void IoTManager::sendEvent(String eventId)
 
 bool IoTManager::bindData(String key, callbackFunction callbackFn)
 {
-    if (key == NULL || callbackFn == NULL)
+    if (key.isEmpty() || callbackFn == NULL)
     {
         return false;
     }
-    for (auto &entry : callbackArray)
-    {
-        if (entry.callbackFn == nullptr)
-        {
-            entry.key = key;
-            entry.callbackFn = callbackFn;
-            return true;
-        }
-    }
-
-    callbackArray.push_back({key, callbackFn});
+    callbacks.bind(key, callbackFn);
     return true;
 }
-
 bool IoTManager::unbindData(String key)
 {
-    for (auto it = callbackArray.begin(); it != callbackArray.end();)
-    {
-        if (it->key == key)
-        {
-            it = callbackArray.erase(it);
-            return true;
-        }
-        else
-        {
-            it++;
-        }
-    }
-    return false;
+    return callbacks.unbind(key);
 }
 
 void IoTManager::logError()
@@ -295,17 +561,20 @@ void IoTManager::logError()
         errorMsg = "MQTT连接失败: 未知错误";
         break;
     }
-    logger.error(errorMsg, "MQTT");
+    LOG_ERROR(MQTT, "%s", errorMsg.c_str());
 }
 
 void IoTManager::callback(char *topic, byte *payload, unsigned int length)
 {
+    // 校时应答的接收时间要在解析之前记录
+    int64_t receivedMs = esp_timer_get_time() / 1000;
+
     // 使用静态缓冲区
     static char payloadBuffer[1024];
 
     if (length >= sizeof(payloadBuffer))
     {
-        logger.error("接收到超大消息负载，无法处理", "MQTT");
+        LOG_ERROR(MQTT, "接收到超大消息负载，无法处理");
         return;
     }
 
@@ -313,7 +582,7 @@ void IoTManager::callback(char *topic, byte *payload, unsigned int length)
     memcpy(payloadBuffer, payload, length);
     payloadBuffer[length] = '\0';
 
-    logger.info("收到 MQTT 消息 [" + String(topic) + "] " + payloadBuffer, "MQTT");
+    LOG_INFO(MQTT, "收到 MQTT 消息 [%s] %s", topic, payloadBuffer);
 
     // 根据实际负载大小选择合适的静态JSON文档
 
@@ -322,108 +591,194 @@ void IoTManager::callback(char *topic, byte *payload, unsigned int length)
 
     if (parseError)
     {
-        logger.error("JSON 解析失败", "MQTT");
+        LOG_ERROR(MQTT, "JSON 解析失败");
         return;
     }
     JsonVariant jsonVariant = doc.as<JsonVariant>();
 
-    if (strstr(topic, topicPropSet.c_str()))
+    uint32_t startUs = micros();
+    size_t called = 0;
+    if (CallbackIndex::topicMatches(topicReply.c_str(), topic))
     {
-        processPropertySetMessage(jsonVariant);
+        processReplyMessage(jsonVariant);
     }
-    else if (strstr(topic, topicUser.c_str()))
+    else if (strcmp(topic, topicNtpResponse.c_str()) == 0)
     {
-        processUserMessage(topic, jsonVariant);
+        processNtpResponse(jsonVariant, receivedMs);
+    }
+    else if (strcmp(topic, topicPropSet.c_str()) == 0)
+    {
+        called = processPropertySetMessage(jsonVariant);
     }
     else
     {
-        processGenericMessage(topic, jsonVariant);
+        called = processTopicMessage(topic, jsonVariant);
     }
+    dispatchStats.messages++;
+    dispatchStats.callbacks += called;
+    dispatchStats.micros += micros() - startUs;
 }
 
-void IoTManager::processPropertySetMessage(JsonVariant jsonVariant)
+size_t IoTManager::processPropertySetMessage(JsonVariant jsonVariant)
 {
-    for (const auto &callbackEntry : callbackArray)
+    // 只遍历一次下发的属性，每个属性在索引中查找一次
+    size_t called = 0;
+    for (JsonPair kv : jsonVariant["params"].as<JsonObject>())
     {
-        if (!callbackEntry.key.isEmpty())
+        callbackFunction callbackFn = callbacks.find(kv.key().c_str(), kv.key().size());
+        if (callbackFn)
         {
-            bool keyExists = jsonVariant["params"].containsKey(callbackEntry.key.c_str());
-            if (keyExists)
-            {
-                callbackEntry.callbackFn(jsonVariant["params"][callbackEntry.key.c_str()]);
-            }
+            callbackFn(kv.value());
+            called++;
         }
     }
+    return called;
 }
 
-void IoTManager::processUserMessage(const char *topic, JsonVariant jsonVariant)
+void IoTManager::processReplyMessage(JsonVariant jsonVariant)
 {
-    for (const auto &callbackEntry : callbackArray)
+    uint32_t id = strtoul(jsonVariant["id"] | "0", nullptr, 10);
+    int code = jsonVariant["code"] | 0;
+    if (!delivery.acknowledge(id, code))
     {
-        if (!callbackEntry.key.isEmpty() && callbackEntry.key == topic)
-        {
-            callbackEntry.callbackFn(jsonVariant);
-        }
+        // 重发后先后收到两次应答，或已放弃的消息
+        return;
     }
+    if (code != 200)
+    {
+        LOG_ERROR(MQTT, "平台拒绝消息 %lu: %s", (unsigned long)id, (const char *)(jsonVariant["message"] | ""));
+    }
+}
+
+size_t IoTManager::processTopicMessage(const char *topic, JsonVariant jsonVariant)
+{
+    return callbacks.dispatchTopic(topic, jsonVariant);
 }
 
-void IoTManager::processGenericMessage(const char *topic, JsonVariant jsonVariant)
+void IoTManager::checkMessageQueue()
 {
-    for (const auto &callbackEntry : callbackArray)
+    delivery.retransmitExpired();
+
+    // 只处理本次进入时已排队的属性，生产者同时写入的新属性留给下一轮
+    size_t pending = messageQueue.size();
+
+    // 单次发布的负载上限：缓冲区减去 MQTT 固定头、主题长度字段与主题
+    size_t limit = MAX_BUFFER_SIZE - MQTT_PUBLISH_OVERHEAD - topicPropPost.length();
+
+    while (pending > 0)
     {
-        if (!callbackEntry.key.isEmpty() && callbackEntry.key == topic)
+        // 投递窗口已满时属性留在队列中，等应答释放槽位后再发
+        InFlightMessage *message = delivery.reserve(topicPropPost.c_str());
+        if (!message)
         {
-            callbackEntry.callbackFn(jsonVariant);
+            LOG_WARNING(MQTT, "投递窗口已满，属性留待下一轮发送");
+            return;
         }
+
+        uint32_t startUs = micros();
+        char id[12];
+        snprintf(id, sizeof(id), "%lu", (unsigned long)message->id);
+        AlinkWriter writer(message->payload, limit + 1);
+        writer.begin(id, ALINK_METHOD_PROP_POST);
+        size_t envelopeLength = writer.length() + 2;
+        size_t batched = 0;
+
+        while (pending > 0)
+        {
+            const PropertyMessage *msg = messageQueue.peek();
+            if (isSuperseded(pending))
+            {
+                // 同一个键重复出现时只发送最后写入的值
+                messageQueue.drop();
+                pending--;
+                batchStats.superseded++;
+                continue;
+            }
+
+            size_t mark = writer.mark();
+            if (msg->type == PROPERTY_NUMBER)
+            {
+                writer.addRaw(msg->key, msg->value, strlen(msg->value));
+            }
+            else
+            {
+                writer.add(msg->key, msg->value);
+            }
+            if (writer.overflowed())
+            {
+                writer.rewind(mark);
+                if (batched > 0)
+                {
+                    // 放不下的属性留在队首，作为下一批的第一条
+                    break;
+                }
+                LOG_ERROR(MQTT, "属性消息超出发布缓冲区，已丢弃: %s", msg->key);
+            }
+            else
+            {
+                batched++;
+            }
+            messageQueue.drop();
+            pending--;
+        }
+        batchStats.buildMicros += micros() - startUs;
+
+        if (batched == 0)
+        {
+            delivery.cancel(message);
+            continue;
+        }
+        publishPropertyBatch(writer, message, batched, envelopeLength);
     }
 }
 
-void IoTManager::checkMessageQueue()
+bool IoTManager::isSuperseded(size_t pending)
 {
-    for (auto it = messageQueue.begin(); it != messageQueue.end();)
+    const char *key = messageQueue.peek()->key;
+    for (size_t i = 1; i < pending; i++)
     {
-        JsonDocument doc;
-        JsonObject root = doc.to<JsonObject>();
-        root["id"] = String(timeManager.getTimestamp());
-        root["version"] = "1.0";
-        root["params"][it->key] = it->value;
-
-        String payloadStr;
-        serializeJson(root, payloadStr);
+        if (strcmp(messageQueue.peekAt(i)->key, key) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-        sendGenericPropetry(payloadStr.c_str());
+void IoTManager::publishPropertyBatch(AlinkWriter &writer, InFlightMessage *message, size_t messages, size_t envelopeLength)
+{
+    writer.finish();
+    sendGenericPropetry(message, writer.length());
 
-        // 清空已发送的消息
-        it = messageQueue.erase(it);
-    }
+    batchStats.messages += messages;
+    batchStats.publishes++;
+    // 每合并一条消息就少发一个 id/version/method/params 外壳
+    batchStats.bytesSaved += (messages - 1) * envelopeLength;
 }
 
-void IoTManager::sendGenericPropetry(String payload)
+bool IoTManager::sendGenericPropetry(InFlightMessage *message, size_t length)
 {
-    bool success = mqttClient.publish(topicPropPost.c_str(), payload.c_str(), false);
-    logger.info("发送属性 " + topicPropPost + " " + payload, "MQTT");
+    // 发送后槽位可能随应答立即被释放复用，负载在发送前记录
+    uint32_t id = message->id;
+    LOG_INFO(MQTT, "发送属性 %s %s", topicPropPost.c_str(), message->payload);
+    bool success = delivery.send(message, length);
     if (success)
     {
-        logger.info("MQTT属性发送成功: " + String(payload), "MQTT");
+        LOG_INFO(MQTT, "MQTT属性发送成功: %lu", (unsigned long)id);
     }
     else
     {
         logError();
-        logger.error("MQTT属性发送失败: " + String(payload), "MQTT");
+        LOG_ERROR(MQTT, "MQTT属性发送失败，等待重发: %lu", (unsigned long)id);
     }
+    return success;
 }
 
-void IoTManager::checkConnectionCallback(){
-    if(IoTManager::instance){
-        IoTManager::instance->checkConnection();
-    }
-
-}
-void IoTManager::checkMessageQueueCallback(){
-    if(IoTManager::instance){
-        IoTManager::instance->checkMessageQueue();
-    }
+DeliveryStats IoTManager::getDeliveryStats()
+{
+    return delivery.getStats();
 }
+
 void IoTManager::mqttCallback(char *topic, byte *payload, unsigned int length){
     if(IoTManager::instance){
         IoTManager::instance->callback(topic, payload, length);
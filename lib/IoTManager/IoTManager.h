@@ -4,12 +4,16 @@
 #include <vector>
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <WiFi.h>
 #include <WiFiClient.h>
 #include <PubSubClient.h>
 #include "Logger.h"
 #include "TimeManager.h"
-#include <mbedtls/md.h>
-#include <Ticker.h>
+#include "KeyedMac.h"
+#include "SpscRing.h"
+#include "CallbackIndex.h"
+#include "AlinkWriter.h"
+#include "DeliveryWindow.h"
 
 extern WiFiClient wifiClient;
 extern PubSubClient mqttClient;
@@ -17,29 +21,85 @@ extern Logger logger;
 extern TimeManager timeManager;
 
 #define SHA256HMAC_SIZE 32
-#define MESSAGE_QUEUE_CHECK_INTERVAL 5
-#define CONNECTION_CHECK_INTERVAL 10
+#define MESSAGE_QUEUE_CHECK_INTERVAL_MS 5000  // loop() 发送排队属性与重发超时消息的间隔
+#define MQTT_TCP_CONNECT_TIMEOUT_MS 3000    // 建立 TCP 连接的超时
+#define MQTT_HANDSHAKE_TIMEOUT 3             // 等待 CONNACK 的超时（秒）
+#define MQTT_BACKOFF_BASE_MS 1000            // 重连退避的初始间隔
+#define MQTT_BACKOFF_MAX_MS 60000            // 重连退避的最大间隔
+#define MQTT_CREDENTIAL_TTL_MS (6 * 3600000UL) // 连接签名的复用时长
+#define MQTT_DNS_RETRY_FAILURES 3            // 连续失败该次数后重新解析域名
+#define MQTT_TIME_WAIT_MS 15000              // 首选 SNTP 时等待时间同步的最长时间，超时后用未同步的时间签名
+#define MQTT_NTP_RETRY_MS 10000              // MQTT 校时请求未得到有效应答时的重试间隔
 #define KEEP_ALIVE_INTERVAL 60
 #define MAX_BUFFER_SIZE 1024
 #define MAX_TOPIC_SIZE 512
-#define ALINK_BODY_FORMAT "{\"id\":\"123\",\"version\":\"1.0\",\"method\":\"thing.event.property.post\",\"params\":%s}"
-#define ALINK_EVENT_BODY_FORMAT "{\"id\": \"123\",\"version\": \"1.0\",\"params\": %s,\"method\": \"thing.event.%s.post\"}"
+#define MQTT_PUBLISH_OVERHEAD 7 // PubSubClient 在缓冲区中预留的固定头（5）与主题长度字段（2）
+#define PROPERTY_QUEUE_LENGTH 32 // 属性队列槽位数，必须为 2 的幂
+#define PROPERTY_KEY_SIZE 32     // 属性键的最大长度（含结尾 0）
+#define PROPERTY_VALUE_SIZE 160  // 属性值的最大长度（含结尾 0），需容纳图片 URL
+#define ALINK_METHOD_PROP_POST "thing.event.property.post"
+#define ALINK_METHOD_EVENT_POST "thing.event.%s.post"
 #define ALINK_TOPIC_PROP_POST "/sys/%s/%s/thing/event/property/post"
 #define ALINK_TOPIC_PROP_SET "/sys/%s/%s/thing/service/property/set"
 #define ALINK_TOPIC_USER "/sys/%s/%s/thing/event/user/%s"
 #define ALINK_TOPIC_GENERIC "/sys/%s/%s/thing/event/%s"
 #define ALINK_TOPIC_EVENT "/sys/%s/%s/thing/event"
+#define ALINK_TOPIC_REPLY "/sys/%s/%s/thing/event/+/post_reply"
+#define ALINK_TOPIC_NTP_REQUEST "/ext/ntp/%s/%s/request"
+#define ALINK_TOPIC_NTP_RESPONSE "/ext/ntp/%s/%s/response"
 
-typedef void (*callbackFunction)(JsonVariant);
+enum PropertyType : uint8_t {
+    PROPERTY_STRING, // 值按 JSON 字符串发送
+    PROPERTY_NUMBER  // 值是已格式化的 JSON 数字，原样发送
+};
 
 struct PropertyMessage {
-    String key;
-    String value;
+    PropertyType type;
+    char key[PROPERTY_KEY_SIZE];
+    char value[PROPERTY_VALUE_SIZE];
+};
+
+struct PropertyQueueStats {
+    size_t depth = 0;     // 当前排队的属性数
+    size_t highWater = 0; // 出现过的最大排队数
+    size_t overflows = 0; // 队列已满被丢弃的属性数
+    size_t rejected = 0;  // 键或值超长被拒绝的属性数
+};
+
+struct PropertyBatchStats {
+    uint32_t messages = 0;   // 已发送的属性消息数
+    uint32_t publishes = 0;  // 实际发布次数
+    uint32_t bytesSaved = 0; // 合并后少发送的字节数（估算）
+    uint32_t superseded = 0; // 被同一轮中更新的值覆盖而未发送的属性数
+    uint32_t buildMicros = 0; // 累计组包耗时（微秒）
+};
+
+enum MqttState : uint8_t {
+    MQTT_STATE_STOPPED,   // 尚未调用 connect()
+    MQTT_STATE_BACKOFF,   // 等待 WiFi 或退避时间到达
+    MQTT_STATE_HANDSHAKE, // TCP 已连接，下一步发送 MQTT CONNECT
+    MQTT_STATE_CONNECTED  // 已连接
+};
+
+struct MqttConnectionStats {
+    uint32_t attempts = 0;        // 连接尝试次数
+    uint32_t failures = 0;        // 失败次数
+    uint32_t reconnects = 0;      // 断线后重新连上的次数
+    uint32_t signatures = 0;      // 重新签名的次数
+    uint32_t lastReconnectMs = 0; // 最近一次从断开到重新连上的耗时
+    uint32_t maxReconnectMs = 0;  // 从断开到重新连上的最长耗时
+    uint32_t disconnectedMs = 0;  // 累计断开时长（含当前这次断开）
 };
 
-struct CallbackEntry {
-    String key;
-    callbackFunction callbackFn;
+struct Subscription {
+    String topic;
+    uint8_t qos;
+};
+
+struct DispatchStats {
+    uint32_t messages = 0;  // 收到并解析的消息数
+    uint32_t callbacks = 0; // 调用的回调数
+    uint32_t micros = 0;    // 累计分发耗时（微秒，不含 JSON 解析）
 };
 
 /**
@@ -70,21 +130,36 @@ public:
     String sign(const char *plaintext);
 
     /**
-     * @brief 连接到 MQTT 代理。
+     * @brief 配置 MQTT 客户端并启动连接状态机，立即尝试一次连接。
+     * 之后的断线重连都由 loop() 驱动。
      * @return 如果连接成功返回 true，否则返回 false。
      */
     bool connect();
 
     /**
-     * @brief 检查连接状态并在必要时重新连接。
+     * @brief 推进一步连接状态机：断开时按带抖动的指数退避重连，每次调用最多阻塞一个连接超时。
      */
     void checkConnection();
 
     /**
-     * @brief 处理 MQTT 客户端循环以保持连接并处理消息。
+     * @brief 推进连接状态机，并处理 MQTT 客户端循环以保持连接并处理消息；
+     * 每隔 MESSAGE_QUEUE_CHECK_INTERVAL_MS 发送排队的属性并重发超时未应答的消息。
+     * mqttClient 只在调用 loop() 的任务中使用。
      */
     void loop();
 
+    /**
+     * @brief WiFi 连接状态变化时调用：断开时立即进入重连退避，恢复时立即尝试重连。
+     *
+     * @param up WiFi 是否已获得 IP
+     */
+    void onNetworkChange(bool up);
+
+    /**
+     * @brief 获取连接统计（重连耗时、累计断开时长等）。
+     */
+    MqttConnectionStats getConnectionStats();
+
     /**
      * @brief 发布消息到指定的 MQTT 主题。
      * @param topic 要发布的 MQTT 主题。
@@ -126,11 +201,11 @@ public:
     bool unsubscribeUser(String topicSuffix);
 
     /**
-     * @brief 订阅指定的 MQTT 主题。
+     * @brief 订阅指定的 MQTT 主题，断线重连后自动重新订阅。
      * @param topic 要订阅的 MQTT 主题。
      * @param qos 服务质量（QoS）级别。
      * @param fp 回调函数。
-     * @return 如果订阅成功返回 true，否则返回 false。
+     * @return 如果订阅成功或未连接时已记录待连接后订阅返回 true，否则返回 false。
      */
     bool subscribe(String topic, uint8_t qos, callbackFunction fp);
 
@@ -191,8 +266,8 @@ public:
     void sendEvent(String eventId);
 
     /**
-     * @brief 添加属性的回调函数。
-     * @param key 属性的键。
+     * @brief 添加属性或主题的回调函数，同一个键重复绑定时替换原有回调。
+     * @param key 属性的键、主题，或含 `+`/`#` 通配符的主题过滤器。
      * @param callbackFn 回调函数。
      * @return 如果添加成功返回 true，否则返回 false。
      */
@@ -204,13 +279,33 @@ public:
      * @return 如果移除成功返回 true，否则返回 false。
      */
     bool unbindData(String key);
-    static void checkMessageQueueCallback();
-    static void checkConnectionCallback();
+
+    /**
+     * @brief 属性合并发送统计，messages / publishes 即平均每次发布携带的属性数。
+     */
+    PropertyBatchStats batchStats;
+
+    /**
+     * @brief 获取属性队列的深度、高水位与丢弃统计。
+     */
+    PropertyQueueStats getQueueStats();
+
+    /**
+     * @brief 下行消息分发统计，micros / messages 即平均每条消息的分发耗时。
+     */
+    DispatchStats dispatchStats;
+
+    /**
+     * @brief 获取属性与事件的投递统计（未应答数、应答延迟分位数、重发次数）。
+     */
+    DeliveryStats getDeliveryStats();
+
     static void mqttCallback(char *topic, byte *payload, unsigned int length);
 private:
     String productKey;
     String deviceName;
     String deviceSecret;
+    KeyedMac deviceMac{MBEDTLS_MD_SHA256}; // 以 deviceSecret 为密钥的 HMAC-SHA256
     String briefId;
     String username;
     String hostUrl;
@@ -221,17 +316,60 @@ private:
     String topicPropSet;
     String topicEvent;
     String topicUser;
-
-    std::vector<PropertyMessage> messageQueue; // 使用vector管理消息队列
-    std::vector<CallbackEntry> callbackArray; // 使用vector管理回调函数
-    Ticker queueCheckTicker;
-    Ticker connectionCheckTicker;
+    String topicReply;
+    String topicNtpRequest;
+    String topicNtpResponse;
+
+    // 属性队列：sendProperty 所在任务为唯一生产者，loop() 所在任务为唯一消费者
+    SpscRing<PropertyMessage, PROPERTY_QUEUE_LENGTH> messageQueue;
+    size_t rejectedProperties = 0;
+    DeliveryWindow delivery; // 等待 _reply 应答的属性与事件，消息直接在窗口槽位中组包
+    CallbackIndex callbacks; // 属性名与主题的回调索引
+    std::vector<Subscription> subscriptions; // 重连后需重新订阅的主题
+
+    MqttState state = MQTT_STATE_STOPPED;
+    MqttConnectionStats connectionStats;
+    uint32_t nextAttemptMs = 0;     // 下一次连接尝试的时间
+    uint32_t disconnectedAtMs = 0;  // 本次断开的开始时间
+    uint32_t credentialsAtMs = 0;   // 签名的生成时间，0 表示需要重新签名
+    bool credentialsSynced = false; // 签名时时间是否已同步，同步后需要重新签名
+    uint32_t ntpRequestedMs = 0;    // 上一次 MQTT 校时请求的时间，0 表示尚未请求
+    int64_t ntpSendMs = -1;         // 未应答的校时请求中的 deviceSendTime，-1 表示没有
+    uint32_t queueCheckedMs = 0;    // 上一次检查属性队列的时间
+    uint32_t consecutiveFailures = 0;
+    IPAddress brokerAddress;        // 缓存的代理地址，避免每次重连都做 DNS 解析
 
     /**
      * @brief 记录错误信息。
      */
     void logError();
 
+    /**
+     * @brief 签名过期或被拒绝后重新生成 clientId 与 password，否则复用缓存的签名。
+     */
+    void refreshCredentials();
+
+    /**
+     * @brief 以有限的超时建立到代理的 TCP 连接，必要时先解析域名。
+     * @return 连接成功返回 true。
+     */
+    bool openSocket();
+
+    /**
+     * @brief 连接成功后重新订阅并重发未应答的消息，记录重连耗时。
+     */
+    void onConnected();
+
+    /**
+     * @brief 记录断开时间并进入退避状态。
+     */
+    void onDisconnected();
+
+    /**
+     * @brief 一次连接尝试失败后按带抖动的指数退避安排下一次尝试。
+     */
+    void scheduleRetry();
+
     /**
      * @brief 处理收到的 MQTT 消息。
      * @param topic 主题。
@@ -243,34 +381,73 @@ private:
     /**
      * @brief 处理属性设置消息。
      * @param jsonVariant JSON 变体。
+     * @return 调用的回调数量。
      */
-    void processPropertySetMessage(JsonVariant jsonVariant);
+    size_t processPropertySetMessage(JsonVariant jsonVariant);
 
     /**
-     * @brief 处理用户消息。
-     * @param topic 主题。
+     * @brief 处理属性与事件上报的 `_reply` 应答。
      * @param jsonVariant JSON 变体。
      */
-    void processUserMessage(const char *topic, JsonVariant jsonVariant);
+    void processReplyMessage(JsonVariant jsonVariant);
 
     /**
-     * @brief 处理通用消息。
+     * @brief 发送 MQTT 校时请求，deviceSendTime 使用单调时钟，应答中原样带回，用于计算往返时间。
+     */
+    void requestNetworkTime();
+
+    /**
+     * @brief 处理 MQTT 校时应答。
+     * @param jsonVariant 应答消息。
+     * @param receivedMs 收到消息时的单调时钟（毫秒）。
+     */
+    void processNtpResponse(JsonVariant jsonVariant, int64_t receivedMs);
+
+    /**
+     * @brief 处理用户主题和其他主题的消息。
      * @param topic 主题。
      * @param jsonVariant JSON 变体。
+     * @return 调用的回调数量。
      */
-    void processGenericMessage(const char *topic, JsonVariant jsonVariant);
+    size_t processTopicMessage(const char *topic, JsonVariant jsonVariant);
 
     /**
-     * @brief 检查消息队列。
+     * @brief 检查消息队列，把排队的属性合并为尽量少的 property.post 消息发送。
      */
     void checkMessageQueue();
 
+    /**
+     * @brief 闭合并发送一批合并后的属性，更新统计。
+     * @param writer 已写入属性的组包器。
+     * @param message 组包所在的投递窗口槽位。
+     * @param messages 本批合并的属性消息数。
+     * @param envelopeLength 不含属性的消息外壳长度。
+     */
+    void publishPropertyBatch(AlinkWriter &writer, InFlightMessage *message, size_t messages, size_t envelopeLength);
+
+    /**
+     * @brief 判断队首属性是否被本轮中稍后排队的同名属性覆盖。
+     * @param pending 本轮待处理的属性数（含队首）。
+     */
+    bool isSuperseded(size_t pending);
+
+    /**
+     * @brief 把属性写入队列的下一个槽位。
+     * @param key 属性的键。
+     * @param value 属性的值。
+     * @param type 值的类型。
+     * @return 写入成功返回 true；超长或队列已满时丢弃并返回 false。
+     */
+    bool enqueueProperty(const char *key, const char *value, PropertyType type);
+
 
     /**
      * @brief 发送通用属性消息。
-     * @param Payload 消息负载。
+     * @param message 已写好负载的投递窗口槽位。
+     * @param length 负载长度。
+     * @return 发布成功返回 true；失败的消息留在窗口中等待重发。
      */
-    void sendGenericPropetry(String Payload);
+    bool sendGenericPropetry(InFlightMessage *message, size_t length);
    
 };
 
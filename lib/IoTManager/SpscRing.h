@@ -0,0 +1,131 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+
+/**
+ * @class SpscRing
+ * @brief 固定容量的单生产者单消费者无锁环形队列。
+ *
+ * 槽位在对象内预先分配，入队和出队都只复制一个元素，不做任何堆分配。
+ * 只允许一个任务入队（push() 或 claim()/commit()），一个任务出队（peek()/peekAt()/drop()）。队列满时 push() 返回 false（丢弃新元素），
+ * 并累计溢出次数；highWaterMark() 记录出现过的最大深度。
+ *
+ * @tparam T 元素类型，需可平凡复制。
+ * @tparam N 容量，必须为 2 的幂。
+ */
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    /**
+     * @brief 生产者入队。
+     * @return 队列已满时返回 false，元素被丢弃。
+     */
+    bool push(const T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail >= N)
+        {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+
+        size_t depth = head + 1 - tail;
+        if (depth > highWater_.load(std::memory_order_relaxed))
+        {
+            highWater_.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 生产者入队前获取待写槽位，填写后调用 commit() 发布，避免先在栈上构造再复制。
+     * @return 队列已满时返回 nullptr，并计入溢出次数。
+     */
+    T *claim()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= N)
+        {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &slots_[head & (N - 1)];
+    }
+
+    /**
+     * @brief 发布 claim() 得到的槽位。
+     */
+    void commit()
+    {
+        size_t head = head_.load(std::memory_order_relaxed) + 1;
+        head_.store(head, std::memory_order_release);
+        size_t depth = head - tail_.load(std::memory_order_relaxed);
+        if (depth > highWater_.load(std::memory_order_relaxed))
+        {
+            highWater_.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief 消费者查看队首元素而不出队。
+     * @return 队列为空时返回 nullptr。
+     */
+    const T *peek() const
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &slots_[tail & (N - 1)];
+    }
+
+    /**
+     * @brief 消费者查看队首之后第 offset 个元素。
+     * @return offset 超出当前深度时返回 nullptr。
+     */
+    const T *peekAt(size_t offset) const
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (offset >= head_.load(std::memory_order_acquire) - tail)
+        {
+            return nullptr;
+        }
+        return &slots_[(tail + offset) & (N - 1)];
+    }
+
+    /**
+     * @brief 消费者丢弃队首元素（配合 peek() 使用）。
+     */
+    void drop()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+    size_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+    size_t highWaterMark() const { return highWater_.load(std::memory_order_relaxed); }
+
+private:
+    T slots_[N];
+    std::atomic<size_t> head_{0};      // 下一个写入位置，只由生产者修改
+    std::atomic<size_t> tail_{0};      // 下一个读取位置，只由消费者修改
+    std::atomic<size_t> overflows_{0};
+    std::atomic<size_t> highWater_{0};
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,131 @@
+/**
+ * @file KeyedMac.cpp
+ * @author 稀饭
+ * @brief 实现了 KeyedMac 类。
+ */
+
+#include "KeyedMac.h"
+#include "_Base64.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+KeyedMac::KeyedMac(mbedtls_md_type_t type) : type(type)
+{
+    mbedtls_md_init(&inner);
+    mbedtls_md_init(&outer);
+    mbedtls_md_init(&work);
+}
+
+KeyedMac::~KeyedMac()
+{
+    mbedtls_md_free(&inner);
+    mbedtls_md_free(&outer);
+    mbedtls_md_free(&work);
+}
+
+/**
+ * ### 设置密钥
+ *
+ * 上下文只在第一次设置密钥时初始化，之后更换密钥不再分配内存。
+ */
+bool KeyedMac::setKey(const uint8_t *key, size_t keyLength)
+{
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(type);
+    if (!info)
+    {
+        return false;
+    }
+    if (!ready)
+    {
+        if (mbedtls_md_setup(&inner, info, 0) != 0 || mbedtls_md_setup(&outer, info, 0) != 0 || mbedtls_md_setup(&work, info, 0) != 0)
+        {
+            return false;
+        }
+        digestSize = mbedtls_md_get_size(info);
+        blockSize = (type == MBEDTLS_MD_SHA384 || type == MBEDTLS_MD_SHA512) ? 128 : 64;
+        ready = true;
+    }
+
+    // 长于分组的密钥先做一次摘要
+    uint8_t hashedKey[KEYED_MAC_MAX_SIZE];
+    if (keyLength > blockSize)
+    {
+        mbedtls_md(info, key, keyLength, hashedKey);
+        key = hashedKey;
+        keyLength = digestSize;
+    }
+
+    uint8_t ipad[128];
+    uint8_t opad[128];
+    memset(ipad, 0x36, blockSize);
+    memset(opad, 0x5c, blockSize);
+    for (size_t i = 0; i < keyLength; i++)
+    {
+        ipad[i] ^= key[i];
+        opad[i] ^= key[i];
+    }
+
+    mbedtls_md_starts(&inner);
+    mbedtls_md_update(&inner, ipad, blockSize);
+    mbedtls_md_starts(&outer);
+    mbedtls_md_update(&outer, opad, blockSize);
+
+    memset(ipad, 0, sizeof(ipad));
+    memset(opad, 0, sizeof(opad));
+    memset(hashedKey, 0, sizeof(hashedKey));
+    hasKey = true;
+    return true;
+}
+
+bool KeyedMac::setKey(const String &key)
+{
+    return setKey((const uint8_t *)key.c_str(), key.length());
+}
+
+/**
+ * ### 计算 HMAC
+ *
+ * HMAC(K, m) = H((K⊕opad) || H((K⊕ipad) || m))，两层的密钥块都取自预先计算的状态。
+ */
+bool KeyedMac::sign(const uint8_t *message, size_t length, uint8_t *output)
+{
+    if (!hasKey)
+    {
+        return false;
+    }
+    uint8_t innerDigest[KEYED_MAC_MAX_SIZE];
+    mbedtls_md_clone(&work, &inner);
+    mbedtls_md_update(&work, message, length);
+    mbedtls_md_finish(&work, innerDigest);
+
+    mbedtls_md_clone(&work, &outer);
+    mbedtls_md_update(&work, innerDigest, digestSize);
+    mbedtls_md_finish(&work, output);
+    return true;
+}
+
+bool KeyedMac::signHex(const char *message, char *output)
+{
+    uint8_t digest[KEYED_MAC_MAX_SIZE];
+    if (!sign((const uint8_t *)message, strlen(message), digest))
+    {
+        return false;
+    }
+    toHex(digest, digestSize, output);
+    return true;
+}
+
+void KeyedMac::toHex(const uint8_t *input, size_t length, char *output)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        *output++ = HEX_DIGITS[input[i] >> 4];
+        *output++ = HEX_DIGITS[input[i] & 0x0f];
+    }
+    *output = '\0';
+}
+
+size_t KeyedMac::toBase64Url(const uint8_t *input, size_t length, char *output)
+{
+    return _Base64::encodeTo<true>(input, length, output);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file KeyedMac.h
+ * @author 稀饭
+ * @brief 定义了 KeyedMac 类，按密钥预先计算 HMAC 内外层摘要状态，签名时只复制状态。
+ */
+
+#ifndef KEYED_MAC_H
+#define KEYED_MAC_H
+
+#include <Arduino.h>
+#include <mbedtls/md.h>
+
+#define KEYED_MAC_MAX_SIZE 64 // 支持的最长摘要（SHA-512）
+
+/**
+ * @class KeyedMac
+ * @brief 可重复使用的 HMAC 计算器。
+ *
+ * setKey() 时对 key⊕ipad 与 key⊕opad 各做一次摘要并保存中间状态，之后每条消息只需
+ * 复制这两个状态再处理消息本身，省去每次重新派生密钥块与初始化上下文的开销。
+ * 同一个实例不能被多个任务同时使用。
+ */
+class KeyedMac
+{
+public:
+    explicit KeyedMac(mbedtls_md_type_t type);
+    ~KeyedMac();
+    KeyedMac(const KeyedMac &) = delete;
+    KeyedMac &operator=(const KeyedMac &) = delete;
+
+    /**
+     * @brief 设置密钥并预先计算内外层摘要状态。
+     * @return 成功返回 true。
+     */
+    bool setKey(const uint8_t *key, size_t keyLength);
+    bool setKey(const String &key);
+
+    /**
+     * @brief 是否已设置密钥。
+     */
+    bool keyed() const { return hasKey; }
+
+    /**
+     * @brief 摘要长度（字节）。
+     */
+    size_t size() const { return digestSize; }
+
+    /**
+     * @brief 计算消息的 HMAC。
+     * @param message 消息。
+     * @param length 消息长度。
+     * @param output 输出缓冲区，至少 size() 字节。
+     * @return 成功返回 true。
+     */
+    bool sign(const uint8_t *message, size_t length, uint8_t *output);
+
+    /**
+     * @brief 计算 HMAC 并以小写十六进制写入 output，output 至少 2 * size() + 1 字节。
+     * @return 成功返回 true。
+     */
+    bool signHex(const char *message, char *output);
+
+    /**
+     * @brief 把字节写成小写十六进制并以 0 结尾。
+     * @param output 至少 2 * length + 1 字节。
+     */
+    static void toHex(const uint8_t *input, size_t length, char *output);
+
+    /**
+     * @brief 把字节写成 URL 安全的 Base64（带 '=' 填充）并以 0 结尾。
+     * @param output 至少 4 * ((length + 2) / 3) + 1 字节。
+     * @return 写入的字符数（不含结尾 0）。
+     */
+    static size_t toBase64Url(const uint8_t *input, size_t length, char *output);
+
+private:
+    mbedtls_md_type_t type;
+    mbedtls_md_context_t inner; // 已处理 key⊕ipad 的摘要状态
+    mbedtls_md_context_t outer; // 已处理 key⊕opad 的摘要状态
+    mbedtls_md_context_t work;  // 每条消息使用的工作状态
+    size_t digestSize = 0;
+    size_t blockSize = 0;
+    bool ready = false;
+    bool hasKey = false;
+};
+
+#endif // KEYED_MAC_H
@@ -5,86 +5,262 @@
  */
 
 #include "Logger.h"
-#include "TimeManager.h"
+#include <sys/time.h>
 
-extern TimeManager timeManager;
+static const char *const LEVEL_NAMES[] = {"DEBUG", "INFO", "WARNING", "ERROR", "NONE"};
+static const char *const LEVEL_KEYS[] = {"debug", "info", "warning", "error", "none"};
+
+// 与 LogModule 顺序一致，输出时使用原来的模块名
+static const char *const MODULE_NAMES[LOG_MODULE_COUNT] = {
+    "camera", "pipeline", "sdcard", "segment", "retention", "backlog",
+    "Qiniu", "MQTT", "Time", "WiFi", "Logger"};
 
 /**
- * ### 记录信息级别的日志。
- *
- * ### 参数
+ * ### 启动后台输出任务
  *
- * - `msg`：日志消息
- * - `moduleName`：模块名称
+ * 输出任务优先级为 1，只在其他任务空闲时占用 CPU 与串口。
  */
-void Logger::info(String msg, String moduleName)
+bool Logger::begin()
 {
-    String date = timeManager.getFormattedDate();
-    String time = timeManager.getFormattedTime();
-
-     if(date == "" || time == "")
+    if (started)
     {
-        Serial.println("[INFO]-[" + moduleName + "]: " + msg);
-        return;
+        return true;
     }
-    Serial.println("[INFO]-" + date + " " + time + "-[" + moduleName + "]: " + msg);
+    for (uint32_t i = 0; i < LOG_RING_LENGTH; i++)
+    {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueuePosition.store(0, std::memory_order_relaxed);
+    dequeuePosition = 0;
+    started = xTaskCreate(Logger::drainTask, "logger", LOG_TASK_STACK_SIZE, this, 1, nullptr) == pdPASS;
+    return started;
 }
+
 /**
- * ### 输出调试信息
+ * ### 写入一条日志
+ *
+ * 多个任务可以同时写入：先用 CAS 抢占一个槽位，把消息直接格式化进槽位后更新槽位序号发布给后台任务。
+ * 缓冲区已满时直接丢弃，不做格式化，调用方从不等待串口。
+ * 格式化必须在调用方完成，因为 %s 参数可能指向调用方的临时缓冲区。
  *
  * #### 参数
  *
- * - `msg`：调试消息
- * - `moduleName`：模块名称
+ * - `level`：日志级别
+ * - `module`：模块
+ * - `format`：printf 格式
  */
-void Logger::debug(String msg, String moduleName)
+void Logger::log(LogLevel level, LogModule module, const char *format, ...)
 {
-    String date = timeManager.getFormattedDate();
-    String time = timeManager.getFormattedTime();
-     if(date == "" || time == "")
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    va_list args;
+    if (!started)
     {
-        Serial.println("[DEBUG]-[" + moduleName + "]: " + msg);
+        char msg[LOG_MESSAGE_SIZE];
+        va_start(args, format);
+        vsnprintf(msg, sizeof(msg), format, args);
+        va_end(args);
+        emit(level, now.tv_sec, module, msg);
         return;
     }
-    Serial.println("[DEBUG]-" + date + " " + time + "-[" + moduleName + "]: " + msg);
+
+    uint32_t startUs = micros();
+    uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+    LogRecord *record;
+    for (;;)
+    {
+        record = &ring[position & (LOG_RING_LENGTH - 1)];
+        int32_t diff = (int32_t)(record->sequence.load(std::memory_order_acquire) - position);
+        if (diff == 0)
+        {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    record->module = module;
+    record->seconds = now.tv_sec;
+    va_start(args, format);
+    vsnprintf(record->message, LOG_MESSAGE_SIZE, format, args);
+    va_end(args);
+    record->sequence.store(position + 1, std::memory_order_release);
+
+    records.fetch_add(1, std::memory_order_relaxed);
+    callerMicros.fetch_add(micros() - startUs, std::memory_order_relaxed);
 }
 
 /**
- * ### 输出警告信息
- *
- * #### 参数
+ * ### 格式化并输出一条日志
  *
- * - `msg`：警告消息
- * - `moduleName`：模块名称
+ * 时间尚未同步时（早于 2016 年）不输出日期。
  */
-void Logger::warning(String msg, String moduleName)
+void Logger::emit(LogLevel level, uint32_t seconds, LogModule module, const char *msg)
 {
-    String date = timeManager.getFormattedDate();
-    String time = timeManager.getFormattedTime();
-     if(date == "" || time == "")
+    const char *moduleName = MODULE_NAMES[module];
+    char line[LOG_MESSAGE_SIZE + 64];
+    struct tm timeinfo;
+    time_t t = seconds;
+    localtime_r(&t, &timeinfo);
+    int length;
+    if (timeinfo.tm_year < (2016 - 1900))
     {
-        Serial.println("[WARNING]-[" + moduleName + "]: " + msg);
-        return;
+        length = snprintf(line, sizeof(line), "[%s]-[%s]: %s\r\n", LEVEL_NAMES[level], moduleName, msg);
+    }
+    else
+    {
+        char stamp[20];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M", &timeinfo);
+        length = snprintf(line, sizeof(line), "[%s]-%s-[%s]: %s\r\n", LEVEL_NAMES[level], stamp, moduleName, msg);
     }
-    Serial.println("[WARNING]-" + date + " " + time + "-[" + moduleName + "]: " + msg);
+    if (length >= (int)sizeof(line))
+    {
+        // 截断时仍以换行结尾
+        length = sizeof(line) - 1;
+        line[length - 2] = '\r';
+        line[length - 1] = '\n';
+    }
+    Serial.write((const uint8_t *)line, length);
 }
+
 /**
- * ### 输出错误信息
+ * ### 输出缓冲区中的全部记录
+ */
+void Logger::drain()
+{
+    for (;;)
+    {
+        LogRecord *record = &ring[dequeuePosition & (LOG_RING_LENGTH - 1)];
+        if (record->sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+        {
+            break;
+        }
+        emit(record->level, record->seconds, record->module, record->message);
+        record->sequence.store(dequeuePosition + LOG_RING_LENGTH, std::memory_order_release);
+        dequeuePosition++;
+    }
+
+    uint32_t droppedNow = dropped.load(std::memory_order_relaxed);
+    if (droppedNow != reportedDropped)
+    {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "日志缓冲区已满，丢弃 %lu 条", (unsigned long)(droppedNow - reportedDropped));
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        emit(LOG_LEVEL_WARNING, now.tv_sec, LOG_MODULE_LOGGER, msg);
+        reportedDropped = droppedNow;
+    }
+}
+
+void Logger::drainTask(void *arg)
+{
+    Logger *logger = static_cast<Logger *>(arg);
+    for (;;)
+    {
+        logger->drain();
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+
+/**
+ * ### 获取日志统计
+ */
+LoggerStats Logger::getStats()
+{
+    LoggerStats stats;
+    stats.records = records.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.callerMicros = callerMicros.load(std::memory_order_relaxed);
+    stats.filtered = filtered.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * ### 设置模块的运行时日志级别
  *
- * #### 参数
+ * 只能放宽到编译期保留的级别，编译期已删除的调用不会恢复。
+ */
+void Logger::setModuleLevel(LogModule module, LogLevel level)
+{
+    if (module < LOG_MODULE_COUNT && level <= LOG_LEVEL_NONE)
+    {
+        moduleLevels[module] = level;
+    }
+}
+
+/**
+ * ### 按文本设置运行时日志级别
  *
- * - `msg`：错误消息
- * - `moduleName`：模块名称
+ * 例如 `*=info,MQTT=debug`，条目按顺序生效，后面的覆盖前面的。
  */
-void Logger::error(String msg, String moduleName)
+bool Logger::applyLevelOverrides(const char *spec)
 {
-    String date = timeManager.getFormattedDate();
-    String time = timeManager.getFormattedTime();
-    
-    if(date == "" || time == "")
+    if (spec == nullptr)
     {
-        Serial.println("[ERROR]-[" + moduleName + "]: " + msg);
-        return;
+        return false;
+    }
+    bool valid = true;
+    const char *entry = spec;
+    while (*entry)
+    {
+        const char *end = strchr(entry, ',');
+        size_t length = end ? (size_t)(end - entry) : strlen(entry);
+        const char *equals = (const char *)memchr(entry, '=', length);
+
+        int level = -1;
+        int module = -2; // -1 表示全部模块
+        if (equals)
+        {
+            size_t nameLength = equals - entry;
+            size_t levelLength = length - nameLength - 1;
+            for (int i = 0; i <= LOG_LEVEL_NONE; i++)
+            {
+                if (strlen(LEVEL_KEYS[i]) == levelLength && strncasecmp(equals + 1, LEVEL_KEYS[i], levelLength) == 0)
+                {
+                    level = i;
+                    break;
+                }
+            }
+            if (nameLength == 1 && entry[0] == '*')
+            {
+                module = -1;
+            }
+            for (int i = 0; i < LOG_MODULE_COUNT && module == -2; i++)
+            {
+                if (strlen(MODULE_NAMES[i]) == nameLength && strncasecmp(entry, MODULE_NAMES[i], nameLength) == 0)
+                {
+                    module = i;
+                }
+            }
+        }
+
+        if (level < 0 || module == -2)
+        {
+            valid = false;
+        }
+        else if (module == -1)
+        {
+            for (int i = 0; i < LOG_MODULE_COUNT; i++)
+            {
+                moduleLevels[i] = (LogLevel)level;
+            }
+        }
+        else
+        {
+            moduleLevels[module] = (LogLevel)level;
+        }
+        entry = end ? end + 1 : entry + length;
     }
-    Serial.println("[ERROR]-" + date + " " + time + "-[" + moduleName + "]: " + msg);
-}
\ No newline at end of file
+    return valid;
+}
@@ -6,48 +6,177 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 #include <Arduino.h>
+#include <atomic>
+
+#define LOG_RING_LENGTH 32         // 日志环形缓冲区的记录数，必须为 2 的幂
+#define LOG_MESSAGE_SIZE 192       // 单条日志消息的最大长度（含结尾 0），超出部分截断
+#define LOG_DRAIN_INTERVAL_MS 10   // 输出任务在缓冲区为空时的轮询间隔
+#define LOG_TASK_STACK_SIZE 3072
+
+enum LogLevel : uint8_t {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_NONE // 只用于过滤，表示关闭
+};
+
+enum LogModule : uint8_t {
+    LOG_MODULE_CAMERA,
+    LOG_MODULE_PIPELINE,
+    LOG_MODULE_SDCARD,
+    LOG_MODULE_SEGMENT,
+    LOG_MODULE_RETENTION,
+    LOG_MODULE_BACKLOG,
+    LOG_MODULE_QINIU,
+    LOG_MODULE_MQTT,
+    LOG_MODULE_TIME,
+    LOG_MODULE_WIFI,
+    LOG_MODULE_LOGGER,
+    LOG_MODULE_COUNT
+};
+
+/**
+ * ### 编译期过滤
+ *
+ * 在 platformio.ini 的 build_flags 中设置，例如 env:esp32cam_release 中的
+ * `-DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO '-DLOG_MODULE_MASK=(~(1u << LOG_MODULE_CAMERA))'`。
+ * 低于 LOG_COMPILE_LEVEL 或不在 LOG_MODULE_MASK 中的日志调用整体被编译器删除，参数也不会求值。
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_MODULE_MASK
+#define LOG_MODULE_MASK 0xffffffffu
+#endif
+
+#define LOG_AT(level, module, ...)                                                              \
+    do                                                                                          \
+    {                                                                                           \
+        if ((level) >= LOG_COMPILE_LEVEL && (LOG_MODULE_MASK & (1u << LOG_MODULE_##module)) && \
+            logger.enabled((level), LOG_MODULE_##module))                                       \
+        {                                                                                       \
+            logger.log((level), LOG_MODULE_##module, __VA_ARGS__);                              \
+        }                                                                                       \
+    } while (0)
+
+// 用法：LOG_INFO(MQTT, "订阅: %s", topic.c_str())，格式与 printf 相同
+#define LOG_DEBUG(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#define LOG_INFO(module, ...) LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define LOG_WARNING(module, ...) LOG_AT(LOG_LEVEL_WARNING, module, __VA_ARGS__)
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+
+/**
+ * ### 一条待输出的日志记录
+ *
+ * 调用方只把消息格式化进槽位并记录时间，日期格式化与串口输出都由后台任务完成。
+ */
+struct LogRecord {
+    std::atomic<uint32_t> sequence; ///< 槽位序号，用于无锁的多生产者入队
+    LogLevel level;
+    LogModule module;
+    uint32_t seconds;               ///< 记录时的 Unix 时间（秒）
+    char message[LOG_MESSAGE_SIZE];
+};
+
+/**
+ * ### 日志统计
+ */
+struct LoggerStats {
+    uint32_t records = 0;      ///< 写入缓冲区的记录数
+    uint32_t dropped = 0;      ///< 缓冲区已满被丢弃的记录数
+    uint32_t callerMicros = 0; ///< 调用方累计耗时（微秒），除以 records 即每次调用的平均开销
+    uint32_t filtered = 0;     ///< 被运行时级别过滤掉的调用数
+};
+
 /**
  * ### 日志记录器类，用于记录不同级别的日志信息。
+ *
+ * begin() 之后为异步模式：调用方把记录写入无锁环形缓冲区后立即返回，
+ * 由低优先级的后台任务加上日期、级别与模块名并写串口；缓冲区已满时丢弃新记录并计数，
+ * 后台任务随后输出一条丢弃提示。begin() 之前按原来的方式同步输出。
+ *
+ * 注意：通过过滤的调用，参数在调用方求值，消息也在调用方用 vsnprintf 格式化进槽位，
+ * 这部分开销不会移到后台任务；只有被过滤或缓冲区已满的调用才省掉格式化。
  */
 class Logger {
 public:
     /**
-     * ### 记录信息级别的日志。
-     * 
-     * #### 参数
-     * 
-     * - `msg`：日志消息
-     * - `moduleName`：模块名称
+     * ### 启动后台输出任务，进入异步模式。
+     *
+     * #### 返回
+     *
+     * - bool：任务创建成功返回 true
      */
-    void info(String msg, String moduleName);
+    bool begin();
 
     /**
-     * ### 记录调试级别的日志。
-     * 
-     * - `msg`：日志消息
-     * - `moduleName`：模块名称
+     * ### 运行时过滤
+     *
+     * 编译期保留下来的日志再按模块的运行时级别过滤，低于该级别的调用不格式化消息。
      */
-    void debug(String msg, String moduleName);
+    bool enabled(LogLevel level, LogModule module)
+    {
+        if (level >= moduleLevels[module])
+        {
+            return true;
+        }
+        filtered.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
 
     /**
-     * ### 记录警告级别的日志。
-     * 
+     * ### 记录一条日志，通常通过 LOG_INFO 等宏调用。
+     *
+     * 消息在抢到缓冲区槽位后才格式化，缓冲区已满时不格式化。
+     *
      * #### 参数
-     * 
-     * - `msg`：日志消息
-     * - `moduleName`：模块名称
+     *
+     * - `level`：日志级别
+     * - `module`：模块
+     * - `format`：printf 格式
      */
-    void warning(String msg, String moduleName);
+    void log(LogLevel level, LogModule module, const char *format, ...) __attribute__((format(printf, 4, 5)));
 
     /**
-     * ### 记录错误级别的日志。
-     * 
-     * #### 参数
-     * 
-     * - `msg`：日志消息
-     * - `moduleName`：模块名称
+     * ### 设置模块的运行时日志级别
      */
-    void error(String msg, String moduleName);
+    void setModuleLevel(LogModule module, LogLevel level);
+
+    /**
+     * ### 按文本设置运行时日志级别
+     *
+     * 格式为逗号分隔的 `模块=级别`，模块名不区分大小写，`*` 表示全部模块，
+     * 级别为 debug、info、warning、error、none，例如 `*=info,camera=warning`。
+     *
+     * #### 返回
+     *
+     * - bool：全部条目都有效返回 true，无效条目被忽略
+     */
+    bool applyLevelOverrides(const char *spec);
+
+    /**
+     * ### 获取日志统计
+     */
+    LoggerStats getStats();
+
+private:
+    LogRecord ring[LOG_RING_LENGTH];
+    std::atomic<uint32_t> enqueuePosition{0};
+    uint32_t dequeuePosition = 0;       ///< 只由后台任务修改
+    std::atomic<uint32_t> records{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> callerMicros{0};
+    std::atomic<uint32_t> filtered{0};
+    volatile LogLevel moduleLevels[LOG_MODULE_COUNT] = {}; ///< 各模块的运行时级别，默认全部输出
+    uint32_t reportedDropped = 0;       ///< 后台任务已提示过的丢弃数
+    bool started = false;
+
+    void emit(LogLevel level, uint32_t seconds, LogModule module, const char *msg);
+    void drain();
+    static void drainTask(void *arg);
 };
 
-#endif
\ No newline at end of file
+extern Logger logger;
+
+#endif
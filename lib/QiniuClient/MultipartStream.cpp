@@ -0,0 +1,91 @@
+#include "MultipartStream.h"
+
+void MultipartStream::addSegment(const uint8_t *data, size_t length)
+{
+    if (segmentCount >= MAX_SEGMENTS)
+    {
+        return;
+    }
+    segmentData[segmentCount] = data;
+    segmentLength[segmentCount] = length;
+    segmentCount++;
+    remaining += length;
+}
+
+// 只保存指针，调用者需保证 text 在上传结束前有效
+void MultipartStream::addSegment(const String &text)
+{
+    addSegment((const uint8_t *)text.c_str(), text.length());
+}
+
+size_t MultipartStream::totalLength() const
+{
+    size_t total = 0;
+    for (uint8_t i = 0; i < segmentCount; i++)
+    {
+        total += segmentLength[i];
+    }
+    return total;
+}
+
+// 回到开头，重发请求时复用同一组分段
+void MultipartStream::rewind()
+{
+    current = 0;
+    offset = 0;
+    remaining = totalLength();
+}
+
+void MultipartStream::skipEmpty()
+{
+    while (current < segmentCount && offset >= segmentLength[current])
+    {
+        current++;
+        offset = 0;
+    }
+}
+
+int MultipartStream::available()
+{
+    return remaining;
+}
+
+int MultipartStream::peek()
+{
+    skipEmpty();
+    if (current >= segmentCount)
+    {
+        return -1;
+    }
+    return segmentData[current][offset];
+}
+
+int MultipartStream::read()
+{
+    int c = peek();
+    if (c >= 0)
+    {
+        offset++;
+        remaining--;
+    }
+    return c;
+}
+
+size_t MultipartStream::readBytes(char *buffer, size_t length)
+{
+    size_t copied = 0;
+    while (copied < length)
+    {
+        skipEmpty();
+        if (current >= segmentCount)
+        {
+            break;
+        }
+        size_t chunk = min(length - copied, segmentLength[current] - offset);
+        memcpy(buffer + copied, segmentData[current] + offset, chunk);
+        offset += chunk;
+        copied += chunk;
+    }
+    remaining -= copied;
+    return copied;
+}
@@ -0,0 +1,38 @@
+#ifndef MULTIPART_STREAM_H
+#define MULTIPART_STREAM_H
+
+#include <Arduino.h>
+
+/**
+ * 把若干段内存（表单头、图片数据、表单尾）串联成一个只读 Stream，
+ * HTTPClient 按块读取后直接写入 socket，图片数据不再整体复制。
+ */
+class MultipartStream : public Stream
+{
+public:
+    static const uint8_t MAX_SEGMENTS = 4;
+
+    void addSegment(const uint8_t *data, size_t length);
+    void addSegment(const String &text);
+    size_t totalLength() const;
+    void rewind();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char *buffer, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+private:
+    const uint8_t *segmentData[MAX_SEGMENTS];
+    size_t segmentLength[MAX_SEGMENTS];
+    uint8_t segmentCount = 0;
+    uint8_t current = 0;
+    size_t offset = 0;
+    size_t remaining = 0;
+
+    void skipEmpty();
+};
+
+#endif
@@ -4,6 +4,8 @@ QiniuClient::QiniuClient(String accessKey, String secretKey, String bucketName,
     : HTTPClient(), accessKey(accessKey), secretKey(secretKey), bucketName(bucketName), domain(domain)
 {
     this->uploadToken = "";
+    // 保持与上传域名的长连接，连续上传复用同一个 TCP 连接
+    this->setReuse(true);
     if (zone == "z0" || zone == "华东")
     {
         uploadHost = "upload.qiniup.com";
@@ -38,7 +40,7 @@ QiniuClient::QiniuClient(String accessKey, String secretKey, String bucketName,
     }
     else
     {
-        logger.error("空间代码错误", "Qiniu");
+        LOG_ERROR(QINIU, "空间代码错误");
         uploadHost = "";
     }
 }
@@ -46,26 +48,23 @@ QiniuClient::QiniuClient(String accessKey, String secretKey, String bucketName,
 String QiniuClient::generateUploadToken(String policy)
 {
     String urlSafePolicy = _base64.urlSafeEncode(policy);
-    const uint8_t *key = (const uint8_t *)this->secretKey.c_str();
-    size_t key_len = this->secretKey.length();
-    uint8_t resultArray[20]; 
-    mbedtls_md_context_t ctx;
-    const mbedtls_md_info_t *md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, md_info, 1);
-    mbedtls_md_hmac_starts(&ctx, key, key_len);
-    mbedtls_md_hmac_update(&ctx, (const uint8_t *)urlSafePolicy.c_str(), urlSafePolicy.length());
-    mbedtls_md_hmac_finish(&ctx, resultArray);
-    mbedtls_md_free(&ctx);
-    String encodeSign = _base64.urlSafeEncode(resultArray,sizeof(resultArray));
+    // 密钥块只在第一次签名时派生，之后每次只复制预先计算的摘要状态
+    if (!this->uploadMac.keyed())
+    {
+        this->uploadMac.setKey(this->secretKey);
+    }
+    uint8_t resultArray[20];
+    this->uploadMac.sign((const uint8_t *)urlSafePolicy.c_str(), urlSafePolicy.length(), resultArray);
+    char encodeSign[29];
+    KeyedMac::toBase64Url(resultArray, sizeof(resultArray), encodeSign);
     this->uploadToken = this->accessKey + ":" + encodeSign + ":" + urlSafePolicy;
     return this->uploadToken;
 }
-String QiniuClient::generateUploadPolicy(String imageName)
+String QiniuClient::generateUploadPolicy(String keyPrefix)
 {
     JsonDocument policy;
-    policy["scope"] = this->bucketName + ":" + imageName;
-    policy["deadline"] = timeManager.getTimestamp() + 3600;
+    policy["scope"] = this->bucketName + ":" + keyPrefix;
+    policy["deadline"] = this->tokenDeadline;
     policy["isPrefixalScope"] = 1;
     policy["returnBody"] = "{\"name\":\"$(fname)\",\"url\":\"" + this->domain + "/$(key)\"}";
     String policyString = "";
@@ -73,6 +72,87 @@ String QiniuClient::generateUploadPolicy(String imageName)
     return policyString;
 }
 
+// 生成一个前缀范围的上传凭证，有效期内可用于所有以 QINIU_KEY_PREFIX 开头的文件名
+void QiniuClient::mintUploadToken()
+{
+    uint32_t startUs = micros();
+    this->tokenDeadline = timeManager.getTimestamp() / 1000 + QINIU_TOKEN_TTL;
+    generateUploadToken(generateUploadPolicy(QINIU_KEY_PREFIX));
+    tokenStats.mints++;
+    tokenStats.signMicros += micros() - startUs;
+}
+
+// 凭证的 deadline 取自本地时间，时间未同步时签出的凭证会被服务端拒绝，此时返回空字符串
+String QiniuClient::currentUploadToken()
+{
+    if (!timeManager.waitForSync(QINIU_TIME_WAIT_MS))
+    {
+        LOG_WARNING(QINIU, "时间尚未同步，暂不签发上传凭证");
+        return "";
+    }
+    uint_fast64_t now = timeManager.getTimestamp() / 1000;
+    if (this->uploadToken == "" || now + QINIU_TOKEN_EXPIRY_MARGIN >= this->tokenDeadline)
+    {
+        mintUploadToken();
+    }
+    else
+    {
+        tokenStats.hits++;
+    }
+    return this->uploadToken;
+}
+
+// 供分片上传等其他上传路径复用缓存的凭证，需在上传任务中调用
+String QiniuClient::getUploadToken()
+{
+    return currentUploadToken();
+}
+
+String QiniuClient::getUploadHost()
+{
+    return uploadHost;
+}
+
+void QiniuClient::invalidateUploadToken()
+{
+    this->uploadToken = "";
+    this->tokenDeadline = 0;
+}
+
+// 在上传空闲时调用，凭证进入刷新窗口后提前重新签名，避免上传路径上等待签名
+void QiniuClient::maintain()
+{
+    if (!timeManager.isSynced())
+    {
+        return;
+    }
+    uint_fast64_t now = timeManager.getTimestamp() / 1000;
+    if (this->uploadToken != "" && now + QINIU_TOKEN_REFRESH_WINDOW >= this->tokenDeadline)
+    {
+        tokenStats.proactiveRefreshes++;
+        mintUploadToken();
+    }
+}
+
+// WiFi 断开后长连接必然失效，下次上传直接新建连接，省去一次失败的请求
+void QiniuClient::onNetworkChange(bool up)
+{
+    if (!up)
+    {
+        linkReset = true;
+    }
+}
+
+// 平均每次签名耗时乘以缓存命中次数，即缓存节省的 CPU 时间
+uint32_t QiniuClient::savedSignMicros()
+{
+    if (tokenStats.mints == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)tokenStats.signMicros * tokenStats.hits / tokenStats.mints);
+}
+
 String QiniuClient::generateBoundary() {
     String boundary = "----WebKitFormBoundary";
     for (int i = 0; i < 16; i++) {
@@ -82,9 +162,52 @@ String QiniuClient::generateBoundary() {
 }
 
 String QiniuClient::uploadImage(String imageName, const uint8_t *imageData, size_t imageLength)
+{
+    int httpCode;
+    return uploadImage(imageName, imageData, imageLength, httpCode);
+}
+
+// httpCode 返回最终的 HTTP 状态码，连接或发送失败时为负数，请求未发出（文件名或凭证不可用）时为 0
+String QiniuClient::uploadImage(String imageName, const uint8_t *imageData, size_t imageLength, int &httpCode)
+{
+    httpCode = 0;
+    if (!imageName.startsWith(QINIU_KEY_PREFIX))
+    {
+        LOG_ERROR(QINIU, "文件名不在上传凭证的前缀范围内: %s", imageName.c_str());
+        return "";
+    }
+
+    String token = currentUploadToken();
+    if (token == "")
+    {
+        return "";
+    }
+    String response;
+    httpCode = postImage(imageName, imageData, imageLength, token, response);
+    if (httpCode == HTTP_CODE_UNAUTHORIZED)
+    {
+        // 凭证被服务端拒绝（过期或时钟偏差），重新签名后重试一次
+        LOG_WARNING(QINIU, "上传凭证被拒绝，重新签名后重试");
+        tokenStats.rejections++;
+        invalidateUploadToken();
+        httpCode = postImage(imageName, imageData, imageLength, currentUploadToken(), response);
+    }
+
+    if (httpCode == HTTP_CODE_OK) {
+       JsonDocument doc;
+        deserializeJson(doc, response);
+        String url = doc["url"].as<String>();
+        LOG_INFO(QINIU, "上传成功: %s", url.c_str());
+        return url;
+    } else {
+        LOG_ERROR(QINIU, "上传失败: %s", response.c_str());
+        return "";
+    }
+}
+
+int QiniuClient::postImage(const String &imageName, const uint8_t *imageData, size_t imageLength, const String &token, String &response)
 {
     String boundary = generateBoundary();
-    String token = generateUploadToken(generateUploadPolicy(imageName));
 
     // 构建表单的头部部分
     String head = "--" + boundary + "\r\n"
@@ -103,41 +226,71 @@ String QiniuClient::uploadImage(String imageName, const uint8_t *imageData, size
     // 构建表单的尾部部分
     String tail = "\r\n--" + boundary + "--\r\n";
 
-    // 创建完整的请求体
-    size_t fullBodyLength = head.length() + imageLength + tail.length();
-    uint8_t *fullBody = new uint8_t[fullBodyLength];
-
-    // 将头部数据复制到请求体
-    memcpy(fullBody, head.c_str(), head.length());
-    // 将文件数据复制到请求体
-    memcpy(fullBody + head.length(), imageData, imageLength);
-    // 将尾部数据复制到请求体
-    memcpy(fullBody + head.length() + imageLength, tail.c_str(), tail.length());
+    // 表单头、图片数据、表单尾依次写入 socket，图片数据直接取自帧缓冲区
+    MultipartStream body;
+    body.addSegment(head);
+    body.addSegment(imageData, imageLength);
+    body.addSegment(tail);
 
     String url = "http://" + uploadHost;
 
-    this->begin(url);
+    uint32_t startMs = millis();
+    if (linkReset)
+    {
+        linkReset = false;
+        uploadConnection.stop();
+    }
+    bool reused = uploadConnection.connected();
+    this->begin(uploadConnection, url);
     this->addHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
-    this->addHeader("Content-Length", String(fullBodyLength));
 
-    // 发送完整的请求体
-    int httpCode = this->POST(fullBody, fullBodyLength);
+    // 发送请求体，Content-Length 由 sendRequest 根据预先计算的总长度填写
+    int httpCode = this->sendRequest("POST", &body, body.totalLength());
 
-    // 清理分配的内存
-    delete[] fullBody;
+    if (httpCode < 0 && reused)
+    {
+        // 复用的连接已被服务端关闭，丢弃后用新连接重发一次
+        LOG_WARNING(QINIU, "上传长连接已失效，重新建立连接");
+        connectionStats.staleRetries++;
+        this->end();
+        uploadConnection.stop();
+        body.rewind();
+        reused = false;
+        this->begin(uploadConnection, url);
+        this->addHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+        httpCode = this->sendRequest("POST", &body, body.totalLength());
+    }
+    if (reused)
+    {
+        connectionStats.reused++;
+    }
+    else
+    {
+        connectionStats.opened++;
+    }
 
-    // 获取响应并处理
-    String response = this->getString();
+    // 获取响应，end() 在连接可复用时保持连接不关闭
+    response = this->getString();
     this->end();
+    lastUploadMs = millis() - startMs;
+    totalUploadMs += lastUploadMs;
+    uploadCount++;
+    if (httpCode == HTTP_CODE_OK)
+    {
+        // 计入当前接入点的实测吞吐量，供漫游决策使用
+        wifiManager.recordUpload(body.totalLength(), lastUploadMs);
+    }
 
-    if (httpCode == HTTP_CODE_OK) {
-       JsonDocument doc;
-        deserializeJson(doc, response);
-        String url = doc["url"].as<String>();
-        logger.info("上传成功: " + url, "Qiniu");
-        return url;
-    } else {
-        logger.error("上传失败: " + response, "Qiniu");
+    return httpCode;
+}
+
+String QiniuClient::uploadImage(String imageName, const FrameHandle &frame)
+{
+    if (!frame)
+    {
+        LOG_ERROR(QINIU, "上传失败: 帧缓冲区为空");
         return "";
     }
-}
\ No newline at end of file
+    // 上传期间持有帧引用，直接读取驱动缓冲区，不复制 JPEG
+    return uploadImage(imageName, frame.data(), frame.length());
+}
@@ -4,16 +4,40 @@
 #include <HTTPClient.h>
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <mbedtls/md.h>
+#include "KeyedMac.h"
 #include "_Base64.h"
 #include "Logger.h"
 #include "TimeManager.h"
+#include "FrameHandle.h"
+#include "MultipartStream.h"
+#include "WifiManager.h"
 
 
 extern WiFiClient wifiClient;
 extern Logger logger;
 extern _Base64 _base64;
 extern TimeManager timeManager;
+extern WifiManager wifiManager;
+
+#define QINIU_KEY_PREFIX "image"          // 上传凭证覆盖的文件名前缀
+#define QINIU_TOKEN_TTL 3600              // 上传凭证有效期（秒）
+#define QINIU_TOKEN_REFRESH_WINDOW 600    // 距离过期不足该时长时在空闲期提前刷新（秒）
+#define QINIU_TOKEN_EXPIRY_MARGIN 60      // 距离过期不足该时长时不再使用旧凭证（秒）
+#define QINIU_TIME_WAIT_MS 5000           // 签名前等待时间同步的最长时间（毫秒）
+
+struct TokenStats {
+    uint32_t hits = 0;               // 复用缓存凭证的次数
+    uint32_t mints = 0;              // 重新签名的次数
+    uint32_t proactiveRefreshes = 0; // 空闲期提前刷新的次数
+    uint32_t rejections = 0;         // 凭证被服务端拒绝的次数
+    uint32_t signMicros = 0;         // 累计签名耗时（微秒）
+};
+
+struct ConnectionStats {
+    uint32_t opened = 0;       // 新建 TCP 连接的上传次数
+    uint32_t reused = 0;       // 复用长连接的上传次数
+    uint32_t staleRetries = 0; // 长连接被服务端关闭后重连重发的次数
+};
 
 class QiniuClient:public HTTPClient{
 
@@ -26,11 +50,33 @@ class QiniuClient:public HTTPClient{
         QiniuClient(String accessKey, String secretKey, String bucketName, String domain,String zone);
        
         String uploadImage(String imageName,const uint8_t *imageData, size_t imageLength);
+        String uploadImage(String imageName,const uint8_t *imageData, size_t imageLength, int &httpCode);
+        String uploadImage(String imageName,const FrameHandle &frame);
+
+        uint32_t uploadCount = 0;   // 已完成的上传请求数
+        uint32_t lastUploadMs = 0;  // 最近一次上传耗时
+        uint32_t totalUploadMs = 0; // 累计上传耗时
+
+        void maintain();
+        void onNetworkChange(bool up);
+        String getUploadToken();
+        String getUploadHost();
+        uint32_t savedSignMicros();
+        TokenStats tokenStats;
+        ConnectionStats connectionStats;
     private:
+        WiFiClient uploadConnection; // 与 uploadHost 之间的长连接
+        volatile bool linkReset = false; // WiFi 断开过，长连接已失效，由上传任务关闭
         String uploadHost;
         String uploadToken;
+        KeyedMac uploadMac{MBEDTLS_MD_SHA1}; // 以 secretKey 为密钥的 HMAC-SHA1
+        uint_fast64_t tokenDeadline = 0; // 当前凭证的过期时间（秒级时间戳）
         String generateUploadToken(String policy);
-        String generateUploadPolicy(String imageName);
+        String generateUploadPolicy(String keyPrefix);
+        void mintUploadToken();
+        String currentUploadToken();
+        void invalidateUploadToken();
+        int postImage(const String &imageName, const uint8_t *imageData, size_t imageLength, const String &token, String &response);
         String generateBoundary();
 };
 #endif
\ No newline at end of file
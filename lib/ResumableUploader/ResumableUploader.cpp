@@ -0,0 +1,477 @@
+/**
+ * @file ResumableUploader.cpp
+ * @author 稀饭
+ * @brief 实现了 ResumableUploader 类，包括分片上传 v2 的初始化、分片并发上传、合并与进度持久化。
+ */
+
+#include "ResumableUploader.h"
+
+int FileRangeStream::read()
+{
+    if (remaining == 0)
+    {
+        return -1;
+    }
+    int c = file.read();
+    if (c >= 0)
+    {
+        remaining--;
+    }
+    return c;
+}
+
+int FileRangeStream::peek()
+{
+    return remaining == 0 ? -1 : file.peek();
+}
+
+size_t FileRangeStream::readBytes(char *buffer, size_t length)
+{
+    size_t n = file.read((uint8_t *)buffer, min(length, remaining));
+    remaining -= n;
+    return n;
+}
+
+/**
+ * ### 构造函数
+ *
+ * #### 参数
+ *
+ * - `client`：提供上传域名与上传凭证的七牛客户端
+ * - `maxWorkers`：并发上传分片的最大连接数
+ */
+ResumableUploader::ResumableUploader(QiniuClient &client, uint8_t maxWorkers)
+    : client(client), maxWorkers(constrain(maxWorkers, 1, RESUMABLE_MAX_WORKERS))
+{
+    mutex = xSemaphoreCreateMutex();
+    workerDone = xSemaphoreCreateCounting(RESUMABLE_MAX_WORKERS, 0);
+}
+
+/**
+ * ### 上传内存卡上的文件
+ */
+String ResumableUploader::uploadFile(const String &key, const String &path)
+{
+    if (!key.startsWith(QINIU_KEY_PREFIX))
+    {
+        LOG_ERROR(QINIU, "文件名不在上传凭证的前缀范围内: %s", key.c_str());
+        return "";
+    }
+    File file = SD_MMC.open(path, FILE_READ);
+    if (!file)
+    {
+        LOG_ERROR(QINIU, "分片上传失败：无法打开文件 %s", path.c_str());
+        return "";
+    }
+    totalSize = file.size();
+    file.close();
+    sourcePath = path;
+    sourceData = nullptr;
+    return upload(key);
+}
+
+/**
+ * ### 上传内存中的数据
+ */
+String ResumableUploader::uploadBuffer(const String &key, const uint8_t *data, size_t length)
+{
+    if (!key.startsWith(QINIU_KEY_PREFIX))
+    {
+        LOG_ERROR(QINIU, "文件名不在上传凭证的前缀范围内: %s", key.c_str());
+        return "";
+    }
+    totalSize = length;
+    sourcePath = "";
+    sourceData = data;
+    return upload(key);
+}
+
+/**
+ * ### 执行一次分片上传
+ *
+ * 读取已保存的进度，只上传尚未完成的分片；所有分片完成后合并文件并删除进度记录。
+ * 内存来源不读写进度，每次都重新初始化上传任务。
+ */
+String ResumableUploader::upload(const String &key)
+{
+    if (totalSize == 0)
+    {
+        LOG_ERROR(QINIU, "分片上传失败：文件为空");
+        return "";
+    }
+    partCount = (totalSize + RESUMABLE_PART_SIZE - 1) / RESUMABLE_PART_SIZE;
+    if (partCount > RESUMABLE_MAX_PARTS)
+    {
+        LOG_ERROR(QINIU, "分片上传失败：文件过大，分片数 %u", (unsigned)partCount);
+        return "";
+    }
+
+    this->key = key;
+    this->encodedKey = _base64.urlSafeEncode(key);
+    this->token = client.getUploadToken();
+    if (this->token == "")
+    {
+        LOG_ERROR(QINIU, "分片上传失败：没有可用的上传凭证");
+        return "";
+    }
+    for (uint16_t i = 0; i < partCount; i++)
+    {
+        etags[i] = "";
+    }
+
+    if (loadProgress())
+    {
+        LOG_INFO(QINIU, "从断点继续上传 %s", key.c_str());
+    }
+    else
+    {
+        if (!initUpload())
+        {
+            return "";
+        }
+        saveProgress();
+    }
+
+    uint16_t pending = 0;
+    for (uint16_t i = 0; i < partCount; i++)
+    {
+        if (etags[i] == "")
+        {
+            pending++;
+        }
+    }
+
+    nextPart = 0;
+    failed = false;
+    uint8_t workers = min((uint16_t)maxWorkers, pending);
+    uint8_t started = 0;
+    for (uint8_t i = 0; i < workers; i++)
+    {
+        if (xTaskCreate(ResumableUploader::workerTask, "uploadpart", RESUMABLE_WORKER_STACK_SIZE, this, 2, nullptr) == pdPASS)
+        {
+            started++;
+        }
+    }
+    if (workers > 0 && started == 0)
+    {
+        LOG_ERROR(QINIU, "分片上传失败：无法创建上传任务");
+        return "";
+    }
+    for (uint8_t i = 0; i < started; i++)
+    {
+        xSemaphoreTake(workerDone, portMAX_DELAY);
+    }
+
+    if (failed)
+    {
+        LOG_ERROR(QINIU, "分片上传未完成，进度已保存: %s", key.c_str());
+        return "";
+    }
+    return completeUpload();
+}
+
+String ResumableUploader::baseUrl()
+{
+    return "http://" + client.getUploadHost() + "/buckets/" + client.bucketName + "/objects/" + encodedKey + "/uploads";
+}
+
+String ResumableUploader::progressPath()
+{
+    return String(RESUMABLE_PROGRESS_DIR) + "/" + encodedKey + ".json";
+}
+
+/**
+ * ### 读取上传进度
+ *
+ * #### 返回
+ *
+ * - bool：存在与当前文件匹配且未过期的进度时返回 true；内存来源始终返回 false
+ */
+bool ResumableUploader::loadProgress()
+{
+    if (sourcePath == "")
+    {
+        return false;
+    }
+    File file = SD_MMC.open(progressPath(), FILE_READ);
+    if (!file)
+    {
+        return false;
+    }
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+    {
+        return false;
+    }
+
+    uint32_t now = timeManager.getTimestamp() / 1000;
+    if (doc["size"].as<size_t>() != totalSize || doc["expireAt"].as<uint32_t>() <= now + 60)
+    {
+        clearProgress();
+        return false;
+    }
+
+    uploadId = doc["uploadId"].as<String>();
+    expireAt = doc["expireAt"].as<uint32_t>();
+    JsonArray parts = doc["parts"].as<JsonArray>();
+    uint16_t i = 0;
+    for (JsonVariant part : parts)
+    {
+        if (i >= partCount)
+        {
+            break;
+        }
+        etags[i++] = part.as<String>();
+    }
+    return uploadId != "";
+}
+
+/**
+ * ### 保存上传进度
+ *
+ * 调用者需持有 mutex，或确保没有分片任务在运行。内存来源重启后无法续传，不保存进度。
+ */
+void ResumableUploader::saveProgress()
+{
+    if (sourcePath == "")
+    {
+        return;
+    }
+    if (!SD_MMC.exists(RESUMABLE_PROGRESS_DIR))
+    {
+        SD_MMC.mkdir(RESUMABLE_PROGRESS_DIR);
+    }
+    JsonDocument doc;
+    doc["key"] = key;
+    doc["size"] = totalSize;
+    doc["uploadId"] = uploadId;
+    doc["expireAt"] = expireAt;
+    JsonArray parts = doc["parts"].to<JsonArray>();
+    for (uint16_t i = 0; i < partCount; i++)
+    {
+        parts.add(etags[i]);
+    }
+
+    File file = SD_MMC.open(progressPath(), FILE_WRITE);
+    if (!file)
+    {
+        LOG_ERROR(QINIU, "无法保存分片上传进度");
+        return;
+    }
+    serializeJson(doc, file);
+    file.close();
+}
+
+void ResumableUploader::clearProgress()
+{
+    if (sourcePath == "")
+    {
+        return;
+    }
+    SD_MMC.remove(progressPath());
+}
+
+/**
+ * ### 初始化分片上传任务
+ *
+ * #### 返回
+ *
+ * - bool：获取到 uploadId 返回 true
+ */
+bool ResumableUploader::initUpload()
+{
+    WiFiClient connection;
+    HTTPClient http;
+    http.begin(connection, baseUrl());
+    http.addHeader("Authorization", "UpToken " + token);
+    int httpCode = http.POST("");
+    String response = http.getString();
+    http.end();
+
+    if (httpCode != HTTP_CODE_OK)
+    {
+        LOG_ERROR(QINIU, "分片上传初始化失败: %s", response.c_str());
+        return false;
+    }
+    JsonDocument doc;
+    deserializeJson(doc, response);
+    uploadId = doc["uploadId"].as<String>();
+    expireAt = doc["expireAt"].as<uint32_t>();
+    return uploadId != "";
+}
+
+/**
+ * ### 合并分片
+ *
+ * #### 返回
+ *
+ * - String：成功返回文件地址，失败返回空字符串
+ */
+String ResumableUploader::completeUpload()
+{
+    JsonDocument doc;
+    JsonArray parts = doc["parts"].to<JsonArray>();
+    for (uint16_t i = 0; i < partCount; i++)
+    {
+        JsonObject part = parts.add<JsonObject>();
+        part["etag"] = etags[i];
+        part["partNumber"] = i + 1;
+    }
+    doc["fname"] = key;
+    String body;
+    serializeJson(doc, body);
+
+    WiFiClient connection;
+    HTTPClient http;
+    http.begin(connection, baseUrl() + "/" + uploadId);
+    http.addHeader("Authorization", "UpToken " + token);
+    http.addHeader("Content-Type", "application/json");
+    int httpCode = http.POST(body);
+    String response = http.getString();
+    http.end();
+
+    if (httpCode == HTTP_CODE_OK)
+    {
+        clearProgress();
+        JsonDocument result;
+        deserializeJson(result, response);
+        String url = result["url"].as<String>();
+        LOG_INFO(QINIU, "分片上传成功: %s", url.c_str());
+        return url;
+    }
+    if (httpCode == 612)
+    {
+        // uploadId 已失效，下次从头上传
+        clearProgress();
+    }
+    LOG_ERROR(QINIU, "合并分片失败: %s", response.c_str());
+    return "";
+}
+
+void ResumableUploader::workerTask(void *arg)
+{
+    ResumableUploader *uploader = static_cast<ResumableUploader *>(arg);
+    uploader->workerLoop();
+    xSemaphoreGive(uploader->workerDone);
+    vTaskDelete(nullptr);
+}
+
+/**
+ * ### 分片任务主循环
+ *
+ * 每个任务持有一条独立的连接，不断领取未完成的分片直到全部完成或出现失败。
+ */
+void ResumableUploader::workerLoop()
+{
+    WiFiClient connection;
+    HTTPClient http;
+    http.setReuse(true);
+    uint16_t part;
+    while (claimPart(part))
+    {
+        String etag;
+        bool ok = false;
+        for (uint8_t attempt = 0; attempt < RESUMABLE_PART_RETRIES && !ok; attempt++)
+        {
+            ok = uploadPart(http, connection, part, etag);
+            if (!ok)
+            {
+                connection.stop();
+                if (attempt + 1 < RESUMABLE_PART_RETRIES)
+                {
+                    delay(500 << attempt);
+                }
+            }
+        }
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (ok)
+        {
+            etags[part] = etag;
+            saveProgress();
+        }
+        else
+        {
+            failed = true;
+        }
+        xSemaphoreGive(mutex);
+    }
+}
+
+/**
+ * ### 领取下一个未完成的分片
+ *
+ * #### 返回
+ *
+ * - bool：领取成功返回 true；没有剩余分片或已有分片失败时返回 false
+ */
+bool ResumableUploader::claimPart(uint16_t &part)
+{
+    bool claimed = false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    while (!failed && nextPart < partCount)
+    {
+        uint16_t candidate = nextPart++;
+        if (etags[candidate] == "")
+        {
+            part = candidate;
+            claimed = true;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+    return claimed;
+}
+
+/**
+ * ### 上传一个分片
+ *
+ * #### 返回
+ *
+ * - bool：上传成功返回 true，并通过 `etag` 返回分片标识
+ */
+bool ResumableUploader::uploadPart(HTTPClient &http, WiFiClient &connection, uint16_t part, String &etag)
+{
+    size_t offset = (size_t)part * RESUMABLE_PART_SIZE;
+    size_t length = min((size_t)RESUMABLE_PART_SIZE, totalSize - offset);
+
+    http.begin(connection, baseUrl() + "/" + uploadId + "/" + String(part + 1));
+    http.addHeader("Authorization", "UpToken " + token);
+    http.addHeader("Content-Type", "application/octet-stream");
+
+    int httpCode;
+    if (sourcePath != "")
+    {
+        File file = SD_MMC.open(sourcePath, FILE_READ);
+        if (!file || !file.seek(offset))
+        {
+            http.end();
+            LOG_ERROR(QINIU, "分片读取失败: %s", sourcePath.c_str());
+            return false;
+        }
+        FileRangeStream body(file, length);
+        httpCode = http.sendRequest("PUT", &body, length);
+        file.close();
+    }
+    else
+    {
+        MultipartStream body;
+        body.addSegment(sourceData + offset, length);
+        httpCode = http.sendRequest("PUT", &body, length);
+    }
+
+    String response = http.getString();
+    http.end();
+    if (httpCode != HTTP_CODE_OK)
+    {
+        LOG_WARNING(QINIU, "分片 %u 上传失败: %s", (unsigned)(part + 1), response.c_str());
+        return false;
+    }
+
+    JsonDocument doc;
+    deserializeJson(doc, response);
+    etag = doc["etag"].as<String>();
+    return etag != "";
+}
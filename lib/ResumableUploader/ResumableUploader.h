@@ -0,0 +1,144 @@
+/**
+ * @file ResumableUploader.h
+ * @author 稀饭
+ * @brief 定义了 ResumableUploader 类，实现七牛云分片上传 v2 协议，支持并发上传分片与断点续传。
+ */
+
+#ifndef RESUMABLE_UPLOADER_H
+#define RESUMABLE_UPLOADER_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include <SD_MMC.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "QiniuClient.h"
+#include "Logger.h"
+#include "TimeManager.h"
+#include "_Base64.h"
+
+extern Logger logger;
+extern TimeManager timeManager;
+extern _Base64 _base64;
+
+#define RESUMABLE_PART_SIZE (1024 * 1024) ///< 分片大小，七牛要求除最后一片外不小于 1MB
+#define RESUMABLE_MAX_PARTS 64            ///< 单个文件允许的最大分片数
+#define RESUMABLE_MAX_WORKERS 4           ///< 最大并发连接数
+#define RESUMABLE_PART_RETRIES 3          ///< 单个分片的最大尝试次数
+#define RESUMABLE_WORKER_STACK_SIZE 6144  ///< 分片上传任务栈大小
+#define RESUMABLE_PROGRESS_DIR "/uploads" ///< 上传进度文件所在目录
+
+/**
+ * ### 文件区间流
+ *
+ * 把文件中 [offset, offset + length) 区间包装为只读 Stream，供 HTTPClient 直接发送。
+ */
+class FileRangeStream : public Stream
+{
+public:
+    FileRangeStream(File &file, size_t length) : file(file), remaining(length) {}
+
+    int available() override { return remaining; }
+    int read() override;
+    int peek() override;
+    size_t readBytes(char *buffer, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+private:
+    File &file;
+    size_t remaining;
+};
+
+/**
+ * ### 分片上传器
+ *
+ * 按七牛云分片上传 v2 协议上传大文件或内存缓冲区：初始化任务、并发上传分片、合并分片。
+ * 上传内存卡上的文件时，每完成一个分片就把进度写入内存卡，断网或重启后对同一文件重新调用即可从断点继续；
+ * 内存中的数据在重启后不复存在，不保存进度。
+ *
+ * #### 方法
+ *
+ * - `ResumableUploader(client, maxWorkers)`：构造函数
+ * - `uploadFile(key, path)`：上传内存卡上的文件
+ * - `uploadBuffer(key, data, length)`：上传内存中的数据
+ */
+class ResumableUploader
+{
+public:
+    /**
+     * ### 构造函数
+     *
+     * #### 参数
+     *
+     * - `client`：提供上传域名与上传凭证的七牛客户端
+     * - `maxWorkers`：并发上传分片的最大连接数
+     */
+    ResumableUploader(QiniuClient &client, uint8_t maxWorkers);
+
+    /**
+     * ### 上传内存卡上的文件
+     *
+     * #### 参数
+     *
+     * - `key`：七牛对象名
+     * - `path`：内存卡上的文件路径
+     *
+     * #### 返回
+     *
+     * - String：上传成功返回文件地址，失败返回空字符串（进度已保存，可稍后续传）
+     */
+    String uploadFile(const String &key, const String &path);
+
+    /**
+     * ### 上传内存中的数据
+     *
+     * #### 参数
+     *
+     * - `key`：七牛对象名
+     * - `data`：数据指针，上传期间必须保持有效
+     * - `length`：数据长度
+     *
+     * #### 返回
+     *
+     * - String：上传成功返回文件地址，失败返回空字符串
+     */
+    String uploadBuffer(const String &key, const uint8_t *data, size_t length);
+
+private:
+    QiniuClient &client;
+    uint8_t maxWorkers;
+
+    // 以下为当前上传任务的状态，由 mutex 保护
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t workerDone;
+    String key;
+    String encodedKey;
+    String token;
+    String uploadId;
+    uint32_t expireAt;
+    String sourcePath;            ///< 文件来源，为空时使用 sourceData
+    const uint8_t *sourceData;    ///< 内存来源
+    size_t totalSize;
+    uint16_t partCount;
+    uint16_t nextPart;            ///< 下一个待分配的分片下标
+    bool failed;                  ///< 是否有分片用尽了重试次数
+    String etags[RESUMABLE_MAX_PARTS];
+
+    String upload(const String &key);
+    String baseUrl();
+    String progressPath();
+    bool loadProgress();
+    void saveProgress();
+    void clearProgress();
+    bool initUpload();
+    String completeUpload();
+
+    static void workerTask(void *arg);
+    void workerLoop();
+    bool claimPart(uint16_t &part);
+    bool uploadPart(HTTPClient &http, WiFiClient &connection, uint16_t part, String &etag);
+};
+
+#endif // RESUMABLE_UPLOADER_H
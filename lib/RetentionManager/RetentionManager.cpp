@@ -0,0 +1,162 @@
+/**
+ * @file RetentionManager.cpp
+ * @author 稀饭
+ * @brief 实现了 RetentionManager 类，包括占用估算与后台淘汰、抽稀。
+ */
+
+#include "RetentionManager.h"
+
+/**
+ * ### 启动保留管理
+ *
+ * #### 参数
+ *
+ * - `policy`：保留策略
+ *
+ * #### 返回
+ *
+ * - bool：后台任务启动成功返回 true
+ */
+bool RetentionManager::begin(const RetentionPolicy &policy)
+{
+    this->policy = policy;
+    if (sdcardManager.getStorageMode() != SD_STORAGE_SEGMENT)
+    {
+        LOG_WARNING(RETENTION, "保留管理仅支持段式存储，未启用");
+        return false;
+    }
+
+    cardBytes = SD_MMC.totalBytes();
+    uint64_t used = sampleUsage();
+
+    if (xTaskCreatePinnedToCore(RetentionManager::retentionTask, "retention", RETENTION_STACK_SIZE, this, 1, nullptr, 1) != pdPASS)
+    {
+        LOG_ERROR(RETENTION, "保留管理任务启动失败");
+        return false;
+    }
+    LOG_INFO(RETENTION, "保留管理已启动，内存卡已用 %luMB", (unsigned long)(used / 1024 / 1024));
+    return true;
+}
+
+/**
+ * ### 获取保留统计
+ */
+RetentionStats RetentionManager::getStats()
+{
+    RetentionStats stats;
+    stats.cardBytes = cardBytes;
+    stats.usedBytes = otherBytes + segmentBytes(sdcardManager.getSegmentStore().getSegments());
+    stats.evictedSegments = evictedSegments;
+    stats.thinnedSegments = thinnedSegments;
+    stats.freedBytes = freedBytes;
+    return stats;
+}
+
+/**
+ * ### 测量段文件以外的已用空间
+ *
+ * #### 返回
+ *
+ * - uint64_t：内存卡已用空间
+ */
+uint64_t RetentionManager::sampleUsage()
+{
+    uint64_t used = SD_MMC.usedBytes();
+    uint64_t segments = segmentBytes(sdcardManager.getSegmentStore().getSegments());
+    otherBytes = used > segments ? used - segments : 0;
+    lastSampleMs = millis();
+    return used;
+}
+
+uint64_t RetentionManager::segmentBytes(const std::vector<SegmentInfo> &segments)
+{
+    uint64_t total = 0;
+    for (const auto &info : segments)
+    {
+        total += info.fileSize;
+    }
+    return total;
+}
+
+void RetentionManager::retentionTask(void *arg)
+{
+    static_cast<RetentionManager *>(arg)->retentionLoop();
+}
+
+void RetentionManager::retentionLoop()
+{
+    for (;;)
+    {
+        if (millis() - lastSampleMs >= RETENTION_RESAMPLE_INTERVAL_MS)
+        {
+            sampleUsage();
+        }
+        enforce();
+        vTaskDelay(pdMS_TO_TICKS(RETENTION_CHECK_INTERVAL_MS));
+    }
+}
+
+/**
+ * ### 执行一次保留策略
+ *
+ * 依次处理：超龄删除、超过字节上限或高水位时删除最旧的段、对较旧的段抽稀。
+ * 当前写入段（列表最后一个）从不处理。
+ */
+void RetentionManager::enforce()
+{
+    SegmentStore &store = sdcardManager.getSegmentStore();
+    std::vector<SegmentInfo> segments = store.getSegments();
+    if (segments.size() < 2)
+    {
+        return;
+    }
+
+    uint64_t now = timeManager.getTimestamp();
+    uint64_t segBytes = segmentBytes(segments);
+    bool overHighWater = policy.highWaterPercent > 0 && cardBytes > 0 &&
+                         (otherBytes + segBytes) * 100 > cardBytes * policy.highWaterPercent;
+    uint64_t lowWaterBytes = cardBytes * (policy.lowWaterPercent ? policy.lowWaterPercent : policy.highWaterPercent) / 100;
+
+    size_t sealed = segments.size() - 1;
+    for (size_t i = 0; i < sealed; i++)
+    {
+        const SegmentInfo &info = segments[i];
+        bool expired = policy.maxAgeSec > 0 && info.count > 0 &&
+                       info.lastTimestamp + (uint64_t)policy.maxAgeSec * 1000 < now;
+        bool overBytes = policy.maxBytes > 0 && segBytes > policy.maxBytes;
+        bool overCard = overHighWater && otherBytes + segBytes > lowWaterBytes;
+        if (!expired && !overBytes && !overCard)
+        {
+            break;
+        }
+        if (store.removeSegment(info.id))
+        {
+            segBytes -= info.fileSize;
+            freedBytes += info.fileSize;
+            evictedSegments++;
+            LOG_INFO(RETENTION, "淘汰段 %s", SegmentStore::segmentPath(info.id).c_str());
+        }
+    }
+
+    if (policy.thinAfterSec == 0 || policy.keepEvery < 2)
+    {
+        return;
+    }
+    segments = store.getSegments();
+    for (size_t i = 0; i + 1 < segments.size(); i++)
+    {
+        const SegmentInfo &info = segments[i];
+        if (info.thinned || info.count < policy.keepEvery ||
+            info.lastTimestamp + (uint64_t)policy.thinAfterSec * 1000 >= now)
+        {
+            continue;
+        }
+        if (store.thinSegment(info.id, policy.keepEvery))
+        {
+            thinnedSegments++;
+            LOG_INFO(RETENTION, "抽稀段 %s", SegmentStore::segmentPath(info.id).c_str());
+            // 每轮只抽稀一个段，避免长时间占用内存卡带宽
+            break;
+        }
+    }
+}
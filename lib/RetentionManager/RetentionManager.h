@@ -0,0 +1,91 @@
+/**
+ * @file RetentionManager.h
+ * @author 稀饭
+ * @brief 定义了 RetentionManager 类，在内存卡将满时按保留策略淘汰最旧的段文件。
+ */
+
+#ifndef RETENTION_MANAGER_H
+#define RETENTION_MANAGER_H
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "SdCardManager.h"
+#include "SegmentStore.h"
+#include "TimeManager.h"
+#include "Logger.h"
+
+extern SdCardManager sdcardManager;
+extern TimeManager timeManager;
+extern Logger logger;
+
+#define RETENTION_CHECK_INTERVAL_MS 10000 ///< 后台检查周期
+#define RETENTION_STACK_SIZE 4096         ///< 后台任务栈大小
+#define RETENTION_RESAMPLE_INTERVAL_MS (10UL * 60 * 1000) ///< 重新测量段文件以外已用空间的间隔
+
+/**
+ * ### 保留策略
+ *
+ * 各项为 0 表示不启用该限制。
+ */
+struct RetentionPolicy
+{
+    uint64_t maxBytes;         ///< 段文件总占用上限（字节）
+    uint32_t maxAgeSec;        ///< 最长保留时间（秒），早于此的段整体删除
+    uint32_t thinAfterSec;     ///< 早于此时间（秒）的段只保留每 keepEvery 帧中的一帧
+    uint16_t keepEvery;        ///< 抽稀时保留的间隔
+    uint8_t highWaterPercent;  ///< 内存卡使用率超过该值时开始淘汰
+    uint8_t lowWaterPercent;   ///< 淘汰到使用率低于该值为止
+};
+
+/**
+ * ### 保留统计
+ */
+struct RetentionStats
+{
+    uint64_t cardBytes;        ///< 内存卡总容量
+    uint64_t usedBytes;        ///< 估算的已用空间
+    uint32_t evictedSegments;  ///< 已删除的段数
+    uint32_t thinnedSegments;  ///< 已抽稀的段数
+    uint64_t freedBytes;       ///< 删除段累计释放的字节数
+};
+
+/**
+ * ### 保留管理器
+ *
+ * 启动时读取内存卡容量与已用空间，之后根据段文件摘要增量估算占用，不扫描目录。
+ * 段文件以外的占用（按帧存储的旧图像、日志等）由后台任务每隔 RETENTION_RESAMPLE_INTERVAL_MS
+ * 用 SD_MMC.usedBytes() 重新测量一次，两次测量之间的变化不计入水位判断。
+ * 后台低优先级任务周期性检查：超过水位线或字节上限时从最旧的段开始删除，
+ * 删除超过最长保留时间的段，并对较旧的段抽稀。写卡路径上不做任何保留相关的工作。
+ * 仅支持段式存储。
+ *
+ * #### 方法
+ *
+ * - `begin(policy)`：设置策略并启动后台任务
+ * - `getStats()`：获取保留统计
+ */
+class RetentionManager
+{
+public:
+    bool begin(const RetentionPolicy &policy);
+    RetentionStats getStats();
+
+private:
+    RetentionPolicy policy;
+    uint64_t cardBytes = 0;
+    uint64_t otherBytes = 0;   ///< 段文件以外的已用空间（最近一次测量）
+    uint32_t lastSampleMs = 0;
+    volatile uint32_t evictedSegments = 0;
+    volatile uint32_t thinnedSegments = 0;
+    uint64_t freedBytes = 0;
+
+    static void retentionTask(void *arg);
+    void retentionLoop();
+    uint64_t sampleUsage();
+    void enforce();
+    uint64_t segmentBytes(const std::vector<SegmentInfo> &segments);
+};
+
+#endif // RETENTION_MANAGER_H
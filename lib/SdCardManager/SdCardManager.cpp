@@ -1,4 +1,5 @@
 #include "SdCardManager.h"
+#include <esp_heap_caps.h>
 
 /**
  * ### 初始化SD卡管理器
@@ -11,17 +12,45 @@ void SdCardManager::init()
 {
     if (!SD_MMC.begin())
     {
-        logger.error("内存卡挂载失败", "sdcard");
+        LOG_ERROR(SDCARD, "内存卡挂载失败");
         return;
     }
     uint8_t cardType = SD_MMC.cardType();
     if (cardType == CARD_NONE)
     {
-        logger.error("内存卡类型错误", "sdcard");
+        LOG_ERROR(SDCARD, "内存卡类型错误");
         return;
     }
 
-    logger.info("内存卡挂载成功", "sdcard");
+    LOG_INFO(SDCARD, "内存卡挂载成功");
+
+    if (storageMode == SD_STORAGE_SEGMENT && !segmentStore.begin())
+    {
+        LOG_ERROR(SDCARD, "段式存储初始化失败，改为按帧存储");
+        storageMode = SD_STORAGE_FILE;
+    }
+}
+
+/**
+ * ### 设置图像存储方式
+ * 
+ * #### 参数
+ * 
+ * - `mode` 存储方式，`SD_STORAGE_SEGMENT` 把帧追加到段文件，`SD_STORAGE_FILE` 每帧一个文件
+ */
+void SdCardManager::setStorageMode(SdStorageMode mode)
+{
+    storageMode = mode;
+}
+
+SdStorageMode SdCardManager::getStorageMode()
+{
+    return storageMode;
+}
+
+SegmentStore &SdCardManager::getSegmentStore()
+{
+    return segmentStore;
 }
 
 /**
@@ -33,18 +62,28 @@ void SdCardManager::init()
  */
 void SdCardManager::checkDirExists(const String &dir)
 {
+    for (const auto &known : knownDirs)
+    {
+        if (known == dir)
+        {
+            return;
+        }
+    }
+
     if (!SD_MMC.exists(dir))
     {
-        logger.info("创建目录 " + dir, "sdcard");
+        LOG_INFO(SDCARD, "创建目录 %s", dir.c_str());
         if (SD_MMC.mkdir(dir))
         {
-            logger.info("创建目录 " + dir + " 成功", "sdcard");
+            LOG_INFO(SDCARD, "创建目录 %s 成功", dir.c_str());
         }
         else
         {
-            logger.error("创建目录 " + dir + " 失败", "sdcard");
+            LOG_ERROR(SDCARD, "创建目录 %s 失败", dir.c_str());
+            return;
         }
     }
+    knownDirs.push_back(dir);
 }
 
 /**
@@ -58,31 +97,372 @@ void SdCardManager::saveImage(camera_fb_t *fb)
 {
     if (!fb)
     {
-        logger.error("保存图像失败：帧缓冲区为空", "sdcard");
+        LOG_ERROR(SDCARD, "保存图像失败：帧缓冲区为空");
+        return;
+    }
+
+    saveImage(fb->buf, fb->len);
+}
+
+/**
+ * ### 保存帧句柄指向的图像到SD卡。
+ * 
+ * 调用期间持有帧的一个引用，直接写出驱动缓冲区中的 JPEG 数据，不做复制。
+ * 
+ * #### 参数
+ * 
+ * - `frame` 帧句柄
+ */
+void SdCardManager::saveImage(const FrameHandle &frame)
+{
+    if (!frame)
+    {
+        LOG_ERROR(SDCARD, "保存图像失败：帧缓冲区为空");
         return;
     }
 
+    saveImage(frame.data(), frame.length(), frame.timestamp());
+}
+
+/**
+ * ### 保存图像数据到SD卡。
+ * 
+ * 以当前时间作为拍摄时间。
+ * 
+ * #### 参数
+ * 
+ * - `buf` JPEG 数据
+ * - `len` JPEG 数据长度
+ */
+void SdCardManager::saveImage(const uint8_t *buf, size_t len)
+{
+    saveImage(buf, len, timeManager.getTimestamp());
+}
+
+/**
+ * ### 按拍摄时间生成图像文件路径。
+ * 
+ * #### 参数
+ * 
+ * - `timestamp` 拍摄时间戳（毫秒）
+ * 
+ * #### 返回
+ * 
+ * - String：形如 `/pictures/YYYYMMDDHHMMSS.jpg` 的路径
+ */
+String SdCardManager::imagePath(uint_fast64_t timestamp)
+{
+    time_t seconds = timestamp / 1000;
+    struct tm timeinfo;
+    localtime_r(&seconds, &timeinfo);
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y%m%d%H%M%S", &timeinfo);
+    return "/pictures/" + String(buffer) + ".jpg";
+}
+
+/**
+ * ### 保存图像数据到SD卡。
+ * 
+ * #### 参数
+ * 
+ * - `buf` JPEG 数据
+ * - `len` JPEG 数据长度
+ * - `timestamp` 拍摄时间戳（毫秒），决定文件名
+ */
+void SdCardManager::saveImage(const uint8_t *buf, size_t len, uint_fast64_t timestamp)
+{
+    writeImage(buf, len, timestamp, true);
+}
+
+/**
+ * ### 写入图像数据。
+ * 
+ * #### 参数
+ * 
+ * - `buf` JPEG 数据
+ * - `len` JPEG 数据长度
+ * - `timestamp` 拍摄时间戳（毫秒）
+ * - `flush` 段式存储下是否立即落盘，批量写入时只在最后一帧落盘
+ * 
+ * #### 返回
+ * 
+ * - bool：写入成功返回 true
+ */
+bool SdCardManager::writeImage(const uint8_t *buf, size_t len, uint_fast64_t timestamp, bool flush)
+{
+    if (!buf)
+    {
+        LOG_ERROR(SDCARD, "保存图像失败：帧缓冲区为空");
+        return false;
+    }
+
+    if (storageMode == SD_STORAGE_SEGMENT)
+    {
+        bool ok = segmentStore.append(buf, len, timestamp, flush);
+        if (ok)
+        {
+            LOG_INFO(SDCARD, "图像保存成功: %llu", (unsigned long long)timestamp);
+        }
+        return ok;
+    }
+
     checkDirExists("/pictures");
 
-    String filename = "/pictures/" + String(timeManager.getFormattedDateAndTime())+ ".jpg";
+    String filename = imagePath(timestamp);
 
     File file = SD_MMC.open(filename, FILE_WRITE);
     if (!file)
     {
-        logger.error("无法打开文件 " + filename + " 进行写入", "sdcard");
-        return;
+        LOG_ERROR(SDCARD, "无法打开文件 %s 进行写入", filename.c_str());
+        return false;
     }
 
-    size_t written = file.write(fb->buf, fb->len);
+    size_t written = stagedWrite(file, buf, len, stage, SD_STAGE_BUFFER_SIZE);
 
-    if (written != fb->len)
+    bool ok = written == len;
+    if (!ok)
     {
-        logger.error("写入文件 " + filename + " 时发生错误", "sdcard");
+        LOG_ERROR(SDCARD, "写入文件 %s 时发生错误", filename.c_str());
     }
     else
     {
-        logger.info("图像保存成功: " + filename, "sdcard");
+        LOG_INFO(SDCARD, "图像保存成功: %s", filename.c_str());
     }
 
     file.close();
+    return ok;
+}
+
+/**
+ * ### 启动后台写卡任务。
+ * 
+ * 写卡任务运行在核心 1，调用者通过 `submit()` 提交帧后立即返回，内存卡的写入延迟与
+ * 磨损均衡造成的停顿不会传递给拍照任务。
+ * 
+ * #### 参数
+ * 
+ * - `policy` 队列已满时的处理策略
+ * 
+ * #### 返回
+ * 
+ * - bool：任务启动成功返回 true
+ */
+bool SdCardManager::startWriter(SdQueuePolicy policy)
+{
+    queuePolicy = policy;
+    queueCapacity = SD_WRITER_QUEUE_LENGTH + (policy == SD_QUEUE_SPILL ? SD_WRITER_SPILL_LENGTH : 0);
+    writerQueue = xQueueCreate(queueCapacity, sizeof(FrameBlock *));
+    if (!stage)
+    {
+        stage = (uint8_t *)heap_caps_malloc(SD_STAGE_BUFFER_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    }
+    if (!writerQueue ||
+        xTaskCreatePinnedToCore(SdCardManager::writerTask, "sdwriter", SD_WRITER_STACK_SIZE, this, 2, nullptr, 1) != pdPASS)
+    {
+        LOG_ERROR(SDCARD, "写卡任务启动失败");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * ### 提交一帧到写卡任务。
+ * 
+ * 从不阻塞。队列中的驱动帧数达到 `SD_WRITER_QUEUE_LENGTH` 时按策略处理：
+ * 丢弃新帧、丢弃最旧的帧，或把新帧复制到 PSRAM 后排队以便立即归还驱动缓冲区。
+ * 
+ * #### 参数
+ * 
+ * - `frame` 帧句柄，写卡任务持有其一个引用
+ * 
+ * #### 返回
+ * 
+ * - bool：帧已进入队列返回 true
+ */
+bool SdCardManager::submit(const FrameHandle &frame)
+{
+    if (!writerQueue || !frame)
+    {
+        return false;
+    }
+    submitted++;
+
+    UBaseType_t depth = uxQueueMessagesWaiting(writerQueue);
+    if (depth < SD_WRITER_QUEUE_LENGTH)
+    {
+        return enqueue(frame);
+    }
+
+    switch (queuePolicy)
+    {
+    case SD_QUEUE_DROP_OLDEST:
+    {
+        FrameBlock *oldest;
+        if (xQueueReceive(writerQueue, &oldest, 0) == pdTRUE)
+        {
+            FrameHandle::adopt(oldest).reset();
+            dropped++;
+        }
+        return enqueue(frame);
+    }
+    case SD_QUEUE_SPILL:
+    {
+        FrameHandle copy = FrameHandle::copyOf(frame);
+        if (copy && enqueue(copy))
+        {
+            spilled++;
+            return true;
+        }
+        dropped++;
+        return false;
+    }
+    case SD_QUEUE_DROP_NEWEST:
+    default:
+        dropped++;
+        return false;
+    }
+}
+
+bool SdCardManager::enqueue(const FrameHandle &frame)
+{
+    FrameHandle ref = frame;
+    FrameBlock *block = ref.detach();
+    if (xQueueSend(writerQueue, &block, 0) != pdTRUE)
+    {
+        FrameHandle::adopt(block).reset();
+        return false;
+    }
+    UBaseType_t depth = uxQueueMessagesWaiting(writerQueue);
+    if (depth > maxDepth)
+    {
+        maxDepth = depth;
+    }
+    return true;
+}
+
+/**
+ * ### 获取写卡任务统计。
+ */
+SdWriterStats SdCardManager::getWriterStats()
+{
+    SdWriterStats stats;
+    stats.submitted = submitted;
+    stats.written = written;
+    stats.failed = failed;
+    stats.dropped = dropped;
+    stats.spilled = spilled;
+    stats.depth = writerQueue ? uxQueueMessagesWaiting(writerQueue) : 0;
+    stats.maxDepth = maxDepth;
+    for (int i = 0; i < SD_LATENCY_BUCKETS; i++)
+    {
+        stats.latencyHistogram[i] = latencyHistogram[i];
+    }
+    return stats;
+}
+
+void SdCardManager::recordLatency(uint32_t ms)
+{
+    static const uint32_t bounds[SD_LATENCY_BUCKETS - 1] = {5, 10, 20, 50, 100, 200, 500};
+    int bucket = 0;
+    while (bucket < SD_LATENCY_BUCKETS - 1 && ms >= bounds[bucket])
+    {
+        bucket++;
+    }
+    latencyHistogram[bucket]++;
+}
+
+void SdCardManager::writerTask(void *arg)
+{
+    static_cast<SdCardManager *>(arg)->writerLoop();
+}
+
+/**
+ * ### 写卡任务主循环。
+ * 
+ * 每次取出队列中已有的全部帧（最多 `SD_WRITER_BATCH` 帧）连续写入，段式存储下只在最后一帧落盘。
+ */
+void SdCardManager::writerLoop()
+{
+    FrameBlock *block;
+    for (;;)
+    {
+        if (xQueueReceive(writerQueue, &block, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        for (int batch = 0; batch < SD_WRITER_BATCH && block; batch++)
+        {
+            FrameBlock *next = nullptr;
+            if (batch + 1 < SD_WRITER_BATCH && xQueueReceive(writerQueue, &next, 0) != pdTRUE)
+            {
+                next = nullptr;
+            }
+
+            FrameHandle frame = FrameHandle::adopt(block);
+            uint32_t startMs = millis();
+            bool ok = writeImage(frame.data(), frame.length(), frame.timestamp(), next == nullptr);
+            recordLatency(millis() - startMs);
+            if (ok)
+            {
+                written++;
+            }
+            else
+            {
+                failed++;
+            }
+            block = next;
+        }
+    }
+}
+
+/**
+ * ### 按拍摄时间从SD卡读取图像。
+ * 
+ * #### 参数
+ * 
+ * - `timestamp` 拍摄时间戳（毫秒）
+ * - `buf` 输出：新分配的 JPEG 缓冲区，使用完毕后由调用者 `free()`
+ * - `len` 输出：JPEG 数据长度
+ * 
+ * #### 返回
+ * 
+ * - bool：读取成功返回 true
+ */
+bool SdCardManager::loadImage(uint_fast64_t timestamp, uint8_t *&buf, size_t &len)
+{
+    if (storageMode == SD_STORAGE_SEGMENT)
+    {
+        return segmentStore.read(timestamp, buf, len);
+    }
+
+    String filename = imagePath(timestamp);
+    File file = SD_MMC.open(filename, FILE_READ);
+    if (!file)
+    {
+        return false;
+    }
+
+    len = file.size();
+    buf = (uint8_t *)ps_malloc(len);
+    if (!buf)
+    {
+        buf = (uint8_t *)malloc(len);
+    }
+    if (!buf)
+    {
+        LOG_ERROR(SDCARD, "读取图像失败：内存不足 %s", filename.c_str());
+        file.close();
+        return false;
+    }
+
+    size_t read = file.read(buf, len);
+    file.close();
+    if (read != len)
+    {
+        LOG_ERROR(SDCARD, "读取文件 %s 时发生错误", filename.c_str());
+        free(buf);
+        buf = nullptr;
+        return false;
+    }
+    return true;
 }
@@ -10,25 +10,114 @@
 #include <Arduino.h>
 #include <SD_MMC.h>
 #include <esp_camera.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include "Logger.h"
 #include "TimeManager.h"
+#include "FrameHandle.h"
+#include "SegmentStore.h"
 
 extern TimeManager timeManager;
 extern Logger logger;
+
+/**
+ * ### 图像存储方式
+ */
+enum SdStorageMode {
+    SD_STORAGE_FILE,    ///< 每帧一个文件：/pictures/YYYYMMDDHHMMSS.jpg
+    SD_STORAGE_SEGMENT  ///< 追加写入段文件：/segments/*.seg + *.idx
+};
+
+#define SD_WRITER_QUEUE_LENGTH 2      ///< 写卡队列中最多持有的驱动帧数（与相机 fb_count 相同）
+#define SD_WRITER_SPILL_LENGTH 8      ///< 溢出策略下额外缓存的 PSRAM 副本帧数
+#define SD_WRITER_BATCH 8             ///< 写卡任务一次最多合并写入的帧数
+#define SD_WRITER_STACK_SIZE 4096     ///< 写卡任务栈大小
+#define SD_LATENCY_BUCKETS 8          ///< 写入延迟直方图的桶数
+
+/**
+ * ### 写卡队列已满时的处理策略
+ */
+enum SdQueuePolicy {
+    SD_QUEUE_DROP_NEWEST, ///< 丢弃新到的帧
+    SD_QUEUE_DROP_OLDEST, ///< 丢弃队列中最旧的帧，为新帧腾出位置
+    SD_QUEUE_SPILL        ///< 把新帧复制到 PSRAM 后排队，立即归还驱动缓冲区
+};
+
+/**
+ * ### 写卡任务统计
+ *
+ * 延迟直方图的桶上限依次为 5、10、20、50、100、200、500 毫秒，最后一个桶为 500 毫秒以上。
+ */
+struct SdWriterStats {
+    uint32_t submitted;                          ///< 提交的帧数
+    uint32_t written;                            ///< 写入成功的帧数
+    uint32_t failed;                             ///< 写入失败的帧数
+    uint32_t dropped;                            ///< 按策略丢弃的帧数
+    uint32_t spilled;                            ///< 复制到 PSRAM 后排队的帧数
+    uint32_t depth;                              ///< 当前队列深度
+    uint32_t maxDepth;                           ///< 队列深度峰值
+    uint32_t latencyHistogram[SD_LATENCY_BUCKETS]; ///< 单帧写入耗时分布
+};
+
 /**
  * ### 内存卡管理类
  * 
  * #### 方法
  * 
  * - `init()` 初始化内存卡
- * - `checkDirExists(const String& dir)` 检查目录是否存在，不存在则创建
+ * - `setStorageMode(SdStorageMode mode)` 设置图像存储方式，需在 `init()` 之前调用
+ * - `startWriter(SdQueuePolicy policy)` 启动后台写卡任务
+ * - `submit(const FrameHandle &frame)` 把帧交给写卡任务，从不阻塞
+ * - `getWriterStats()` 获取写卡任务统计
+ * - `checkDirExists(const String& dir)` 检查目录是否存在，不存在则创建（结果会被缓存）
  * - `saveImage(camera_fb_t *fb)` 保存图片到内存卡
+ * - `saveImage(const FrameHandle &frame)` 保存帧句柄指向的图片到内存卡
+ * - `saveImage(const uint8_t *buf, size_t len)` 保存图像数据到内存卡
+ * - `saveImage(const uint8_t *buf, size_t len, uint_fast64_t timestamp)` 按拍摄时间保存图像数据到内存卡
+ * - `loadImage(uint_fast64_t timestamp, uint8_t *&buf, size_t &len)` 按拍摄时间读取图片
+ * - `imagePath(uint_fast64_t timestamp)` 按拍摄时间生成图片路径
  */
 class SdCardManager {
 public:
     void init();
+    void setStorageMode(SdStorageMode mode);
+    SdStorageMode getStorageMode();
+    SegmentStore &getSegmentStore();
+    bool startWriter(SdQueuePolicy policy);
+    bool submit(const FrameHandle &frame);
+    SdWriterStats getWriterStats();
     void checkDirExists(const String& dir);
     void saveImage(camera_fb_t *fb);
+    void saveImage(const FrameHandle &frame);
+    void saveImage(const uint8_t *buf, size_t len);
+    void saveImage(const uint8_t *buf, size_t len, uint_fast64_t timestamp);
+    bool loadImage(uint_fast64_t timestamp, uint8_t *&buf, size_t &len);
+    String imagePath(uint_fast64_t timestamp);
+
+private:
+    SdStorageMode storageMode = SD_STORAGE_FILE;
+    SegmentStore segmentStore;
+    std::vector<String> knownDirs;     // 已确认存在的目录
+    uint8_t *stage = nullptr;          // 按帧存储时的写入中转缓冲区
+
+    QueueHandle_t writerQueue = nullptr; // 元素为 FrameBlock*
+    SdQueuePolicy queuePolicy = SD_QUEUE_DROP_NEWEST;
+    uint32_t queueCapacity = 0;
+    volatile uint32_t submitted = 0;
+    volatile uint32_t written = 0;
+    volatile uint32_t failed = 0;
+    volatile uint32_t dropped = 0;
+    volatile uint32_t spilled = 0;
+    volatile uint32_t maxDepth = 0;
+    volatile uint32_t latencyHistogram[SD_LATENCY_BUCKETS] = {};
+
+    bool writeImage(const uint8_t *buf, size_t len, uint_fast64_t timestamp, bool flush);
+    bool enqueue(const FrameHandle &frame);
+    void recordLatency(uint32_t ms);
+    static void writerTask(void *arg);
+    void writerLoop();
 
 };
 
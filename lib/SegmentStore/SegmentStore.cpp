@@ -0,0 +1,593 @@
+/**
+ * @file SegmentStore.cpp
+ * @author 稀饭
+ * @brief 实现了 SegmentStore 类，包括段文件的预分配、滚动、追加写入与按时间读取。
+ */
+
+#include "SegmentStore.h"
+#include <algorithm>
+#include <esp32/rom/crc.h>
+#include <esp_heap_caps.h>
+
+/**
+ * ### 段文件路径
+ */
+String SegmentStore::segmentPath(uint32_t id)
+{
+    char path[32];
+    snprintf(path, sizeof(path), SEGMENT_DIR "/%08lu.seg", (unsigned long)id);
+    return String(path);
+}
+
+/**
+ * ### 索引文件路径
+ */
+String SegmentStore::indexPath(uint32_t id)
+{
+    char path[32];
+    snprintf(path, sizeof(path), SEGMENT_DIR "/%08lu.idx", (unsigned long)id);
+    return String(path);
+}
+
+/**
+ * ### 初始化段式存储
+ *
+ * 启动时扫描一次段目录：先处理抽稀留下的 .tmp 与 .old 文件，再从各索引文件恢复段摘要，
+ * 并在最后一个段的有效数据末尾继续写入。
+ *
+ * #### 返回
+ *
+ * - bool：初始化成功返回 true
+ */
+bool SegmentStore::begin()
+{
+    if (!mutex)
+    {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (!stage)
+    {
+        stage = (uint8_t *)heap_caps_malloc(SD_STAGE_BUFFER_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    }
+    if (!SD_MMC.exists(SEGMENT_DIR) && !SD_MMC.mkdir(SEGMENT_DIR))
+    {
+        LOG_ERROR(SEGMENT, "创建目录 " SEGMENT_DIR " 失败");
+        return false;
+    }
+
+    segments.clear();
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> unfinished;
+    File root = SD_MMC.open(SEGMENT_DIR);
+    File entry = root.openNextFile();
+    while (entry)
+    {
+        String name = entry.name();
+        entry.close();
+        int slash = name.lastIndexOf('/');
+        uint32_t id = name.substring(slash + 1).toInt();
+        if (id > 0 && name.endsWith(".idx"))
+        {
+            ids.push_back(id);
+        }
+        else if (id > 0 && (name.endsWith(SEGMENT_TMP_SUFFIX) || name.endsWith(SEGMENT_OLD_SUFFIX)))
+        {
+            unfinished.push_back(id);
+        }
+        entry = root.openNextFile();
+    }
+    root.close();
+
+    std::sort(unfinished.begin(), unfinished.end());
+    unfinished.erase(std::unique(unfinished.begin(), unfinished.end()), unfinished.end());
+    for (uint32_t id : unfinished)
+    {
+        if (recoverThinning(id) && std::find(ids.begin(), ids.end(), id) == ids.end())
+        {
+            ids.push_back(id);
+        }
+    }
+    for (uint32_t id : ids)
+    {
+        SegmentInfo info;
+        if (loadSegmentInfo(id, info))
+        {
+            segments.push_back(info);
+        }
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const SegmentInfo &a, const SegmentInfo &b) { return a.id < b.id; });
+
+    bool ok;
+    if (segments.empty())
+    {
+        ok = openSegment(1, true);
+        if (ok)
+        {
+            segments.push_back({1, 0, 0, 0, 0, SEGMENT_SIZE, false});
+        }
+        writeOffset = 0;
+    }
+    else
+    {
+        ok = openSegment(segments.back().id, false);
+        writeOffset = segments.back().bytes;
+    }
+
+    if (ok)
+    {
+        LOG_INFO(SEGMENT, "段式存储就绪，共 %u 个段", (unsigned)segments.size());
+    }
+    return ok;
+}
+
+/**
+ * ### 读取段摘要
+ *
+ * 只读取索引文件的首尾两条记录；末尾不完整的记录（写入时掉电）被忽略。
+ */
+bool SegmentStore::loadSegmentInfo(uint32_t id, SegmentInfo &info)
+{
+    File index = SD_MMC.open(indexPath(id), FILE_READ);
+    if (!index)
+    {
+        return false;
+    }
+    info = {id, 0, 0, 0, 0, 0, false};
+    info.count = index.size() / sizeof(SegmentIndexEntry);
+    if (info.count > 0)
+    {
+        SegmentIndexEntry first, last;
+        index.seek(0);
+        index.read((uint8_t *)&first, sizeof(first));
+        index.seek((info.count - 1) * sizeof(SegmentIndexEntry));
+        index.read((uint8_t *)&last, sizeof(last));
+        info.firstTimestamp = first.timestamp;
+        info.lastTimestamp = last.timestamp;
+        info.bytes = last.offset + last.length;
+        info.thinned = first.flags & SEGMENT_FLAG_THINNED;
+    }
+    index.close();
+
+    File data = SD_MMC.open(segmentPath(id), FILE_READ);
+    if (data)
+    {
+        info.fileSize = data.size();
+        data.close();
+    }
+    return true;
+}
+
+/**
+ * ### 打开段文件
+ *
+ * #### 参数
+ *
+ * - `id`：段编号
+ * - `create`：为 true 时新建并预分配段文件，否则在索引中最后一条完整记录之后继续写入
+ */
+bool SegmentStore::openSegment(uint32_t id, bool create)
+{
+    String path = segmentPath(id);
+    if (create)
+    {
+        // 预分配整段空间，之后的写入不再扩展 FAT 簇链
+        File file = SD_MMC.open(path, FILE_WRITE);
+        if (!file || !file.seek(SEGMENT_SIZE - 1) || file.write((uint8_t)0) != 1)
+        {
+            LOG_ERROR(SEGMENT, "预分配段文件失败: %s", path.c_str());
+            return false;
+        }
+        file.close();
+    }
+
+    dataFile = SD_MMC.open(path, "r+");
+    indexFile = SD_MMC.open(indexPath(id), create ? FILE_WRITE : "r+");
+    if (!dataFile || !indexFile)
+    {
+        LOG_ERROR(SEGMENT, "打开段文件失败: %s", path.c_str());
+        return false;
+    }
+    // 写入时掉电会在索引末尾留下不完整的记录，从最后一条完整记录之后继续写，覆盖残缺部分，
+    // 否则之后的记录都不再对齐
+    size_t indexEnd = indexFile.size() / sizeof(SegmentIndexEntry) * sizeof(SegmentIndexEntry);
+    if (!indexFile.seek(indexEnd))
+    {
+        LOG_ERROR(SEGMENT, "定位索引文件失败: %s", indexPath(id).c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * ### 切换到新的段文件
+ */
+bool SegmentStore::rollOver()
+{
+    uint32_t id = segments.back().id + 1;
+    dataFile.close();
+    indexFile.close();
+    if (!openSegment(id, true))
+    {
+        return false;
+    }
+    segments.push_back({id, 0, 0, 0, 0, SEGMENT_SIZE, false});
+    writeOffset = 0;
+    LOG_INFO(SEGMENT, "切换到新段 %s", segmentPath(id).c_str());
+    return true;
+}
+
+/**
+ * ### 追加一帧
+ *
+ * 当前段剩余空间不足、时间跨度超限或时间戳回退时先切换新段，保证每段内时间戳有序。
+ * 每帧从扇区对齐的偏移开始写入。先写数据再写索引，掉电时最多丢失最后一批未落盘的帧。
+ *
+ * #### 参数
+ *
+ * - `buf`：JPEG 数据
+ * - `len`：JPEG 长度
+ * - `timestamp`：拍摄时间戳（毫秒）
+ * - `flush`：是否立即落盘；批量写入时只在最后一帧落盘
+ *
+ * #### 返回
+ *
+ * - bool：写入成功返回 true
+ */
+bool SegmentStore::append(const uint8_t *buf, size_t len, uint64_t timestamp, bool flush)
+{
+    if (!mutex || len == 0 || len > SEGMENT_SIZE)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    SegmentInfo *active = &segments.back();
+    writeOffset = (writeOffset + SEGMENT_ALIGN - 1) & ~(uint32_t)(SEGMENT_ALIGN - 1);
+    bool full = writeOffset + len > SEGMENT_SIZE;
+    bool expired = active->count > 0 &&
+                   (timestamp < active->lastTimestamp || timestamp - active->firstTimestamp > SEGMENT_MAX_AGE_MS);
+    if ((full || expired) && !rollOver())
+    {
+        xSemaphoreGive(mutex);
+        return false;
+    }
+    active = &segments.back();
+
+    bool ok = dataFile.seek(writeOffset) && stagedWrite(dataFile, buf, len, stage, SD_STAGE_BUFFER_SIZE) == len;
+    if (ok)
+    {
+        SegmentIndexEntry entry = {timestamp, writeOffset, (uint32_t)len, crc32_le(0, buf, len), 0};
+        ok = indexFile.write((const uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+    }
+    if (ok && flush)
+    {
+        dataFile.flush();
+        indexFile.flush();
+    }
+    if (ok)
+    {
+        if (active->count == 0)
+        {
+            active->firstTimestamp = timestamp;
+        }
+        active->lastTimestamp = timestamp;
+        active->count++;
+        writeOffset += len;
+        active->bytes = writeOffset;
+    }
+    xSemaphoreGive(mutex);
+
+    if (!ok)
+    {
+        LOG_ERROR(SEGMENT, "写入段文件失败: %s", segmentPath(active->id).c_str());
+    }
+    return ok;
+}
+
+/**
+ * ### 落盘
+ *
+ * 先落盘数据再落盘索引，保证索引指向的数据总是完整的。
+ */
+void SegmentStore::flush()
+{
+    if (!mutex)
+    {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    dataFile.flush();
+    indexFile.flush();
+    xSemaphoreGive(mutex);
+}
+
+/**
+ * ### 在段索引中二分查找时间戳
+ */
+bool SegmentStore::findEntry(const SegmentInfo &info, uint64_t timestamp, SegmentIndexEntry &entry)
+{
+    File index = SD_MMC.open(indexPath(info.id), FILE_READ);
+    if (!index)
+    {
+        return false;
+    }
+    int32_t low = 0;
+    int32_t high = (int32_t)info.count - 1;
+    bool found = false;
+    while (low <= high)
+    {
+        int32_t mid = low + (high - low) / 2;
+        index.seek(mid * sizeof(SegmentIndexEntry));
+        if (index.read((uint8_t *)&entry, sizeof(entry)) != sizeof(entry))
+        {
+            break;
+        }
+        if (entry.timestamp == timestamp)
+        {
+            found = true;
+            break;
+        }
+        if (entry.timestamp < timestamp)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    index.close();
+    return found;
+}
+
+/**
+ * ### 按时间戳读取一帧
+ *
+ * #### 参数
+ *
+ * - `timestamp`：拍摄时间戳（毫秒）
+ * - `buf`：输出，新分配的 JPEG 缓冲区，使用完毕后由调用者 `free()`
+ * - `len`：输出，JPEG 长度
+ *
+ * #### 返回
+ *
+ * - bool：找到且 CRC 校验通过返回 true
+ */
+bool SegmentStore::read(uint64_t timestamp, uint8_t *&buf, size_t &len)
+{
+    if (!mutex)
+    {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    // 先落盘当前写入段，确保批量写入中尚未落盘的帧与索引对读取可见
+    dataFile.flush();
+    indexFile.flush();
+    SegmentIndexEntry entry;
+    bool found = false;
+    uint32_t id = 0;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it)
+    {
+        if (it->count > 0 && timestamp >= it->firstTimestamp && timestamp <= it->lastTimestamp &&
+            findEntry(*it, timestamp, entry))
+        {
+            found = true;
+            id = it->id;
+            break;
+        }
+    }
+
+    bool ok = false;
+    if (found)
+    {
+        File file = SD_MMC.open(segmentPath(id), FILE_READ);
+        buf = (uint8_t *)ps_malloc(entry.length);
+        if (!buf)
+        {
+            buf = (uint8_t *)malloc(entry.length);
+        }
+        ok = file && buf && file.seek(entry.offset) && file.read(buf, entry.length) == entry.length &&
+             crc32_le(0, buf, entry.length) == entry.crc;
+        file.close();
+        if (!ok)
+        {
+            LOG_ERROR(SEGMENT, "读取段内帧失败或 CRC 校验错误: %s", segmentPath(id).c_str());
+            free(buf);
+            buf = nullptr;
+        }
+        else
+        {
+            len = entry.length;
+        }
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+/**
+ * ### 获取段文件摘要
+ */
+std::vector<SegmentInfo> SegmentStore::getSegments()
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    std::vector<SegmentInfo> copy = segments;
+    xSemaphoreGive(mutex);
+    return copy;
+}
+
+/**
+ * ### 删除一个已封存的段
+ *
+ * 当前写入段不能删除。
+ *
+ * #### 返回
+ *
+ * - bool：删除成功返回 true
+ */
+bool SegmentStore::removeSegment(uint32_t id)
+{
+    if (!mutex)
+    {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = false;
+    if (segments.size() > 1 && segments.back().id != id)
+    {
+        for (auto it = segments.begin(); it != segments.end(); ++it)
+        {
+            if (it->id == id)
+            {
+                SD_MMC.remove(indexPath(id));
+                SD_MMC.remove(segmentPath(id));
+                segments.erase(it);
+                ok = true;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+/**
+ * ### 抽稀一个已封存的段
+ *
+ * 把段内每 `keepEvery` 帧中的第一帧复制到临时文件，完成后替换原段，新段不再预分配空间。
+ * 复制过程不持有锁，已封存的段不会再被写入，写卡任务不受影响；只有替换文件时短暂加锁。
+ *
+ * 替换分三步：原文件改名为 .old，临时文件改名到位，删除 .old。任一步掉电，
+ * begin() 都会通过 recoverThinning() 完成或回滚替换，段不会丢失。
+ *
+ * #### 返回
+ *
+ * - bool：抽稀成功返回 true
+ */
+bool SegmentStore::thinSegment(uint32_t id, uint32_t keepEvery)
+{
+    if (!mutex || keepEvery < 2)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool sealed = segments.back().id != id;
+    xSemaphoreGive(mutex);
+    if (!sealed)
+    {
+        return false;
+    }
+
+    String tmpData = segmentPath(id) + SEGMENT_TMP_SUFFIX;
+    String tmpIndex = indexPath(id) + SEGMENT_TMP_SUFFIX;
+    File srcData = SD_MMC.open(segmentPath(id), FILE_READ);
+    File srcIndex = SD_MMC.open(indexPath(id), FILE_READ);
+    File dstData = SD_MMC.open(tmpData, FILE_WRITE);
+    File dstIndex = SD_MMC.open(tmpIndex, FILE_WRITE);
+    uint8_t *buf = nullptr;
+    size_t bufSize = 0;
+    bool ok = srcData && srcIndex && dstData && dstIndex;
+
+    SegmentIndexEntry entry;
+    uint32_t n = 0;
+    uint32_t offset = 0;
+    while (ok && srcIndex.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry))
+    {
+        if (n++ % keepEvery != 0)
+        {
+            continue;
+        }
+        if (entry.length > bufSize)
+        {
+            free(buf);
+            bufSize = entry.length;
+            buf = (uint8_t *)ps_malloc(bufSize);
+            if (!buf)
+            {
+                ok = false;
+                break;
+            }
+        }
+        ok = srcData.seek(entry.offset) && srcData.read(buf, entry.length) == entry.length &&
+             dstData.write(buf, entry.length) == entry.length;
+        entry.offset = offset;
+        entry.flags |= SEGMENT_FLAG_THINNED;
+        ok = ok && dstIndex.write((const uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+        offset += entry.length;
+    }
+    free(buf);
+    srcData.close();
+    srcIndex.close();
+    dstData.close();
+    dstIndex.close();
+
+    if (!ok)
+    {
+        SD_MMC.remove(tmpData);
+        SD_MMC.remove(tmpIndex);
+        LOG_ERROR(SEGMENT, "抽稀段失败: %s", segmentPath(id).c_str());
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    ok = SD_MMC.rename(segmentPath(id), segmentPath(id) + SEGMENT_OLD_SUFFIX) &&
+         SD_MMC.rename(indexPath(id), indexPath(id) + SEGMENT_OLD_SUFFIX) &&
+         SD_MMC.rename(tmpData, segmentPath(id)) && SD_MMC.rename(tmpIndex, indexPath(id));
+    if (ok)
+    {
+        SD_MMC.remove(segmentPath(id) + SEGMENT_OLD_SUFFIX);
+        SD_MMC.remove(indexPath(id) + SEGMENT_OLD_SUFFIX);
+    }
+    else
+    {
+        // 按掉电后的同一规则完成或回滚
+        LOG_ERROR(SEGMENT, "替换抽稀后的段失败: %s", segmentPath(id).c_str());
+        recoverThinning(id);
+    }
+    for (auto &info : segments)
+    {
+        if (info.id == id)
+        {
+            loadSegmentInfo(id, info);
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+/**
+ * ### 完成或回滚一次未完成的抽稀
+ *
+ * 原文件只在两个临时文件都写完之后才改名为 .old，因此：
+ * - 没有 .old 文件：复制过程中断，删除临时文件，原段不变
+ * - 有 .old 文件：临时文件已完整，把尚未改名的临时文件换到位，再删除 .old
+ *
+ * #### 返回
+ *
+ * - bool：处理后段文件与索引文件都存在返回 true
+ */
+bool SegmentStore::recoverThinning(uint32_t id)
+{
+    String paths[2] = {segmentPath(id), indexPath(id)};
+    bool swapping = SD_MMC.exists(paths[0] + SEGMENT_OLD_SUFFIX) || SD_MMC.exists(paths[1] + SEGMENT_OLD_SUFFIX);
+    for (const String &path : paths)
+    {
+        String tmp = path + SEGMENT_TMP_SUFFIX;
+        if (!swapping)
+        {
+            SD_MMC.remove(tmp);
+            continue;
+        }
+        if (SD_MMC.exists(tmp))
+        {
+            // 原文件可能还没改名为 .old；它已被 .tmp 取代，直接删除
+            SD_MMC.remove(path);
+            SD_MMC.rename(tmp, path);
+        }
+        SD_MMC.remove(path + SEGMENT_OLD_SUFFIX);
+    }
+    LOG_WARNING(SEGMENT, swapping ? "完成了未完成的抽稀: %s" : "回滚了未完成的抽稀: %s", paths[0].c_str());
+    return SD_MMC.exists(paths[0]) && SD_MMC.exists(paths[1]);
+}
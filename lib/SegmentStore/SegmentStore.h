@@ -0,0 +1,135 @@
+/**
+ * @file SegmentStore.h
+ * @author 稀饭
+ * @brief 定义了 SegmentStore 类，把图像帧追加写入预分配的大段文件，并维护紧凑的索引。
+ */
+
+#ifndef SEGMENT_STORE_H
+#define SEGMENT_STORE_H
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "Logger.h"
+
+extern Logger logger;
+
+#define SEGMENT_DIR "/segments"                    ///< 段文件所在目录
+#define SEGMENT_SIZE (16UL * 1024 * 1024)          ///< 段文件预分配大小，写满后切换新段
+#define SEGMENT_MAX_AGE_MS (60UL * 60 * 1000)      ///< 段文件覆盖的最长时间跨度，超过后切换新段
+#define SEGMENT_ALIGN 512                          ///< 帧在段文件中的起始偏移按扇区对齐
+#define SEGMENT_FLAG_THINNED 0x1                   ///< 索引记录 flags：所在段已被抽稀
+#define SEGMENT_TMP_SUFFIX ".tmp"                  ///< 抽稀时正在写入的新文件
+#define SEGMENT_OLD_SUFFIX ".old"                  ///< 抽稀替换过程中被换下的原文件
+#define SD_STAGE_BUFFER_SIZE (16 * 1024)           ///< 内部 DMA 内存中的写入中转缓冲区大小
+
+/**
+ * ### 经中转缓冲区写入文件
+ *
+ * SDMMC 驱动无法直接对 PSRAM 做 DMA，会按扇区逐块中转；先把数据按大块复制到内部 DMA 内存，
+ * 每次写入整块，减少驱动层的小块传输。`stage` 为空时直接写入。
+ *
+ * #### 返回
+ *
+ * - size_t：实际写入的字节数
+ */
+inline size_t stagedWrite(File &file, const uint8_t *buf, size_t len, uint8_t *stage, size_t stageSize)
+{
+    if (!stage)
+    {
+        return file.write(buf, len);
+    }
+    size_t written = 0;
+    while (written < len)
+    {
+        size_t chunk = len - written < stageSize ? len - written : stageSize;
+        memcpy(stage, buf + written, chunk);
+        size_t n = file.write(stage, chunk);
+        written += n;
+        if (n != chunk)
+        {
+            break;
+        }
+    }
+    return written;
+}
+
+/**
+ * ### 索引记录
+ *
+ * 每帧一条，按写入顺序追加到与段文件同名的 `.idx` 文件中。
+ */
+struct SegmentIndexEntry
+{
+    uint64_t timestamp; ///< 拍摄时间戳（毫秒）
+    uint32_t offset;    ///< 帧在段文件中的偏移
+    uint32_t length;    ///< 帧长度
+    uint32_t crc;       ///< 帧数据的 CRC32
+    uint32_t flags;     ///< SEGMENT_FLAG_*，同时保持记录 8 字节对齐
+};
+
+/**
+ * ### 段文件摘要
+ *
+ * 启动时从索引文件恢复，按段编号递增保存在内存中，用于按时间定位段文件。
+ */
+struct SegmentInfo
+{
+    uint32_t id;             ///< 段编号
+    uint64_t firstTimestamp; ///< 段内第一帧的时间戳
+    uint64_t lastTimestamp;  ///< 段内最后一帧的时间戳
+    uint32_t count;          ///< 段内帧数
+    uint32_t bytes;          ///< 段内有效数据的末尾偏移
+    uint32_t fileSize;       ///< 段文件在卡上占用的字节数
+    bool thinned;            ///< 是否已被抽稀
+};
+
+/**
+ * ### 段式图像存储
+ *
+ * 帧被追加写入预分配的段文件，同时在索引文件中记录偏移、长度、时间戳与 CRC。
+ * 段文件按大小或时间跨度滚动，目录中的文件数量与帧数无关，避免 FAT 大目录下创建文件变慢，
+ * 同一秒内的多帧也不会互相覆盖。同一段内时间戳单调递增，按时间读取时在索引上二分查找。
+ *
+ * #### 方法
+ *
+ * - `begin()`：完成或回滚上次掉电时未完成的抽稀，扫描已有段文件并恢复写入位置
+ * - `append(buf, len, timestamp, flush)`：追加一帧，批量写入时可延迟到最后一帧再落盘
+ * - `flush()`：把已追加的数据与索引落盘
+ * - `read(timestamp, buf, len)`：按时间戳读取一帧
+ * - `getSegments()`：获取段文件摘要
+ * - `removeSegment(id)`：删除一个已封存的段
+ * - `thinSegment(id, keepEvery)`：把已封存的段重写为只保留每 N 帧中的一帧
+ */
+class SegmentStore
+{
+public:
+    bool begin();
+    bool append(const uint8_t *buf, size_t len, uint64_t timestamp, bool flush = true);
+    void flush();
+    bool read(uint64_t timestamp, uint8_t *&buf, size_t &len);
+    std::vector<SegmentInfo> getSegments();
+    bool removeSegment(uint32_t id);
+    bool thinSegment(uint32_t id, uint32_t keepEvery);
+
+    static String segmentPath(uint32_t id);
+    static String indexPath(uint32_t id);
+
+private:
+    SemaphoreHandle_t mutex = nullptr;
+    std::vector<SegmentInfo> segments; ///< 按编号递增，最后一个为当前写入段
+    File dataFile;                     ///< 当前写入段的数据文件
+    File indexFile;                    ///< 当前写入段的索引文件
+    uint32_t writeOffset = 0;          ///< 当前写入段的下一个写入位置
+    uint8_t *stage = nullptr;          ///< 写入中转缓冲区
+
+    bool openSegment(uint32_t id, bool create);
+    bool rollOver();
+    bool loadSegmentInfo(uint32_t id, SegmentInfo &info);
+    bool recoverThinning(uint32_t id);
+    bool findEntry(const SegmentInfo &info, uint64_t timestamp, SegmentIndexEntry &entry);
+};
+
+#endif // SEGMENT_STORE_H
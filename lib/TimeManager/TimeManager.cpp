@@ -5,46 +5,230 @@
  * @brief 时间管理器类的源文件
  */
 #include "TimeManager.h"
+#include "esp_timer.h"
+
+static const char *const WEEKDAY_NAMES[] = {"星期日", "星期一", "星期二", "星期三", "星期四", "星期五", "星期六"};
+
+#define TIME_SYNCED_BIT BIT0
+
+static TimeManager *syncTarget = nullptr; ///< SNTP 回调没有用户参数，通过它找到实例
 
 /**
- * ### 更新时间信息
+ * ### 启动后台时间同步
  *
- * 更新类中保存的当前时间信息。
+ * 只配置时区与时间来源，不等待结果。
  */
-void TimeManager::updateTime()
+void TimeManager::begin(TimeSource primary)
 {
+    if (syncEvents == nullptr)
+    {
+        syncEvents = xEventGroupCreate();
+    }
+    syncTarget = this;
+    primarySource = primary;
+    setenv("TZ", TIME_TIMEZONE, 1);
+    tzset();
+    if (primary == TIME_SOURCE_SNTP)
+    {
+        startSntp();
+    }
+    else
+    {
+        fallbackTicker.once_ms(TIME_SNTP_FALLBACK_MS, TimeManager::fallbackCallback);
+        LOG_INFO(TIME, "等待通过 MQTT 校时");
+    }
+}
 
-    configTime(3600 * 8, 0, "ntp1.ntsc.ac.cn", "time1.aliyun.com", "ntp.tencent.com");
-
-    // 开始NTP时间同步
+/**
+ * ### 启动 SNTP
+ *
+ * SNTP 按 TIME_RESYNC_INTERVAL_MS 自动重新同步。
+ */
+void TimeManager::startSntp()
+{
+    if (sntpStarted)
+    {
+        return;
+    }
+    sntpStarted = true;
+    sntp_set_time_sync_notification_cb(TimeManager::syncNotification);
     sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
-    sntp_init();
+    sntp_set_sync_interval(TIME_RESYNC_INTERVAL_MS);
+    configTzTime(TIME_TIMEZONE, "ntp1.ntsc.ac.cn", "time1.aliyun.com", "ntp.tencent.com");
+    LOG_INFO(TIME, "开始 SNTP 后台时间同步");
+}
+
+void TimeManager::fallbackCallback()
+{
+    if (syncTarget != nullptr && !syncTarget->isSynced())
+    {
+        LOG_WARNING(TIME, "MQTT 校时超时，改用 SNTP");
+        syncTarget->startSntp();
+    }
+}
 
-    int checkCount = 0;
-    sntp_sync_status_t syncStatus = sntp_get_sync_status();
+TimeSource TimeManager::getPrimarySource()
+{
+    return primarySource;
+}
 
-    // 尝试最多100次等待时间同步，每次等待0.1秒，总等待时间10秒
-    while (syncStatus != SNTP_SYNC_STATUS_COMPLETED && checkCount < 100)
+/**
+ * ### 是否需要通过 MQTT 校时
+ */
+bool TimeManager::needsNetworkTime()
+{
+    if (!isSynced())
+    {
+        return true;
+    }
+    int32_t age = getSyncAge();
+    if (age < 0)
     {
-        logger.info("等待时间同步...", "Time");
-        checkCount++; // 增加尝试次数
-        delay(1000);   // 等待1秒
-        syncStatus = sntp_get_sync_status();
+        // 时间有效但不是本次启动同步的（例如 RTC 在软件复位后保留），校准一次
+        return true;
     }
+    uint32_t interval = TIME_RESYNC_INTERVAL_MS / 1000;
+    return (uint32_t)age >= (primarySource == TIME_SOURCE_MQTT ? interval : 2 * interval);
+}
 
-    // 检查是否成功同步时间
-    if (syncStatus == SNTP_SYNC_STATUS_COMPLETED)
+/**
+ * ### 应用一次 MQTT 校时结果
+ *
+ * 往返时间为负或过长的结果不可信，直接丢弃。
+ */
+bool TimeManager::applyNetworkTime(int64_t serverRecvMs, int64_t serverSendMs, int64_t deviceSendMs, int64_t deviceRecvMs)
+{
+    int64_t rttMs = (deviceRecvMs - deviceSendMs) - (serverSendMs - serverRecvMs);
+    if (serverRecvMs / 1000 < TIME_VALID_AFTER || rttMs < 0 || rttMs > TIME_MQTT_MAX_RTT_MS)
     {
-        sntp_stop();
-        String date = getFormattedDate();
-        String time = getFormattedTime();
-        logger.info("更新时间成功，当前时间：" + date + " " + time, "Time");
+        LOG_WARNING(TIME, "MQTT 校时结果无效，往返 %ld ms", (long)rttMs);
+        return false;
     }
-    else
+
+    // 收到应答后又经过的时间（消息解析等）一并补上
+    int64_t nowUs = esp_timer_get_time();
+    int64_t nowMs = (serverRecvMs + serverSendMs + deviceRecvMs - deviceSendMs) / 2 + (nowUs / 1000 - deviceRecvMs);
+    struct timeval tv;
+    tv.tv_sec = nowMs / 1000;
+    tv.tv_usec = (nowMs % 1000) * 1000;
+    settimeofday(&tv, NULL);
+
+    portENTER_CRITICAL(&cacheLock);
+    syncStats.rttMs = (uint32_t)rttMs;
+    portEXIT_CRITICAL(&cacheLock);
+    recordSync(nowMs, nowUs, TIME_SOURCE_MQTT);
+    return true;
+}
+
+void TimeManager::syncNotification(struct timeval *tv)
+{
+    if (syncTarget != nullptr && tv != nullptr)
+    {
+        syncTarget->recordSync((int64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000, esp_timer_get_time());
+    }
+}
+
+/**
+ * ### 记录一次同步结果
+ *
+ * 用上次同步的 NTP 时间加上单调时钟经过的时间推算本次的预期时间，
+ * 与本次 NTP 时间之差即为本地时钟在这段时间内累积的偏差。
+ * SNTP 任务与 MQTT 任务都会调用，统计在锁内更新，日志与回调使用锁内复制的结果。
+ */
+void TimeManager::recordSync(int64_t ntpMs, int64_t monotonicUs, TimeSource source)
+{
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&cacheLock);
+    if (lastSyncMonotonicUs != 0)
+    {
+        int64_t elapsedMs = (monotonicUs - lastSyncMonotonicUs) / 1000;
+        int64_t offsetMs = ntpMs - (lastSyncNtpMs + elapsedMs);
+        syncStats.lastOffsetMs = (int32_t)offsetMs;
+        if (elapsedMs > 0)
+        {
+            syncStats.driftPpm = (float)offsetMs * 1000000.0f / (float)elapsedMs;
+        }
+    }
+    lastSyncNtpMs = ntpMs;
+    lastSyncMonotonicUs = monotonicUs;
+    syncStats.syncs++;
+    syncStats.source = source;
+    syncStats.lastSyncMs = nowMs != 0 ? nowMs : 1;
+    // 系统时间已被修改，下一次 getter 重新计算缓存
+    cacheValid = false;
+    TimeSyncStats stats = syncStats;
+    portEXIT_CRITICAL(&cacheLock);
+
+    if (syncEvents != nullptr)
+    {
+        xEventGroupSetBits(syncEvents, TIME_SYNCED_BIT);
+    }
+    LOG_INFO(TIME, "时间同步成功（%s），偏差 %ld ms，漂移 %.1f ppm", source == TIME_SOURCE_MQTT ? "MQTT" : "SNTP",
+             (long)stats.lastOffsetMs, stats.driftPpm);
+
+    for (uint8_t i = 0; i < callbackCount; i++)
+    {
+        callbacks[i](stats);
+    }
+}
+
+/**
+ * ### 等待时间有效
+ */
+bool TimeManager::waitForSync(uint32_t timeoutMs)
+{
+    if (isSynced())
+    {
+        return true;
+    }
+    if (syncEvents == nullptr)
+    {
+        return false;
+    }
+    xEventGroupWaitBits(syncEvents, TIME_SYNCED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    invalidate();
+    return isSynced();
+}
+
+/**
+ * ### 注册同步回调
+ *
+ * 应在 begin() 之前或启动阶段注册，注册后不可移除。
+ */
+bool TimeManager::onSync(TimeSyncCallback callback)
+{
+    if (callback == nullptr || callbackCount >= TIME_SYNC_CALLBACKS)
+    {
+        return false;
+    }
+    callbacks[callbackCount++] = callback;
+    return true;
+}
+
+/**
+ * ### 距上次同步的秒数
+ */
+int32_t TimeManager::getSyncAge()
+{
+    portENTER_CRITICAL(&cacheLock);
+    uint32_t lastSyncMs = syncStats.lastSyncMs;
+    portEXIT_CRITICAL(&cacheLock);
+    if (lastSyncMs == 0)
     {
-        // 未能在10次尝试后同步时间
-        logger.error("更新时间失败，超过最大尝试次数。", "Time");
+        return -1;
     }
+    return (millis() - lastSyncMs) / 1000;
+}
+
+/**
+ * ### 获取时间同步统计
+ */
+TimeSyncStats TimeManager::getSyncStats()
+{
+    portENTER_CRITICAL(&cacheLock);
+    TimeSyncStats stats = syncStats;
+    portEXIT_CRITICAL(&cacheLock);
+    return stats;
 }
 
 /**
@@ -65,6 +249,87 @@ uint_fast64_t TimeManager::getTimestamp()
     return timestamp;
 }
 
+/**
+ * ### 刷新时间缓存
+ *
+ * 同一秒内返回缓存的副本；跨过整秒后重新分解时间并格式化。
+ * 格式化在临界区外完成，临界区内只判断与复制，返回值不会被其他任务的刷新改写。
+ */
+TimeCache TimeManager::refresh()
+{
+    uint32_t nowMs = millis();
+    TimeCache result;
+    portENTER_CRITICAL(&cacheLock);
+    bool fresh = cacheValid && (int32_t)(nowMs - nextRefreshMs) < 0;
+    if (fresh)
+    {
+        result = cache;
+    }
+    portEXIT_CRITICAL(&cacheLock);
+    if (fresh)
+    {
+        return result;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    result = {};
+    result.synced = tv.tv_sec >= TIME_VALID_AFTER;
+    result.weekday = "";
+    if (result.synced)
+    {
+        time_t seconds = tv.tv_sec;
+        localtime_r(&seconds, &result.timeinfo);
+        strftime(result.date, sizeof(result.date), "%Y-%m-%d", &result.timeinfo);
+        strftime(result.time, sizeof(result.time), "%H:%M", &result.timeinfo);
+        strftime(result.dateAndTime, sizeof(result.dateAndTime), "%Y%m%d%H%M%S", &result.timeinfo);
+        result.weekday = WEEKDAY_NAMES[result.timeinfo.tm_wday % 7];
+    }
+
+    portENTER_CRITICAL(&cacheLock);
+    cache = result;
+    nextRefreshMs = nowMs + (1000 - tv.tv_usec / 1000);
+    cacheValid = true;
+    cacheRefreshes++;
+    portEXIT_CRITICAL(&cacheLock);
+    return result;
+}
+
+uint32_t TimeManager::getCacheRefreshes()
+{
+    portENTER_CRITICAL(&cacheLock);
+    uint32_t refreshes = cacheRefreshes;
+    portEXIT_CRITICAL(&cacheLock);
+    return refreshes;
+}
+
+/**
+ * ### 使时间缓存失效
+ */
+void TimeManager::invalidate()
+{
+    portENTER_CRITICAL(&cacheLock);
+    cacheValid = false;
+    portEXIT_CRITICAL(&cacheLock);
+}
+
+/**
+ * ### 时间是否已同步
+ */
+bool TimeManager::isSynced()
+{
+    return refresh().synced;
+}
+
+/**
+ * ### 获取时间缓存的副本
+ */
+bool TimeManager::getCache(TimeCache &out)
+{
+    out = refresh();
+    return out.synced;
+}
+
 /**
  * ### 获取当前年份
  *
@@ -72,17 +337,12 @@ uint_fast64_t TimeManager::getTimestamp()
  *
  * #### 返回
  *
- * - int：当前年份，如果获取失败返回 -1
+ * - int：当前年份，如果时间尚未同步返回 -1
  */
 int TimeManager::getYear()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    year = timeinfo.tm_year + 1900;
-    return year;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_year + 1900 : -1;
 }
 
 /**
@@ -92,17 +352,12 @@ int TimeManager::getYear()
  *
  * #### 返回
  *
- * - int：当前月份，如果获取失败返回 -1
+ * - int：当前月份，如果时间尚未同步返回 -1
  */
 int TimeManager::getMonth()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    month = timeinfo.tm_mon + 1;
-    return month;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_mon + 1 : -1;
 }
 
 /**
@@ -112,17 +367,12 @@ int TimeManager::getMonth()
  *
  * #### 返回
  *
- * - int：当前星期几的数值表示，如果获取失败返回 -1
+ * - int：当前星期几的数值表示，如果时间尚未同步返回 -1
  */
 int TimeManager::getWeekDay()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    weekday = timeinfo.tm_wday;
-    return weekday;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_wday : -1;
 }
 
 /**
@@ -132,17 +382,12 @@ int TimeManager::getWeekDay()
  *
  * #### 返回
  *
- * - int：当前日期，如果获取失败返回 -1
+ * - int：当前日期，如果时间尚未同步返回 -1
  */
 int TimeManager::getDay()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    day = timeinfo.tm_mday;
-    return day;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_mday : -1;
 }
 
 /**
@@ -152,17 +397,12 @@ int TimeManager::getDay()
  *
  * #### 返回
  *
- * - int：当前小时，如果获取失败返回 -1
+ * - int：当前小时，如果时间尚未同步返回 -1
  */
 int TimeManager::getHour()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    hour = timeinfo.tm_hour;
-    return hour;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_hour : -1;
 }
 
 /**
@@ -172,17 +412,12 @@ int TimeManager::getHour()
  *
  * #### 返回
  *
- * - int：当前分钟，如果获取失败返回 -1
+ * - int：当前分钟，如果时间尚未同步返回 -1
  */
 int TimeManager::getMinute()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    minute = timeinfo.tm_min;
-    return minute;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_min : -1;
 }
 
 /**
@@ -192,17 +427,12 @@ int TimeManager::getMinute()
  *
  * #### 返回
  *
- * - int：当前秒数，如果获取失败返回 -1
+ * - int：当前秒数，如果时间尚未同步返回 -1
  */
 int TimeManager::getSecond()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return -1;
-    }
-    second = timeinfo.tm_sec;
-    return second;
+    TimeCache now = refresh();
+    return now.synced ? now.timeinfo.tm_sec : -1;
 }
 
 /**
@@ -210,21 +440,20 @@ int TimeManager::getSecond()
  *
  * 获取当前时间的格式化日期字符串，格式为 "YYYY-MM-DD"。
  *
+ * #### 参数
+ *
+ * - `out`：输出缓冲区，至少 TIME_DATE_SIZE 字节
+ * - `size`：缓冲区大小
+ *
  * #### 返回
  *
- * - String：格式化的日期字符串，如果获取失败返回空字符串
+ * - bool：时间已同步返回 true；未同步时写入空字符串
  */
-String TimeManager::getFormattedDate()
+bool TimeManager::getFormattedDate(char *out, size_t size)
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return "";
-    }
-    char buffer[16];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d", &timeinfo);
-    formattedDate = String(buffer);
-    return formattedDate;
+    TimeCache now = refresh();
+    snprintf(out, size, "%s", now.date);
+    return now.synced;
 }
 
 /**
@@ -232,21 +461,20 @@ String TimeManager::getFormattedDate()
  *
  * 获取当前时间的格式化时间字符串，格式为 "HH:MM"。
  *
+ * #### 参数
+ *
+ * - `out`：输出缓冲区，至少 TIME_TIME_SIZE 字节
+ * - `size`：缓冲区大小
+ *
  * #### 返回
  *
- * - String：格式化的时间字符串，如果获取失败返回空字符串
+ * - bool：时间已同步返回 true；未同步时写入空字符串
  */
-String TimeManager::getFormattedTime()
+bool TimeManager::getFormattedTime(char *out, size_t size)
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return "";
-    }
-    char buffer[16];
-    strftime(buffer, sizeof(buffer), "%H:%M", &timeinfo);
-    formattedTime = String(buffer);
-    return formattedTime;
+    TimeCache now = refresh();
+    snprintf(out, size, "%s", now.time);
+    return now.synced;
 }
 
 /**
@@ -254,67 +482,33 @@ String TimeManager::getFormattedTime()
  *
  * 获取当前时间的格式化日期和时间字符串，格式为 "YYYYMMDDHHMMSS"。
  *
+ * #### 参数
+ *
+ * - `out`：输出缓冲区，至少 TIME_DATE_AND_TIME_SIZE 字节
+ * - `size`：缓冲区大小
+ *
  * #### 返回
  *
- * - String：格式化的日期和时间字符串，如果获取失败返回空字符串
+ * - bool：时间已同步返回 true；未同步时写入空字符串
  */
-String TimeManager::getFormattedDateAndTime()
+bool TimeManager::getFormattedDateAndTime(char *out, size_t size)
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return "";
-    }
-    char buffer[32];
-    strftime(buffer, sizeof(buffer), "%Y%m%d%H%M%S", &timeinfo);
-    formattedDateAndTime = String(buffer);
-    return formattedDateAndTime;
+    TimeCache now = refresh();
+    snprintf(out, size, "%s", now.dateAndTime);
+    return now.synced;
 }
 
 /**
  * ### 获取格式化的星期几字符串
  *
  * 获取当前时间的格式化星期几字符串，如 "星期一"。
+ * 返回的是常量字符串，可以长期保存。
  *
  * #### 返回
  *
- * - String：格式化的星期几字符串，如果获取失败返回空字符串
+ * - const char*：格式化的星期几字符串，如果时间尚未同步返回空字符串
  */
-String TimeManager::getFormattedWeekday()
+const char *TimeManager::getFormattedWeekday()
 {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-        return "";
-    }
-    int weekday = timeinfo.tm_wday;
-    String formattedWeekday;
-    switch (weekday)
-    {
-    case 0:
-        formattedWeekday = "星期日";
-        break;
-    case 1:
-        formattedWeekday = "星期一";
-        break;
-    case 2:
-        formattedWeekday = "星期二";
-        break;
-    case 3:
-        formattedWeekday = "星期三";
-        break;
-    case 4:
-        formattedWeekday = "星期四";
-        break;
-    case 5:
-        formattedWeekday = "星期五";
-        break;
-    case 6:
-        formattedWeekday = "星期六";
-        break;
-    default:
-        formattedWeekday = "未知";
-        break;
-    }
-    return formattedWeekday;
+    return refresh().weekday;
 }
@@ -11,32 +11,82 @@
 #include <time.h>
 #include "Logger.h"
 #include "esp_sntp.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <Ticker.h>
 
 extern Logger logger; ///< 外部定义的日志记录器对象
 
+#define TIME_VALID_AFTER 1451606400 // 2016-01-01，早于此时间视为尚未同步
+#define TIME_RESYNC_INTERVAL_MS (3600UL * 1000) // SNTP 后台重新同步的间隔
+#define TIME_SYNC_CALLBACKS 4       // 最多可注册的同步回调数
+#define TIME_TIMEZONE "CST-8"
+#define TIME_SNTP_FALLBACK_MS 30000 // 以 MQTT 为首选时，超过该时间仍未同步则启动 SNTP
+#define TIME_MQTT_MAX_RTT_MS 5000   // MQTT 校时往返时间超过该值时丢弃结果
+#define TIME_DATE_SIZE 11           // "YYYY-MM-DD" 含结尾 0
+#define TIME_TIME_SIZE 6            // "HH:MM" 含结尾 0
+#define TIME_DATE_AND_TIME_SIZE 15  // "YYYYMMDDHHMMSS" 含结尾 0
+
+/**
+ * ### 时间来源
+ */
+enum TimeSource : uint8_t {
+    TIME_SOURCE_SNTP, ///< UDP 123 访问公共 NTP 服务器
+    TIME_SOURCE_MQTT  ///< 通过已建立的 MQTT 连接向物联网平台请求 NTP 时间
+};
+
+/**
+ * ### 时间同步统计
+ */
+struct TimeSyncStats
+{
+    uint32_t syncs;         ///< 同步成功次数
+    uint32_t lastSyncMs;    ///< 最近一次同步时的 millis()，未同步过为 0
+    int32_t lastOffsetMs;   ///< 最近一次同步时 NTP 时间与本地时钟推算值之差
+    float driftPpm;         ///< 由相邻两次同步测得的本地时钟漂移（百万分之一），正值表示本地时钟偏慢
+    TimeSource source;      ///< 最近一次同步的来源
+    uint32_t rttMs;         ///< 最近一次 MQTT 校时的网络往返时间
+};
+
+/**
+ * ### 时间同步回调
+ *
+ * 在 SNTP 所在的 lwIP 任务中调用，只能做简短的工作（置标志、使缓存失效等）。
+ */
+typedef void (*TimeSyncCallback)(const TimeSyncStats &stats);
+
+/**
+ * ### 时间缓存
+ *
+ * 分解后的时间与格式化字符串，每秒最多重新计算一次。
+ */
+struct TimeCache
+{
+    struct tm timeinfo;       ///< 分解后的本地时间
+    char date[TIME_DATE_SIZE];                ///< "YYYY-MM-DD"
+    char time[TIME_TIME_SIZE];                ///< "HH:MM"
+    char dateAndTime[TIME_DATE_AND_TIME_SIZE]; ///< "YYYYMMDDHHMMSS"
+    const char *weekday;      ///< "星期一" 等
+    bool synced;              ///< 时间是否已同步
+};
+
 /**
  * ### 时间管理器类
  *
  * 该类提供了获取和管理当前时间信息的功能。
  *
- * #### 属性
- *
- * - `formattedDate`：格式化的日期字符串
- * - `formattedTime`：格式化的时间字符串
- * - `formattedWeekday`：格式化的星期几字符串
- * - `formattedDateAndTime`：格式化的日期和时间字符串
- * - `timestamp`：时间戳
- * - `year`：年份
- * - `month`：月份
- * - `weekday`：星期几（0-6，0 表示星期日）
- * - `day`：日期（1-31）
- * - `hour`：小时（0-23）
- * - `minute`：分钟（0-59）
- * - `second`：秒数（0-59）
+ * 所有 getter 都不阻塞：结果来自时间缓存，缓存按 millis() 计算的下一个整秒刷新，
+ * 同一秒内的调用只读取缓存。缓存与同步统计由同一个锁保护，getter 在锁内复制结果，
+ * 字符串 getter 复制到调用方的缓冲区，因此可以在任意任务中调用。
+ * 时间尚未同步时数值 getter 返回 -1，字符串 getter 写入空字符串。
  *
  * #### 方法
  *
- * - `updateTime()`：更新时间信息
+ * - `begin()`：启动后台 SNTP 同步
+ * - `waitForSync(timeoutMs)`：等待时间有效
+ * - `onSync(callback)`：注册同步回调
+ * - `getSyncAge()`：距上次同步的秒数
+ * - `isSynced()`：时间是否已同步
  * - `getTimestamp()`：获取当前时间戳
  * - `getYear()`：获取当前年份
  * - `getMonth()`：获取当前月份
@@ -45,33 +95,127 @@ extern Logger logger; ///< 外部定义的日志记录器对象
  * - `getHour()`：获取当前小时
  * - `getMinute()`：获取当前分钟
  * - `getSecond()`：获取当前秒数
- * - `getFormattedDate()`：获取格式化的日期字符串
+ * - `getFormattedDate(out, size)`：获取格式化的日期字符串
  * - `getFormattedWeekday()`：获取格式化的星期几字符串
- * - `getFormattedTime()`：获取格式化的时间字符串
- * - `getFormattedDateAndTime()`：获取格式化的日期和时间字符串
+ * - `getFormattedTime(out, size)`：获取格式化的时间字符串
+ * - `getFormattedDateAndTime(out, size)`：获取格式化的日期和时间字符串
  */
 class TimeManager
 {
 public:
-    String formattedDate;        ///< 格式化的日期字符串
-    String formattedTime;        ///< 格式化的时间字符串
-    String formattedWeekday;     ///< 格式化的星期几字符串
-    String formattedDateAndTime; ///< 格式化的日期和时间字符串
-    int timestamp;               ///< 时间戳
-    int year;                    ///< 年份
-    int month;                   ///< 月份
-    int weekday;                 ///< 星期几（0-6，0 表示星期日）
-    int day;                     ///< 日期（1-31）
-    int hour;                    ///< 小时（0-23）
-    int minute;                  ///< 分钟（0-59）
-    int second;                  ///< 秒数（0-59）
+    /**
+     * ### 启动后台时间同步
+     *
+     * 立即返回。首选 SNTP 时，SNTP 在后台完成首次同步后每隔 TIME_RESYNC_INTERVAL_MS 重新同步，
+     * MQTT 校时只在 SNTP 未能同步时作为后备；首选 MQTT 时，由 IoTManager 在连接后校时，
+     * 超过 TIME_SNTP_FALLBACK_MS 仍未同步才启动 SNTP。WiFi 尚未连接时也可以调用。
+     *
+     * #### 参数
+     *
+     * - `primary`：首选的时间来源
+     */
+    void begin(TimeSource primary = TIME_SOURCE_SNTP);
 
     /**
-     * ### 更新时间信息
+     * ### 获取首选的时间来源
+     */
+    TimeSource getPrimarySource();
+
+    /**
+     * ### 是否需要通过 MQTT 校时
      *
-     * 更新类中保存的当前时间信息。
+     * 时间尚未同步，或首选 MQTT 且已到重新同步的时间，或 SNTP 长时间没有同步成功时返回 true。
      */
-    void updateTime();
+    bool needsNetworkTime();
+
+    /**
+     * ### 应用一次 MQTT 校时结果
+     *
+     * 按 NTP 的方式补偿往返时延：设备收到应答时的时间为
+     * (serverRecvTime + serverSendTime + deviceRecvTime - deviceSendTime) / 2。
+     * 设备侧的两个时间使用单调时钟，不受校时本身影响。
+     *
+     * #### 参数
+     *
+     * - `serverRecvMs`：平台收到请求的时间（毫秒）
+     * - `serverSendMs`：平台发送应答的时间（毫秒）
+     * - `deviceSendMs`：设备发送请求时的单调时钟（毫秒）
+     * - `deviceRecvMs`：设备收到应答时的单调时钟（毫秒）
+     *
+     * #### 返回
+     *
+     * - bool：结果有效并已设置系统时间返回 true
+     */
+    bool applyNetworkTime(int64_t serverRecvMs, int64_t serverSendMs, int64_t deviceSendMs, int64_t deviceRecvMs);
+
+    /**
+     * ### 等待时间有效
+     *
+     * 阻塞当前任务直到首次同步完成或超时，等待期间不占用 CPU。
+     *
+     * #### 参数
+     *
+     * - `timeoutMs`：最长等待时间（毫秒）
+     *
+     * #### 返回
+     *
+     * - bool：时间有效返回 true
+     */
+    bool waitForSync(uint32_t timeoutMs);
+
+    /**
+     * ### 注册同步回调
+     *
+     * 每次同步成功后调用。
+     *
+     * #### 返回
+     *
+     * - bool：注册成功返回 true，回调数量已满返回 false
+     */
+    bool onSync(TimeSyncCallback callback);
+
+    /**
+     * ### 记录一次同步结果
+     *
+     * 由 SNTP 回调调用，计算偏差与漂移，使时间缓存失效并通知订阅者。
+     *
+     * #### 参数
+     *
+     * - `ntpMs`：同步得到的 Unix 时间（毫秒）
+     * - `monotonicUs`：同步时刻的单调时钟（微秒）
+     * - `source`：时间来源
+     */
+    void recordSync(int64_t ntpMs, int64_t monotonicUs, TimeSource source = TIME_SOURCE_SNTP);
+
+    /**
+     * ### 距上次同步的秒数
+     *
+     * #### 返回
+     *
+     * - int32_t：秒数，尚未同步过返回 -1
+     */
+    int32_t getSyncAge();
+
+    /**
+     * ### 获取时间同步统计
+     */
+    TimeSyncStats getSyncStats();
+
+    /**
+     * ### 时间是否已同步
+     *
+     * #### 返回
+     *
+     * - bool：系统时间晚于 2016 年返回 true
+     */
+    bool isSynced();
+
+    /**
+     * ### 使时间缓存失效
+     *
+     * 系统时间被修改后调用，下一次 getter 重新计算。
+     */
+    void invalidate();
 
     /**
      * ### 获取当前时间戳
@@ -91,7 +235,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前年份，如果获取失败返回 -1
+     * - int：当前年份，如果时间尚未同步返回 -1
      */
     int getYear();
 
@@ -102,7 +246,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前月份，如果获取失败返回 -1
+     * - int：当前月份，如果时间尚未同步返回 -1
      */
     int getMonth();
 
@@ -113,7 +257,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前星期几的数值表示，如果获取失败返回 -1
+     * - int：当前星期几的数值表示，如果时间尚未同步返回 -1
      */
     int getWeekDay();
 
@@ -124,7 +268,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前日期，如果获取失败返回 -1
+     * - int：当前日期，如果时间尚未同步返回 -1
      */
     int getDay();
 
@@ -135,7 +279,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前小时，如果获取失败返回 -1
+     * - int：当前小时，如果时间尚未同步返回 -1
      */
     int getHour();
 
@@ -146,7 +290,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前分钟，如果获取失败返回 -1
+     * - int：当前分钟，如果时间尚未同步返回 -1
      */
     int getMinute();
 
@@ -157,7 +301,7 @@ public:
      *
      * #### 返回
      *
-     * - int：当前秒数，如果获取失败返回 -1
+     * - int：当前秒数，如果时间尚未同步返回 -1
      */
     int getSecond();
 
@@ -166,11 +310,16 @@ public:
      *
      * 获取当前时间的格式化日期字符串，格式为 "YYYY-MM-DD"。
      *
+     * #### 参数
+     *
+     * - `out`：输出缓冲区，至少 TIME_DATE_SIZE 字节
+     * - `size`：缓冲区大小
+     *
      * #### 返回
      *
-     * - String：格式化的日期字符串，如果获取失败返回空字符串
+     * - bool：时间已同步返回 true；未同步时写入空字符串
      */
-    String getFormattedDate();
+    bool getFormattedDate(char *out, size_t size);
 
     /**
      * ### 获取格式化的星期几字符串
@@ -179,31 +328,83 @@ public:
      *
      * #### 返回
      *
-     * - String：格式化的星期几字符串，如果获取失败返回空字符串
+     * - const char*：格式化的星期几字符串，如果时间尚未同步返回空字符串。返回的是常量字符串，可以长期保存
      */
-    String getFormattedWeekday();
+    const char *getFormattedWeekday();
 
     /**
      * ### 获取格式化的时间字符串
      *
      * 获取当前时间的格式化时间字符串，格式为 "HH:MM"。
      *
+     * #### 参数
+     *
+     * - `out`：输出缓冲区，至少 TIME_TIME_SIZE 字节
+     * - `size`：缓冲区大小
+     *
      * #### 返回
      *
-     * - String：格式化的时间字符串，如果获取失败返回空字符串
+     * - bool：时间已同步返回 true；未同步时写入空字符串
      */
-    String getFormattedTime();
+    bool getFormattedTime(char *out, size_t size);
 
     /**
      * ### 获取格式化的日期和时间字符串
      *
      * 获取当前时间的格式化日期和时间字符串，格式为 "YYYYMMDDHHMMSS"。
      *
+     * #### 参数
+     *
+     * - `out`：输出缓冲区，至少 TIME_DATE_AND_TIME_SIZE 字节
+     * - `size`：缓冲区大小
+     *
      * #### 返回
      *
-     * - String：格式化的日期和时间字符串，如果获取失败返回空字符串
+     * - bool：时间已同步返回 true；未同步时写入空字符串
      */
-    String getFormattedDateAndTime();
+    bool getFormattedDateAndTime(char *out, size_t size);
+
+    /**
+     * ### 获取时间缓存的副本
+     *
+     * 其他任务需要同一时刻的多个字段时使用，保证各字段一致。
+     *
+     * #### 返回
+     *
+     * - bool：时间已同步返回 true
+     */
+    bool getCache(TimeCache &out);
+
+    /**
+     * ### 获取缓存重新计算的次数
+     *
+     * 同一秒内的 getter 只读缓存，计数每秒最多增加一次（校时后另加一次）。
+     */
+    uint32_t getCacheRefreshes();
+
+private:
+    TimeCache cache = {};
+    uint32_t nextRefreshMs = 0; ///< 下一个整秒对应的 millis()
+    bool cacheValid = false;
+    uint32_t cacheRefreshes = 0; ///< 缓存重新计算的次数
+    portMUX_TYPE cacheLock = portMUX_INITIALIZER_UNLOCKED;
+
+    EventGroupHandle_t syncEvents = nullptr;
+    TimeSyncCallback callbacks[TIME_SYNC_CALLBACKS] = {};
+    uint8_t callbackCount = 0;
+    TimeSyncStats syncStats = {};
+    int64_t lastSyncNtpMs = 0;     ///< 上次同步得到的 Unix 时间（毫秒）
+    int64_t lastSyncMonotonicUs = 0;
+
+    TimeSource primarySource = TIME_SOURCE_SNTP;
+    bool sntpStarted = false;
+    Ticker fallbackTicker;
+
+    void startSntp();
+    static void syncNotification(struct timeval *tv);
+    static void fallbackCallback();
+
+    TimeCache refresh();
 };
 
 #endif // TIMEMANAGER_H
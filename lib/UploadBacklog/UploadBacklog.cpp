@@ -0,0 +1,279 @@
+/**
+ * @file UploadBacklog.cpp
+ * @author 稀饭
+ * @brief 实现了 UploadBacklog 类，包括队列文件的读写与限速补传。
+ */
+
+#include "UploadBacklog.h"
+
+/**
+ * ### 从内存卡恢复队列
+ *
+ * #### 返回
+ *
+ * - bool：初始化成功返回 true
+ */
+bool UploadBacklog::init()
+{
+    if (!mutex)
+    {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (!pending)
+    {
+        pending = xQueueCreate(BACKLOG_PENDING_LENGTH, sizeof(BacklogRecord));
+    }
+    sdcardManager.checkDirExists(BACKLOG_DIR);
+
+    File data = SD_MMC.open(BACKLOG_DATA_PATH, FILE_READ);
+    if (data)
+    {
+        tail = data.size() / sizeof(BacklogRecord);
+        data.close();
+    }
+    File headFile = SD_MMC.open(BACKLOG_HEAD_PATH, FILE_READ);
+    if (headFile)
+    {
+        if (headFile.read((uint8_t *)&head, sizeof(head)) != sizeof(head))
+        {
+            head = 0;
+        }
+        headFile.close();
+    }
+    if (head > tail)
+    {
+        head = tail;
+    }
+
+    lastReportMs = millis();
+    LOG_INFO(BACKLOG, "离线上传队列积压 %lu 帧", (unsigned long)(tail - head));
+    return mutex != nullptr && pending != nullptr;
+}
+
+/**
+ * ### 记录一帧待补传
+ *
+ * 只放入内存中的待写队列，不读写内存卡，从不阻塞。
+ *
+ * #### 参数
+ *
+ * - `timestamp`：拍摄时间戳（毫秒）
+ * - `name`：七牛对象名
+ *
+ * #### 返回
+ *
+ * - bool：放入待写队列返回 true，队列已满时返回 false
+ */
+bool UploadBacklog::enqueue(uint_fast64_t timestamp, const String &name)
+{
+    if (!pending)
+    {
+        return false;
+    }
+    BacklogRecord record = {};
+    record.timestamp = timestamp;
+    strlcpy(record.name, name.c_str(), sizeof(record.name));
+
+    if (xQueueSend(pending, &record, 0) != pdTRUE)
+    {
+        LOG_WARNING(BACKLOG, "离线上传待写队列已满，丢弃记录: %s", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * ### 当前积压深度
+ */
+uint32_t UploadBacklog::depth()
+{
+    return tail - head + (pending ? uxQueueMessagesWaiting(pending) : 0);
+}
+
+/**
+ * ### 把待写记录写入内存卡
+ */
+void UploadBacklog::flush()
+{
+    BacklogRecord record;
+    while (xQueueReceive(pending, &record, 0) == pdTRUE)
+    {
+        if (!append(record))
+        {
+            LOG_ERROR(BACKLOG, "写入离线上传队列失败: %s", record.name);
+        }
+    }
+}
+
+/**
+ * ### 在队列文件末尾追加一条记录
+ */
+bool UploadBacklog::append(const BacklogRecord &record)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = false;
+    File data = SD_MMC.open(BACKLOG_DATA_PATH, FILE_APPEND);
+    if (data)
+    {
+        ok = data.write((const uint8_t *)&record, sizeof(record)) == sizeof(record);
+        data.close();
+    }
+    if (ok)
+    {
+        tail++;
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+/**
+ * ### 读取队首记录
+ */
+bool UploadBacklog::peek(BacklogRecord &record)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = false;
+    if (head < tail)
+    {
+        File data = SD_MMC.open(BACKLOG_DATA_PATH, FILE_READ);
+        if (data)
+        {
+            ok = data.seek((size_t)head * sizeof(record)) &&
+                 data.read((uint8_t *)&record, sizeof(record)) == sizeof(record);
+            data.close();
+        }
+    }
+    xSemaphoreGive(mutex);
+    record.name[BACKLOG_NAME_SIZE - 1] = '\0';
+    return ok;
+}
+
+/**
+ * ### 移除队首记录
+ *
+ * 队列清空时删除记录文件，避免文件无限增长。
+ */
+void UploadBacklog::pop()
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (head < tail)
+    {
+        head++;
+    }
+    if (head == tail)
+    {
+        SD_MMC.remove(BACKLOG_DATA_PATH);
+        head = 0;
+        tail = 0;
+    }
+    missingSinceMs = 0;
+    writeHead();
+    xSemaphoreGive(mutex);
+}
+
+void UploadBacklog::writeHead()
+{
+    File headFile = SD_MMC.open(BACKLOG_HEAD_PATH, FILE_WRITE);
+    if (headFile)
+    {
+        headFile.write((const uint8_t *)&head, sizeof(head));
+        headFile.close();
+    }
+}
+
+/**
+ * ### 补传一帧
+ *
+ * 先把待写记录写入内存卡，再在网络已连接且距上次补传超过限速间隔时补传队首的一帧：
+ *
+ * - 上传成功或服务端返回 614（文件已存在）时移除记录
+ * - 连接失败、请求未发出或 5xx 时保留记录，间隔按指数退避，成功后恢复
+ * - 其他 4xx/6xx 重试也不会成功，丢弃记录，避免堵住后面的帧
+ *
+ * 卡上暂时找不到的帧按限速间隔重试，超过 `BACKLOG_MISSING_WAIT_MS` 仍找不到才丢弃记录。需在上传任务中调用，与实时上传共用七牛客户端。
+ */
+void UploadBacklog::drain()
+{
+    if (!mutex || !pending)
+    {
+        return;
+    }
+    flush();
+    report();
+    if (depth() == 0 || WiFi.status() != WL_CONNECTED)
+    {
+        return;
+    }
+    if (millis() - lastDrainMs < drainIntervalMs)
+    {
+        return;
+    }
+    lastDrainMs = millis();
+
+    BacklogRecord record;
+    if (!peek(record))
+    {
+        return;
+    }
+
+    uint8_t *buf = nullptr;
+    size_t len = 0;
+    if (!sdcardManager.loadImage(record.timestamp, buf, len))
+    {
+        // 写卡任务异步落盘，帧可能还在写卡队列中，超过等待时间仍找不到才丢弃
+        if (missingSinceMs == 0)
+        {
+            missingSinceMs = millis() | 1;
+            return;
+        }
+        if (millis() - missingSinceMs < BACKLOG_MISSING_WAIT_MS)
+        {
+            return;
+        }
+        LOG_WARNING(BACKLOG, "内存卡上找不到待补传的帧，丢弃记录: %s", record.name);
+        pop();
+        return;
+    }
+    missingSinceMs = 0;
+
+    int httpCode;
+    String url = qiniuClient.uploadImage(String(record.name), buf, len, httpCode);
+    free(buf);
+    if (httpCode == HTTP_CODE_OK || httpCode == QINIU_CODE_FILE_EXISTS)
+    {
+        drainIntervalMs = BACKLOG_DRAIN_INTERVAL_MS;
+        pop();
+        drainedSinceReport++;
+        if (url != "")
+        {
+            iotManager.sendProperty("img", url);
+        }
+        return;
+    }
+    if (httpCode <= 0 || (httpCode >= 500 && httpCode < 600))
+    {
+        drainIntervalMs = min(drainIntervalMs * 2, (uint32_t)BACKLOG_MAX_BACKOFF_MS);
+        return;
+    }
+    LOG_ERROR(BACKLOG, "补传被服务端拒绝（%d），丢弃记录: %s", httpCode, record.name);
+    drainIntervalMs = BACKLOG_DRAIN_INTERVAL_MS;
+    pop();
+}
+
+/**
+ * ### 上报积压深度与补传速率
+ *
+ * 补传速率单位为帧/分钟。
+ */
+void UploadBacklog::report()
+{
+    uint32_t elapsed = millis() - lastReportMs;
+    if (elapsed < BACKLOG_REPORT_INTERVAL_MS)
+    {
+        return;
+    }
+    iotManager.sendProperty("backlog", (int)depth());
+    iotManager.sendProperty("drainRate", drainedSinceReport * 60000.0f / elapsed);
+    drainedSinceReport = 0;
+    lastReportMs = millis();
+}
@@ -0,0 +1,90 @@
+/**
+ * @file UploadBacklog.h
+ * @author 稀饭
+ * @brief 定义了 UploadBacklog 类，在内存卡上持久化记录未能上传的帧，并在网络恢复后限速补传。
+ */
+
+#ifndef UPLOAD_BACKLOG_H
+#define UPLOAD_BACKLOG_H
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "SdCardManager.h"
+#include "QiniuClient.h"
+#include "IoTManager.h"
+#include "Logger.h"
+
+extern SdCardManager sdcardManager;
+extern QiniuClient qiniuClient;
+extern IoTManager iotManager;
+extern Logger logger;
+
+#define BACKLOG_DIR "/queue"                     ///< 队列文件所在目录
+#define BACKLOG_DATA_PATH "/queue/pending.dat"   ///< 定长记录文件，只追加
+#define BACKLOG_HEAD_PATH "/queue/head.dat"      ///< 队首下标
+#define BACKLOG_NAME_SIZE 40                     ///< 记录中文件名的最大长度（含结尾）
+#define BACKLOG_DRAIN_INTERVAL_MS 2000           ///< 两次补传之间的最小间隔
+#define BACKLOG_MAX_BACKOFF_MS 60000             ///< 补传失败后的最大退避间隔
+#define BACKLOG_REPORT_INTERVAL_MS 60000         ///< 上报积压深度与补传速率的周期
+#define BACKLOG_PENDING_LENGTH 16                ///< 尚未写入内存卡的记录数上限
+#define BACKLOG_MISSING_WAIT_MS 30000            ///< 卡上找不到队首帧时等待写卡任务落盘的最长时间
+#define QINIU_CODE_FILE_EXISTS 614               ///< 七牛：目标文件已存在，说明之前的上传已成功
+
+/**
+ * ### 积压记录
+ *
+ * 定长记录，第 n 条位于文件偏移 n * sizeof(BacklogRecord) 处。
+ */
+struct BacklogRecord
+{
+    uint64_t timestamp;            ///< 拍摄时间戳（毫秒），用于从内存卡读取帧
+    char name[BACKLOG_NAME_SIZE];  ///< 七牛对象名
+};
+
+/**
+ * ### 离线上传队列
+ *
+ * 上传失败或被跳过的帧以定长记录追加到内存卡上的队列文件，队首下标单独保存，
+ * 入队和出队都只读写一条记录与一个下标，与积压深度无关；队列清空时截断文件。
+ * 重启后从文件恢复队列。`enqueue()` 只把记录放入内存中的待写队列，不读写内存卡，
+ * 拍照任务也可以调用；记录由上传任务在 `drain()` 中写入内存卡。
+ *
+ * #### 方法
+ *
+ * - `init()`：从内存卡恢复队列，需在内存卡挂载后调用
+ * - `enqueue(timestamp, name)`：记录一帧待补传，从不阻塞
+ * - `depth()`：当前积压深度（含尚未写入内存卡的记录）
+ * - `drain()`：在上传任务空闲时调用，写入待写记录，网络可用时限速补传一帧，并周期性上报积压情况
+ */
+class UploadBacklog
+{
+public:
+    bool init();
+    bool enqueue(uint_fast64_t timestamp, const String &name);
+    uint32_t depth();
+    void drain();
+
+private:
+    SemaphoreHandle_t mutex = nullptr;
+    QueueHandle_t pending = nullptr;                ///< 待写入内存卡的记录，元素为 BacklogRecord
+    uint32_t head = 0;                              ///< 下一条待补传记录的下标
+    uint32_t tail = 0;                              ///< 记录总数
+    uint32_t lastDrainMs = 0;
+    uint32_t drainIntervalMs = BACKLOG_DRAIN_INTERVAL_MS;
+    uint32_t lastReportMs = 0;
+    uint32_t drainedSinceReport = 0;
+    uint32_t missingSinceMs = 0;                    ///< 首次发现队首帧不在卡上的时间，0 表示未缺失
+
+    void flush();
+    bool append(const BacklogRecord &record);
+    bool peek(BacklogRecord &record);
+    void pop();
+    void writeHead();
+    void report();
+};
+
+#endif // UPLOAD_BACKLOG_H
@@ -0,0 +1,164 @@
+/**
+ * @file ApSelector.cpp
+ * @author 稀饭
+ * @brief 实现了 ApSelector 类的方法。
+ */
+#include "ApSelector.h"
+#include <string.h>
+
+const ApHistory *ApSelector::find(const uint8_t *bssid) const
+{
+    for (const ApHistory &entry : history)
+    {
+        if (entry.used && memcmp(entry.bssid, bssid, sizeof(entry.bssid)) == 0)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * ### 查找接入点的记录，没有时淘汰最久未用的记录
+ */
+ApHistory *ApSelector::findOrInsert(const uint8_t *bssid, uint32_t nowMs)
+{
+    ApHistory *entry = const_cast<ApHistory *>(find(bssid));
+    if (entry == nullptr)
+    {
+        entry = &history[0];
+        for (ApHistory &candidate : history)
+        {
+            if (!candidate.used)
+            {
+                entry = &candidate;
+                break;
+            }
+            if (nowMs - candidate.lastUsedMs > nowMs - entry->lastUsedMs)
+            {
+                entry = &candidate;
+            }
+        }
+        *entry = {};
+        memcpy(entry->bssid, bssid, sizeof(entry->bssid));
+        entry->used = true;
+    }
+    entry->lastUsedMs = nowMs;
+    return entry;
+}
+
+/**
+ * ### 记录一次上传的吞吐量
+ *
+ * 按 1/4 的权重更新滑动平均，单次上传的抖动不会立即触发漫游。
+ */
+void ApSelector::recordThroughput(const uint8_t *bssid, uint32_t bytes, uint32_t elapsedMs, uint32_t nowMs)
+{
+    if (elapsedMs == 0)
+    {
+        return;
+    }
+    uint32_t kbps = (uint32_t)((uint64_t)bytes * 8 / elapsedMs);
+    ApHistory *entry = findOrInsert(bssid, nowMs);
+    entry->kbps = entry->kbps == 0 ? kbps : (entry->kbps * 3 + kbps) / 4;
+    if (entry->kbps == 0)
+    {
+        entry->kbps = 1;
+    }
+}
+
+void ApSelector::recordFailure(const uint8_t *bssid, uint32_t nowMs)
+{
+    findOrInsert(bssid, nowMs)->failedAtMs = nowMs != 0 ? nowMs : 1;
+}
+
+uint32_t ApSelector::throughputKbps(const uint8_t *bssid) const
+{
+    const ApHistory *entry = find(bssid);
+    return entry ? entry->kbps : 0;
+}
+
+int32_t ApSelector::score(const ApCandidate &candidate, uint32_t defaultKbps) const
+{
+    uint32_t kbps = throughputKbps(candidate.bssid);
+    if (kbps == 0)
+    {
+        kbps = defaultKbps;
+    }
+    if (kbps > AP_THROUGHPUT_CAP_KBPS)
+    {
+        kbps = AP_THROUGHPUT_CAP_KBPS;
+    }
+    return candidate.rssi + (int32_t)(kbps / AP_KBPS_PER_POINT);
+}
+
+bool ApSelector::wantsRoam(const ApCandidate &current) const
+{
+    if (current.rssi < AP_ROAM_RSSI_TRIGGER)
+    {
+        return true;
+    }
+    uint32_t kbps = throughputKbps(current.bssid);
+    return kbps != 0 && kbps < AP_ROAM_SLOW_KBPS;
+}
+
+bool ApSelector::usable(const ApCandidate &candidate, uint32_t nowMs) const
+{
+    if (candidate.rssi < AP_MIN_RSSI)
+    {
+        return false;
+    }
+    const ApHistory *entry = find(candidate.bssid);
+    return entry == nullptr || entry->failedAtMs == 0 || nowMs - entry->failedAtMs >= AP_FAILURE_PENALTY_MS;
+}
+
+int ApSelector::selectBest(const ApCandidate *candidates, size_t count, uint32_t nowMs) const
+{
+    int best = -1;
+    int32_t bestScore = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!usable(candidates[i], nowMs))
+        {
+            continue;
+        }
+        int32_t value = score(candidates[i], 0);
+        if (best < 0 || value > bestScore)
+        {
+            best = i;
+            bestScore = value;
+        }
+    }
+    return best;
+}
+
+/**
+ * ### 选择漫游目标
+ *
+ * 没有吞吐量记录的候选按当前接入点的吞吐量计分，避免因为没测过就被高估或低估。
+ */
+int ApSelector::selectRoam(const ApCandidate *candidates, size_t count, const ApCandidate &current, uint32_t nowMs) const
+{
+    if (!wantsRoam(current))
+    {
+        return -1;
+    }
+    uint32_t currentKbps = throughputKbps(current.bssid);
+    int32_t threshold = score(current, currentKbps) + AP_ROAM_HYSTERESIS;
+    int best = -1;
+    int32_t bestScore = threshold - 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (memcmp(candidates[i].bssid, current.bssid, sizeof(current.bssid)) == 0 || !usable(candidates[i], nowMs))
+        {
+            continue;
+        }
+        int32_t value = score(candidates[i], currentKbps);
+        if (value > bestScore)
+        {
+            best = i;
+            bestScore = value;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file ApSelector.h
+ * @author 稀饭
+ * @brief 定义了 ApSelector 类，按信号强度与实测上传吞吐量为接入点评分并做漫游决策。
+ */
+
+#ifndef AP_SELECTOR_H
+#define AP_SELECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AP_HISTORY_SIZE 8               // 记录吞吐量与失败记录的接入点数
+#define AP_MIN_RSSI -85                 // 信号弱于该值的接入点不作为候选（dBm）
+#define AP_ROAM_RSSI_TRIGGER -67        // 当前信号弱于该值时才考虑漫游（dBm）
+#define AP_ROAM_SLOW_KBPS 200           // 当前实测吞吐量低于该值时也考虑漫游
+#define AP_ROAM_HYSTERESIS 8            // 候选得分至少高出当前接入点该值才漫游（相当于 dB）
+#define AP_KBPS_PER_POINT 100           // 吞吐量每多 100 kbps 加 1 分
+#define AP_THROUGHPUT_CAP_KBPS 2000     // 吞吐量加分的上限，避免压过信号强度
+#define AP_FAILURE_PENALTY_MS 600000    // 连接失败的接入点在该时间内不作为候选
+
+/**
+ * ### 扫描得到的一个接入点
+ */
+struct ApCandidate
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;     ///< 信号强度（dBm）
+    uint8_t network; ///< 对应的已配置网络序号
+};
+
+/**
+ * ### 一个接入点的历史记录
+ */
+struct ApHistory
+{
+    uint8_t bssid[6];
+    uint32_t kbps;          ///< 上传吞吐量的指数滑动平均，0 表示尚未测得
+    uint32_t failedAtMs;    ///< 最近一次连接失败的时间，0 表示没有失败
+    uint32_t lastUsedMs;    ///< 用于淘汰最久未用的记录
+    bool used;
+};
+
+/**
+ * ### 接入点选择器
+ *
+ * 得分 = RSSI + min(吞吐量, AP_THROUGHPUT_CAP_KBPS) / AP_KBPS_PER_POINT。
+ * 没有吞吐量记录的接入点按当前接入点的吞吐量计分，即只比较信号强度。
+ * 只在当前连接变差（信号弱或上传慢）时才考虑漫游，且候选得分须高出 AP_ROAM_HYSTERESIS，
+ * 避免在两个信号相近的接入点之间来回切换。
+ *
+ * 不依赖 WiFi 库，可以用构造的扫描结果在主机上测试。不是线程安全的，由调用方加锁。
+ */
+class ApSelector
+{
+public:
+    /**
+     * ### 记录一次上传的吞吐量
+     *
+     * #### 参数
+     *
+     * - `bssid`：上传时连接的接入点
+     * - `bytes`：上传字节数
+     * - `elapsedMs`：上传耗时
+     * - `nowMs`：当前时间
+     */
+    void recordThroughput(const uint8_t *bssid, uint32_t bytes, uint32_t elapsedMs, uint32_t nowMs);
+
+    /**
+     * ### 记录一次连接失败
+     */
+    void recordFailure(const uint8_t *bssid, uint32_t nowMs);
+
+    /**
+     * ### 获取接入点的实测吞吐量
+     *
+     * #### 返回
+     *
+     * - uint32_t：吞吐量（kbps），没有记录返回 0
+     */
+    uint32_t throughputKbps(const uint8_t *bssid) const;
+
+    /**
+     * ### 计算接入点得分
+     *
+     * #### 参数
+     *
+     * - `candidate`：接入点
+     * - `defaultKbps`：没有吞吐量记录时使用的吞吐量
+     */
+    int32_t score(const ApCandidate &candidate, uint32_t defaultKbps) const;
+
+    /**
+     * ### 当前连接是否值得寻找更好的接入点
+     */
+    bool wantsRoam(const ApCandidate &current) const;
+
+    /**
+     * ### 选择首次连接的接入点
+     *
+     * #### 返回
+     *
+     * - int：候选序号，没有可用候选返回 -1
+     */
+    int selectBest(const ApCandidate *candidates, size_t count, uint32_t nowMs) const;
+
+    /**
+     * ### 选择漫游目标
+     *
+     * #### 返回
+     *
+     * - int：应漫游到的候选序号，保持当前连接返回 -1
+     */
+    int selectRoam(const ApCandidate *candidates, size_t count, const ApCandidate &current, uint32_t nowMs) const;
+
+private:
+    ApHistory history[AP_HISTORY_SIZE] = {};
+
+    const ApHistory *find(const uint8_t *bssid) const;
+    ApHistory *findOrInsert(const uint8_t *bssid, uint32_t nowMs);
+    bool usable(const ApCandidate &candidate, uint32_t nowMs) const;
+};
+
+#endif // AP_SELECTOR_H
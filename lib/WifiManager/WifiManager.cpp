@@ -1,10 +1,44 @@
-
 /**
  * @file WifiManager.cpp
  * @author 稀饭
  * @brief 实现了 WifiManager 类的方法，用于连接到 WiFi 网络并检查连接状态。
  */
 #include "WifiManager.h"
+#include "TimeManager.h"
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/dhcp.h>
+
+#define WIFI_EVENT_UP BIT0
+#define WIFI_EVENT_DOWN BIT1
+
+static const uint32_t CONNECT_BUCKET_LIMITS[WIFI_CONNECT_BUCKETS - 1] = {250, 500, 1000, 2000, 4000};
+
+WifiManager *WifiManager::instance = nullptr;
+
+/**
+ * ### 当前时间（Unix 秒），时间尚未同步时返回 0
+ */
+static uint32_t syncedNow()
+{
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    return now.tv_sec >= TIME_VALID_AFTER ? (uint32_t)now.tv_sec : 0;
+}
+
+/**
+ * ### 读取 STA 接口当前 DHCP 租约的租期（秒）
+ *
+ * esp_netif 没有提供租期，直接读 lwIP 的 DHCP 客户端数据；只读一个 32 位字段，不需要加 tcpip 锁。
+ * 未使用 DHCP 或读不到时返回 0。
+ */
+static uint32_t dhcpLeaseSeconds()
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    struct netif *lwipNetif = netif ? (struct netif *)esp_netif_get_netif_impl(netif) : nullptr;
+    struct dhcp *dhcp = lwipNetif ? netif_dhcp_data(lwipNetif) : nullptr;
+    return dhcp ? dhcp->offered_t0_lease : 0;
+}
 
 /**
  * ### 构造函数
@@ -18,8 +52,23 @@
  */
 WifiManager::WifiManager(String ssid, String password)
 {
-    this->ssid = ssid;
-    this->password = password;
+    addNetwork(ssid, password);
+    instance = this;
+}
+
+/**
+ * ### 添加一个网络
+ */
+bool WifiManager::addNetwork(String ssid, String password)
+{
+    if (networkCount >= WIFI_MAX_NETWORKS)
+    {
+        return false;
+    }
+    networks[networkCount].ssid = ssid;
+    networks[networkCount].password = password;
+    networkCount++;
+    return true;
 }
 
 /**
@@ -35,12 +84,12 @@ bool WifiManager::checkConnection()
 {
     if (WiFi.status() == WL_CONNECTED)
     {
-        logger.info("检查 WiFi 状态：已连接", "WiFi");
+        LOG_INFO(WIFI, "检查 WiFi 状态：已连接");
         return true;
     }
     else
     {
-        logger.error("检查 WiFi 状态：未连接", "WiFi");
+        LOG_ERROR(WIFI, "检查 WiFi 状态：未连接");
         return false;
     }
 }
@@ -48,17 +97,586 @@ bool WifiManager::checkConnection()
 /**
  * ### 连接到 WiFi 网络
  *
- * 尝试连接到预设的 WiFi 网络，使用构造函数中提供的 SSID 和密码。
- * 如果连接成功，将保持连接状态；如果在 10 秒内未能成功连接，将放弃连接。
+ * 由本类负责重连，关闭 WiFi 库自带的自动重连与凭据保存。
  */
 void WifiManager::connect()
 {
-    WiFi.begin(ssid.c_str(), password.c_str());
-    int count = 0;
-    while (WiFi.status() != WL_CONNECTED && count < 10)
+    if (linkEvents == nullptr)
+    {
+        linkEvents = xEventGroupCreate();
+        WiFi.persistent(false);
+        WiFi.setAutoReconnect(false);
+        WiFi.mode(WIFI_STA);
+        WiFi.onEvent(WifiManager::eventCallback);
+        loadCache();
+    }
+    if (state == WIFI_STATE_IDLE)
+    {
+        startAttempt();
+    }
+    xEventGroupWaitBits(linkEvents, WIFI_EVENT_UP, pdFALSE, pdTRUE, pdMS_TO_TICKS(WIFI_BOOT_WAIT_MS));
+    loop();
+}
+
+void WifiManager::eventCallback(arduino_event_id_t event, arduino_event_info_t)
+{
+    if (instance)
+    {
+        instance->handleEvent(event);
+    }
+}
+
+/**
+ * ### 记录一个 WiFi 事件
+ *
+ * 运行在 WiFi 事件任务中，只记录事件，不做状态转换。
+ */
+void WifiManager::handleEvent(arduino_event_id_t event)
+{
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+    {
+        pendingEvents.fetch_or(WIFI_EVENT_UP);
+        if (linkEvents)
+        {
+            xEventGroupSetBits(linkEvents, WIFI_EVENT_UP);
+        }
+    }
+    else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP)
+    {
+        pendingEvents.fetch_or(WIFI_EVENT_DOWN);
+        if (linkEvents)
+        {
+            xEventGroupClearBits(linkEvents, WIFI_EVENT_UP);
+        }
+    }
+}
+
+/**
+ * ### 推进连接状态机
+ *
+ * 同一轮中既收到连接又收到断开事件时，以当前的连接状态为准。
+ */
+void WifiManager::loop()
+{
+    uint32_t events = pendingEvents.exchange(0);
+    if (events == (WIFI_EVENT_UP | WIFI_EVENT_DOWN))
+    {
+        events = WiFi.isConnected() ? WIFI_EVENT_UP : WIFI_EVENT_DOWN;
+    }
+    if (events & WIFI_EVENT_UP)
+    {
+        onLinkUp();
+    }
+    else if (events & WIFI_EVENT_DOWN)
+    {
+        onLinkDown();
+    }
+
+    switch (state)
+    {
+    case WIFI_STATE_SCANNING:
+        checkScan();
+        break;
+
+    case WIFI_STATE_CONNECTED:
+        checkLinkQuality();
+        break;
+
+    case WIFI_STATE_CONNECTING:
+        if (millis() - attemptStartMs >= WIFI_ATTEMPT_TIMEOUT_MS)
+        {
+            LOG_WARNING(WIFI, "WiFi 连接超时");
+            failAttempt();
+        }
+        break;
+
+    case WIFI_STATE_BACKOFF:
+        // 漫游扫描在断开前已开始时，等它结束再连接
+        if ((int32_t)(millis() - nextAttemptMs) >= 0 && WiFi.scanComplete() != WIFI_SCAN_RUNNING)
+        {
+            startAttempt();
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * ### 开始一次连接尝试
+ *
+ * 依次使用扫描或漫游选出的接入点、缓存的接入点、唯一配置的网络；配置了多个网络而没有缓存时先扫描。
+ * 连接指定的 BSSID 与信道时跳过全信道扫描；连接缓存的接入点且租约仍可用（见 leaseUsable()）时
+ * 使用缓存的静态 IP 跳过 DHCP。
+ */
+void WifiManager::startAttempt()
+{
+    // 上一次尝试中 WiFi.disconnect() 产生的断开事件不属于本次尝试
+    pendingEvents.fetch_and(~(uint32_t)WIFI_EVENT_DOWN);
+    WiFi.scanDelete();
+    if (!targetSet && !cache.valid && networkCount > 1)
+    {
+        startScan();
+        return;
+    }
+
+    stats.attempts++;
+    attemptStartMs = millis();
+    state = WIFI_STATE_CONNECTING;
+    const uint8_t *bssid = nullptr;
+    uint8_t channel = 0;
+    attemptUsedCache = false;
+    attemptUsedLease = false;
+    attemptNetwork = 0;
+    if (targetSet)
+    {
+        attemptNetwork = target.network;
+        bssid = target.bssid;
+        channel = target.channel;
+        attemptUsedLease = cache.valid && memcmp(cache.bssid, target.bssid, sizeof(cache.bssid)) == 0 &&
+                           leaseUsable();
+    }
+    else if (cache.valid)
+    {
+        attemptNetwork = cache.network;
+        bssid = cache.bssid;
+        channel = cache.channel;
+        attemptUsedCache = true;
+        attemptUsedLease = leaseUsable();
+    }
+
+    if (attemptUsedLease)
+    {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+    }
+    else
+    {
+        // 全 0 地址表示使用 DHCP
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    }
+
+    const WifiCredential &network = networks[attemptNetwork];
+    if (bssid)
+    {
+        stats.fastAttempts++;
+        LOG_INFO(WIFI, "WiFi 正在连接 %s（信道 %u）……", network.ssid.c_str(), channel);
+        WiFi.begin(network.ssid.c_str(), network.password.c_str(), channel, bssid);
+    }
+    else
+    {
+        LOG_INFO(WIFI, "WiFi 正在连接 %s……", network.ssid.c_str());
+        WiFi.begin(network.ssid.c_str(), network.password.c_str());
+    }
+}
+
+/**
+ * ### 开始后台扫描
+ */
+void WifiManager::startScan()
+{
+    stats.scans++;
+    scanStartMs = millis();
+    state = WIFI_STATE_SCANNING;
+    if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED)
+    {
+        LOG_WARNING(WIFI, "WiFi 扫描启动失败");
+        consecutiveFailures++;
+        scheduleRetry();
+    }
+}
+
+/**
+ * ### 取出扫描结果中属于已配置网络的接入点
+ */
+size_t WifiManager::collectScan(ApCandidate *candidates, size_t capacity)
+{
+    int16_t found = WiFi.scanComplete();
+    size_t count = 0;
+    for (int16_t i = 0; i < found && count < capacity; i++)
+    {
+        String ssid = WiFi.SSID(i);
+        for (uint8_t j = 0; j < networkCount; j++)
+        {
+            if (networks[j].ssid == ssid)
+            {
+                ApCandidate &candidate = candidates[count++];
+                memcpy(candidate.bssid, WiFi.BSSID(i), sizeof(candidate.bssid));
+                candidate.channel = WiFi.channel(i);
+                candidate.rssi = WiFi.RSSI(i);
+                candidate.network = j;
+                break;
+            }
+        }
+    }
+    WiFi.scanDelete();
+    return count;
+}
+
+/**
+ * ### 首次连接的扫描完成后选择接入点
+ */
+void WifiManager::checkScan()
+{
+    if (WiFi.scanComplete() == WIFI_SCAN_RUNNING && millis() - scanStartMs < WIFI_SCAN_TIMEOUT_MS)
+    {
+        return;
+    }
+    ApCandidate candidates[WIFI_SCAN_CANDIDATES];
+    size_t count = collectScan(candidates, WIFI_SCAN_CANDIDATES);
+    portENTER_CRITICAL(&selectorLock);
+    int best = selector.selectBest(candidates, count, millis());
+    portEXIT_CRITICAL(&selectorLock);
+    if (best < 0)
+    {
+        LOG_WARNING(WIFI, "未扫描到已配置的网络");
+        consecutiveFailures++;
+        scheduleRetry();
+        return;
+    }
+    target = candidates[best];
+    targetSet = true;
+    startAttempt();
+}
+
+ApCandidate WifiManager::currentCandidate()
+{
+    ApCandidate current = {};
+    memcpy(current.bssid, linkBssid, sizeof(current.bssid));
+    current.channel = WiFi.channel();
+    current.rssi = WiFi.RSSI();
+    current.network = attemptNetwork;
+    return current;
+}
+
+/**
+ * ### 检查连接质量，必要时漫游
+ *
+ * 每隔 WIFI_SCAN_INTERVAL_MS 检查一次；只有信号弱或上传慢时才扫描，信号好时不打扰正在进行的上传。
+ * 扫描结果交给 ApSelector 决定是否漫游，两次漫游至少间隔 WIFI_ROAM_MIN_INTERVAL_MS。
+ */
+void WifiManager::checkLinkQuality()
+{
+    if (roamScanRunning)
+    {
+        if (WiFi.scanComplete() == WIFI_SCAN_RUNNING && millis() - scanStartMs < WIFI_SCAN_TIMEOUT_MS)
+        {
+            return;
+        }
+        roamScanRunning = false;
+        ApCandidate candidates[WIFI_SCAN_CANDIDATES];
+        size_t count = collectScan(candidates, WIFI_SCAN_CANDIDATES);
+        ApCandidate current = currentCandidate();
+        portENTER_CRITICAL(&selectorLock);
+        uint32_t currentKbps = selector.throughputKbps(current.bssid);
+        int choice = selector.selectRoam(candidates, count, current, millis());
+        int32_t currentScore = selector.score(current, currentKbps);
+        int32_t targetScore = choice >= 0 ? selector.score(candidates[choice], currentKbps) : 0;
+        portEXIT_CRITICAL(&selectorLock);
+        if (choice < 0)
+        {
+            LOG_DEBUG(WIFI, "没有明显更好的接入点，保持连接（RSSI %d）", current.rssi);
+            return;
+        }
+
+        target = candidates[choice];
+        LOG_INFO(WIFI, "漫游到 %02x:%02x:%02x:%02x:%02x:%02x（信道 %u，RSSI %d，得分 %ld），当前 RSSI %d，得分 %ld",
+                 target.bssid[0], target.bssid[1], target.bssid[2], target.bssid[3], target.bssid[4], target.bssid[5],
+                 target.channel, target.rssi, (long)targetScore, current.rssi, (long)currentScore);
+        stats.roams++;
+        lastRoamMs = millis();
+        targetSet = true;
+        attemptIsRoam = true;
+        // 主动断开产生的事件在 BACKOFF 状态下被忽略
+        state = WIFI_STATE_BACKOFF;
+        nextAttemptMs = millis() + WIFI_BACKOFF_BASE_MS / 2;
+        WiFi.disconnect();
+        notify(false);
+        return;
+    }
+
+    if (millis() - lastQualityCheckMs < WIFI_SCAN_INTERVAL_MS)
+    {
+        return;
+    }
+    lastQualityCheckMs = millis();
+    ApCandidate current = currentCandidate();
+    portENTER_CRITICAL(&selectorLock);
+    stats.uploadKbps = selector.throughputKbps(current.bssid);
+    bool wantsRoam = selector.wantsRoam(current);
+    portEXIT_CRITICAL(&selectorLock);
+    stats.rssi = current.rssi;
+    if (!wantsRoam || (lastRoamMs != 0 && millis() - lastRoamMs < WIFI_ROAM_MIN_INTERVAL_MS))
+    {
+        return;
+    }
+    if (WiFi.scanNetworks(true) != WIFI_SCAN_FAILED)
+    {
+        stats.scans++;
+        scanStartMs = millis();
+        roamScanRunning = true;
+    }
+}
+
+/**
+ * ### 记录一次上传的吞吐量
+ */
+void WifiManager::recordUpload(uint32_t bytes, uint32_t elapsedMs)
+{
+    if (state != WIFI_STATE_CONNECTED)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&selectorLock);
+    selector.recordThroughput(linkBssid, bytes, elapsedMs, millis());
+    portEXIT_CRITICAL(&selectorLock);
+}
+
+/**
+ * ### 本次尝试失败
+ *
+ * 扫描或漫游选出的接入点连接失败时，该接入点在一段时间内不再作为候选；
+ * 使用缓存失败时清除缓存（接入点可能已更换信道或租约已失效），下次走完整的扫描与 DHCP。
+ */
+void WifiManager::failAttempt()
+{
+    stats.failures++;
+    consecutiveFailures++;
+    WiFi.disconnect();
+    if (targetSet)
+    {
+        portENTER_CRITICAL(&selectorLock);
+        selector.recordFailure(target.bssid, millis());
+        portEXIT_CRITICAL(&selectorLock);
+        if (attemptIsRoam)
+        {
+            LOG_WARNING(WIFI, "漫游目标连接失败");
+            stats.roamFailures++;
+        }
+        targetSet = false;
+        attemptIsRoam = false;
+        // 换一个接入点不是网络故障，稍后重试，留出时间让断开事件先到达
+        state = WIFI_STATE_BACKOFF;
+        nextAttemptMs = millis() + WIFI_BACKOFF_BASE_MS / 2;
+        return;
+    }
+    if (attemptUsedCache)
+    {
+        LOG_WARNING(WIFI, "使用缓存的接入点连接失败，清除缓存");
+        clearCache();
+        state = WIFI_STATE_BACKOFF;
+        nextAttemptMs = millis() + WIFI_BACKOFF_BASE_MS / 2;
+        return;
+    }
+    scheduleRetry();
+}
+
+void WifiManager::scheduleRetry()
+{
+    uint32_t delayMs = WIFI_BACKOFF_BASE_MS << min(consecutiveFailures - 1, (uint32_t)5);
+    delayMs = min(delayMs, (uint32_t)WIFI_BACKOFF_MAX_MS);
+    // 在 [delay/2, delay] 之间随机
+    nextAttemptMs = millis() + delayMs / 2 + esp_random() % (delayMs / 2 + 1);
+    state = WIFI_STATE_BACKOFF;
+}
+
+/**
+ * ### 已获得 IP
+ */
+void WifiManager::onLinkUp()
+{
+    if (state == WIFI_STATE_CONNECTED)
+    {
+        return;
+    }
+    uint32_t elapsed = millis() - attemptStartMs;
+    stats.lastConnectMs = elapsed;
+    uint8_t bucket = 0;
+    while (bucket < WIFI_CONNECT_BUCKETS - 1 && elapsed >= CONNECT_BUCKET_LIMITS[bucket])
+    {
+        bucket++;
+    }
+    stats.connectHistogram[bucket]++;
+    consecutiveFailures = 0;
+    state = WIFI_STATE_CONNECTED;
+    LOG_INFO(WIFI, "WiFi 连接成功，耗时 %lu ms，IP %s，RSSI %d", (unsigned long)elapsed,
+             WiFi.localIP().toString().c_str(), WiFi.RSSI());
+    portENTER_CRITICAL(&selectorLock);
+    memcpy(linkBssid, WiFi.BSSID(), sizeof(linkBssid));
+    portEXIT_CRITICAL(&selectorLock);
+    targetSet = false;
+    attemptIsRoam = false;
+    lastQualityCheckMs = millis();
+
+    if (attemptUsedLease)
+    {
+        cache.fastConnects++;
+    }
+    else
+    {
+        memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+        cache.channel = WiFi.channel();
+        cache.ip = WiFi.localIP();
+        cache.gateway = WiFi.gatewayIP();
+        cache.subnet = WiFi.subnetMask();
+        cache.dns = WiFi.dnsIP();
+        cache.leaseObtained = syncedNow();
+        cache.leaseSeconds = dhcpLeaseSeconds();
+        cache.fastConnects = 0;
+        cache.network = attemptNetwork;
+        cache.valid = true;
+    }
+    saveCache();
+    notify(true);
+}
+
+/**
+ * ### 连接断开
+ */
+void WifiManager::onLinkDown()
+{
+    if (state == WIFI_STATE_CONNECTED)
+    {
+        stats.drops++;
+        LOG_WARNING(WIFI, "WiFi 连接断开，尝试重新连接……");
+        state = WIFI_STATE_BACKOFF;
+        nextAttemptMs = millis();
+        roamScanRunning = false;
+        notify(false);
+    }
+    else if (state == WIFI_STATE_CONNECTING)
+    {
+        failAttempt();
+    }
+}
+
+void WifiManager::notify(bool up)
+{
+    for (uint8_t i = 0; i < callbackCount; i++)
+    {
+        callbacks[i](up);
+    }
+}
+
+/**
+ * ### 注册连接状态回调
+ */
+bool WifiManager::onLinkChange(WifiLinkCallback callback)
+{
+    if (callback == nullptr || callbackCount >= WIFI_LINK_CALLBACKS)
+    {
+        return false;
+    }
+    callbacks[callbackCount++] = callback;
+    return true;
+}
+
+WifiState WifiManager::getState()
+{
+    return state;
+}
+
+WifiStats WifiManager::getStats()
+{
+    return stats;
+}
+
+/**
+ * ### 缓存的 IP 租约能否复用
+ *
+ * 复用次数未满，且当前时间早于取得租约后租期的一半；时间尚未同步或租期未知时无法判断租约
+ * 是否已过期，改走 DHCP。
+ */
+bool WifiManager::leaseUsable()
+{
+    if (cache.fastConnects >= WIFI_LEASE_FAST_CONNECTS)
+    {
+        return false;
+    }
+    uint32_t now = syncedNow();
+    if (now == 0 || cache.leaseObtained == 0 || cache.leaseSeconds == 0 ||
+        now - cache.leaseObtained >= cache.leaseSeconds / 2)
+    {
+        LOG_INFO(WIFI, "IP 租约已过半或无法判断，使用 DHCP");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * ### 从 NVS 读取缓存
+ *
+ * 缓存的网络已不在配置中时缓存作废。
+ */
+void WifiManager::loadCache()
+{
+    Preferences prefs;
+    if (!prefs.begin(WIFI_PREFS_NAMESPACE, true))
+    {
+        return;
+    }
+    String ssid = prefs.getString("ssid", "");
+    if (prefs.getBytes("cache", &cache, sizeof(cache)) == sizeof(cache) && cache.network < networkCount &&
+        networks[cache.network].ssid == ssid)
+    {
+        LOG_INFO(WIFI, "读取到上次连接的接入点，信道 %u", cache.channel);
+    }
+    else
+    {
+        cache = {};
+    }
+    savedCache = cache;
+    prefs.end();
+}
+
+/**
+ * ### 缓存是否指向同一个接入点与租约
+ *
+ * 不比较租约复用次数：它每次重连都会变化，只在用满与否改变时才需要写入。
+ */
+static bool sameCache(const WifiCache &a, const WifiCache &b)
+{
+    return a.valid == b.valid && memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0 && a.channel == b.channel &&
+           a.ip == b.ip && a.gateway == b.gateway && a.subnet == b.subnet && a.dns == b.dns && a.network == b.network &&
+           a.leaseObtained == b.leaseObtained && a.leaseSeconds == b.leaseSeconds &&
+           (a.fastConnects >= WIFI_LEASE_FAST_CONNECTS) == (b.fastConnects >= WIFI_LEASE_FAST_CONNECTS);
+}
+
+/**
+ * ### 把缓存写入 NVS
+ *
+ * 内容与已保存的相同时不写，避免每次重连都擦写闪存。租约复用次数只保存在内存中，
+ * 用满时才写入，重启后因此最多多复用 WIFI_LEASE_FAST_CONNECTS 次。
+ */
+void WifiManager::saveCache()
+{
+    if (sameCache(cache, savedCache))
+    {
+        return;
+    }
+    Preferences prefs;
+    if (!prefs.begin(WIFI_PREFS_NAMESPACE, false))
+    {
+        return;
+    }
+    const String &ssid = networks[cache.network].ssid;
+    if (prefs.getString("ssid", "") != ssid)
+    {
+        prefs.putString("ssid", ssid);
+    }
+    prefs.putBytes("cache", &cache, sizeof(cache));
+    prefs.end();
+    savedCache = cache;
+}
+
+void WifiManager::clearCache()
+{
+    cache = {};
+    Preferences prefs;
+    if (prefs.begin(WIFI_PREFS_NAMESPACE, false))
     {
-        delay(1000);
-        logger.info("WiFi 正在连接中……", "WiFi");
-        count++;
+        prefs.remove("cache");
+        prefs.end();
     }
+    savedCache = {};
 }
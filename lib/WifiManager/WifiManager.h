@@ -10,51 +10,243 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WiFiClient.h>
+#include <Preferences.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
 #include "Logger.h"
+#include "ApSelector.h"
 
 extern Logger logger;        // 外部定义的日志记录器对象
 extern WiFiClient wifiClient; // 外部定义的 WiFi 客户端对象
 
+#define WIFI_BOOT_WAIT_MS 10000       // connect() 等待首次连接的最长时间
+#define WIFI_ATTEMPT_TIMEOUT_MS 10000 // 单次连接尝试的超时
+#define WIFI_BACKOFF_BASE_MS 1000     // 重连退避的初始间隔
+#define WIFI_BACKOFF_MAX_MS 30000     // 重连退避的最大间隔
+#define WIFI_LEASE_FAST_CONNECTS 8    // 连续复用缓存 IP 租约的次数上限，之后走一次 DHCP 续租
+#define WIFI_LINK_CALLBACKS 4         // 最多可注册的连接状态回调数
+#define WIFI_CONNECT_BUCKETS 6        // 连接耗时直方图的桶数
+#define WIFI_PREFS_NAMESPACE "wifi"
+#define WIFI_MAX_NETWORKS 4           // 最多可配置的网络数
+#define WIFI_SCAN_CANDIDATES 16       // 一次扫描最多处理的接入点数
+#define WIFI_SCAN_INTERVAL_MS 60000   // 已连接时检查是否需要漫游的间隔
+#define WIFI_SCAN_TIMEOUT_MS 10000    // 后台扫描的超时
+#define WIFI_ROAM_MIN_INTERVAL_MS 300000 // 两次漫游之间的最短间隔
+
+enum WifiState : uint8_t {
+    WIFI_STATE_IDLE,       // 尚未开始连接
+    WIFI_STATE_SCANNING,   // 配置了多个网络且没有缓存，扫描后选择接入点
+    WIFI_STATE_CONNECTING, // 已调用 WiFi.begin，等待获得 IP
+    WIFI_STATE_CONNECTED,  // 已获得 IP
+    WIFI_STATE_BACKOFF     // 连接失败或断开，等待下一次尝试
+};
+
+/**
+ * ### 上一次成功连接的接入点与 IP 租约
+ *
+ * 保存在 NVS 中，重启后用 BSSID 与信道跳过扫描，用租约跳过 DHCP。
+ * 租约只在租期过半（DHCP 客户端本应续租的时刻）之前复用。
+ */
+struct WifiCache
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t leaseObtained; // 取得租约时的 Unix 时间（秒），时间尚未同步时为 0
+    uint32_t leaseSeconds;  // DHCP 服务器给出的租期，未知时为 0
+    uint8_t fastConnects; // 租约取得后已复用的次数
+    uint8_t network;      // 对应的已配置网络序号
+    bool valid;
+};
+
+/**
+ * ### 一组 WiFi 凭据
+ */
+struct WifiCredential
+{
+    String ssid;
+    String password;
+};
+
+/**
+ * ### WiFi 连接统计
+ *
+ * 连接耗时从调用 WiFi.begin 到获得 IP，直方图各桶的上限为
+ * 250、500、1000、2000、4000 ms，最后一桶为 4000 ms 以上。
+ */
+struct WifiStats
+{
+    uint32_t attempts = 0;     // 连接尝试次数
+    uint32_t fastAttempts = 0; // 使用缓存 BSSID 与信道的尝试次数
+    uint32_t failures = 0;     // 失败的尝试次数
+    uint32_t drops = 0;        // 已连接后断开的次数
+    uint32_t lastConnectMs = 0;
+    uint32_t connectHistogram[WIFI_CONNECT_BUCKETS] = {};
+    uint32_t scans = 0;        // 后台扫描次数
+    uint32_t roams = 0;        // 漫游次数
+    uint32_t roamFailures = 0; // 漫游目标连接失败的次数
+    int8_t rssi = 0;           // 最近一次检查时的信号强度（dBm）
+    uint32_t uploadKbps = 0;   // 当前接入点的实测上传吞吐量
+};
+
+/**
+ * ### 连接状态回调
+ *
+ * 在调用 WifiManager::loop() 的任务中调用，`up` 为 true 表示已获得 IP。
+ */
+typedef void (*WifiLinkCallback)(bool up);
+
 /**
  * ### WiFi 管理器类
- * 
+ *
  * 该类负责连接到指定的 WiFi 网络并检查连接状态。
+ *
+ * WiFi 事件回调只记录事件，状态转换都在 loop() 中完成：连接超时或断开后按带抖动的
+ * 指数退避自动重连，连接建立与断开时通知注册的回调。
+ *
+ * 可以配置多个网络。已连接时每隔 WIFI_SCAN_INTERVAL_MS 检查连接质量，信号弱或上传慢时
+ * 在后台扫描，由 ApSelector 按信号强度与实测上传吞吐量选出明显更好的接入点后漫游过去。
  */
 class WifiManager {
 public:
-    String ssid;       ///< WiFi 网络的SSID
-    String password;   ///< WiFi 网络的密码
-
     /**
      * ### 构造函数
-     * 
+     *
      * 初始化 WifiManager 对象并设置要连接的 WiFi 网络的 SSID 和密码。
-     * 
+     *
      * #### 参数
-     * 
+     *
      * - `ssid`：WiFi 网络的SSID
      * - `password`：WiFi 网络的密码
      */
     WifiManager(String ssid, String password);
 
+    /**
+     * ### 添加一个网络
+     *
+     * 需在 connect() 之前调用。
+     *
+     * #### 返回
+     *
+     * - bool：添加成功返回 true，网络数量已满返回 false
+     */
+    bool addNetwork(String ssid, String password);
+
+    /**
+     * ### 记录一次上传的吞吐量
+     *
+     * 由上传任务调用，计入当前接入点的吞吐量。
+     *
+     * #### 参数
+     *
+     * - `bytes`：上传字节数
+     * - `elapsedMs`：上传耗时
+     */
+    void recordUpload(uint32_t bytes, uint32_t elapsedMs);
+
     /**
      * ### 连接到 WiFi 网络
-     * 
-     * 尝试连接到预设的 WiFi 网络，使用构造函数中提供的 SSID 和密码。
-     * 如果连接成功，将保持连接状态；如果在 10 秒内未能成功连接，将放弃连接。
+     *
+     * 开始连接并等待首次连接结果，最多等待 WIFI_BOOT_WAIT_MS，等待期间不占用 CPU。
+     * 未能连接时由 loop() 继续在后台重连。
      */
     void connect();
 
     /**
      * ### 检查 WiFi 连接状态
-     * 
+     *
      * 检查当前设备是否已连接到 WiFi 网络。
-     * 
+     *
      * #### 返回
-     * 
+     *
      * -  bool：true | false 当前 WiFi 连接状态，true 表示已连接，false 表示未连接
      */
     bool checkConnection();
+
+    /**
+     * ### 推进连接状态机
+     *
+     * 处理 WiFi 事件、连接超时与退避重连，需在主循环中调用。
+     */
+    void loop();
+
+    /**
+     * ### 注册连接状态回调
+     *
+     * #### 返回
+     *
+     * - bool：注册成功返回 true，回调数量已满返回 false
+     */
+    bool onLinkChange(WifiLinkCallback callback);
+
+    /**
+     * ### 记录一个 WiFi 事件
+     *
+     * 由 WiFi 事件回调调用，也可以直接调用以模拟事件。
+     */
+    void handleEvent(arduino_event_id_t event);
+
+    /**
+     * ### 获取连接状态
+     */
+    WifiState getState();
+
+    /**
+     * ### 获取连接统计
+     */
+    WifiStats getStats();
+
+private:
+    WifiCredential networks[WIFI_MAX_NETWORKS];
+    uint8_t networkCount = 0;
+    ApSelector selector;
+    portMUX_TYPE selectorLock = portMUX_INITIALIZER_UNLOCKED; // 上传任务与 loop() 共用 selector
+    uint8_t linkBssid[6] = {};     // 当前连接的接入点
+    ApCandidate target = {};       // 下一次尝试要连接的接入点（扫描或漫游选出）
+    bool targetSet = false;
+    bool attemptIsRoam = false;
+    uint8_t attemptNetwork = 0;    // 本次尝试（连接成功后即当前连接）的网络序号
+    bool roamScanRunning = false;
+    uint32_t scanStartMs = 0;
+    uint32_t lastQualityCheckMs = 0;
+    uint32_t lastRoamMs = 0;
+
+    WifiState state = WIFI_STATE_IDLE;
+    WifiStats stats;
+    WifiCache cache = {};
+    WifiCache savedCache = {};      // NVS 中保存的缓存，内容未变时不重复写入
+    bool attemptUsedCache = false;  // 本次尝试使用了缓存的 BSSID 与信道
+    bool attemptUsedLease = false;  // 本次尝试复用了缓存的 IP 租约
+    uint32_t attemptStartMs = 0;
+    uint32_t nextAttemptMs = 0;
+    uint32_t consecutiveFailures = 0;
+    std::atomic<uint32_t> pendingEvents{0}; // 事件回调写入，loop() 读取
+    EventGroupHandle_t linkEvents = nullptr;
+    WifiLinkCallback callbacks[WIFI_LINK_CALLBACKS] = {};
+    uint8_t callbackCount = 0;
+
+    static WifiManager *instance;
+    static void eventCallback(arduino_event_id_t event, arduino_event_info_t info);
+
+    void startAttempt();
+    void startScan();
+    void checkScan();
+    void checkLinkQuality();
+    size_t collectScan(ApCandidate *candidates, size_t capacity);
+    ApCandidate currentCandidate();
+    void failAttempt();
+    void scheduleRetry();
+    void onLinkUp();
+    void onLinkDown();
+    void notify(bool up);
+    bool leaseUsable();
+    void loadCache();
+    void saveCache();
+    void clearCache();
 };
 
 #endif // WIFI_MANAGER_H
@@ -0,0 +1,22 @@
+#!/bin/sh
+# 比较 env:esp32cam 与 env:esp32cam_release（编译期日志过滤）的固件代码段大小
+# 用法：在项目根目录执行 scripts/log_size.sh
+set -e
+
+SIZE="${PLATFORMIO_CORE_DIR:-$HOME/.platformio}/packages/toolchain-xtensa-esp32/bin/xtensa-esp32-elf-size"
+
+# 输出 ELF 中 .iram0.text 与 .flash.text 的大小及其合计
+text_size() {
+    "$SIZE" -A "$1" | awk '
+        $1 == ".iram0.text" || $1 == ".flash.text" { printf "  %-12s %8d\n", $1, $2; total += $2 }
+        END { printf "  %-12s %8d\n", "total", total }'
+}
+
+for env in esp32cam esp32cam_release; do
+    pio run -s -e "$env"
+done
+
+for env in esp32cam esp32cam_release; do
+    echo "$env:"
+    text_size ".pio/build/$env/firmware.elf"
+done
@@ -8,6 +8,10 @@
 #include "_Base64.h"
 #include "Logger.h"
 #include "QiniuClient.h"
+#include "ResumableUploader.h"
+#include "UploadBacklog.h"
+#include "RetentionManager.h"
+#include "FramePipeline.h"
 
 
 
@@ -22,39 +26,56 @@ TimeManager timeManager;
 WifiManager wifiManager("Tenda_2344E0","lvjiang516116");
 IoTManager iotManager("k1jf1H5lHO8","ESPcam","a5c9dadff635870d067233b08ab66c3e","iot-06z00j81cbwhmp9.mqtt.iothub.aliyuncs.com",1883);
 QiniuClient qiniuClient("-FrVRtN6n86rbnw6iwLF8SZHHJ8mv2NNJNtNYYIL","6XraLGydOPzTtG3Yrs65e4VKPu2X7M-oXUg7PvDu","storage-fan","https://storage.xifan.fun","z0");
+ResumableUploader resumableUploader(qiniuClient, 2);
+UploadBacklog uploadBacklog;
+RetentionManager retentionManager;
+FramePipeline framePipeline;
 
 
+// 云端下发 logLevel 属性调整运行时日志级别，例如 "*=info,MQTT=debug"
+void onLogLevel(JsonVariant value)
+{
+  const char *spec = value.as<const char *>();
+  if (!logger.applyLevelOverrides(spec))
+  {
+    LOG_WARNING(LOGGER, "无效的日志级别设置: %s", spec ? spec : "");
+  }
+}
+
+// WiFi 连接状态变化时通知依赖网络的模块
+void onWifiLink(bool up)
+{
+  iotManager.onNetworkChange(up);
+  qiniuClient.onNetworkChange(up);
+}
 
 void setup()
 {
   Serial.begin(115200);
+  logger.begin();
+  iotManager.bindData("logLevel", onLogLevel);
+  // 同一 SSID 的多个接入点无需重复添加；其他网络用 wifiManager.addNetwork(ssid, password) 添加
+  wifiManager.onLinkChange(onWifiLink);
   wifiManager.connect();
-  if (wifiManager.checkConnection()==true)
-  {
-    timeManager.updateTime();
-    String timestamp = String(timeManager.getTimestamp());
-    iotManager.connect();
-  }
+  // 通过 MQTT 连接校时，30 秒内未同步再启用 SNTP；上传凭证在时间有效后才签名
+  timeManager.begin(TIME_SOURCE_MQTT);
+  // WiFi 未连接时 MQTT 状态机等待网络恢复后再连接
+  wifiManager.checkConnection();
+  iotManager.connect();
+  sdcardManager.setStorageMode(SD_STORAGE_SEGMENT);
   sdcardManager.init();
+  sdcardManager.startWriter(SD_QUEUE_SPILL);
+  // 保留 30 天，7 天前的帧每 10 帧保留 1 帧，内存卡使用率超过 90% 时淘汰到 80%
+  retentionManager.begin({0, 30 * 24 * 3600, 7 * 24 * 3600, 10, 90, 80});
+  uploadBacklog.init();
   camera.init();
-
+  framePipeline.begin(1000);
 }
 
 
 void loop()
 {
-  camera_fb_t*  image = camera.capture();
-  sdcardManager.saveImage(image);
-  String imageName = "image" + String(timeManager.getTimestamp()) + ".jpg";
-  String url = qiniuClient.uploadImage(imageName,image->buf,image->len);
-  if(url!="")
-  {
-    iotManager.sendProperty("img",url);
-  }
-  else
-  {
-    iotManager.sendProperty("img","error");
-  }
-  camera.returnFrameBuffer(image);
-  delay(1000);
+  wifiManager.loop();
+  iotManager.loop();
+  delay(10);
 }
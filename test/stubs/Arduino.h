@@ -0,0 +1,263 @@
+/**
+ * @file Arduino.h
+ * @brief 主机测试用的 Arduino 核心替身。
+ *
+ * 只覆盖固件用到的部分：String、Print/Stream、Serial、计时与随机数。
+ * millis()/micros() 以真实流逝时间为准，测试可用 hostAdvanceMillis() 人为拨快；
+ * 墙上时间从 1970 年开始（即未同步），settimeofday() 只改偏移。
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "WString.h"
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+
+#define IRAM_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// ---------------------------------------------------------------- 时钟
+
+inline const std::chrono::steady_clock::time_point hostBootTime = std::chrono::steady_clock::now();
+inline std::atomic<int64_t> hostSkewUs{0};    // 测试拨快的时间
+inline std::atomic<int64_t> hostWallBaseUs{0}; // 墙上时间相对开机的偏移
+
+/**
+ * ### 开机以来的微秒数
+ *
+ * 真实流逝时间加上测试拨快的部分。
+ */
+inline int64_t hostMonotonicUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostBootTime).count() + hostSkewUs.load();
+}
+
+/**
+ * ### 拨快时钟
+ *
+ * 让依赖 millis() 的超时与退避立即到期，而不必真的等待。
+ */
+inline void hostAdvanceMillis(uint32_t ms) { hostSkewUs += (int64_t)ms * 1000; }
+
+inline unsigned long millis() { return (unsigned long)(uint32_t)(hostMonotonicUs() / 1000); }
+inline unsigned long micros() { return (unsigned long)(uint32_t)hostMonotonicUs(); }
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() { std::this_thread::yield(); }
+
+inline int hostGettimeofday(struct timeval *tv, void *)
+{
+    int64_t us = hostWallBaseUs.load() + hostMonotonicUs();
+    tv->tv_sec = (time_t)(us / 1000000);
+    tv->tv_usec = (suseconds_t)(us % 1000000);
+    return 0;
+}
+
+inline int hostSettimeofday(const struct timeval *tv, const void *)
+{
+    hostWallBaseUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - hostMonotonicUs();
+    return 0;
+}
+
+#define gettimeofday hostGettimeofday
+#define settimeofday hostSettimeofday
+
+/**
+ * ### 与 ESP32 Arduino 相同的 getLocalTime()
+ *
+ * 时间尚未同步时每 10 ms 重试一次，直到超时。
+ */
+inline bool getLocalTime(struct tm *info, uint32_t ms = 5000)
+{
+    uint32_t start = millis();
+    while ((millis() - start) <= ms)
+    {
+        struct timeval tv;
+        hostGettimeofday(&tv, nullptr);
+        time_t now = tv.tv_sec;
+        localtime_r(&now, info);
+        if (info->tm_year > (2016 - 1900))
+        {
+            return true;
+        }
+        delay(10);
+    }
+    return false;
+}
+
+inline void configTzTime(const char *tz, const char *, const char * = nullptr, const char * = nullptr)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+// ---------------------------------------------------------------- 随机数与内存
+
+inline std::mt19937 &hostRng()
+{
+    static thread_local std::mt19937 rng(12345);
+    return rng;
+}
+
+inline long random(long howbig) { return howbig <= 0 ? 0 : (long)(hostRng()() % (unsigned long)howbig); }
+inline long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+inline void randomSeed(unsigned long seed) { hostRng().seed(seed); }
+
+inline void *ps_malloc(size_t size) { return malloc(size); }
+inline bool psramFound() { return true; }
+
+inline size_t hostStrlcpy(char *dst, const char *src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size)
+    {
+        size_t n = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return length;
+}
+#define strlcpy hostStrlcpy
+
+// ---------------------------------------------------------------- Print / Stream
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size-- && write(*buffer++))
+        {
+            n++;
+        }
+        return n;
+    }
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    size_t print(const char *str) { return write(str); }
+    size_t print(const String &str) { return write((const uint8_t *)str.c_str(), str.length()); }
+    size_t println(const char *str = "") { return print(str) + write("\r\n"); }
+    size_t println(const String &str) { return print(str) + write("\r\n"); }
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(char *buffer, size_t length)
+    {
+        size_t count = 0;
+        while (count < length)
+        {
+            int c = read();
+            if (c < 0)
+            {
+                break;
+            }
+            *buffer++ = (char)c;
+            count++;
+        }
+        return count;
+    }
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+    String readString()
+    {
+        String out;
+        int c;
+        while ((c = read()) >= 0)
+        {
+            out += (char)c;
+        }
+        return out;
+    }
+
+protected:
+    unsigned long timeoutMs = 1000;
+};
+
+/**
+ * ### 串口替身
+ *
+ * 默认丢弃输出，避免基准测试被终端拖慢；hostEcho 置位后写到标准输出，hostCapture 置位后保存到 hostOutput。
+ * hostUsPerByte 模拟串口发送耗时（115200 波特约 87 微秒每字节），写入在发送完之前不返回。
+ */
+class HardwareSerial : public Stream
+{
+public:
+    bool hostEcho = false;
+    bool hostCapture = false;
+    std::atomic<uint32_t> hostUsPerByte{0};
+    std::atomic<size_t> hostBytes{0};
+    std::mutex hostLock;
+    std::string hostOutput;
+
+    void begin(unsigned long) {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        hostBytes += size;
+        if (hostEcho)
+        {
+            fwrite(buffer, 1, size, stdout);
+        }
+        if (hostCapture)
+        {
+            std::lock_guard<std::mutex> guard(hostLock);
+            hostOutput.append((const char *)buffer, size);
+        }
+        if (hostUsPerByte)
+        {
+            delayMicroseconds(size * hostUsPerByte);
+        }
+        return size;
+    }
+    using Print::write;
+    operator bool() const { return true; }
+};
+
+inline HardwareSerial Serial;
+
+// 与 ESP32 核心一样，Arduino.h 同时带入 FreeRTOS 与系统接口
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+
+#endif // HOST_ARDUINO_H
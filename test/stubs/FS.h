@@ -0,0 +1,249 @@
+/**
+ * @file FS.h
+ * @brief 主机测试用的文件系统替身，File 直接映射到主机上的文件。
+ */
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+/**
+ * ### 写卡耗时
+ *
+ * 每写入 1 KB 额外等待的微秒数，用来模拟内存卡的写入速度，默认为 0。
+ */
+inline std::atomic<uint32_t> hostSdWriteUsPerKb{0};
+
+namespace fs
+{
+    struct HostFileState
+    {
+        FILE *fp = nullptr;
+        std::string path;     ///< 卡上的路径（以 / 开头）
+        std::string hostPath; ///< 主机上的真实路径
+        bool directory = false;
+        std::vector<std::string> entries;
+        size_t nextEntry = 0;
+
+        ~HostFileState()
+        {
+            if (fp)
+            {
+                fclose(fp);
+            }
+        }
+    };
+
+    /**
+     * ### 文件
+     *
+     * 与 Arduino 一样按值传递、共享同一个打开的句柄。
+     */
+    class File : public Stream
+    {
+    public:
+        File() {}
+        explicit File(std::shared_ptr<HostFileState> state) : state(state) {}
+
+        operator bool() const { return state && (state->fp || state->directory); }
+
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *buf, size_t size) override
+        {
+            if (!state || !state->fp)
+            {
+                return 0;
+            }
+            if (hostSdWriteUsPerKb)
+            {
+                delayMicroseconds((uint32_t)((uint64_t)size * hostSdWriteUsPerKb / 1024));
+            }
+            return fwrite(buf, 1, size, state->fp);
+        }
+        using Print::write;
+
+        int available() override
+        {
+            if (!state || !state->fp)
+            {
+                return 0;
+            }
+            return (int)(size() - position());
+        }
+        int read() override
+        {
+            return state && state->fp ? fgetc(state->fp) : -1;
+        }
+        size_t read(uint8_t *buf, size_t size)
+        {
+            return state && state->fp ? fread(buf, 1, size, state->fp) : 0;
+        }
+        size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *)buffer, length); }
+        int peek() override
+        {
+            if (!state || !state->fp)
+            {
+                return -1;
+            }
+            int c = fgetc(state->fp);
+            if (c >= 0)
+            {
+                ungetc(c, state->fp);
+            }
+            return c;
+        }
+        void flush() override
+        {
+            if (state && state->fp)
+            {
+                fflush(state->fp);
+            }
+        }
+        bool seek(uint32_t pos)
+        {
+            return state && state->fp && fseek(state->fp, pos, SEEK_SET) == 0;
+        }
+        size_t position() const
+        {
+            return state && state->fp ? (size_t)ftell(state->fp) : 0;
+        }
+        size_t size() const
+        {
+            if (!state || !state->fp)
+            {
+                return 0;
+            }
+            fflush(state->fp);
+            struct stat st;
+            return fstat(fileno(state->fp), &st) == 0 ? (size_t)st.st_size : 0;
+        }
+        void close()
+        {
+            state.reset();
+        }
+        const char *path() const { return state ? state->path.c_str() : ""; }
+        const char *name() const
+        {
+            if (!state)
+            {
+                return "";
+            }
+            size_t slash = state->path.rfind('/');
+            return state->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+        }
+        bool isDirectory() const { return state && state->directory; }
+        File openNextFile(const char *mode = FILE_READ);
+        void rewindDirectory()
+        {
+            if (state)
+            {
+                state->nextEntry = 0;
+            }
+        }
+
+    private:
+        std::shared_ptr<HostFileState> state;
+    };
+
+    /**
+     * ### 文件系统
+     *
+     * 卡上的路径都映射到 root 目录之下。
+     */
+    class FS
+    {
+    public:
+        std::string root;
+
+        std::string hostPath(const String &path) const { return root + (path.startsWith("/") ? "" : "/") + path.c_str(); }
+
+        File open(const String &path, const char *mode = FILE_READ, bool = false)
+        {
+            std::string real = hostPath(path);
+            auto state = std::make_shared<HostFileState>();
+            state->path = path.startsWith("/") ? path.c_str() : (String("/") + path).c_str();
+            state->hostPath = real;
+            struct stat st;
+            if (stat(real.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            {
+                state->directory = true;
+                if (DIR *dir = opendir(real.c_str()))
+                {
+                    while (struct dirent *entry = readdir(dir))
+                    {
+                        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                        {
+                            state->entries.push_back(entry->d_name);
+                        }
+                    }
+                    closedir(dir);
+                }
+                return File(state);
+            }
+            std::string flags = mode;
+            if (flags == "r+" || flags == "w" || flags == "a")
+            {
+                // 与 ESP32 一样，"r+" 打开不存在的文件时新建
+                if (flags == "r+" && stat(real.c_str(), &st) != 0)
+                {
+                    flags = "w+";
+                }
+            }
+            state->fp = fopen(real.c_str(), flags == "r" ? "rb" : (flags + "b").c_str());
+            if (!state->fp)
+            {
+                return File();
+            }
+            return File(state);
+        }
+        bool exists(const String &path) const
+        {
+            struct stat st;
+            return stat(hostPath(path).c_str(), &st) == 0;
+        }
+        bool mkdir(const String &path) { return ::mkdir(hostPath(path).c_str(), 0755) == 0; }
+        bool rmdir(const String &path) { return ::rmdir(hostPath(path).c_str()) == 0; }
+        bool remove(const String &path) { return ::unlink(hostPath(path).c_str()) == 0; }
+        bool rename(const String &from, const String &to) { return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0; }
+    };
+
+    inline File File::openNextFile(const char *)
+    {
+        if (!state || !state->directory || state->nextEntry >= state->entries.size())
+        {
+            return File();
+        }
+        std::string child = state->path + (state->path.back() == '/' ? "" : "/") + state->entries[state->nextEntry++];
+        auto next = std::make_shared<HostFileState>();
+        next->path = child;
+        next->hostPath = state->hostPath + "/" + child.substr(child.rfind('/') + 1);
+        struct stat st;
+        if (stat(next->hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            next->directory = true;
+        }
+        else
+        {
+            next->fp = fopen(next->hostPath.c_str(), "rb");
+        }
+        return File(next);
+    }
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif // HOST_FS_H
@@ -0,0 +1,294 @@
+/**
+ * @file HTTPClient.h
+ * @brief 主机测试用的 HTTPClient 替身，请求交给进程内的 HTTP 服务端替身处理。
+ *
+ * 服务端替身 hostHttp 按 WiFiClient 区分连接：没有打开的连接先建连（计入 opened 并模拟握手耗时），
+ * 打开的连接直接复用（计入 reused）。请求体按 1460 字节分块从 Stream 读取，与 ESP32 实现一致。
+ * 测试通过 handler 决定响应，并可用 hostHttpCloseIdle() 模拟服务端关闭空闲长连接。
+ */
+
+#ifndef HOST_HTTP_CLIENT_H
+#define HOST_HTTP_CLIENT_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_BAD_REQUEST 400
+#define HTTP_CODE_UNAUTHORIZED 401
+#define HTTP_CODE_FORBIDDEN 403
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_INTERNAL_SERVER_ERROR 500
+#define HTTP_CODE_SERVICE_UNAVAILABLE 503
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTP_TCP_BUFFER_SIZE 1460
+
+struct HostHttpRequest
+{
+    String method;
+    String url;
+    std::vector<std::pair<String, String>> headers;
+    std::string body;     ///< 请求体（keepBodies 为 false 时为空）
+    size_t bodyLength;    ///< 实际收到的请求体字节数
+    bool reused;          ///< 是否复用了已有连接
+    uint32_t firstByteUs; ///< 从发起请求到收到第一个请求体字节的耗时
+    uint32_t firstByteAt; ///< 收到第一个请求体字节时的 micros()，便于调用方计入组包耗时
+
+    String header(const char *name) const
+    {
+        for (const auto &h : headers)
+        {
+            if (h.first == name)
+            {
+                return h.second;
+            }
+        }
+        return String();
+    }
+};
+
+/**
+ * ### HTTP 服务端替身
+ *
+ * handler 返回状态码并填写响应体；返回负数表示传输错误，连接随之关闭。
+ */
+struct HostHttpServer
+{
+    std::mutex lock;
+    std::function<int(const HostHttpRequest &, String &)> handler;
+    uint32_t connectUs = 0; ///< 新建连接的耗时（TCP 握手）
+    uint32_t latencyUs = 0; ///< 每个请求的往返耗时
+    bool keepAlive = true;  ///< 服务端是否保持连接
+    bool keepBodies = true; ///< 是否保存请求体
+
+    std::atomic<uint32_t> requests{0};
+    std::atomic<uint32_t> opened{0};
+    std::atomic<uint32_t> reused{0};
+    std::atomic<uint32_t> staleFailures{0};
+    std::atomic<uint64_t> bodyBytes{0};
+    std::atomic<uint64_t> firstByteUsTotal{0};
+    std::vector<HostHttpRequest> log; ///< 全部请求（受 lock 保护）
+
+    std::map<const WiFiClient *, uint32_t> connections; ///< 连接 -> 建立时的代数
+    uint32_t generation = 0;
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        handler = nullptr;
+        connectUs = latencyUs = 0;
+        keepAlive = keepBodies = true;
+        requests = opened = reused = staleFailures = 0;
+        bodyBytes = firstByteUsTotal = 0;
+        log.clear();
+        connections.clear();
+        generation++;
+    }
+};
+
+inline HostHttpServer hostHttp;
+
+/**
+ * ### 关闭空闲长连接
+ *
+ * 之后复用旧连接的第一个请求会以 HTTPC_ERROR_CONNECTION_LOST 失败，与服务端超时断开长连接时一致。
+ */
+inline void hostHttpCloseIdle()
+{
+    std::lock_guard<std::mutex> guard(hostHttp.lock);
+    hostHttp.generation++;
+}
+
+class HTTPClient
+{
+public:
+    HTTPClient() {}
+    virtual ~HTTPClient() {}
+
+    bool begin(WiFiClient &client, const String &url)
+    {
+        this->client = &client;
+        this->url = url;
+        headers.clear();
+        response = String();
+        return true;
+    }
+    bool begin(const String &url)
+    {
+        return begin(ownClient, url);
+    }
+    void end()
+    {
+        if (client && !(reuse && hostHttp.keepAlive))
+        {
+            client->stop();
+        }
+        headers.clear();
+    }
+    void setReuse(bool reuse) { this->reuse = reuse; }
+    void setTimeout(uint16_t) {}
+    void setConnectTimeout(int32_t) {}
+    void addHeader(const String &name, const String &value) { headers.push_back(std::make_pair(name, value)); }
+
+    int sendRequest(const char *type, Stream *stream, size_t size = 0)
+    {
+        HostHttpRequest request;
+        request.method = type;
+        uint32_t startUs = micros();
+        int code = connect(request);
+        if (code < 0)
+        {
+            return code;
+        }
+        char buffer[HTTP_TCP_BUFFER_SIZE];
+        size_t received = 0;
+        while (stream && received < size)
+        {
+            size_t chunk = stream->readBytes(buffer, min(sizeof(buffer), size - received));
+            if (chunk == 0)
+            {
+                break;
+            }
+            if (received == 0)
+            {
+                request.firstByteAt = micros();
+                request.firstByteUs = request.firstByteAt - startUs;
+            }
+            if (hostHttp.keepBodies)
+            {
+                request.body.append(buffer, chunk);
+            }
+            received += chunk;
+        }
+        if (received != size)
+        {
+            client->stop();
+            return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        }
+        request.bodyLength = received;
+        return respond(request);
+    }
+    int sendRequest(const char *type, const uint8_t *payload, size_t size)
+    {
+        HostHttpRequest request;
+        request.method = type;
+        uint32_t startUs = micros();
+        int code = connect(request);
+        if (code < 0)
+        {
+            return code;
+        }
+        request.firstByteAt = micros();
+        request.firstByteUs = request.firstByteAt - startUs;
+        if (hostHttp.keepBodies && payload)
+        {
+            request.body.assign((const char *)payload, size);
+        }
+        request.bodyLength = size;
+        return respond(request);
+    }
+    int sendRequest(const char *type, const String &payload = String())
+    {
+        return sendRequest(type, (const uint8_t *)payload.c_str(), payload.length());
+    }
+    int GET() { return sendRequest("GET"); }
+    int POST(const String &payload) { return sendRequest("POST", payload); }
+    int POST(const uint8_t *payload, size_t size) { return sendRequest("POST", payload, size); }
+    int PUT(const String &payload) { return sendRequest("PUT", payload); }
+    int PUT(const uint8_t *payload, size_t size) { return sendRequest("PUT", payload, size); }
+
+    String getString() { return response; }
+    int getSize() { return (int)response.length(); }
+    bool connected() { return client && client->connected(); }
+
+private:
+    WiFiClient ownClient;
+    WiFiClient *client = nullptr;
+    String url;
+    String response;
+    std::vector<std::pair<String, String>> headers;
+    bool reuse = false;
+
+    int connect(HostHttpRequest &request)
+    {
+        request.url = url;
+        request.headers = headers;
+        request.firstByteUs = request.firstByteAt = 0;
+        response = String();
+        if (client->connected())
+        {
+            bool stale;
+            {
+                std::lock_guard<std::mutex> guard(hostHttp.lock);
+                auto it = hostHttp.connections.find(client);
+                stale = it == hostHttp.connections.end() || it->second != hostHttp.generation;
+            }
+            if (stale)
+            {
+                hostHttp.staleFailures++;
+                client->stop();
+                return HTTPC_ERROR_CONNECTION_LOST;
+            }
+            request.reused = true;
+            hostHttp.reused++;
+            return 0;
+        }
+        if (!client->connect("host", 80))
+        {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        if (hostHttp.connectUs)
+        {
+            delayMicroseconds(hostHttp.connectUs);
+        }
+        {
+            std::lock_guard<std::mutex> guard(hostHttp.lock);
+            hostHttp.connections[client] = hostHttp.generation;
+        }
+        request.reused = false;
+        hostHttp.opened++;
+        return 0;
+    }
+
+    int respond(HostHttpRequest &request)
+    {
+        if (hostHttp.latencyUs)
+        {
+            delayMicroseconds(hostHttp.latencyUs);
+        }
+        hostHttp.requests++;
+        hostHttp.bodyBytes += request.bodyLength;
+        hostHttp.firstByteUsTotal += request.firstByteUs;
+        int code;
+        {
+            std::lock_guard<std::mutex> guard(hostHttp.lock);
+            code = hostHttp.handler ? hostHttp.handler(request, response) : HTTP_CODE_OK;
+            hostHttp.log.push_back(std::move(request));
+            if (!hostHttp.keepBodies)
+            {
+                hostHttp.log.back().body.clear();
+            }
+        }
+        if (code < 0 || !hostHttp.keepAlive)
+        {
+            client->stop();
+        }
+        return code;
+    }
+};
+
+#endif // HOST_HTTP_CLIENT_H
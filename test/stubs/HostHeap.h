@@ -0,0 +1,91 @@
+/**
+ * @file HostHeap.h
+ * @brief 主机测试用的堆统计：替换全局 operator new/delete，记录当前占用、峰值与分配次数。
+ *
+ * 替换函数不能是 inline，因此本头文件只能由测试文件包含一次。
+ * 只统计 C++ 分配（String、new[] 等），malloc 直接分配的内存不计入。
+ */
+
+#ifndef HOST_HEAP_H
+#define HOST_HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+struct HostHeap
+{
+    std::atomic<int64_t> inUse{0};        ///< 当前占用字节数
+    std::atomic<int64_t> peak{0};         ///< 自上次 resetPeak() 以来的最大占用
+    std::atomic<uint64_t> allocations{0}; ///< 累计分配次数
+
+    /**
+     * ### 以当前占用作为新的峰值起点
+     *
+     * #### 返回
+     *
+     * - int64_t：当前占用，调用方用 `peak - 返回值` 得到区间内的峰值增量
+     */
+    int64_t resetPeak()
+    {
+        int64_t now = inUse.load();
+        peak = now;
+        return now;
+    }
+};
+
+static HostHeap hostHeap;
+
+static constexpr size_t HOST_HEAP_HEADER = alignof(std::max_align_t);
+
+static void *hostHeapAllocate(size_t size)
+{
+    uint8_t *raw = (uint8_t *)malloc(size + HOST_HEAP_HEADER);
+    if (!raw)
+    {
+        return nullptr;
+    }
+    *(size_t *)raw = size;
+    int64_t now = hostHeap.inUse += (int64_t)size;
+    int64_t peak = hostHeap.peak.load();
+    while (now > peak && !hostHeap.peak.compare_exchange_weak(peak, now))
+    {
+    }
+    hostHeap.allocations++;
+    return raw + HOST_HEAP_HEADER;
+}
+
+static void hostHeapRelease(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    uint8_t *raw = (uint8_t *)ptr - HOST_HEAP_HEADER;
+    hostHeap.inUse -= (int64_t)*(size_t *)raw;
+    free(raw);
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = hostHeapAllocate(size);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return hostHeapAllocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return hostHeapAllocate(size); }
+void operator delete(void *ptr) noexcept { hostHeapRelease(ptr); }
+void operator delete[](void *ptr) noexcept { hostHeapRelease(ptr); }
+void operator delete(void *ptr, size_t) noexcept { hostHeapRelease(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { hostHeapRelease(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { hostHeapRelease(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { hostHeapRelease(ptr); }
+
+#endif // HOST_HEAP_H
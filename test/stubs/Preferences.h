@@ -0,0 +1,96 @@
+/**
+ * @file Preferences.h
+ * @brief 主机测试用的 NVS 替身，数据保存在内存中，并统计写入次数。
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+struct HostNvs
+{
+    std::map<std::string, std::vector<uint8_t>> entries; ///< "命名空间/键" -> 值
+    uint32_t writes = 0;                                 ///< put 与 remove 的次数
+};
+
+inline HostNvs hostNvs;
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false)
+    {
+        space = name;
+        this->readOnly = readOnly;
+        return true;
+    }
+    void end() {}
+
+    size_t putBytes(const char *key, const void *value, size_t length)
+    {
+        if (readOnly)
+        {
+            return 0;
+        }
+        hostNvs.writes++;
+        hostNvs.entries[path(key)].assign((const uint8_t *)value, (const uint8_t *)value + length);
+        return length;
+    }
+    size_t getBytes(const char *key, void *buffer, size_t maxLength)
+    {
+        auto it = hostNvs.entries.find(path(key));
+        if (it == hostNvs.entries.end() || it->second.size() > maxLength)
+        {
+            return 0;
+        }
+        memcpy(buffer, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+    size_t getBytesLength(const char *key)
+    {
+        auto it = hostNvs.entries.find(path(key));
+        return it == hostNvs.entries.end() ? 0 : it->second.size();
+    }
+    size_t putString(const char *key, const String &value) { return putBytes(key, value.c_str(), value.length()); }
+    String getString(const char *key, const String &defaultValue = String())
+    {
+        auto it = hostNvs.entries.find(path(key));
+        if (it == hostNvs.entries.end())
+        {
+            return defaultValue;
+        }
+        return String((const char *)it->second.data(), it->second.size());
+    }
+    bool isKey(const char *key) { return hostNvs.entries.count(path(key)) != 0; }
+    bool remove(const char *key)
+    {
+        if (readOnly)
+        {
+            return false;
+        }
+        hostNvs.writes++;
+        return hostNvs.entries.erase(path(key)) != 0;
+    }
+    bool clear()
+    {
+        std::string prefix = space + "/";
+        for (auto it = hostNvs.entries.begin(); it != hostNvs.entries.end();)
+        {
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? hostNvs.entries.erase(it) : std::next(it);
+        }
+        return true;
+    }
+
+private:
+    std::string space;
+    bool readOnly = false;
+
+    std::string path(const char *key) const { return space + "/" + key; }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,255 @@
+/**
+ * @file PubSubClient.h
+ * @brief 主机测试用的 MQTT 客户端替身，背后是进程内的代理替身 hostBroker。
+ *
+ * 代理替身记录每一条发布，可以按比例丢包（发布成功但代理收不到）或让发布直接失败，
+ * 也可以通过 respond 回调或 hostBrokerDeliver() 给客户端下发消息，在下一次 loop() 中投递。
+ */
+
+#ifndef HOST_PUB_SUB_CLIENT_H
+#define HOST_PUB_SUB_CLIENT_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include "IPAddress.h"
+#include "WiFiClient.h"
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+struct HostMqttMessage
+{
+    std::string topic;
+    std::string payload;
+};
+
+/**
+ * ### MQTT 代理替身
+ */
+struct HostBroker
+{
+    std::recursive_mutex lock;
+    bool online = true;              ///< 代理是否可连
+    int refuseState = MQTT_CONNECTED; ///< 非 0 时 connect() 以该状态失败
+    bool connected = false;
+    uint32_t connects = 0;
+    uint32_t dropEvery = 0; ///< 每 N 条发布丢一条（0 表示不丢）
+    bool failPublish = false; ///< 发布直接返回失败
+    uint32_t attempts = 0;    ///< 客户端调用 publish() 的次数
+    uint32_t dropped = 0;
+    std::vector<HostMqttMessage> received; ///< 代理实际收到的发布
+    std::vector<std::string> subscriptions;
+    std::deque<HostMqttMessage> outbound; ///< 等待投递给客户端的消息
+    std::function<void(const HostMqttMessage &)> respond;
+
+    void reset()
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        online = true;
+        refuseState = MQTT_CONNECTED;
+        connected = false;
+        connects = attempts = dropped = dropEvery = 0;
+        failPublish = false;
+        received.clear();
+        subscriptions.clear();
+        outbound.clear();
+        respond = nullptr;
+    }
+};
+
+inline HostBroker hostBroker;
+
+inline void hostBrokerDeliver(const std::string &topic, const std::string &payload)
+{
+    std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+    hostBroker.outbound.push_back({topic, payload});
+}
+
+/**
+ * ### 断开会话
+ *
+ * 模拟网络中断，客户端下一次 connected() 返回 false。
+ */
+inline void hostBrokerDisconnect()
+{
+    std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+    hostBroker.connected = false;
+}
+
+class PubSubClient
+{
+public:
+    typedef void (*callback_t)(char *, uint8_t *, unsigned int);
+
+    PubSubClient() {}
+    explicit PubSubClient(WiFiClient &client) : client(&client) {}
+
+    PubSubClient &setServer(const char *, uint16_t) { return *this; }
+    PubSubClient &setServer(IPAddress, uint16_t) { return *this; }
+    PubSubClient &setClient(WiFiClient &client)
+    {
+        this->client = &client;
+        return *this;
+    }
+    PubSubClient &setCallback(callback_t callback)
+    {
+        this->callback = callback;
+        return *this;
+    }
+    bool setBufferSize(uint16_t size)
+    {
+        bufferSize = size;
+        return true;
+    }
+    uint16_t getBufferSize() { return bufferSize; }
+    PubSubClient &setKeepAlive(uint16_t) { return *this; }
+    PubSubClient &setSocketTimeout(uint16_t) { return *this; }
+
+    bool connect(const char *, const char * = nullptr, const char * = nullptr)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+        if (!hostBroker.online)
+        {
+            lastState = MQTT_CONNECT_FAILED;
+            return false;
+        }
+        if (hostBroker.refuseState != MQTT_CONNECTED)
+        {
+            lastState = hostBroker.refuseState;
+            return false;
+        }
+        hostBroker.connected = true;
+        hostBroker.connects++;
+        lastState = MQTT_CONNECTED;
+        return true;
+    }
+    void disconnect()
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+        hostBroker.connected = false;
+        lastState = MQTT_DISCONNECTED;
+    }
+    bool connected()
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+        if (!hostBroker.connected && lastState == MQTT_CONNECTED)
+        {
+            lastState = MQTT_CONNECTION_LOST;
+        }
+        return hostBroker.connected;
+    }
+    int state() { return lastState; }
+
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool = false)
+    {
+        HostMqttMessage message{topic, std::string((const char *)payload, length)};
+        std::function<void(const HostMqttMessage &)> respond;
+        {
+            std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+            hostBroker.attempts++;
+            if (!hostBroker.connected || hostBroker.failPublish || message.topic.size() + length + 7 > bufferSize)
+            {
+                return false;
+            }
+            if (hostBroker.dropEvery && hostBroker.attempts % hostBroker.dropEvery == 0)
+            {
+                hostBroker.dropped++;
+                return true;
+            }
+            hostBroker.received.push_back(message);
+            respond = hostBroker.respond;
+        }
+        if (respond)
+        {
+            respond(message);
+        }
+        return true;
+    }
+    bool publish(const char *topic, const char *payload, bool retained = false)
+    {
+        return publish(topic, (const uint8_t *)payload, payload ? strlen(payload) : 0, retained);
+    }
+
+    bool subscribe(const char *topic, uint8_t = 0)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+        if (!hostBroker.connected)
+        {
+            return false;
+        }
+        hostBroker.subscriptions.push_back(topic);
+        return true;
+    }
+    bool unsubscribe(const char *topic)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+        auto &subs = hostBroker.subscriptions;
+        for (auto it = subs.begin(); it != subs.end(); ++it)
+        {
+            if (*it == topic)
+            {
+                subs.erase(it);
+                return true;
+            }
+        }
+        return hostBroker.connected;
+    }
+
+    /**
+     * ### 处理下行消息
+     *
+     * 把代理替身中排队的消息逐条交给回调。
+     */
+    bool loop()
+    {
+        while (true)
+        {
+            HostMqttMessage message;
+            {
+                std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+                if (!hostBroker.connected)
+                {
+                    return false;
+                }
+                if (hostBroker.outbound.empty())
+                {
+                    return true;
+                }
+                message = std::move(hostBroker.outbound.front());
+                hostBroker.outbound.pop_front();
+            }
+            if (callback)
+            {
+                std::vector<char> topic(message.topic.begin(), message.topic.end());
+                topic.push_back(0);
+                std::vector<uint8_t> payload(message.payload.begin(), message.payload.end());
+                payload.push_back(0);
+                callback(topic.data(), payload.data(), (unsigned int)message.payload.size());
+            }
+        }
+    }
+
+private:
+    WiFiClient *client = nullptr;
+    callback_t callback = nullptr;
+    uint16_t bufferSize = MQTT_MAX_PACKET_SIZE;
+    int lastState = MQTT_DISCONNECTED;
+};
+
+#endif // HOST_PUB_SUB_CLIENT_H
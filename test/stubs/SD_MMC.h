@@ -0,0 +1,74 @@
+/**
+ * @file SD_MMC.h
+ * @brief 主机测试用的 SD 卡替身，卡的内容放在一个临时目录中。
+ */
+
+#ifndef HOST_SD_MMC_H
+#define HOST_SD_MMC_H
+
+#include <ftw.h>
+#include <stdlib.h>
+
+#include "FS.h"
+
+typedef enum
+{
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN,
+} sdcard_type_t;
+
+class SDMMCFS : public fs::FS
+{
+public:
+    bool present = true;                           ///< 置为 false 模拟没插卡
+    uint64_t capacity = 4ULL * 1024 * 1024 * 1024; ///< totalBytes() 的返回值
+
+    bool begin(const char * = "/sdcard", bool = false, bool = false, int = 0, uint8_t = 5)
+    {
+        if (root.empty())
+        {
+            char pattern[] = "/tmp/sdmmc-XXXXXX";
+            const char *dir = mkdtemp(pattern);
+            root = dir ? dir : "/tmp";
+        }
+        return present;
+    }
+    sdcard_type_t cardType() const { return present ? CARD_SDHC : CARD_NONE; }
+    uint64_t totalBytes() const { return capacity; }
+    uint64_t usedBytes() const
+    {
+        hostUsed = 0;
+        nftw(root.c_str(), [](const char *, const struct stat *st, int type, struct FTW *)
+             {
+                 if (type == FTW_F)
+                 {
+                     hostUsed += st->st_size;
+                 }
+                 return 0; }, 16, FTW_PHYS);
+        return hostUsed;
+    }
+
+    /**
+     * ### 清空卡
+     *
+     * 删除临时目录下的全部内容，供测试之间复位。
+     */
+    void hostWipe()
+    {
+        if (!root.empty())
+        {
+            nftw(root.c_str(), [](const char *path, const struct stat *, int, struct FTW *ftw)
+                 { return ftw->level == 0 ? 0 : ::remove(path); }, 16, FTW_DEPTH | FTW_PHYS);
+        }
+    }
+
+private:
+    static inline uint64_t hostUsed = 0;
+};
+
+inline SDMMCFS SD_MMC;
+
+#endif // HOST_SD_MMC_H
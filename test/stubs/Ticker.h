@@ -0,0 +1,70 @@
+/**
+ * @file Ticker.h
+ * @brief 主机测试用的 Ticker 替身，每次启动定时器都由一个独立线程计时。
+ *
+ * 计时以 millis() 为准，hostAdvanceMillis() 拨快时钟后定时器随之提前到期。
+ */
+
+#ifndef HOST_TICKER_H
+#define HOST_TICKER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <Arduino.h>
+
+class Ticker
+{
+public:
+    typedef void (*callback_t)();
+
+    ~Ticker() { detach(); }
+
+    void attach(float seconds, callback_t callback) { arm((uint32_t)(seconds * 1000), callback, true); }
+    void attach_ms(uint32_t milliseconds, callback_t callback) { arm(milliseconds, callback, true); }
+    void once(float seconds, callback_t callback) { arm((uint32_t)(seconds * 1000), callback, false); }
+    void once_ms(uint32_t milliseconds, callback_t callback) { arm(milliseconds, callback, false); }
+
+    void detach()
+    {
+        if (generation)
+        {
+            generation->fetch_add(1);
+            generation.reset();
+        }
+    }
+
+    bool active() const { return (bool)generation; }
+
+private:
+    std::shared_ptr<std::atomic<uint32_t>> generation;
+
+    void arm(uint32_t periodMs, callback_t callback, bool repeat)
+    {
+        detach();
+        generation = std::make_shared<std::atomic<uint32_t>>(0);
+        std::shared_ptr<std::atomic<uint32_t>> current = generation;
+        // 起点在启动线程之前取，线程晚于 hostAdvanceMillis() 运行也不会错过拨快的时间
+        uint32_t startMs = millis();
+        std::thread([current, startMs, periodMs, callback, repeat]() mutable
+                    {
+                        do
+                        {
+                            while (millis() - startMs < periodMs && current->load() == 0)
+                            {
+                                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                            }
+                            startMs += periodMs;
+                            if (current->load() != 0)
+                            {
+                                return;
+                            }
+                            callback();
+                        } while (repeat); })
+            .detach();
+    }
+};
+
+#endif // HOST_TICKER_H
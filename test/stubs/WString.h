@@ -0,0 +1,308 @@
+/**
+ * @file WString.h
+ * @brief 主机测试用的 Arduino String，以 std::string 存储，只实现固件用到的接口。
+ */
+
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+
+class String
+{
+public:
+    String() {}
+    String(const char *cstr) : s(cstr ? cstr : "") {}
+    String(const char *cstr, size_t length) : s(cstr ? std::string(cstr, length) : std::string()) {}
+    String(const uint8_t *cstr, size_t length) : s(cstr ? std::string((const char *)cstr, length) : std::string()) {}
+    String(const std::string &str) : s(str) {}
+    String(const String &other) = default;
+    String(String &&other) noexcept = default;
+    explicit String(char c) : s(1, c) {}
+    explicit String(unsigned char value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(int value, unsigned char base = 10) { fromSigned(value, base); }
+    explicit String(unsigned int value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(long value, unsigned char base = 10) { fromSigned(value, base); }
+    explicit String(unsigned long value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(long long value, unsigned char base = 10) { fromSigned(value, base); }
+    explicit String(unsigned long long value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(float value, unsigned int decimals = 2) { fromDouble(value, decimals); }
+    explicit String(double value, unsigned int decimals = 2) { fromDouble(value, decimals); }
+
+    String &operator=(const String &other) = default;
+    String &operator=(String &&other) noexcept = default;
+    String &operator=(const char *cstr)
+    {
+        s = cstr ? cstr : "";
+        return *this;
+    }
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return (unsigned int)s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(unsigned int size)
+    {
+        s.reserve(size);
+        return true;
+    }
+
+    bool concat(const String &other)
+    {
+        s += other.s;
+        return true;
+    }
+    bool concat(const char *cstr)
+    {
+        if (!cstr)
+        {
+            return false;
+        }
+        s += cstr;
+        return true;
+    }
+    bool concat(const char *cstr, unsigned int length)
+    {
+        if (!cstr)
+        {
+            return false;
+        }
+        s.append(cstr, length);
+        return true;
+    }
+    bool concat(char c)
+    {
+        s += c;
+        return true;
+    }
+    template <typename T>
+    bool concat(T value)
+    {
+        return concat(String(value));
+    }
+
+    String &operator+=(const String &other)
+    {
+        concat(other);
+        return *this;
+    }
+    String &operator+=(const char *cstr)
+    {
+        concat(cstr);
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        concat(c);
+        return *this;
+    }
+    template <typename T>
+    String &operator+=(T value)
+    {
+        concat(String(value));
+        return *this;
+    }
+
+    bool equals(const String &other) const { return s == other.s; }
+    bool equals(const char *cstr) const { return s == (cstr ? cstr : ""); }
+    bool operator==(const String &other) const { return equals(other); }
+    bool operator==(const char *cstr) const { return equals(cstr); }
+    bool operator!=(const String &other) const { return !equals(other); }
+    bool operator!=(const char *cstr) const { return !equals(cstr); }
+    bool operator<(const String &other) const { return s < other.s; }
+    int compareTo(const String &other) const { return s.compare(other.s); }
+
+    char charAt(unsigned int index) const { return index < s.size() ? s[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index) { return s[index]; }
+    void setCharAt(unsigned int index, char c)
+    {
+        if (index < s.size())
+        {
+            s[index] = c;
+        }
+    }
+
+    bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return position(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return position(s.rfind(c)); }
+    int lastIndexOf(const String &str) const { return position(s.rfind(str.s)); }
+    String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to)
+        {
+            unsigned int t = from;
+            from = to;
+            to = t;
+        }
+        if (from >= s.size())
+        {
+            return String();
+        }
+        return String(s.substr(from, to - from));
+    }
+    void remove(unsigned int index) { remove(index, (unsigned int)-1); }
+    void remove(unsigned int index, unsigned int count)
+    {
+        if (index < s.size())
+        {
+            s.erase(index, count);
+        }
+    }
+    void replace(const String &find, const String &replacement)
+    {
+        if (find.s.empty())
+        {
+            return;
+        }
+        size_t pos = 0;
+        while ((pos = s.find(find.s, pos)) != std::string::npos)
+        {
+            s.replace(pos, find.s.size(), replacement.s);
+            pos += replacement.s.size();
+        }
+    }
+    void replace(char find, char replacement)
+    {
+        for (char &c : s)
+        {
+            if (c == find)
+            {
+                c = replacement;
+            }
+        }
+    }
+    void trim()
+    {
+        size_t begin = s.find_first_not_of(" \t\r\n");
+        size_t end = s.find_last_not_of(" \t\r\n");
+        s = begin == std::string::npos ? std::string() : s.substr(begin, end - begin + 1);
+    }
+    void toLowerCase()
+    {
+        for (char &c : s)
+        {
+            c = tolower((unsigned char)c);
+        }
+    }
+    void toUpperCase()
+    {
+        for (char &c : s)
+        {
+            c = toupper((unsigned char)c);
+        }
+    }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return (float)atof(s.c_str()); }
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const
+    {
+        if (!buf || bufsize == 0)
+        {
+            return;
+        }
+        size_t n = index < s.size() ? s.size() - index : 0;
+        if (n > bufsize - 1)
+        {
+            n = bufsize - 1;
+        }
+        memcpy(buf, s.data() + (index < s.size() ? index : 0), n);
+        buf[n] = 0;
+    }
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const
+    {
+        getBytes((unsigned char *)buf, bufsize, index);
+    }
+
+private:
+    std::string s;
+
+    static int position(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    void fromUnsigned(unsigned long long value, unsigned char base)
+    {
+        char buf[72];
+        char *p = buf + sizeof(buf) - 1;
+        *p = 0;
+        do
+        {
+            unsigned digit = value % base;
+            *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+            value /= base;
+        } while (value);
+        s = p;
+    }
+    void fromSigned(long long value, unsigned char base)
+    {
+        if (value < 0 && base == 10)
+        {
+            fromUnsigned(0ULL - (unsigned long long)value, base);
+            s.insert(s.begin(), '-');
+            return;
+        }
+        fromUnsigned((unsigned long long)value, base);
+    }
+    void fromDouble(double value, unsigned int decimals)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", (int)decimals, value);
+        s = buf;
+    }
+};
+
+/**
+ * ### 拼接结果
+ *
+ * Arduino 中 `+` 返回 StringSumHelper，ArduinoJson 也按这个类型名适配。
+ */
+class StringSumHelper : public String
+{
+public:
+    StringSumHelper(const String &s) : String(s) {}
+    StringSumHelper(const char *p) : String(p) {}
+};
+
+inline StringSumHelper operator+(const String &lhs, const String &rhs)
+{
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+inline StringSumHelper operator+(const String &lhs, const char *rhs)
+{
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+inline StringSumHelper operator+(const char *lhs, const String &rhs)
+{
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+inline StringSumHelper operator+(const String &lhs, char rhs)
+{
+    StringSumHelper sum(lhs);
+    sum.concat(rhs);
+    return sum;
+}
+template <typename T>
+inline StringSumHelper operator+(const String &lhs, T rhs)
+{
+    StringSumHelper sum(lhs);
+    sum.concat(String(rhs));
+    return sum;
+}
+inline bool operator==(const char *lhs, const String &rhs) { return rhs == lhs; }
+inline bool operator!=(const char *lhs, const String &rhs) { return rhs != lhs; }
+
+#endif // HOST_WSTRING_H
@@ -0,0 +1,269 @@
+/**
+ * @file WiFi.h
+ * @brief 主机测试用的 WiFi 替身。
+ *
+ * 不会自己连上网络：测试调用 hostWiFiLinkUp()/hostWiFiLinkDown() 改变链路状态并触发事件，
+ * 用 hostWiFi.scan 预置扫描结果，并从 hostWiFi 读取固件发起的 begin()/config() 参数。
+ */
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+#include <mutex>
+#include <vector>
+#include "IPAddress.h"
+#include "WiFiClient.h"
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_OFF,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA,
+} wifi_mode_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum
+{
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_STA_START = 2,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP = 9,
+    ARDUINO_EVENT_MAX = 64,
+} arduino_event_id_t;
+
+typedef struct
+{
+    uint8_t reason;
+} arduino_event_info_t;
+
+typedef void (*WiFiEventCb)(arduino_event_id_t event, arduino_event_info_t info);
+
+struct HostAccessPoint
+{
+    String ssid;
+    uint8_t bssid[6];
+    int32_t channel;
+    int32_t rssi;
+};
+
+/**
+ * ### 无线环境
+ *
+ * 记录链路状态、扫描结果与固件最近一次 begin()/config() 的参数。
+ */
+struct HostWiFi
+{
+    std::recursive_mutex lock;
+    std::vector<WiFiEventCb> callbacks;
+
+    // 链路
+    bool connected = false;
+    String ssid;
+    uint8_t bssid[6] = {0};
+    int32_t channel = 0;
+    int32_t rssi = -100;
+    IPAddress ip, gateway, subnet, dns;
+
+    // 扫描
+    std::vector<HostAccessPoint> scan;
+    bool scanFails = false;
+    bool scanRunning = false;
+    bool scanStarted = false;
+    uint32_t scans = 0;
+
+    // 固件发起的操作
+    uint32_t begins = 0;
+    String lastSsid;
+    int32_t lastChannel = 0;
+    bool lastHadBssid = false;
+    uint8_t lastBssid[6] = {0};
+    bool staticConfig = false;
+    IPAddress lastIp;
+    uint32_t disconnects = 0;
+
+    // DNS
+    bool dnsFails = false;
+    uint32_t lookups = 0;
+};
+
+inline HostWiFi hostWiFi;
+
+inline void hostWiFiRaise(arduino_event_id_t event)
+{
+    std::vector<WiFiEventCb> callbacks;
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        callbacks = hostWiFi.callbacks;
+    }
+    arduino_event_info_t info = {0};
+    for (WiFiEventCb callback : callbacks)
+    {
+        callback(event, info);
+    }
+}
+
+/**
+ * ### 连上接入点
+ *
+ * 设置当前链路并触发 GOT_IP 事件。地址沿用 config() 给出的静态地址，否则模拟 DHCP 分配。
+ */
+inline void hostWiFiLinkUp(const HostAccessPoint &ap, IPAddress dhcpIp = IPAddress(192, 168, 0, 100))
+{
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        hostWiFi.connected = true;
+        hostWiFi.ssid = ap.ssid;
+        memcpy(hostWiFi.bssid, ap.bssid, 6);
+        hostWiFi.channel = ap.channel;
+        hostWiFi.rssi = ap.rssi;
+        if (!hostWiFi.staticConfig)
+        {
+            hostWiFi.ip = dhcpIp;
+            hostWiFi.gateway = IPAddress(192, 168, 0, 1);
+            hostWiFi.subnet = IPAddress(255, 255, 255, 0);
+            hostWiFi.dns = IPAddress(192, 168, 0, 1);
+        }
+    }
+    hostWiFiRaise(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+}
+
+inline void hostWiFiLinkDown()
+{
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        hostWiFi.connected = false;
+    }
+    hostWiFiRaise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+}
+
+class WiFiClass
+{
+public:
+    wl_status_t status() { return hostWiFi.connected ? WL_CONNECTED : WL_DISCONNECTED; }
+    bool isConnected() { return hostWiFi.connected; }
+    bool mode(wifi_mode_t) { return true; }
+    void persistent(bool) {}
+    bool setAutoReconnect(bool) { return true; }
+    int onEvent(WiFiEventCb callback, arduino_event_id_t = ARDUINO_EVENT_MAX)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        hostWiFi.callbacks.push_back(callback);
+        return (int)hostWiFi.callbacks.size();
+    }
+
+    wl_status_t begin(const char *ssid, const char * = nullptr, int32_t channel = 0, const uint8_t *bssid = nullptr, bool = true)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        hostWiFi.begins++;
+        hostWiFi.lastSsid = ssid;
+        hostWiFi.lastChannel = channel;
+        hostWiFi.lastHadBssid = bssid != nullptr;
+        if (bssid)
+        {
+            memcpy(hostWiFi.lastBssid, bssid, 6);
+        }
+        return WL_DISCONNECTED;
+    }
+
+    bool config(IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns = INADDR_NONE)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        hostWiFi.staticConfig = ip != INADDR_NONE;
+        hostWiFi.lastIp = ip;
+        if (hostWiFi.staticConfig)
+        {
+            hostWiFi.ip = ip;
+            hostWiFi.gateway = gateway;
+            hostWiFi.subnet = subnet;
+            hostWiFi.dns = dns;
+        }
+        return true;
+    }
+
+    bool disconnect(bool = false, bool = false)
+    {
+        bool wasConnected;
+        {
+            std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+            hostWiFi.disconnects++;
+            wasConnected = hostWiFi.connected;
+            hostWiFi.connected = false;
+        }
+        if (wasConnected)
+        {
+            hostWiFiRaise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+        }
+        return true;
+    }
+
+    String SSID() { return hostWiFi.ssid; }
+    uint8_t *BSSID() { return hostWiFi.bssid; }
+    int32_t channel() { return hostWiFi.channel; }
+    int8_t RSSI() { return (int8_t)hostWiFi.rssi; }
+    IPAddress localIP() { return hostWiFi.ip; }
+    IPAddress gatewayIP() { return hostWiFi.gateway; }
+    IPAddress subnetMask() { return hostWiFi.subnet; }
+    IPAddress dnsIP(uint8_t = 0) { return hostWiFi.dns; }
+
+    int hostByName(const char *, IPAddress &result)
+    {
+        hostWiFi.lookups++;
+        if (hostWiFi.dnsFails)
+        {
+            return 0;
+        }
+        result = IPAddress(10, 0, 0, 1);
+        return 1;
+    }
+
+    int16_t scanNetworks(bool async = false, bool = false, bool = false, uint32_t = 300, uint8_t = 0)
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        if (hostWiFi.scanFails)
+        {
+            return WIFI_SCAN_FAILED;
+        }
+        hostWiFi.scans++;
+        hostWiFi.scanStarted = true;
+        return async ? WIFI_SCAN_RUNNING : (int16_t)hostWiFi.scan.size();
+    }
+    int16_t scanComplete()
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        if (!hostWiFi.scanStarted)
+        {
+            return WIFI_SCAN_FAILED;
+        }
+        return hostWiFi.scanRunning ? WIFI_SCAN_RUNNING : (int16_t)hostWiFi.scan.size();
+    }
+    void scanDelete()
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+        hostWiFi.scanStarted = false;
+    }
+    String SSID(uint8_t i) { return i < hostWiFi.scan.size() ? hostWiFi.scan[i].ssid : String(); }
+    uint8_t *BSSID(uint8_t i) { return i < hostWiFi.scan.size() ? hostWiFi.scan[i].bssid : nullptr; }
+    int32_t channel(uint8_t i) { return i < hostWiFi.scan.size() ? hostWiFi.scan[i].channel : 0; }
+    int32_t RSSI(uint8_t i) { return i < hostWiFi.scan.size() ? hostWiFi.scan[i].rssi : 0; }
+};
+
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
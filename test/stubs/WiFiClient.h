@@ -0,0 +1,52 @@
+/**
+ * @file WiFiClient.h
+ * @brief 主机测试用的 TCP 客户端替身，只记录连接是否成功。
+ */
+
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+struct HostNetwork
+{
+    std::atomic<bool> reachable{true};  ///< TCP 连接能否建立
+    std::atomic<uint32_t> connects{0};  ///< 建立过的连接数
+};
+
+inline HostNetwork hostNetwork;
+
+class WiFiClient : public Stream
+{
+public:
+    int connect(IPAddress, uint16_t, int32_t = 0) { return open(); }
+    int connect(const char *, uint16_t, int32_t = 0) { return open(); }
+    uint8_t connected() { return isOpen && hostNetwork.reachable; }
+    void stop() { isOpen = false; }
+    void setTimeout(uint32_t) {}
+    void setNoDelay(bool) {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t) override { return isOpen ? 1 : 0; }
+    size_t write(const uint8_t *, size_t size) override { return isOpen ? size : 0; }
+    using Print::write;
+    operator bool() { return connected(); }
+
+private:
+    bool isOpen = false;
+
+    int open()
+    {
+        isOpen = hostNetwork.reachable;
+        if (isOpen)
+        {
+            hostNetwork.connects++;
+        }
+        return isOpen;
+    }
+};
+
+#endif // HOST_WIFI_CLIENT_H
@@ -0,0 +1,26 @@
+/**
+ * @file crc.h
+ * @brief 主机测试替身：ROM 中的 CRC32（小端，多项式 0xEDB88320，入口与出口取反）。
+ */
+
+#ifndef HOST_ESP32_ROM_CRC_H
+#define HOST_ESP32_ROM_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+inline uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#endif // HOST_ESP32_ROM_CRC_H
@@ -0,0 +1,234 @@
+/**
+ * @file esp_camera.h
+ * @brief 主机测试用的相机驱动替身。
+ *
+ * 与真实驱动一样只有 fb_count 块帧缓冲区：全部被占用时 esp_camera_fb_get()
+ * 会阻塞直到有缓冲区归还，超过 hostCamera.timeoutMs 后返回空指针。
+ */
+
+#ifndef HOST_ESP_CAMERA_H
+#define HOST_ESP_CAMERA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <Arduino.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum
+{
+    PIXFORMAT_RGB565,
+    PIXFORMAT_YUV422,
+    PIXFORMAT_GRAYSCALE,
+    PIXFORMAT_JPEG,
+} pixformat_t;
+
+typedef enum
+{
+    FRAMESIZE_96X96,
+    FRAMESIZE_QQVGA,
+    FRAMESIZE_QCIF,
+    FRAMESIZE_HQVGA,
+    FRAMESIZE_240X240,
+    FRAMESIZE_QVGA,
+    FRAMESIZE_CIF,
+    FRAMESIZE_HVGA,
+    FRAMESIZE_VGA,
+    FRAMESIZE_SVGA,
+    FRAMESIZE_XGA,
+    FRAMESIZE_HD,
+    FRAMESIZE_SXGA,
+    FRAMESIZE_UXGA,
+} framesize_t;
+
+typedef enum
+{
+    LEDC_TIMER_0,
+    LEDC_TIMER_1,
+} ledc_timer_t;
+
+typedef enum
+{
+    LEDC_CHANNEL_0,
+    LEDC_CHANNEL_1,
+} ledc_channel_t;
+
+typedef enum
+{
+    CAMERA_FB_IN_PSRAM,
+    CAMERA_FB_IN_DRAM,
+} camera_fb_location_t;
+
+typedef enum
+{
+    CAMERA_GRAB_WHEN_EMPTY,
+    CAMERA_GRAB_LATEST,
+} camera_grab_mode_t;
+
+typedef struct
+{
+    int pin_pwdn;
+    int pin_reset;
+    int pin_xclk;
+    int pin_sscb_sda;
+    int pin_sscb_scl;
+    int pin_d7;
+    int pin_d6;
+    int pin_d5;
+    int pin_d4;
+    int pin_d3;
+    int pin_d2;
+    int pin_d1;
+    int pin_d0;
+    int pin_vsync;
+    int pin_href;
+    int pin_pclk;
+    int xclk_freq_hz;
+    ledc_timer_t ledc_timer;
+    ledc_channel_t ledc_channel;
+    pixformat_t pixel_format;
+    framesize_t frame_size;
+    int jpeg_quality;
+    size_t fb_count;
+    camera_fb_location_t fb_location;
+    camera_grab_mode_t grab_mode;
+} camera_config_t;
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    pixformat_t format;
+    struct timeval timestamp;
+} camera_fb_t;
+
+#define OV2640_PID 0x26
+
+typedef struct
+{
+    uint16_t PID;
+} sensor_id_t;
+
+typedef struct
+{
+    sensor_id_t id;
+} sensor_t;
+
+/**
+ * ### 驱动模型
+ *
+ * 测试通过 hostCamera 设置帧大小与出帧耗时，并读取阻塞统计。
+ */
+struct HostCamera
+{
+    std::mutex lock;
+    std::condition_variable returned;
+    std::vector<camera_fb_t> buffers;
+    std::vector<bool> busy;
+    sensor_t sensor{{OV2640_PID}};
+    size_t frameBytes = 12 * 1024; ///< 每帧 JPEG 大小
+    uint32_t frameMs = 0;          ///< 出一帧的耗时
+    uint32_t timeoutMs = 4000;     ///< 没有空闲缓冲区时的等待上限（与驱动一致）
+    uint32_t frames = 0;           ///< 成功取到的帧数
+    uint32_t stalls = 0;           ///< 因缓冲区全被占用而等待的次数
+    uint32_t timeouts = 0;         ///< 等待超时、返回空指针的次数
+    uint32_t maxBusy = 0;          ///< 同时被占用的缓冲区最大数量
+};
+
+inline HostCamera hostCamera;
+
+inline esp_err_t esp_camera_init(const camera_config_t *config)
+{
+    std::lock_guard<std::mutex> guard(hostCamera.lock);
+    size_t count = config->fb_count ? config->fb_count : 1;
+    hostCamera.buffers.assign(count, camera_fb_t());
+    hostCamera.busy.assign(count, false);
+    for (camera_fb_t &fb : hostCamera.buffers)
+    {
+        fb.buf = (uint8_t *)malloc(hostCamera.frameBytes);
+        fb.len = hostCamera.frameBytes;
+        fb.format = config->pixel_format;
+    }
+    return ESP_OK;
+}
+
+inline sensor_t *esp_camera_sensor_get() { return &hostCamera.sensor; }
+
+inline camera_fb_t *esp_camera_fb_get()
+{
+    if (hostCamera.frameMs)
+    {
+        delay(hostCamera.frameMs);
+    }
+    std::unique_lock<std::mutex> guard(hostCamera.lock);
+    auto freeSlot = [&]() -> int
+    {
+        for (size_t i = 0; i < hostCamera.busy.size(); i++)
+        {
+            if (!hostCamera.busy[i])
+            {
+                return (int)i;
+            }
+        }
+        return -1;
+    };
+    if (freeSlot() < 0)
+    {
+        hostCamera.stalls++;
+        if (!hostCamera.returned.wait_for(guard, std::chrono::milliseconds(hostCamera.timeoutMs), [&]
+                                          { return freeSlot() >= 0; }))
+        {
+            hostCamera.timeouts++;
+            return nullptr;
+        }
+    }
+    int slot = freeSlot();
+    if (slot < 0)
+    {
+        return nullptr;
+    }
+    hostCamera.busy[slot] = true;
+    uint32_t inUse = 0;
+    for (bool b : hostCamera.busy)
+    {
+        inUse += b;
+    }
+    hostCamera.maxBusy = max(hostCamera.maxBusy, inUse);
+    hostCamera.frames++;
+
+    camera_fb_t *fb = &hostCamera.buffers[slot];
+    if (fb->len != hostCamera.frameBytes)
+    {
+        free(fb->buf);
+        fb->buf = (uint8_t *)malloc(hostCamera.frameBytes);
+        fb->len = hostCamera.frameBytes;
+    }
+    memset(fb->buf, (uint8_t)hostCamera.frames, fb->len);
+    fb->buf[0] = 0xff;
+    fb->buf[1] = 0xd8;
+    return fb;
+}
+
+inline void esp_camera_fb_return(camera_fb_t *fb)
+{
+    std::lock_guard<std::mutex> guard(hostCamera.lock);
+    for (size_t i = 0; i < hostCamera.buffers.size(); i++)
+    {
+        if (&hostCamera.buffers[i] == fb)
+        {
+            hostCamera.busy[i] = false;
+        }
+    }
+    hostCamera.returned.notify_all();
+}
+
+#endif // HOST_ESP_CAMERA_H
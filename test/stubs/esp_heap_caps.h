@@ -0,0 +1,19 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief 主机测试替身：按能力分配内存，全部退化为 malloc。
+ */
+
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void heap_caps_free(void *ptr) { free(ptr); }
+
+#endif // HOST_ESP_HEAP_CAPS_H
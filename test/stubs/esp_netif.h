@@ -0,0 +1,23 @@
+/**
+ * @file esp_netif.h
+ * @brief 主机测试用的 esp_netif 替身，只有 WiFi STA 接口的句柄。
+ */
+
+#ifndef HOST_ESP_NETIF_H
+#define HOST_ESP_NETIF_H
+
+#include <string.h>
+
+struct esp_netif_obj
+{
+};
+typedef struct esp_netif_obj esp_netif_t;
+
+inline esp_netif_t hostStaNetif;
+
+inline esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key)
+{
+    return strcmp(if_key, "WIFI_STA_DEF") == 0 ? &hostStaNetif : nullptr;
+}
+
+#endif
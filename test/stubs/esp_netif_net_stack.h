@@ -0,0 +1,17 @@
+/**
+ * @file esp_netif_net_stack.h
+ * @brief 主机测试用的替身：esp_netif 句柄对应的 lwIP 接口。
+ */
+
+#ifndef HOST_ESP_NETIF_NET_STACK_H
+#define HOST_ESP_NETIF_NET_STACK_H
+
+#include "esp_netif.h"
+#include "lwip/dhcp.h"
+
+inline void *esp_netif_get_netif_impl(esp_netif_t *esp_netif)
+{
+    return esp_netif == &hostStaNetif ? &hostLwipNetif : nullptr;
+}
+
+#endif
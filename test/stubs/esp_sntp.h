@@ -0,0 +1,51 @@
+/**
+ * @file esp_sntp.h
+ * @brief 主机测试用的 SNTP 替身。
+ *
+ * 不访问网络；测试调用 hostSntpDeliver() 模拟一次同步：设置系统时间并触发通知回调。
+ */
+
+#ifndef HOST_ESP_SNTP_H
+#define HOST_ESP_SNTP_H
+
+#include <Arduino.h>
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+typedef enum
+{
+    SNTP_SYNC_MODE_IMMED,
+    SNTP_SYNC_MODE_SMOOTH,
+} sntp_sync_mode_t;
+
+struct HostSntp
+{
+    sntp_sync_time_cb_t callback = nullptr;
+    sntp_sync_mode_t mode = SNTP_SYNC_MODE_IMMED;
+    uint32_t intervalMs = 3600000;
+};
+
+inline HostSntp hostSntp;
+
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) { hostSntp.callback = callback; }
+inline void sntp_set_sync_mode(sntp_sync_mode_t mode) { hostSntp.mode = mode; }
+inline void sntp_set_sync_interval(uint32_t intervalMs) { hostSntp.intervalMs = intervalMs; }
+
+/**
+ * ### 模拟一次 SNTP 同步
+ *
+ * #### 参数
+ *
+ * - `seconds`：服务器给出的 Unix 时间（秒）
+ */
+inline void hostSntpDeliver(time_t seconds)
+{
+    struct timeval tv = {seconds, 0};
+    settimeofday(&tv, nullptr);
+    if (hostSntp.callback)
+    {
+        hostSntp.callback(&tv);
+    }
+}
+
+#endif // HOST_ESP_SNTP_H
@@ -0,0 +1,14 @@
+/**
+ * @file esp_system.h
+ * @brief 主机测试替身：硬件随机数。
+ */
+
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <Arduino.h>
+
+inline uint32_t esp_random() { return (uint32_t)hostRng()(); }
+inline void esp_restart() { exit(0); }
+
+#endif // HOST_ESP_SYSTEM_H
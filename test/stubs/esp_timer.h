@@ -0,0 +1,13 @@
+/**
+ * @file esp_timer.h
+ * @brief 主机测试替身：开机以来的微秒数，与 millis() 同源。
+ */
+
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return hostMonotonicUs(); }
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,378 @@
+/**
+ * @file FreeRTOS.h
+ * @brief 主机测试用的 FreeRTOS 替身，任务、队列、信号量与事件组都由 pthread 实现。
+ *
+ * 一个节拍等于 1 ms；核心号与优先级被忽略，任务之间真正并发运行。
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7fffffff
+#define configASSERT(x) ((void)0)
+
+/**
+ * ### 带超时等待
+ *
+ * portMAX_DELAY 表示一直等待，其余按毫秒计。
+ */
+template <typename Predicate>
+inline bool hostWait(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Predicate ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// ---------------------------------------------------------------- 任务
+
+struct HostTask
+{
+    TaskFunction_t function;
+    void *parameter;
+    char name[16];
+};
+typedef HostTask *TaskHandle_t;
+
+inline thread_local HostTask *hostCurrentTask = nullptr;
+
+inline void *hostTaskEntry(void *arg)
+{
+    HostTask *task = (HostTask *)arg;
+    hostCurrentTask = task;
+    task->function(task->parameter);
+    return nullptr;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t, void *parameter, UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+    HostTask *task = new HostTask{function, parameter, {0}};
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&thread, &attr, hostTaskEntry, task);
+    pthread_attr_destroy(&attr);
+    if (rc != 0)
+    {
+        delete task;
+        return pdFAIL;
+    }
+    if (handle)
+    {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack, void *parameter, UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stack, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+/**
+ * ### 删除任务
+ *
+ * 只支持任务删除自己（固件也只这样用）。
+ */
+inline void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == hostCurrentTask)
+    {
+        pthread_exit(nullptr);
+    }
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return hostCurrentTask; }
+inline TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+inline void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment)
+{
+    *previousWake += increment;
+    int32_t remaining = (int32_t)(*previousWake - xTaskGetTickCount());
+    if (remaining > 0)
+    {
+        delay(remaining);
+    }
+}
+
+inline BaseType_t xPortGetCoreID() { return 0; }
+
+// ---------------------------------------------------------------- 临界区
+
+/**
+ * ### 自旋锁
+ *
+ * 与 ESP-IDF 一样允许同一任务嵌套进入。
+ */
+struct portMUX_TYPE
+{
+    std::atomic<bool> locked{false};
+    std::atomic<std::thread::id> owner{};
+    uint32_t depth = 0;
+};
+#define portMUX_INITIALIZER_UNLOCKED \
+    {                                \
+    }
+
+inline void hostEnterCritical(portMUX_TYPE *mux)
+{
+    std::thread::id self = std::this_thread::get_id();
+    if (mux->locked.load(std::memory_order_acquire) && mux->owner.load(std::memory_order_relaxed) == self)
+    {
+        mux->depth++;
+        return;
+    }
+    bool expected = false;
+    while (!mux->locked.compare_exchange_weak(expected, true, std::memory_order_acquire))
+    {
+        expected = false;
+        std::this_thread::yield();
+    }
+    mux->owner.store(self, std::memory_order_relaxed);
+    mux->depth = 1;
+}
+
+inline void hostExitCritical(portMUX_TYPE *mux)
+{
+    if (--mux->depth == 0)
+    {
+        mux->owner.store(std::thread::id(), std::memory_order_relaxed);
+        mux->locked.store(false, std::memory_order_release);
+    }
+}
+
+#define portENTER_CRITICAL(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) hostExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) hostExitCritical(mux)
+#define taskENTER_CRITICAL(mux) hostEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux) hostExitCritical(mux)
+
+// ---------------------------------------------------------------- 队列
+
+struct HostQueue
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t capacity;
+    UBaseType_t itemSize;
+};
+typedef HostQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    HostQueue *queue = new HostQueue();
+    queue->capacity = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+inline BaseType_t hostQueuePut(QueueHandle_t queue, const void *item, TickType_t ticks, bool front)
+{
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!hostWait(queue->changed, guard, ticks, [queue]
+                  { return queue->items.size() < queue->capacity; }))
+    {
+        return errQUEUE_FULL;
+    }
+    std::vector<uint8_t> copy((const uint8_t *)item, (const uint8_t *)item + queue->itemSize);
+    if (front)
+    {
+        queue->items.push_front(std::move(copy));
+    }
+    else
+    {
+        queue->items.push_back(std::move(copy));
+    }
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) { return hostQueuePut(queue, item, ticks, false); }
+inline BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks) { return hostQueuePut(queue, item, ticks, false); }
+inline BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks) { return hostQueuePut(queue, item, ticks, true); }
+
+inline BaseType_t hostQueueGet(QueueHandle_t queue, void *item, TickType_t ticks, bool remove)
+{
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!hostWait(queue->changed, guard, ticks, [queue]
+                  { return !queue->items.empty(); }))
+    {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    if (remove)
+    {
+        queue->items.pop_front();
+        queue->changed.notify_all();
+    }
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) { return hostQueueGet(queue, item, ticks, true); }
+inline BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks) { return hostQueueGet(queue, item, ticks, false); }
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->capacity - (UBaseType_t)queue->items.size();
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+// ---------------------------------------------------------------- 信号量
+
+/**
+ * ### 信号量
+ *
+ * 互斥量、二值与计数信号量都按计数处理；互斥量不做优先级继承。
+ */
+struct HostSemaphore
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+};
+typedef HostSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    HostSemaphore *semaphore = new HostSemaphore();
+    semaphore->count = initialCount;
+    semaphore->maxCount = maxCount;
+    return semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    if (!hostWait(semaphore->changed, guard, ticks, [semaphore]
+                  { return semaphore->count > 0; }))
+    {
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count >= semaphore->maxCount)
+    {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->changed.notify_one();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    return semaphore->count;
+}
+
+// ---------------------------------------------------------------- 事件组
+
+struct HostEventGroup
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+typedef HostEventGroup *EventGroupHandle_t;
+
+inline EventGroupHandle_t xEventGroupCreate() { return new HostEventGroup(); }
+inline void vEventGroupDelete(EventGroupHandle_t group) { delete group; }
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> guard(group->lock);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> guard(group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+inline EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    std::lock_guard<std::mutex> guard(group->lock);
+    return group->bits;
+}
+
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> guard(group->lock);
+    bool met = hostWait(group->changed, guard, ticks, [group, bits, waitForAll]
+                        { return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0; });
+    EventBits_t result = group->bits;
+    if (met && clearOnExit)
+    {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+#endif // HOST_FREERTOS_H
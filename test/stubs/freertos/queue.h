@@ -0,0 +1,11 @@
+/**
+ * @file queue.h
+ * @brief 主机测试替身：全部实现都在 FreeRTOS.h 中。
+ */
+
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#endif // HOST_FREERTOS_QUEUE_H
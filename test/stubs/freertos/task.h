@@ -0,0 +1,11 @@
+/**
+ * @file task.h
+ * @brief 主机测试替身：全部实现都在 FreeRTOS.h 中。
+ */
+
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#endif // HOST_FREERTOS_TASK_H
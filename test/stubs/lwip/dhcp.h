@@ -0,0 +1,28 @@
+/**
+ * @file dhcp.h
+ * @brief 主机测试用的 lwIP DHCP 客户端替身。
+ *
+ * 测试通过 hostDhcp.offered_t0_lease 设置服务器给出的租期（秒）。
+ */
+
+#ifndef HOST_LWIP_DHCP_H
+#define HOST_LWIP_DHCP_H
+
+#include <stdint.h>
+
+struct dhcp
+{
+    uint32_t offered_t0_lease;
+};
+
+struct netif
+{
+    struct dhcp *dhcp;
+};
+
+#define netif_dhcp_data(netif) ((netif)->dhcp)
+
+inline struct dhcp hostDhcp = {7200};
+inline struct netif hostLwipNetif = {&hostDhcp};
+
+#endif
@@ -0,0 +1,335 @@
+/**
+ * @file md.h
+ * @brief 主机测试用的 mbedtls 摘要接口替身，实现了 SHA-1 与 SHA-256，以及按 mbedtls 方式
+ *        在上下文中保存 ipad/opad 的 HMAC 接口（供性能对照使用）。
+ */
+
+#ifndef HOST_MBEDTLS_MD_H
+#define HOST_MBEDTLS_MD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum
+{
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_MD5,
+    MBEDTLS_MD_SHA1,
+    MBEDTLS_MD_SHA224,
+    MBEDTLS_MD_SHA256,
+    MBEDTLS_MD_SHA384,
+    MBEDTLS_MD_SHA512,
+} mbedtls_md_type_t;
+
+typedef struct
+{
+    mbedtls_md_type_t type;
+    unsigned char size;
+} mbedtls_md_info_t;
+
+struct HostDigestState
+{
+    uint32_t h[8];
+    uint8_t block[64];
+    size_t used;
+    uint64_t total;
+};
+
+typedef struct
+{
+    const mbedtls_md_info_t *md_info;
+    HostDigestState *md_ctx;
+    unsigned char *hmac_ctx; ///< setup 时 hmac 非 0 才分配，依次保存 ipad 与 opad
+} mbedtls_md_context_t;
+
+inline const mbedtls_md_info_t hostSha1Info = {MBEDTLS_MD_SHA1, 20};
+inline const mbedtls_md_info_t hostSha256Info = {MBEDTLS_MD_SHA256, 32};
+
+inline uint32_t hostRotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+inline uint32_t hostRotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline void hostSha1Block(uint32_t *h, const uint8_t *p)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++)
+    {
+        w[i] = hostRotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = hostRotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = hostRotl(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+inline void hostSha256Block(uint32_t *h, const uint8_t *p)
+{
+    static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = hostRotr(w[i - 15], 7) ^ hostRotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = hostRotr(w[i - 2], 17) ^ hostRotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = hh + (hostRotr(e, 6) ^ hostRotr(e, 11) ^ hostRotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (hostRotr(a, 2) ^ hostRotr(a, 13) ^ hostRotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+inline const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type)
+{
+    switch (type)
+    {
+    case MBEDTLS_MD_SHA1:
+        return &hostSha1Info;
+    case MBEDTLS_MD_SHA256:
+        return &hostSha256Info;
+    default:
+        return nullptr;
+    }
+}
+
+inline unsigned char mbedtls_md_get_size(const mbedtls_md_info_t *info) { return info ? info->size : 0; }
+
+inline void mbedtls_md_init(mbedtls_md_context_t *ctx)
+{
+    ctx->md_info = nullptr;
+    ctx->md_ctx = nullptr;
+    ctx->hmac_ctx = nullptr;
+}
+
+inline void mbedtls_md_free(mbedtls_md_context_t *ctx)
+{
+    delete ctx->md_ctx;
+    delete[] ctx->hmac_ctx;
+    mbedtls_md_init(ctx);
+}
+
+inline int mbedtls_md_setup(mbedtls_md_context_t *ctx, const mbedtls_md_info_t *info, int hmac)
+{
+    if (!info)
+    {
+        return -1;
+    }
+    ctx->md_info = info;
+    ctx->md_ctx = new HostDigestState();
+    if (hmac)
+    {
+        ctx->hmac_ctx = new unsigned char[128];
+    }
+    return 0;
+}
+
+inline int mbedtls_md_starts(mbedtls_md_context_t *ctx)
+{
+    static const uint32_t SHA1_INIT[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    static const uint32_t SHA256_INIT[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    HostDigestState *s = ctx->md_ctx;
+    if (!s)
+    {
+        return -1;
+    }
+    memset(s, 0, sizeof(*s));
+    if (ctx->md_info->type == MBEDTLS_MD_SHA1)
+    {
+        memcpy(s->h, SHA1_INIT, sizeof(SHA1_INIT));
+    }
+    else
+    {
+        memcpy(s->h, SHA256_INIT, sizeof(SHA256_INIT));
+    }
+    return 0;
+}
+
+inline int mbedtls_md_update(mbedtls_md_context_t *ctx, const unsigned char *input, size_t length)
+{
+    HostDigestState *s = ctx->md_ctx;
+    if (!s)
+    {
+        return -1;
+    }
+    bool sha1 = ctx->md_info->type == MBEDTLS_MD_SHA1;
+    s->total += length;
+    while (length)
+    {
+        size_t n = 64 - s->used < length ? 64 - s->used : length;
+        memcpy(s->block + s->used, input, n);
+        s->used += n;
+        input += n;
+        length -= n;
+        if (s->used == 64)
+        {
+            sha1 ? hostSha1Block(s->h, s->block) : hostSha256Block(s->h, s->block);
+            s->used = 0;
+        }
+    }
+    return 0;
+}
+
+inline int mbedtls_md_finish(mbedtls_md_context_t *ctx, unsigned char *output)
+{
+    HostDigestState *s = ctx->md_ctx;
+    if (!s)
+    {
+        return -1;
+    }
+    uint64_t bits = s->total * 8;
+    uint8_t pad[72] = {0x80};
+    size_t padLength = (s->used < 56 ? 56 : 120) - s->used;
+    for (int i = 0; i < 8; i++)
+    {
+        pad[padLength + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    uint64_t total = s->total;
+    mbedtls_md_update(ctx, pad, padLength + 8);
+    s->total = total;
+    int words = ctx->md_info->size / 4;
+    for (int i = 0; i < words; i++)
+    {
+        output[4 * i] = (uint8_t)(s->h[i] >> 24);
+        output[4 * i + 1] = (uint8_t)(s->h[i] >> 16);
+        output[4 * i + 2] = (uint8_t)(s->h[i] >> 8);
+        output[4 * i + 3] = (uint8_t)s->h[i];
+    }
+    return 0;
+}
+
+inline int mbedtls_md_clone(mbedtls_md_context_t *dst, const mbedtls_md_context_t *src)
+{
+    if (!dst->md_ctx || !src->md_ctx || dst->md_info != src->md_info)
+    {
+        return -1;
+    }
+    *dst->md_ctx = *src->md_ctx;
+    return 0;
+}
+
+inline int mbedtls_md(const mbedtls_md_info_t *info, const unsigned char *input, size_t length, unsigned char *output)
+{
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    int rc = mbedtls_md_setup(&ctx, info, 0);
+    if (rc == 0)
+    {
+        mbedtls_md_starts(&ctx);
+        mbedtls_md_update(&ctx, input, length);
+        mbedtls_md_finish(&ctx, output);
+    }
+    mbedtls_md_free(&ctx);
+    return rc;
+}
+
+inline int mbedtls_md_hmac_starts(mbedtls_md_context_t *ctx, const unsigned char *key, size_t keylen)
+{
+    if (!ctx->md_ctx || !ctx->hmac_ctx)
+    {
+        return -1;
+    }
+    unsigned char sum[32];
+    if (keylen > 64)
+    {
+        mbedtls_md(ctx->md_info, key, keylen, sum);
+        key = sum;
+        keylen = ctx->md_info->size;
+    }
+    unsigned char *ipad = ctx->hmac_ctx;
+    unsigned char *opad = ctx->hmac_ctx + 64;
+    memset(ipad, 0x36, 64);
+    memset(opad, 0x5c, 64);
+    for (size_t i = 0; i < keylen; i++)
+    {
+        ipad[i] ^= key[i];
+        opad[i] ^= key[i];
+    }
+    mbedtls_md_starts(ctx);
+    return mbedtls_md_update(ctx, ipad, 64);
+}
+
+inline int mbedtls_md_hmac_update(mbedtls_md_context_t *ctx, const unsigned char *input, size_t ilen)
+{
+    return ctx->hmac_ctx ? mbedtls_md_update(ctx, input, ilen) : -1;
+}
+
+inline int mbedtls_md_hmac_finish(mbedtls_md_context_t *ctx, unsigned char *output)
+{
+    if (!ctx->hmac_ctx)
+    {
+        return -1;
+    }
+    unsigned char inner[32];
+    mbedtls_md_finish(ctx, inner);
+    mbedtls_md_starts(ctx);
+    mbedtls_md_update(ctx, ctx->hmac_ctx + 64, 64);
+    mbedtls_md_update(ctx, inner, ctx->md_info->size);
+    return mbedtls_md_finish(ctx, output);
+}
+
+#endif // HOST_MBEDTLS_MD_H
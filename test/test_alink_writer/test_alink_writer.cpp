@@ -0,0 +1,249 @@
+/**
+ * @file test_alink_writer.cpp
+ * @brief 检查 AlinkWriter 的输出格式与缓冲区边界：任何容量下都不越界写入，空间不足时 finish() 失败；
+ *        并与原来的 JsonDocument + String 组包方式比较每次发布的分配次数和耗时。
+ *
+ * 分配次数由 HostHeap 统计，只包括 operator new（String 等），malloc 直接分配的内存不计入。
+ */
+
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <string>
+#include "AlinkWriter.h"
+#include "HostHeap.h"
+
+#define GUARD_BYTE 0x5a
+#define BENCH_PROPERTIES 8   // 每次发布携带的属性数
+#define BENCH_PUBLISHES 2000 // 每种方式的组包次数
+
+static const char *METHOD = "thing.event.property.post";
+
+/**
+ * ### 属性消息：params 中含一个嵌套对象
+ */
+static bool writeProperties(AlinkWriter &writer)
+{
+    writer.begin("17", METHOD);
+    writer.add("count", 42).add("name", "cam\"1\"");
+    writer.beginObject("frame").add("width", 320).add("height", 240).endObject();
+    writer.add("ok", true);
+    return writer.finish();
+}
+
+static const char *PROPERTIES_JSON =
+    "{\"id\":\"17\",\"version\":\"1.0\",\"method\":\"thing.event.property.post\",\"params\":"
+    "{\"count\":42,\"name\":\"cam\\\"1\\\"\",\"frame\":{\"width\":320,\"height\":240},\"ok\":true}}";
+
+/**
+ * ### 事件消息：params 已序列化好
+ */
+static bool writeEvent(AlinkWriter &writer)
+{
+    writer.begin("18", "thing.event.motion.post", "{\"area\":3}");
+    return writer.finish();
+}
+
+static const char *EVENT_JSON =
+    "{\"id\":\"18\",\"version\":\"1.0\",\"method\":\"thing.event.motion.post\",\"params\":{\"area\":3}}";
+
+/**
+ * ### 在所有容量下写入，检查边界
+ *
+ * 缓冲区末尾之后填充哨兵字节，任何容量下哨兵都不能被改写；
+ * 容量不足时 finish() 返回 false 且结果仍以 0 结尾，容量足够时输出与预期一致。
+ */
+static void checkEveryCapacity(bool (*writeMessage)(AlinkWriter &), const char *expected)
+{
+    size_t full = strlen(expected) + 1;
+    for (size_t capacity = 1; capacity <= full + 8; capacity++)
+    {
+        char buffer[512];
+        memset(buffer, GUARD_BYTE, sizeof(buffer));
+        AlinkWriter writer(buffer, capacity);
+        bool finished = writeMessage(writer);
+
+        for (size_t i = capacity; i < sizeof(buffer); i++)
+        {
+            if ((uint8_t)buffer[i] != GUARD_BYTE)
+            {
+                char line[80];
+                snprintf(line, sizeof(line), "capacity %u: byte %u written past the buffer", (unsigned)capacity,
+                         (unsigned)i);
+                TEST_FAIL_MESSAGE(line);
+            }
+        }
+        TEST_ASSERT_TRUE(memchr(buffer, 0, capacity) != nullptr);
+        TEST_ASSERT_EQUAL(capacity >= full, finished);
+        if (finished)
+        {
+            TEST_ASSERT_EQUAL_STRING(expected, writer.c_str());
+            TEST_ASSERT_EQUAL(full - 1, writer.length());
+        }
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### 输出格式与值类型
+ */
+void test_message_layout(void)
+{
+    char buffer[512];
+    AlinkWriter writer(buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(writeProperties(writer));
+    TEST_ASSERT_EQUAL_STRING(PROPERTIES_JSON, writer.c_str());
+
+    writer.begin("1", METHOD);
+    writer.add("l", -7L).add("u", 4000000000UL).add("f", 1.5f).add("nan", NAN).add("off", false);
+    writer.add("ctl", "a\\b\n");
+    TEST_ASSERT_TRUE(writer.finish());
+    TEST_ASSERT_EQUAL_STRING("{\"id\":\"1\",\"version\":\"1.0\",\"method\":\"thing.event.property.post\",\"params\":"
+                             "{\"l\":-7,\"u\":4000000000,\"f\":1.50,\"nan\":null,\"off\":false,\"ctl\":\"a\\\\b\\u000a\"}}",
+                             writer.c_str());
+
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, writer.c_str()));
+    TEST_ASSERT_EQUAL_STRING("a\\b\n", doc["params"]["ctl"].as<const char *>());
+}
+
+/**
+ * ### 属性消息在任何容量下都不越界
+ */
+void test_properties_never_overrun(void)
+{
+    checkEveryCapacity(writeProperties, PROPERTIES_JSON);
+}
+
+/**
+ * ### 事件消息在任何容量下都不越界
+ */
+void test_event_never_overrun(void)
+{
+    checkEveryCapacity(writeEvent, EVENT_JSON);
+}
+
+/**
+ * ### 撤销放不下的属性
+ *
+ * 第二个属性放不下时回退到 mark()，finish() 成功且只包含第一个属性。
+ */
+void test_rewind_overflowing_field(void)
+{
+    char buffer[512];
+    AlinkWriter probe(buffer, sizeof(buffer));
+    probe.begin("5", METHOD);
+    probe.add("a", "first");
+    size_t capacity = probe.length() + 2 + 1 + 4;
+
+    AlinkWriter writer(buffer, capacity);
+    writer.begin("5", METHOD);
+    writer.add("a", "first");
+    size_t mark = writer.mark();
+    writer.add("b", "second");
+    TEST_ASSERT_TRUE(writer.overflowed());
+    writer.rewind(mark);
+    TEST_ASSERT_FALSE(writer.overflowed());
+    TEST_ASSERT_TRUE(writer.finish());
+    TEST_ASSERT_EQUAL_STRING("{\"id\":\"5\",\"version\":\"1.0\",\"method\":\"thing.event.property.post\",\"params\":"
+                             "{\"a\":\"first\"}}",
+                             writer.c_str());
+}
+
+/**
+ * ### 消息头放不下
+ *
+ * 消息头溢出后 rewind() 不能清除溢出标志。
+ */
+void test_head_overflow_is_sticky(void)
+{
+    char buffer[32];
+    AlinkWriter writer(buffer, sizeof(buffer));
+    writer.begin("6", METHOD);
+    size_t mark = writer.mark();
+    writer.add("a", 1);
+    writer.rewind(mark);
+    TEST_ASSERT_TRUE(writer.overflowed());
+    TEST_ASSERT_FALSE(writer.finish());
+    TEST_ASSERT_TRUE(writer.length() < sizeof(buffer));
+}
+
+/**
+ * ### 组包开销：JsonDocument + String vs AlinkWriter
+ *
+ * 原来的方式每次发布新建 JsonDocument、用 String 保存 id 与序列化结果；
+ * AlinkWriter 直接写入投递窗口的槽位。报告每次发布的分配次数与耗时。
+ */
+void test_build_cost(void)
+{
+    char keys[BENCH_PROPERTIES][8];
+    for (int i = 0; i < BENCH_PROPERTIES; i++)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "prop%d", i);
+    }
+    static char slot[1024];
+    size_t lengths[2] = {0, 0};
+
+    uint64_t before = hostHeap.allocations;
+    uint32_t startUs = micros();
+    for (uint32_t n = 0; n < BENCH_PUBLISHES; n++)
+    {
+        JsonDocument doc;
+        JsonObject root = doc.to<JsonObject>();
+        root["id"] = String(1700000000000ULL + n);
+        root["version"] = "1.0";
+        root["method"] = METHOD;
+        JsonObject params = root["params"].to<JsonObject>();
+        for (int i = 0; i < BENCH_PROPERTIES; i++)
+        {
+            params[(const char *)keys[i]] = String("https://cdn.local/frame.jpg");
+        }
+        String payload;
+        serializeJson(root, payload);
+        lengths[0] += payload.length();
+    }
+    uint32_t documentUs = micros() - startUs;
+    uint64_t documentAllocations = hostHeap.allocations - before;
+
+    before = hostHeap.allocations;
+    startUs = micros();
+    for (uint32_t n = 0; n < BENCH_PUBLISHES; n++)
+    {
+        char id[24];
+        snprintf(id, sizeof(id), "%llu", (unsigned long long)(1700000000000ULL + n));
+        AlinkWriter writer(slot, sizeof(slot));
+        writer.begin(id, METHOD);
+        for (int i = 0; i < BENCH_PROPERTIES; i++)
+        {
+            writer.add(keys[i], "https://cdn.local/frame.jpg");
+        }
+        TEST_ASSERT_TRUE(writer.finish());
+        lengths[1] += writer.length();
+    }
+    uint32_t writerUs = micros() - startUs;
+    uint64_t writerAllocations = hostHeap.allocations - before;
+
+    char line[160];
+    snprintf(line, sizeof(line), "JsonDocument: %.2f us/publish, %.1f allocations/publish",
+             (double)documentUs / BENCH_PUBLISHES, (double)documentAllocations / BENCH_PUBLISHES);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "AlinkWriter : %.2f us/publish, %.1f allocations/publish",
+             (double)writerUs / BENCH_PUBLISHES, (double)writerAllocations / BENCH_PUBLISHES);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(lengths[0], lengths[1]);
+    TEST_ASSERT_EQUAL(0, writerAllocations);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_message_layout);
+    RUN_TEST(test_properties_never_overrun);
+    RUN_TEST(test_event_never_overrun);
+    RUN_TEST(test_rewind_overflowing_field);
+    RUN_TEST(test_head_overflow_is_sticky);
+    RUN_TEST(test_build_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/**
+ * @file test_ap_selector.cpp
+ * @brief 用构造的扫描结果检查接入点选择：首次连接选最强的可用接入点，吞吐量加分与上限，
+ *        连接失败的惩罚期，漫游的触发条件与迟滞，以及走过两个接入点之间时只漫游一次。
+ *
+ * ApSelector 不依赖 WiFi 库，时间由参数传入。
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "ApSelector.h"
+
+#define NOW_MS 1000000
+
+static ApCandidate ap(uint8_t id, int8_t rssi, uint8_t channel = 6)
+{
+    ApCandidate candidate = {{0x02, 0x00, 0x00, 0x00, 0x00, id}, channel, rssi, 0};
+    return candidate;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### 首次连接
+ *
+ * 选信号最强的候选；弱于 AP_MIN_RSSI 的不选；没有候选时返回 -1。
+ */
+void test_select_best_by_rssi(void)
+{
+    ApSelector selector;
+    ApCandidate scan[] = {ap(1, -70), ap(2, -52), ap(3, -61), ap(4, AP_MIN_RSSI - 1)};
+    TEST_ASSERT_EQUAL(1, selector.selectBest(scan, 4, NOW_MS));
+    TEST_ASSERT_EQUAL(-1, selector.selectBest(scan, 0, NOW_MS));
+    ApCandidate weak[] = {ap(4, AP_MIN_RSSI - 1)};
+    TEST_ASSERT_EQUAL(-1, selector.selectBest(weak, 1, NOW_MS));
+}
+
+/**
+ * ### 吞吐量加分
+ *
+ * 实测吞吐量每 AP_KBPS_PER_POINT 加 1 分，加分不超过上限；滑动平均按 1/4 权重更新。
+ */
+void test_throughput_score_and_cap(void)
+{
+    ApSelector selector;
+    ApCandidate fast = ap(1, -60);
+    ApCandidate unmeasured = ap(2, -60);
+    selector.recordThroughput(fast.bssid, 100000, 1000, NOW_MS); // 800 kbps
+    TEST_ASSERT_EQUAL(800, selector.throughputKbps(fast.bssid));
+    TEST_ASSERT_EQUAL(-60 + 8, selector.score(fast, 0));
+    TEST_ASSERT_EQUAL(-60, selector.score(unmeasured, 0));
+    TEST_ASSERT_EQUAL(-60 + 8, selector.score(unmeasured, 800));
+
+    selector.recordThroughput(fast.bssid, 400000, 1000, NOW_MS); // 3200 kbps
+    TEST_ASSERT_EQUAL((800 * 3 + 3200) / 4, selector.throughputKbps(fast.bssid));
+
+    ApCandidate saturated = ap(3, -70);
+    selector.recordThroughput(saturated.bssid, 10000000, 1000, NOW_MS);
+    TEST_ASSERT_EQUAL(-70 + AP_THROUGHPUT_CAP_KBPS / AP_KBPS_PER_POINT, selector.score(saturated, 0));
+
+    ApCandidate scan[] = {ap(4, -55), saturated};
+    TEST_ASSERT_EQUAL(1, selector.selectBest(scan, 2, NOW_MS));
+}
+
+/**
+ * ### 连接失败的惩罚期
+ */
+void test_failure_penalty(void)
+{
+    ApSelector selector;
+    ApCandidate scan[] = {ap(1, -50), ap(2, -65)};
+    selector.recordFailure(scan[0].bssid, NOW_MS);
+    TEST_ASSERT_EQUAL(1, selector.selectBest(scan, 2, NOW_MS));
+    TEST_ASSERT_EQUAL(1, selector.selectBest(scan, 2, NOW_MS + AP_FAILURE_PENALTY_MS - 1));
+    TEST_ASSERT_EQUAL(0, selector.selectBest(scan, 2, NOW_MS + AP_FAILURE_PENALTY_MS));
+}
+
+/**
+ * ### 漫游的触发条件
+ *
+ * 信号好且上传不慢时不漫游；信号弱或实测上传慢时才考虑。
+ */
+void test_wants_roam(void)
+{
+    ApSelector selector;
+    ApCandidate current = ap(1, AP_ROAM_RSSI_TRIGGER);
+    TEST_ASSERT_FALSE(selector.wantsRoam(current));
+    current.rssi = AP_ROAM_RSSI_TRIGGER - 1;
+    TEST_ASSERT_TRUE(selector.wantsRoam(current));
+
+    current.rssi = -50;
+    selector.recordThroughput(current.bssid, AP_ROAM_SLOW_KBPS * 1000 / 8, 1000, NOW_MS);
+    TEST_ASSERT_FALSE(selector.wantsRoam(current));
+    selector.recordThroughput(current.bssid, 1000, 1000, NOW_MS);
+    selector.recordThroughput(current.bssid, 1000, 1000, NOW_MS);
+    TEST_ASSERT_TRUE(selector.wantsRoam(current));
+
+    // 信号相同、实测更快的候选：没测过的候选按当前吞吐量计分，只有测过的才能胜出
+    ApCandidate scan[] = {ap(2, -50), ap(3, -50)};
+    selector.recordThroughput(scan[1].bssid, 200000, 1000, NOW_MS); // 1600 kbps
+    TEST_ASSERT_EQUAL(1, selector.selectRoam(scan, 2, current, NOW_MS));
+}
+
+/**
+ * ### 迟滞
+ *
+ * 候选得分须比当前高出 AP_ROAM_HYSTERESIS；当前接入点出现在扫描结果中也不会被选中。
+ */
+void test_roam_hysteresis(void)
+{
+    ApSelector selector;
+    ApCandidate current = ap(1, -72);
+    ApCandidate almost[] = {current, ap(2, -72 + AP_ROAM_HYSTERESIS - 1)};
+    TEST_ASSERT_EQUAL(-1, selector.selectRoam(almost, 2, current, NOW_MS));
+    ApCandidate better[] = {current, ap(2, -72 + AP_ROAM_HYSTERESIS), ap(3, -80)};
+    TEST_ASSERT_EQUAL(1, selector.selectRoam(better, 3, current, NOW_MS));
+
+    selector.recordFailure(better[1].bssid, NOW_MS);
+    TEST_ASSERT_EQUAL(-1, selector.selectRoam(better, 3, current, NOW_MS));
+}
+
+/**
+ * ### 走过两个接入点之间
+ *
+ * 从 A 附近走到 B 附近，A 的信号从 -45 降到 -85，B 的信号同时从 -85 升到 -45。
+ * 只在 A 明显变差且 B 明显更好时漫游一次，之后不来回切换。
+ */
+void test_walk_between_aps(void)
+{
+    ApSelector selector;
+    ApCandidate a = ap(1, -45, 1);
+    ApCandidate b = ap(2, -85, 11);
+    ApCandidate current = a;
+    int roams = 0;
+    int8_t roamedAtRssi = 0;
+    for (int step = 0; step <= 40; step++)
+    {
+        a.rssi = -45 - step;
+        b.rssi = -85 + step;
+        ApCandidate scan[] = {a, b};
+        current.rssi = memcmp(current.bssid, a.bssid, 6) == 0 ? a.rssi : b.rssi;
+        int choice = selector.selectRoam(scan, 2, current, NOW_MS + step * 1000);
+        if (choice >= 0)
+        {
+            roams++;
+            roamedAtRssi = current.rssi;
+            current = scan[choice];
+        }
+    }
+    TEST_ASSERT_EQUAL(1, roams);
+    TEST_ASSERT_EQUAL_MEMORY(b.bssid, current.bssid, 6);
+    TEST_ASSERT_LESS_THAN(AP_ROAM_RSSI_TRIGGER, roamedAtRssi);
+}
+
+/**
+ * ### 历史记录淘汰
+ *
+ * 记录满后淘汰最久未用的接入点。
+ */
+void test_history_eviction(void)
+{
+    ApSelector selector;
+    for (uint8_t i = 0; i <= AP_HISTORY_SIZE; i++)
+    {
+        ApCandidate candidate = ap(i + 1, -60);
+        selector.recordThroughput(candidate.bssid, 100000, 1000, NOW_MS + i);
+    }
+    ApCandidate oldest = ap(1, -60);
+    ApCandidate newest = ap(AP_HISTORY_SIZE + 1, -60);
+    ApCandidate second = ap(2, -60);
+    TEST_ASSERT_EQUAL(0, selector.throughputKbps(oldest.bssid));
+    TEST_ASSERT_EQUAL(800, selector.throughputKbps(newest.bssid));
+    TEST_ASSERT_EQUAL(800, selector.throughputKbps(second.bssid));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_select_best_by_rssi);
+    RUN_TEST(test_throughput_score_and_cap);
+    RUN_TEST(test_failure_penalty);
+    RUN_TEST(test_wants_roam);
+    RUN_TEST(test_roam_hysteresis);
+    RUN_TEST(test_walk_between_aps);
+    RUN_TEST(test_history_eviction);
+    return UNITY_END();
+}
@@ -0,0 +1,198 @@
+/**
+ * @file test_backlog.cpp
+ * @brief 检查离线上传队列：入队不读写内存卡，卡上暂时找不到的帧稍后重试，
+ *        补传按七牛返回的状态码决定移除、重试或丢弃记录。
+ *
+ * 补传的限速与退避间隔通过 hostAdvanceMillis() 跳过。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <vector>
+#include "UploadBacklog.h"
+
+_Base64 _base64;
+Logger logger;
+WiFiClient wifiClient;
+PubSubClient mqttClient;
+SdCardManager sdcardManager;
+TimeManager timeManager;
+WifiManager wifiManager("ssid", "password");
+IoTManager iotManager("productKey", "device", "secret", "broker.local", 1883);
+QiniuClient qiniuClient("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+UploadBacklog uploadBacklog;
+
+static std::vector<int> responses; ///< 依次返回的状态码，用完后返回 200
+static uint8_t frame[2048];
+
+static int uploadHandler(const HostHttpRequest &, String &response)
+{
+    int code = HTTP_CODE_OK;
+    if (!responses.empty())
+    {
+        code = responses.front();
+        responses.erase(responses.begin());
+    }
+    response = code == HTTP_CODE_OK ? "{\"url\":\"https://cdn.local/frame\"}" : "{\"error\":\"rejected\"}";
+    return code;
+}
+
+static void backlogFrame(uint_fast64_t timestamp)
+{
+    sdcardManager.saveImage(frame, sizeof(frame), timestamp);
+    TEST_ASSERT_TRUE(uploadBacklog.enqueue(timestamp, String(QINIU_KEY_PREFIX) + String(timestamp) + ".jpg"));
+}
+
+/**
+ * ### 跳过限速间隔后补传一次
+ */
+static void drainOnce()
+{
+    hostAdvanceMillis(BACKLOG_MAX_BACKOFF_MS);
+    uploadBacklog.drain();
+}
+
+void setUp(void)
+{
+    hostWiFi.connected = true;
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    responses.clear();
+}
+
+void tearDown(void)
+{
+    while (uploadBacklog.depth() > 0 && hostWiFi.connected)
+    {
+        responses.clear();
+        drainOnce();
+    }
+}
+
+/**
+ * ### 入队不读写内存卡
+ *
+ * 记录先留在内存中，由 drain() 写入队列文件。
+ */
+void test_enqueue_defers_card_io(void)
+{
+    hostWiFi.connected = false;
+    TEST_ASSERT_TRUE(uploadBacklog.enqueue(1700000000000ULL, String(QINIU_KEY_PREFIX) + "1.jpg"));
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    TEST_ASSERT_FALSE(SD_MMC.exists(BACKLOG_DATA_PATH));
+
+    uploadBacklog.drain();
+    TEST_ASSERT_TRUE(SD_MMC.exists(BACKLOG_DATA_PATH));
+    File data = SD_MMC.open(BACKLOG_DATA_PATH, FILE_READ);
+    TEST_ASSERT_EQUAL(sizeof(BacklogRecord), data.size());
+    data.close();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    TEST_ASSERT_EQUAL(0, hostHttp.requests);
+
+    // 卡上一直没有这一帧，等待超过 BACKLOG_MISSING_WAIT_MS 后丢弃记录
+    hostWiFi.connected = true;
+    drainOnce();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    drainOnce();
+    TEST_ASSERT_EQUAL(0, uploadBacklog.depth());
+    TEST_ASSERT_EQUAL(0, hostHttp.requests);
+}
+
+/**
+ * ### 帧晚于记录写到卡上
+ *
+ * 写卡任务异步落盘，补传时帧还不在卡上不能丢弃记录，落盘后照常补传。
+ */
+void test_frame_written_late_is_retried(void)
+{
+    TEST_ASSERT_TRUE(uploadBacklog.enqueue(1700000006000ULL, String(QINIU_KEY_PREFIX) + "1700000006000.jpg"));
+    uploadBacklog.drain();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    hostAdvanceMillis(BACKLOG_DRAIN_INTERVAL_MS);
+    uploadBacklog.drain();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+
+    sdcardManager.saveImage(frame, sizeof(frame), 1700000006000ULL);
+    hostAdvanceMillis(BACKLOG_DRAIN_INTERVAL_MS);
+    uploadBacklog.drain();
+    TEST_ASSERT_EQUAL(0, uploadBacklog.depth());
+    TEST_ASSERT_EQUAL(1, hostHttp.requests);
+}
+
+/**
+ * ### 上传成功或文件已存在时移除记录
+ */
+void test_success_and_file_exists_pop(void)
+{
+    backlogFrame(1700000001000ULL);
+    backlogFrame(1700000002000ULL);
+    responses = {QINIU_CODE_FILE_EXISTS};
+
+    drainOnce();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    drainOnce();
+    TEST_ASSERT_EQUAL(0, uploadBacklog.depth());
+    TEST_ASSERT_EQUAL(2, hostHttp.requests);
+}
+
+/**
+ * ### 连接失败与 5xx 保留记录并重试
+ *
+ * 复用的长连接上失败时七牛客户端会换新连接重发一次，因此连接失败要连续出现两次。
+ */
+void test_transport_errors_and_5xx_retry(void)
+{
+    backlogFrame(1700000003000ULL);
+    responses = {503, 500, HTTPC_ERROR_CONNECTION_REFUSED, HTTPC_ERROR_CONNECTION_REFUSED};
+
+    drainOnce();
+    drainOnce();
+    drainOnce();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    TEST_ASSERT_EQUAL(4, hostHttp.requests);
+    drainOnce();
+    TEST_ASSERT_EQUAL(0, uploadBacklog.depth());
+    TEST_ASSERT_EQUAL(5, hostHttp.requests);
+}
+
+/**
+ * ### 其他 4xx 丢弃记录
+ *
+ * 重试也不会成功的记录不能堵住队列，后面的帧照常补传。
+ */
+void test_client_errors_drop_record(void)
+{
+    backlogFrame(1700000004000ULL);
+    backlogFrame(1700000005000ULL);
+    responses = {403};
+
+    drainOnce();
+    TEST_ASSERT_EQUAL(1, uploadBacklog.depth());
+    drainOnce();
+    TEST_ASSERT_EQUAL(0, uploadBacklog.depth());
+
+    std::lock_guard<std::mutex> guard(hostHttp.lock);
+    TEST_ASSERT_EQUAL(2, hostHttp.log.size());
+    TEST_ASSERT_TRUE(hostHttp.log[1].body.find("image1700000005000.jpg") != std::string::npos);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(1700000000);
+    sdcardManager.init();
+    TEST_ASSERT_TRUE(uploadBacklog.init());
+    memset(frame, 0x3c, sizeof(frame));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_enqueue_defers_card_io);
+    RUN_TEST(test_frame_written_late_is_retried);
+    RUN_TEST(test_success_and_file_exists_pop);
+    RUN_TEST(test_transport_errors_and_5xx_retry);
+    RUN_TEST(test_client_errors_drop_record);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,385 @@
+/**
+ * @file test_base64.cpp
+ * @brief 用随机输入比较 lib/Base64 与它替换掉的原实现：所有编码、解码入口（含按随机分块输入的流式编解码）
+ *        结果都要一致，非法输入要被拒绝；并报告不同输入大小下各入口与原实现的吞吐量。
+ *
+ * 下面的 reference 即原来逐字节处理的实现，除改用 std::string 外未作修改。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "_Base64.h"
+
+#define FUZZ_CASES 20000    // 每个用例的随机输入数
+#define FUZZ_MAX_LENGTH 300 // 随机输入的最大长度
+#define BENCH_BYTES (4 * 1024 * 1024) // 每种入口在每个输入大小下处理的总字节数
+#define BENCH_CHUNK 512               // 流式编解码每次输入的字节数
+
+namespace reference
+{
+static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void bytes3To4(unsigned char *output, const unsigned char *input)
+{
+    output[0] = (input[0] & 0xfc) >> 2;
+    output[1] = ((input[0] & 0x03) << 4) + ((input[1] & 0xf0) >> 4);
+    output[2] = ((input[1] & 0x0f) << 2) + ((input[2] & 0xc0) >> 6);
+    output[3] = (input[2] & 0x3f);
+}
+
+static void bytes4To3(unsigned char *output, const unsigned char *input)
+{
+    output[0] = (input[0] << 2) + ((input[1] & 0x30) >> 4);
+    output[1] = ((input[1] & 0xf) << 4) + ((input[2] & 0x3c) >> 2);
+    output[2] = ((input[2] & 0x3) << 6) + input[3];
+}
+
+static unsigned char lookup(char character)
+{
+    if (character >= 'A' && character <= 'Z')
+        return character - 'A';
+    if (character >= 'a' && character <= 'z')
+        return character - 71;
+    if (character >= '0' && character <= '9')
+        return character + 4;
+    if (character == '+')
+        return 62;
+    if (character == '/')
+        return 63;
+    return -1;
+}
+
+static std::string encode(const std::string &input)
+{
+    std::string output;
+    int i = 0;
+    unsigned char bytes3[3];
+    unsigned char bytes4[4];
+    for (unsigned char c : input)
+    {
+        bytes3[i++] = c;
+        if (i == 3)
+        {
+            bytes3To4(bytes4, bytes3);
+            for (i = 0; i < 4; i++)
+            {
+                output += alphabet[bytes4[i]];
+            }
+            i = 0;
+        }
+    }
+    if (i)
+    {
+        for (int j = i; j < 3; j++)
+        {
+            bytes3[j] = '\0';
+        }
+        bytes3To4(bytes4, bytes3);
+        for (int j = 0; j < i + 1; j++)
+        {
+            output += alphabet[bytes4[j]];
+        }
+        while (i++ < 3)
+        {
+            output += '=';
+        }
+    }
+    return output;
+}
+
+static std::string decode(const std::string &input)
+{
+    std::string output;
+    int i = 0;
+    unsigned char bytes3[3];
+    unsigned char bytes4[4];
+    for (char c : input)
+    {
+        if (c == '=')
+        {
+            break;
+        }
+        bytes4[i++] = c;
+        if (i == 4)
+        {
+            for (i = 0; i < 4; i++)
+            {
+                bytes4[i] = lookup(bytes4[i]);
+            }
+            bytes4To3(bytes3, bytes4);
+            output.append((const char *)bytes3, 3);
+            i = 0;
+        }
+    }
+    if (i)
+    {
+        for (int j = i; j < 4; j++)
+        {
+            bytes4[j] = '\0';
+        }
+        for (int j = 0; j < 4; j++)
+        {
+            bytes4[j] = lookup(bytes4[j]);
+        }
+        bytes4To3(bytes3, bytes4);
+        output.append((const char *)bytes3, i - 1);
+    }
+    return output;
+}
+
+static std::string urlSafe(std::string encoded)
+{
+    for (auto &c : encoded)
+    {
+        c = c == '+' ? '-' : c == '/' ? '_' : c;
+    }
+    return encoded;
+}
+} // namespace reference
+
+static std::string randomBytes()
+{
+    std::string bytes(rand() % (FUZZ_MAX_LENGTH + 1), 0);
+    for (auto &c : bytes)
+    {
+        c = (char)rand();
+    }
+    return bytes;
+}
+
+static std::string toString(const std::vector<uint8_t> &bytes)
+{
+    return std::string(bytes.begin(), bytes.end());
+}
+
+/**
+ * ### 流式编码，输入按随机大小分块（含空块）
+ */
+static std::string streamEncode(const std::string &input, bool urlSafe)
+{
+    Base64Encoder encoder(urlSafe);
+    std::vector<char> output(_Base64::encodedLength(input.size()) + 8);
+    size_t written = 0;
+    size_t offset = 0;
+    while (offset < input.size())
+    {
+        size_t chunk = std::min((size_t)(rand() % 8), input.size() - offset);
+        written += encoder.update((const uint8_t *)input.data() + offset, chunk, output.data() + written);
+        offset += chunk;
+    }
+    written += encoder.finish(output.data() + written);
+    return std::string(output.data(), written);
+}
+
+/**
+ * ### 流式解码，输入按随机大小分块，解码器报错时返回 false
+ */
+static bool streamDecode(const std::string &input, std::string &decoded)
+{
+    Base64Decoder decoder;
+    std::vector<uint8_t> output(_Base64::decodedMaxLength(input.size()) + 3);
+    int written = 0;
+    size_t offset = 0;
+    while (offset < input.size())
+    {
+        size_t chunk = std::min((size_t)(rand() % 8), input.size() - offset);
+        written += decoder.update(input.data() + offset, chunk, output.data() + written);
+        offset += chunk;
+    }
+    written += decoder.finish(output.data() + written);
+    decoded.assign((const char *)output.data(), written);
+    return !decoder.failed();
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### 编码与原实现一致
+ *
+ * 标准与 URL 安全两种字母表下，所有编码入口的输出都与原实现相同。
+ */
+void test_encode_matches_reference(void)
+{
+    srand(1);
+    for (int n = 0; n < FUZZ_CASES; n++)
+    {
+        std::string input = randomBytes();
+        const uint8_t *bytes = (const uint8_t *)input.data();
+        std::string expected = reference::encode(input);
+        std::string expectedUrl = reference::urlSafe(expected);
+
+        TEST_ASSERT_EQUAL(expected.size(), _Base64::encodedLength(input.size()));
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), _Base64::encode(bytes, input.size()).c_str());
+        TEST_ASSERT_TRUE(expected == toString(_Base64::encodeToVector(bytes, input.size())));
+        TEST_ASSERT_EQUAL_STRING(expectedUrl.c_str(), _Base64::urlSafeEncode(bytes, input.size()).c_str());
+        TEST_ASSERT_TRUE(expectedUrl == toString(_Base64::urlSafeEncodeToVector(bytes, input.size())));
+
+        std::vector<char> buffer(_Base64::encodedLength(input.size()) + 1);
+        TEST_ASSERT_EQUAL(expected.size(), _Base64::encodeTo<false>(bytes, input.size(), buffer.data()));
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), buffer.data());
+        TEST_ASSERT_EQUAL(expectedUrl.size(), _Base64::encodeTo<true>(bytes, input.size(), buffer.data()));
+        TEST_ASSERT_EQUAL_STRING(expectedUrl.c_str(), buffer.data());
+
+        TEST_ASSERT_TRUE(expected == streamEncode(input, false));
+        TEST_ASSERT_TRUE(expectedUrl == streamEncode(input, true));
+    }
+}
+
+/**
+ * ### 解码与原实现一致
+ *
+ * 带填充、不带填充与 URL 安全的编码，所有解码入口都还原出原始字节。
+ */
+void test_decode_matches_reference(void)
+{
+    srand(2);
+    for (int n = 0; n < FUZZ_CASES; n++)
+    {
+        std::string input = randomBytes();
+        std::string padded = reference::encode(input);
+        std::string unpadded = padded.substr(0, padded.find('='));
+        std::string url = reference::urlSafe(unpadded);
+        TEST_ASSERT_TRUE(input == reference::decode(padded));
+
+        const std::string *encodings[] = {&padded, &unpadded, &url};
+        for (const std::string *encoded : encodings)
+        {
+            TEST_ASSERT_TRUE(input == toString(_Base64::decode(String(encoded->c_str()))));
+            TEST_ASSERT_TRUE(input == toString(_Base64::urlSafeDecode(String(encoded->c_str()))));
+
+            std::vector<uint8_t> buffer(_Base64::decodedMaxLength(encoded->size()) + 1);
+            int written = _Base64::decodeTo(encoded->data(), encoded->size(), buffer.data());
+            TEST_ASSERT_EQUAL(input.size(), written);
+            TEST_ASSERT_EQUAL_MEMORY(input.data(), buffer.data(), input.size());
+
+            std::string streamed;
+            TEST_ASSERT_TRUE(streamDecode(*encoded, streamed));
+            TEST_ASSERT_TRUE(input == streamed);
+        }
+    }
+}
+
+/**
+ * ### 拒绝非法输入
+ *
+ * 两种字母表之外的字符以及末尾单独的一个字符都要报错。
+ */
+void test_malformed_input_rejected(void)
+{
+    srand(3);
+    const char invalid[] = " \n.*!\x80\xff";
+    for (int n = 0; n < FUZZ_CASES / 10; n++)
+    {
+        std::string input = randomBytes();
+        std::string encoded = reference::encode(input + "x");
+        encoded = encoded.substr(0, encoded.find('='));
+        encoded[rand() % encoded.size()] = invalid[rand() % (sizeof(invalid) - 1)];
+
+        std::vector<uint8_t> buffer(_Base64::decodedMaxLength(encoded.size()) + 1);
+        TEST_ASSERT_EQUAL(-1, _Base64::decodeTo(encoded.data(), encoded.size(), buffer.data()));
+        std::string streamed;
+        TEST_ASSERT_FALSE(streamDecode(encoded, streamed));
+    }
+
+    uint8_t buffer[8];
+    TEST_ASSERT_EQUAL(-1, _Base64::decodeTo("QUJDR", 5, buffer));
+}
+
+/**
+ * ### 重复执行直到处理完 BENCH_BYTES，返回 MB/s
+ */
+template <typename F>
+static double throughput(size_t size, F run)
+{
+    size_t rounds = BENCH_BYTES / size;
+    uint32_t startUs = micros();
+    for (size_t n = 0; n < rounds; n++)
+    {
+        run();
+    }
+    double elapsedUs = (double)(micros() - startUs);
+    return rounds * size / (elapsedUs > 0 ? elapsedUs : 1);
+}
+
+/**
+ * ### 吞吐量：原实现 vs 各入口
+ *
+ * 编码按原始字节计，解码按编码后的字符计。流式编解码每次输入 BENCH_CHUNK 字节。
+ */
+void test_throughput(void)
+{
+    const size_t sizes[] = {32, 1024, 64 * 1024};
+    srand(4);
+    for (size_t size : sizes)
+    {
+        std::string input(size, 0);
+        for (auto &c : input)
+        {
+            c = (char)rand();
+        }
+        const uint8_t *bytes = (const uint8_t *)input.data();
+        std::string encoded = reference::encode(input);
+        std::vector<char> text(_Base64::encodedLength(size) + 8);
+        std::vector<uint8_t> binary(_Base64::decodedMaxLength(encoded.size()) + 3);
+        size_t sink = 0;
+
+        double refEncode = throughput(size, [&]()
+                                      { sink += reference::encode(input).size(); });
+        double encodeTo = throughput(size, [&]()
+                                     { sink += _Base64::encodeTo<false>(bytes, size, text.data()); });
+        double encodeToUrl = throughput(size, [&]()
+                                        { sink += _Base64::encodeTo<true>(bytes, size, text.data()); });
+        double urlSafeEncode = throughput(size, [&]()
+                                          { sink += _Base64::urlSafeEncode(bytes, size).length(); });
+        double streamEncode = throughput(size, [&]()
+                                         {
+            Base64Encoder encoder;
+            size_t written = 0;
+            for (size_t offset = 0; offset < size; offset += BENCH_CHUNK)
+            {
+                written += encoder.update(bytes + offset, std::min((size_t)BENCH_CHUNK, size - offset), text.data() + written);
+            }
+            sink += written + encoder.finish(text.data() + written); });
+
+        double refDecode = throughput(encoded.size(), [&]()
+                                      { sink += reference::decode(encoded).size(); });
+        double decodeTo = throughput(encoded.size(), [&]()
+                                     { sink += _Base64::decodeTo(encoded.data(), encoded.size(), binary.data()); });
+        double streamDecode = throughput(encoded.size(), [&]()
+                                         {
+            Base64Decoder decoder;
+            int written = 0;
+            for (size_t offset = 0; offset < encoded.size(); offset += BENCH_CHUNK)
+            {
+                written += decoder.update(encoded.data() + offset, std::min((size_t)BENCH_CHUNK, encoded.size() - offset),
+                                          binary.data() + written);
+            }
+            sink += written + decoder.finish(binary.data() + written); });
+        TEST_ASSERT_TRUE(sink > 0);
+        TEST_ASSERT_EQUAL_MEMORY(input.data(), binary.data(), size);
+
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%6u B encode MB/s: reference %6.1f, encodeTo %6.1f, encodeTo<url> %6.1f, urlSafeEncode %6.1f, stream %6.1f",
+                 (unsigned)size, refEncode, encodeTo, encodeToUrl, urlSafeEncode, streamEncode);
+        TEST_MESSAGE(line);
+        snprintf(line, sizeof(line), "%6u B decode MB/s: reference %6.1f, decodeTo %6.1f, stream %6.1f", (unsigned)size,
+                 refDecode, decodeTo, streamDecode);
+        TEST_MESSAGE(line);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_encode_matches_reference);
+    RUN_TEST(test_decode_matches_reference);
+    RUN_TEST(test_malformed_input_rejected);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
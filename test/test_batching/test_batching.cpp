@@ -0,0 +1,203 @@
+/**
+ * @file test_batching.cpp
+ * @brief 检查属性合并发送：同一轮排队的属性合并为一条 property.post，同名属性只发送最后的值，
+ *        贴近上限的批次不会超出 PubSubClient 的发布缓冲区，并报告每次发布携带的属性数与节省的字节数。
+ *
+ * 代理替身收到属性后通过 post_reply 应答，应答在下一次 loop() 中处理。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include "IoTManager.h"
+
+Logger logger;
+WiFiClient wifiClient;
+PubSubClient mqttClient;
+TimeManager timeManager;
+IoTManager iotManager("productKey", "device", "secret", "broker.local", 1883);
+
+#define TOPIC_PROP_POST "/sys/productKey/device/thing/event/property/post"
+
+/**
+ * ### 代理替身应答每一条属性上报
+ */
+static void replyToPost(const HostMqttMessage &message)
+{
+    if (message.topic != TOPIC_PROP_POST)
+    {
+        return;
+    }
+    JsonDocument doc;
+    deserializeJson(doc, message.payload.c_str());
+    std::string reply = std::string("{\"id\":\"") + (const char *)(doc["id"] | "0") + "\",\"code\":200,\"data\":{}}";
+    hostBrokerDeliver(TOPIC_PROP_POST "_reply", reply);
+}
+
+/**
+ * ### 推进到下一次队列检查
+ *
+ * 第一次 loop() 发送排队的属性，第二次处理应答。
+ */
+static void flush()
+{
+    hostAdvanceMillis(MESSAGE_QUEUE_CHECK_INTERVAL_MS);
+    iotManager.loop();
+    iotManager.loop();
+}
+
+/**
+ * ### 代理替身收到的属性上报
+ */
+static std::vector<std::string> propertyPosts()
+{
+    std::vector<std::string> posts;
+    for (const auto &message : hostBroker.received)
+    {
+        if (message.topic == TOPIC_PROP_POST)
+        {
+            posts.push_back(message.payload);
+        }
+    }
+    return posts;
+}
+
+void setUp(void)
+{
+    flush();
+    std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+    hostBroker.received.clear();
+    hostBroker.attempts = 0;
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 合并为一次发布
+ */
+void test_properties_merged(void)
+{
+    PropertyBatchStats before = iotManager.batchStats;
+    iotManager.sendProperty("count", 42);
+    iotManager.sendProperty("temperature", 21.5);
+    iotManager.sendProperty("img", String("https://cdn.local/frame.jpg"));
+    for (int i = 0; i < 7; i++)
+    {
+        iotManager.sendProperty(String("p") + String(i), i);
+    }
+    flush();
+
+    std::vector<std::string> posts = propertyPosts();
+    TEST_ASSERT_EQUAL(1, posts.size());
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, posts[0].c_str()));
+    TEST_ASSERT_EQUAL_STRING(ALINK_METHOD_PROP_POST, doc["method"].as<const char *>());
+    JsonVariant params = doc["params"];
+    TEST_ASSERT_EQUAL(10, params.size());
+    TEST_ASSERT_EQUAL(42, params["count"].as<int>());
+    TEST_ASSERT_EQUAL_STRING("https://cdn.local/frame.jpg", params["img"].as<const char *>());
+    TEST_ASSERT_EQUAL(6, params["p6"].as<int>());
+    TEST_ASSERT_TRUE(params["temperature"].as<double>() == 21.5);
+
+    TEST_ASSERT_EQUAL(before.messages + 10, iotManager.batchStats.messages);
+    TEST_ASSERT_EQUAL(before.publishes + 1, iotManager.batchStats.publishes);
+    TEST_ASSERT_TRUE(iotManager.batchStats.bytesSaved > before.bytesSaved);
+    TEST_ASSERT_EQUAL(0, iotManager.getDeliveryStats().inFlight);
+}
+
+/**
+ * ### 同名属性只发送最后的值
+ */
+void test_last_write_wins(void)
+{
+    uint32_t superseded = iotManager.batchStats.superseded;
+    for (int i = 1; i <= 5; i++)
+    {
+        iotManager.sendProperty("temperature", i);
+    }
+    iotManager.sendProperty("mode", String("a"));
+    iotManager.sendProperty("mode", String("b"));
+    flush();
+
+    std::vector<std::string> posts = propertyPosts();
+    TEST_ASSERT_EQUAL(1, posts.size());
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, posts[0].c_str()));
+    TEST_ASSERT_EQUAL(2, doc["params"].size());
+    TEST_ASSERT_EQUAL(5, doc["params"]["temperature"].as<int>());
+    TEST_ASSERT_EQUAL_STRING("b", doc["params"]["mode"].as<const char *>());
+    TEST_ASSERT_EQUAL(superseded + 5, iotManager.batchStats.superseded);
+}
+
+/**
+ * ### 贴近上限的批次
+ *
+ * 六个长属性加一个长度递增的属性，总有一轮恰好落在负载上限附近。
+ * 每一次发布都要被代理接受，所有属性都要送达。
+ */
+void test_batches_fit_publish_buffer(void)
+{
+    std::string longValue(124, 'v');
+    for (int tail = 0; tail < 80; tail++)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            iotManager.sendProperty(String("long") + String(i), String(longValue.c_str()));
+        }
+        iotManager.sendProperty("tail", String(std::string(tail, 't').c_str()));
+        flush();
+    }
+
+    std::vector<std::string> posts = propertyPosts();
+    size_t properties = 0;
+    for (const auto &post : posts)
+    {
+        TEST_ASSERT_TRUE(strlen(TOPIC_PROP_POST) + post.size() + MQTT_PUBLISH_OVERHEAD <= MAX_BUFFER_SIZE);
+        JsonDocument doc;
+        TEST_ASSERT_FALSE(deserializeJson(doc, post.c_str()));
+        properties += doc["params"].size();
+    }
+    TEST_ASSERT_EQUAL(hostBroker.attempts, hostBroker.received.size());
+    TEST_ASSERT_EQUAL(80 * 7, properties);
+    TEST_ASSERT_EQUAL(0, iotManager.getDeliveryStats().retransmits);
+    TEST_ASSERT_EQUAL(0, iotManager.getDeliveryStats().inFlight);
+
+    char line[120];
+    snprintf(line, sizeof(line), "%u properties in %u publishes", (unsigned)properties, (unsigned)posts.size());
+    TEST_MESSAGE(line);
+}
+
+/**
+ * ### 合并统计
+ */
+void test_batch_metrics(void)
+{
+    PropertyBatchStats stats = iotManager.batchStats;
+    TEST_ASSERT_TRUE(stats.publishes > 0);
+    char line[160];
+    snprintf(line, sizeof(line), "%.2f properties/publish, %u bytes saved, %u superseded, %u us build time per publish",
+             (double)stats.messages / stats.publishes, (unsigned)stats.bytesSaved, (unsigned)stats.superseded,
+             (unsigned)(stats.buildMicros / stats.publishes));
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(stats.messages > stats.publishes);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(1700000000);
+    hostWiFi.connected = true;
+    hostBroker.respond = replyToPost;
+    iotManager.connect();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_properties_merged);
+    RUN_TEST(test_last_write_wins);
+    RUN_TEST(test_batches_fit_publish_buffer);
+    RUN_TEST(test_batch_metrics);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,216 @@
+/**
+ * @file test_delivery.cpp
+ * @brief 检查基于 `_reply` 应答的投递窗口：超时重发、重发次数用尽后放弃、断线期间不消耗发送次数，
+ *        以及代理丢包时所有消息最终都能得到应答。
+ *
+ * 每个用例使用新的 DeliveryWindow，时间由 hostAdvanceMillis() 拨快。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <vector>
+#include "DeliveryWindow.h"
+
+Logger logger;
+PubSubClient mqttClient;
+
+#define TEST_TOPIC "/sys/productKey/device/thing/event/property/post"
+
+static std::vector<uint32_t> replies; // 代理替身收到、尚未应答的消息 id
+
+/**
+ * ### 写入负载并发送
+ */
+static bool sendMessage(DeliveryWindow &window, size_t padding = 0)
+{
+    InFlightMessage *message = window.reserve(TEST_TOPIC);
+    if (!message)
+    {
+        return false;
+    }
+    size_t length = snprintf(message->payload, sizeof(message->payload), "{\"id\":\"%lu\"}", (unsigned long)message->id);
+    memset(message->payload + length, ' ', padding);
+    return window.send(message, length + padding);
+}
+
+/**
+ * ### 代理替身收到发布后记下消息 id，稍后由测试统一应答
+ */
+static void recordReply(const HostMqttMessage &message)
+{
+    replies.push_back(strtoul(message.payload.c_str() + strlen("{\"id\":\""), nullptr, 10));
+}
+
+static void acknowledgeAll(DeliveryWindow &window)
+{
+    for (uint32_t id : replies)
+    {
+        window.acknowledge(id, 200);
+    }
+    replies.clear();
+}
+
+void setUp(void)
+{
+    hostBroker.reset();
+    replies.clear();
+    mqttClient.setBufferSize(1024);
+    mqttClient.connect("device");
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 应答释放槽位
+ */
+void test_ack_releases_slot(void)
+{
+    DeliveryWindow window;
+    window.begin();
+    hostBroker.respond = recordReply;
+    TEST_ASSERT_TRUE(sendMessage(window));
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE - 1, window.available());
+    TEST_ASSERT_EQUAL(1, replies.size());
+    TEST_ASSERT_FALSE(window.acknowledge(replies[0] + 1, 200));
+    acknowledgeAll(window);
+
+    DeliveryStats stats = window.getStats();
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE, window.available());
+    TEST_ASSERT_EQUAL(1, stats.acked);
+    TEST_ASSERT_EQUAL(0, stats.retransmits);
+}
+
+/**
+ * ### 超时重发与放弃
+ *
+ * 代理收到但从不应答：每次超时重发一次，发送 DELIVERY_MAX_ATTEMPTS 次后再超时即放弃并释放槽位。
+ */
+void test_timeout_retransmit_and_expire(void)
+{
+    DeliveryWindow window;
+    window.begin();
+    TEST_ASSERT_TRUE(sendMessage(window));
+
+    window.retransmitExpired();
+    TEST_ASSERT_EQUAL(1, hostBroker.received.size());
+    for (int i = 1; i < DELIVERY_MAX_ATTEMPTS; i++)
+    {
+        hostAdvanceMillis(DELIVERY_ACK_TIMEOUT_MS);
+        window.retransmitExpired();
+        TEST_ASSERT_EQUAL(i + 1, hostBroker.received.size());
+    }
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE - 1, window.available());
+
+    hostAdvanceMillis(DELIVERY_ACK_TIMEOUT_MS);
+    window.retransmitExpired();
+    DeliveryStats stats = window.getStats();
+    TEST_ASSERT_EQUAL(DELIVERY_MAX_ATTEMPTS, hostBroker.received.size());
+    TEST_ASSERT_EQUAL(DELIVERY_MAX_ATTEMPTS - 1, stats.retransmits);
+    TEST_ASSERT_EQUAL(1, stats.expired);
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE, window.available());
+}
+
+/**
+ * ### 断线期间不消耗发送次数
+ *
+ * 断线时发出的消息等多久都不会被放弃，重连后 retransmitAll() 立即补发，应答后释放。
+ */
+void test_disconnected_keeps_message(void)
+{
+    DeliveryWindow window;
+    window.begin();
+    hostBrokerDisconnect();
+    TEST_ASSERT_FALSE(sendMessage(window));
+    for (int i = 0; i < DELIVERY_MAX_ATTEMPTS * 2; i++)
+    {
+        hostAdvanceMillis(DELIVERY_ACK_TIMEOUT_MS);
+        window.retransmitExpired();
+    }
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE - 1, window.available());
+    TEST_ASSERT_EQUAL(0, window.getStats().expired);
+
+    hostBroker.respond = recordReply;
+    TEST_ASSERT_TRUE(mqttClient.connect("device"));
+    window.retransmitAll();
+    TEST_ASSERT_EQUAL(1, replies.size());
+    acknowledgeAll(window);
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE, window.available());
+    TEST_ASSERT_EQUAL(1, window.getStats().acked);
+}
+
+/**
+ * ### 已连接仍发不出去的消息被放弃
+ *
+ * 负载超出发布缓冲区时每次发布都失败，失败计入发送次数，用尽后放弃而不是一直占住槽位。
+ */
+void test_unpublishable_message_dropped(void)
+{
+    DeliveryWindow window;
+    window.begin();
+    mqttClient.setBufferSize(256);
+    TEST_ASSERT_FALSE(sendMessage(window, 300));
+    for (int i = 1; i < DELIVERY_MAX_ATTEMPTS; i++)
+    {
+        TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE - 1, window.available());
+        hostAdvanceMillis(DELIVERY_ACK_TIMEOUT_MS);
+        window.retransmitExpired();
+    }
+    DeliveryStats stats = window.getStats();
+    TEST_ASSERT_EQUAL(DELIVERY_MAX_ATTEMPTS, hostBroker.attempts);
+    TEST_ASSERT_EQUAL(0, hostBroker.received.size());
+    TEST_ASSERT_EQUAL(1, stats.expired);
+    TEST_ASSERT_EQUAL(DELIVERY_WINDOW_SIZE, window.available());
+}
+
+/**
+ * ### 代理丢包
+ *
+ * 每三条发布丢一条，窗口满时等待应答；超时重发后全部消息都得到应答，没有放弃的消息。
+ */
+void test_lossy_broker_all_acked(void)
+{
+    const uint32_t total = 40;
+    DeliveryWindow window;
+    window.begin();
+    hostBroker.dropEvery = 3;
+    hostBroker.respond = recordReply;
+
+    uint32_t sent = 0;
+    for (int round = 0; round < 200 && window.getStats().acked < total; round++)
+    {
+        while (sent < total && window.available() > 0)
+        {
+            sendMessage(window);
+            sent++;
+        }
+        acknowledgeAll(window);
+        hostAdvanceMillis(DELIVERY_ACK_TIMEOUT_MS);
+        window.retransmitExpired();
+    }
+    acknowledgeAll(window);
+
+    DeliveryStats stats = window.getStats();
+    char line[120];
+    snprintf(line, sizeof(line), "%u messages: %u dropped by broker, %u retransmits, %u full-window waits",
+             (unsigned)total, (unsigned)hostBroker.dropped, (unsigned)stats.retransmits, (unsigned)stats.windowFull);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(total, stats.acked);
+    TEST_ASSERT_EQUAL(0, stats.expired);
+    TEST_ASSERT_EQUAL(hostBroker.dropped, stats.retransmits);
+}
+
+int main()
+{
+    logger.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_ack_releases_slot);
+    RUN_TEST(test_timeout_retransmit_and_expire);
+    RUN_TEST(test_disconnected_keeps_message);
+    RUN_TEST(test_unpublishable_message_dropped);
+    RUN_TEST(test_lossy_broker_all_acked);
+    int failures = UNITY_END();
+    // 日志任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
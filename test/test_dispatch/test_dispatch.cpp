@@ -0,0 +1,187 @@
+/**
+ * @file test_dispatch.cpp
+ * @brief 检查回调索引的精确查找、重复绑定与解绑、MQTT 通配符匹配，
+ *        并在 1、32、256 个绑定下比较索引查找与原来逐个比较 String 的耗时。
+ */
+
+#include <unity.h>
+#include <vector>
+#include "CallbackIndex.h"
+
+#define BENCH_LOOKUPS 200000 // 每种绑定数下的查找次数
+
+static int exactCalls = 0;
+static int plusCalls = 0;
+static int hashCalls = 0;
+static int lastValue = 0;
+
+static void onExact(JsonVariant value)
+{
+    exactCalls++;
+    lastValue = value.as<int>();
+}
+
+static void onExactReplaced(JsonVariant value)
+{
+    exactCalls += 100;
+    lastValue = value.as<int>();
+}
+
+static void onPlus(JsonVariant) { plusCalls++; }
+
+static void onHash(JsonVariant) { hashCalls++; }
+
+static void onBench(JsonVariant) {}
+
+void setUp(void)
+{
+    exactCalls = plusCalls = hashCalls = lastValue = 0;
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 精确查找
+ *
+ * 键不要求以 0 结尾；重复绑定替换原回调；解绑后查不到。
+ */
+void test_exact_lookup(void)
+{
+    CallbackIndex index;
+    index.bind("temperature", onExact);
+    index.bind("humidity", onExact);
+    TEST_ASSERT_EQUAL(2, index.size());
+
+    const char *payload = "temperaturehumidity";
+    TEST_ASSERT_TRUE(index.find(payload, 11) == onExact);
+    TEST_ASSERT_TRUE(index.find(payload + 11, 8) == onExact);
+    TEST_ASSERT_TRUE(index.find(payload, 10) == nullptr);
+    TEST_ASSERT_TRUE(index.find("pressure", 8) == nullptr);
+
+    index.bind("temperature", onExactReplaced);
+    TEST_ASSERT_EQUAL(2, index.size());
+    TEST_ASSERT_TRUE(index.find("temperature", 11) == onExactReplaced);
+
+    TEST_ASSERT_TRUE(index.unbind("temperature"));
+    TEST_ASSERT_FALSE(index.unbind("temperature"));
+    TEST_ASSERT_TRUE(index.find("temperature", 11) == nullptr);
+    TEST_ASSERT_TRUE(index.find("humidity", 8) == onExact);
+}
+
+/**
+ * ### 主题分发
+ *
+ * 精确主题和所有匹配的通配符过滤器各调用一次。
+ */
+void test_topic_dispatch(void)
+{
+    CallbackIndex index;
+    index.bind("/sys/pk/dev/thing/event/user/cmd", onExact);
+    index.bind("/sys/pk/dev/thing/event/+/cmd", onPlus);
+    index.bind("/sys/pk/dev/#", onHash);
+
+    JsonDocument doc;
+    deserializeJson(doc, "7");
+    TEST_ASSERT_EQUAL(3, index.dispatchTopic("/sys/pk/dev/thing/event/user/cmd", doc.as<JsonVariant>()));
+    TEST_ASSERT_EQUAL(1, exactCalls);
+    TEST_ASSERT_EQUAL(7, lastValue);
+    TEST_ASSERT_EQUAL(1, plusCalls);
+    TEST_ASSERT_EQUAL(1, hashCalls);
+
+    TEST_ASSERT_EQUAL(1, index.dispatchTopic("/sys/pk/dev/thing/event/user/other", doc.as<JsonVariant>()));
+    TEST_ASSERT_EQUAL(0, index.dispatchTopic("/sys/pk/other/thing", doc.as<JsonVariant>()));
+    TEST_ASSERT_EQUAL(2, hashCalls);
+
+    TEST_ASSERT_TRUE(index.unbind("/sys/pk/dev/#"));
+    TEST_ASSERT_EQUAL(0, index.dispatchTopic("/sys/pk/dev/thing/event/user/other", doc.as<JsonVariant>()));
+}
+
+/**
+ * ### 通配符匹配规则
+ */
+void test_topic_matches(void)
+{
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("a/b/c", "a/b/c"));
+    TEST_ASSERT_FALSE(CallbackIndex::topicMatches("a/b/c", "a/b"));
+    TEST_ASSERT_FALSE(CallbackIndex::topicMatches("a/b", "a/b/c"));
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("a/+/c", "a/b/c"));
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("a/+/c", "a//c"));
+    TEST_ASSERT_FALSE(CallbackIndex::topicMatches("a/+/c", "a/b/d/c"));
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("a/+", "a/b"));
+    TEST_ASSERT_FALSE(CallbackIndex::topicMatches("a/+", "a/b/c"));
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("a/#", "a/b/c"));
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("a/#", "a"));
+    TEST_ASSERT_TRUE(CallbackIndex::topicMatches("#", "a/b"));
+    TEST_ASSERT_FALSE(CallbackIndex::topicMatches("b/#", "a/b"));
+}
+
+/**
+ * ### 查找耗时：索引 vs 逐个比较 String
+ *
+ * 原来的分发对每条属性遍历全部绑定并比较 String。查找的键轮流取自全部绑定和一个未绑定的键，
+ * 报告每次查找的平均耗时。
+ */
+void test_lookup_cost(void)
+{
+    const size_t counts[] = {1, 32, 256};
+    double indexNs[3];
+    double linearNs[3];
+    for (int c = 0; c < 3; c++)
+    {
+        size_t count = counts[c];
+        CallbackIndex index;
+        std::vector<CallbackEntry> linear;
+        std::vector<String> keys;
+        for (size_t i = 0; i < count; i++)
+        {
+            keys.push_back(String("property_") + String((int)i));
+            index.bind(keys.back(), onBench);
+            linear.push_back({keys.back(), 0, onBench});
+        }
+        keys.push_back("unbound_property");
+
+        size_t found = 0;
+        uint32_t startUs = micros();
+        for (uint32_t n = 0; n < BENCH_LOOKUPS; n++)
+        {
+            const String &key = keys[n % keys.size()];
+            found += index.find(key.c_str(), key.length()) != nullptr;
+        }
+        indexNs[c] = (micros() - startUs) * 1000.0 / BENCH_LOOKUPS;
+        TEST_ASSERT_EQUAL(BENCH_LOOKUPS - BENCH_LOOKUPS / keys.size(), found);
+
+        found = 0;
+        startUs = micros();
+        for (uint32_t n = 0; n < BENCH_LOOKUPS; n++)
+        {
+            const char *key = keys[n % keys.size()].c_str();
+            for (const auto &entry : linear)
+            {
+                if (entry.key == key)
+                {
+                    found++;
+                    break;
+                }
+            }
+        }
+        linearNs[c] = (micros() - startUs) * 1000.0 / BENCH_LOOKUPS;
+        TEST_ASSERT_EQUAL(BENCH_LOOKUPS - BENCH_LOOKUPS / keys.size(), found);
+
+        char line[96];
+        snprintf(line, sizeof(line), "%3u bindings: index %7.1f ns/lookup, linear %7.1f ns/lookup", (unsigned)count,
+                 indexNs[c], linearNs[c]);
+        TEST_MESSAGE(line);
+    }
+    // 索引的查找耗时与绑定数基本无关，逐个比较随绑定数线性增长
+    TEST_ASSERT_TRUE(indexNs[2] < linearNs[2]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_exact_lookup);
+    RUN_TEST(test_topic_dispatch);
+    RUN_TEST(test_topic_matches);
+    RUN_TEST(test_lookup_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file test_keepalive.cpp
+ * @brief 连续上传 1000 帧，比较复用长连接与每次新建连接的连接数和平均耗时，
+ *        并检查服务端关闭空闲连接、WiFi 断开后能否自动重连。
+ *
+ * 建立连接的耗时由 hostHttp.connectUs 模拟（TCP 握手）。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include "QiniuClient.h"
+
+_Base64 _base64;
+Logger logger;
+WiFiClient wifiClient;
+TimeManager timeManager;
+WifiManager wifiManager("ssid", "password");
+
+#define BENCH_FRAMES 1000             // 每种方式上传的帧数
+#define BENCH_FRAME_BYTES (12 * 1024) // QVGA JPEG 的典型大小
+#define BENCH_CONNECT_US 2000         // 新建连接的耗时
+
+static uint8_t image[BENCH_FRAME_BYTES];
+
+struct KeepAliveResult
+{
+    uint32_t opened;   ///< 服务端看到的新建连接数
+    uint32_t avgUs;    ///< 平均每帧上传耗时
+    uint32_t uploaded; ///< 上传成功的帧数
+};
+
+static int uploadHandler(const HostHttpRequest &, String &response)
+{
+    response = "{\"url\":\"https://cdn.local/frame\"}";
+    return HTTP_CODE_OK;
+}
+
+static KeepAliveResult uploadFrames(QiniuClient &client)
+{
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    hostHttp.keepBodies = false;
+    hostHttp.connectUs = BENCH_CONNECT_US;
+
+    KeepAliveResult result = {0, 0, 0};
+    uint64_t totalUs = 0;
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        String name = String(QINIU_KEY_PREFIX) + String(1700000000000ULL + i) + ".jpg";
+        uint32_t startUs = micros();
+        if (client.uploadImage(name, image, sizeof(image)) != "")
+        {
+            result.uploaded++;
+        }
+        totalUs += micros() - startUs;
+    }
+    result.opened = hostHttp.opened;
+    result.avgUs = (uint32_t)(totalUs / BENCH_FRAMES);
+    return result;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * ### 长连接与短连接的对比
+ *
+ * 长连接只在第一帧建立一次连接，其余帧省去握手，平均耗时更低。
+ */
+void test_keepalive_over_1000_frames(void)
+{
+    QiniuClient perRequest("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    perRequest.setReuse(false);
+    KeepAliveResult closed = uploadFrames(perRequest);
+
+    QiniuClient keepAlive("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    KeepAliveResult reused = uploadFrames(keepAlive);
+
+    char line[160];
+    snprintf(line, sizeof(line), "per-request: %u connections, %u us/frame | keep-alive: %u connections, %u us/frame",
+             (unsigned)closed.opened, (unsigned)closed.avgUs, (unsigned)reused.opened, (unsigned)reused.avgUs);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL(BENCH_FRAMES, closed.uploaded);
+    TEST_ASSERT_EQUAL(BENCH_FRAMES, reused.uploaded);
+    TEST_ASSERT_EQUAL(BENCH_FRAMES, closed.opened);
+    TEST_ASSERT_EQUAL(1, reused.opened);
+    TEST_ASSERT_EQUAL(1, keepAlive.connectionStats.opened);
+    TEST_ASSERT_EQUAL(BENCH_FRAMES - 1, keepAlive.connectionStats.reused);
+    TEST_ASSERT_TRUE(reused.avgUs + BENCH_CONNECT_US / 2 < closed.avgUs);
+}
+
+/**
+ * ### 服务端关闭空闲连接
+ *
+ * 复用已关闭的连接失败后，用新连接重发一次，上传本身不失败。
+ */
+void test_stale_connection_is_retried(void)
+{
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    QiniuClient client("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    String name = String(QINIU_KEY_PREFIX) + "1.jpg";
+
+    TEST_ASSERT_TRUE(client.uploadImage(name, image, sizeof(image)) != "");
+    hostHttpCloseIdle();
+    TEST_ASSERT_TRUE(client.uploadImage(name, image, sizeof(image)) != "");
+
+    TEST_ASSERT_EQUAL(1, client.connectionStats.staleRetries);
+    TEST_ASSERT_EQUAL(1, hostHttp.staleFailures);
+    TEST_ASSERT_EQUAL(2, hostHttp.opened);
+    TEST_ASSERT_EQUAL(2, hostHttp.requests);
+}
+
+/**
+ * ### WiFi 断开后直接新建连接
+ *
+ * 已知连接失效时不再先发一次注定失败的请求。
+ */
+void test_network_change_drops_connection(void)
+{
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    QiniuClient client("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    String name = String(QINIU_KEY_PREFIX) + "1.jpg";
+
+    TEST_ASSERT_TRUE(client.uploadImage(name, image, sizeof(image)) != "");
+    hostHttpCloseIdle();
+    client.onNetworkChange(false);
+    client.onNetworkChange(true);
+    TEST_ASSERT_TRUE(client.uploadImage(name, image, sizeof(image)) != "");
+
+    TEST_ASSERT_EQUAL(0, client.connectionStats.staleRetries);
+    TEST_ASSERT_EQUAL(0, hostHttp.staleFailures);
+    TEST_ASSERT_EQUAL(2, hostHttp.opened);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(1700000000);
+    memset(image, 0x5a, sizeof(image));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_keepalive_over_1000_frames);
+    RUN_TEST(test_stale_connection_is_retried);
+    RUN_TEST(test_network_change_drops_connection);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
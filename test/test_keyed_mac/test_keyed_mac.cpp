@@ -0,0 +1,248 @@
+/**
+ * @file test_keyed_mac.cpp
+ * @brief 用 RFC 4231（HMAC-SHA256）与 RFC 2202（HMAC-SHA1）的测试向量检查 KeyedMac，
+ *        并在随机密钥与消息上与按定义逐步计算的 HMAC 比较，覆盖长于分组的密钥和更换密钥；
+ *        最后比较原来每次重新建立 HMAC 上下文、逐字节 sprintf 的签名方式与 KeyedMac 每秒的签名次数。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include "KeyedMac.h"
+
+#define RANDOM_CASES 500   // 随机比较的次数
+#define BENCH_SIGNS 20000   // 每种签名方式的次数
+
+struct MacVector
+{
+    mbedtls_md_type_t type;
+    std::string key;
+    std::string message;
+    const char *hex;
+};
+
+/**
+ * ### 按定义计算 HMAC
+ *
+ * HMAC(K, m) = H((K⊕opad) || H((K⊕ipad) || m))，每次从头派生密钥块，作为对照。
+ */
+static void referenceHmac(mbedtls_md_type_t type, const std::string &key, const std::string &message, uint8_t *output)
+{
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(type);
+    size_t digestSize = mbedtls_md_get_size(info);
+    uint8_t block[64] = {0};
+    if (key.size() > sizeof(block))
+    {
+        mbedtls_md(info, (const uint8_t *)key.data(), key.size(), block);
+    }
+    else
+    {
+        memcpy(block, key.data(), key.size());
+    }
+
+    std::string inner(64, 0);
+    std::string outer(64, 0);
+    for (size_t i = 0; i < 64; i++)
+    {
+        inner[i] = block[i] ^ 0x36;
+        outer[i] = block[i] ^ 0x5c;
+    }
+    inner += message;
+    uint8_t innerDigest[KEYED_MAC_MAX_SIZE];
+    mbedtls_md(info, (const uint8_t *)inner.data(), inner.size(), innerDigest);
+    outer.append((const char *)innerDigest, digestSize);
+    mbedtls_md(info, (const uint8_t *)outer.data(), outer.size(), output);
+}
+
+/**
+ * ### 原来的签名方式
+ *
+ * 每次签名都重新建立 HMAC 上下文、从密钥派生 ipad/opad，再逐字节 sprintf 成十六进制。
+ */
+static void legacySignHex(mbedtls_md_type_t type, const char *key, const char *message, char *output)
+{
+    uint8_t sign[KEYED_MAC_MAX_SIZE];
+    mbedtls_md_context_t ctx;
+    const mbedtls_md_info_t *md_info = mbedtls_md_info_from_type(type);
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, md_info, 1);
+    mbedtls_md_hmac_starts(&ctx, (const unsigned char *)key, strlen(key));
+    mbedtls_md_hmac_update(&ctx, (const unsigned char *)message, strlen(message));
+    mbedtls_md_hmac_finish(&ctx, sign);
+    mbedtls_md_free(&ctx);
+    size_t size = mbedtls_md_get_size(md_info);
+    for (size_t i = 0; i < size; i++)
+    {
+        sprintf(&output[i * 2], "%02x", sign[i]);
+    }
+    output[size * 2] = '\0';
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### RFC 测试向量
+ */
+void test_rfc_vectors(void)
+{
+    std::string key25;
+    for (int i = 1; i <= 25; i++)
+    {
+        key25 += (char)i;
+    }
+    const MacVector vectors[] = {
+        {MBEDTLS_MD_SHA256, std::string(20, '\x0b'), "Hi There",
+         "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+        {MBEDTLS_MD_SHA256, "Jefe", "what do ya want for nothing?",
+         "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+        {MBEDTLS_MD_SHA256, std::string(20, '\xaa'), std::string(50, '\xdd'),
+         "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe"},
+        {MBEDTLS_MD_SHA256, key25, std::string(50, '\xcd'),
+         "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b"},
+        {MBEDTLS_MD_SHA256, std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First",
+         "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+        {MBEDTLS_MD_SHA256, std::string(131, '\xaa'),
+         "This is a test using a larger than block-size key and a larger than block-size data. "
+         "The key needs to be hashed before being used by the HMAC algorithm.",
+         "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2"},
+        {MBEDTLS_MD_SHA1, std::string(20, '\x0b'), "Hi There", "b617318655057264e28bc0b6fb378c8ef146be00"},
+        {MBEDTLS_MD_SHA1, "Jefe", "what do ya want for nothing?", "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+        {MBEDTLS_MD_SHA1, std::string(80, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First",
+         "aa4ae5e15272d00e95705637ce8a3b55ed402112"},
+    };
+
+    for (const auto &vector : vectors)
+    {
+        KeyedMac mac(vector.type);
+        TEST_ASSERT_FALSE(mac.keyed());
+        TEST_ASSERT_TRUE(mac.setKey((const uint8_t *)vector.key.data(), vector.key.size()));
+        uint8_t digest[KEYED_MAC_MAX_SIZE];
+        TEST_ASSERT_TRUE(mac.sign((const uint8_t *)vector.message.data(), vector.message.size(), digest));
+        char hex[2 * KEYED_MAC_MAX_SIZE + 1];
+        KeyedMac::toHex(digest, mac.size(), hex);
+        TEST_ASSERT_EQUAL_STRING(vector.hex, hex);
+    }
+}
+
+/**
+ * ### 随机密钥与消息
+ *
+ * 同一个实例反复更换密钥，密钥长度覆盖 0 到两个分组，结果与按定义计算的一致。
+ */
+void test_random_against_reference(void)
+{
+    srand(20240501);
+    const mbedtls_md_type_t types[] = {MBEDTLS_MD_SHA256, MBEDTLS_MD_SHA1};
+    for (mbedtls_md_type_t type : types)
+    {
+        KeyedMac mac(type);
+        for (int n = 0; n < RANDOM_CASES; n++)
+        {
+            std::string key(rand() % 129, 0);
+            std::string message(rand() % 300, 0);
+            for (auto &c : key)
+            {
+                c = (char)rand();
+            }
+            for (auto &c : message)
+            {
+                c = (char)rand();
+            }
+            TEST_ASSERT_TRUE(mac.setKey((const uint8_t *)key.data(), key.size()));
+            uint8_t expected[KEYED_MAC_MAX_SIZE];
+            uint8_t actual[KEYED_MAC_MAX_SIZE];
+            referenceHmac(type, key, message, expected);
+            // 同一密钥签两次，检查预先计算的状态没有被第一次签名改动
+            for (int repeat = 0; repeat < 2; repeat++)
+            {
+                TEST_ASSERT_TRUE(mac.sign((const uint8_t *)message.data(), message.size(), actual));
+                TEST_ASSERT_EQUAL_MEMORY(expected, actual, mac.size());
+            }
+        }
+    }
+}
+
+/**
+ * ### 未设置密钥
+ */
+void test_sign_without_key_fails(void)
+{
+    KeyedMac mac(MBEDTLS_MD_SHA256);
+    uint8_t digest[KEYED_MAC_MAX_SIZE];
+    char hex[2 * KEYED_MAC_MAX_SIZE + 1];
+    TEST_ASSERT_FALSE(mac.sign((const uint8_t *)"x", 1, digest));
+    TEST_ASSERT_FALSE(mac.signHex("x", hex));
+}
+
+/**
+ * ### 签名耗时：每次重建上下文 vs KeyedMac
+ *
+ * SHA256 使用 deviceSecret 对 MQTT 连接参数签名（signHex），SHA1 使用 secretKey
+ * 对七牛上传策略签名（sign 后转十六进制），两种方式的结果必须一致。
+ */
+void test_sign_cost(void)
+{
+    struct BenchCase
+    {
+        const char *name;
+        mbedtls_md_type_t type;
+        const char *key;
+        const char *message;
+    };
+    const BenchCase cases[] = {
+        {"sha256 mqtt", MBEDTLS_MD_SHA256, "0123456789abcdef0123456789abcdef",
+         "clientIda1b2c3d4e5.devicedeviceNamedeviceproductKeya1b2c3d4e5timestamp1700000000000"},
+        {"sha1 qiniu", MBEDTLS_MD_SHA1, "abcdefghijklmnopqrstuvwxyz0123456789ABCD",
+         "eyJzY29wZSI6ImJ1Y2tldDpmcmFtZS0xNzAwMDAwMDAwMDAwLmpwZyIsImRlYWRsaW5lIjoxNzAwMDAzNjAwLCJpc1ByZWZp"
+         "eGFsU2NvcGUiOjEsInJldHVybkJvZHkiOiJ7XCJuYW1lXCI6XCIkKGZuYW1lKVwiLFwidXJsXCI6XCJodHRwczovL2Nkbi5s"
+         "b2NhbC8kKGtleSlcIn0ifQ"},
+    };
+    for (const BenchCase &bench : cases)
+    {
+        char legacy[2 * KEYED_MAC_MAX_SIZE + 1];
+        char current[2 * KEYED_MAC_MAX_SIZE + 1];
+        KeyedMac mac(bench.type);
+        TEST_ASSERT_TRUE(mac.setKey((const uint8_t *)bench.key, strlen(bench.key)));
+
+        uint32_t startUs = micros();
+        for (uint32_t n = 0; n < BENCH_SIGNS; n++)
+        {
+            legacySignHex(bench.type, bench.key, bench.message, legacy);
+        }
+        double legacyUs = (double)(micros() - startUs);
+
+        startUs = micros();
+        for (uint32_t n = 0; n < BENCH_SIGNS; n++)
+        {
+            if (bench.type == MBEDTLS_MD_SHA256)
+            {
+                mac.signHex(bench.message, current);
+            }
+            else
+            {
+                uint8_t digest[KEYED_MAC_MAX_SIZE];
+                mac.sign((const uint8_t *)bench.message, strlen(bench.message), digest);
+                KeyedMac::toHex(digest, mac.size(), current);
+            }
+        }
+        double currentUs = (double)(micros() - startUs);
+        TEST_ASSERT_EQUAL_STRING(legacy, current);
+
+        char line[128];
+        snprintf(line, sizeof(line), "%-11s: legacy %8.0f signs/s, KeyedMac %8.0f signs/s (%.2fx)", bench.name,
+                 BENCH_SIGNS * 1e6 / legacyUs, BENCH_SIGNS * 1e6 / currentUs, legacyUs / currentUs);
+        TEST_MESSAGE(line);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rfc_vectors);
+    RUN_TEST(test_random_against_reference);
+    RUN_TEST(test_sign_without_key_fails);
+    RUN_TEST(test_sign_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,273 @@
+/**
+ * @file test_log_filter.cpp
+ * @brief 检查日志的编译期与运行时过滤：被过滤的调用不求值参数、不格式化，
+ *        编译期删除的调用也不计入运行时过滤数；并比较被过滤与实际记录的调用开销，
+ *        以及每帧采集路径上的日志与原来 String + Serial.println 日志的开销。
+ *
+ * 本文件以 LOG_COMPILE_LEVEL=INFO、去掉 CAMERA 模块编译，与 env:esp32cam_release 的 build_flags 相同。
+ */
+
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#define LOG_MODULE_MASK (~(1u << LOG_MODULE_CAMERA))
+
+#include <unity.h>
+#include <stdlib.h>
+#include "Logger.h"
+
+Logger logger;
+
+#define BENCH_CALLS 100000 // 被过滤的调用次数
+#define BENCH_BATCHES 50    // 实际记录的批数，每批 LOG_RING_LENGTH 条
+#define BENCH_FRAMES 20     // 每帧日志的重放帧数，原来的日志每帧要等串口，次数不宜多
+#define UART_US_PER_BYTE 87 // 115200 波特
+
+// 一帧采集、写卡、上传、上报属性时的日志参数
+static const char *const FRAME_FILE = "/image/2023-11-14/22/image1700000000.jpg";
+static const char *const FRAME_URL = "https://cdn.example.com/image/2023-11-14/22/image1700000000.jpg";
+static const char *const FRAME_TOPIC = "/sys/productKey/device/thing/event/property/post";
+static const char *const FRAME_PAYLOAD =
+    "{\"id\":\"17\",\"version\":\"1.0\",\"params\":{\"img\":"
+    "\"https://cdn.example.com/image/2023-11-14/22/image1700000000.jpg\"},\"method\":\"thing.event.property.post\"}";
+
+static int evaluations = 0;
+
+static int argument()
+{
+    evaluations++;
+    return evaluations;
+}
+
+void setUp(void)
+{
+    evaluations = 0;
+    logger.applyLevelOverrides("*=debug");
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 编译期过滤
+ *
+ * 低于 LOG_COMPILE_LEVEL 的级别与不在 LOG_MODULE_MASK 中的模块整体删除：参数不求值，
+ * 运行时也看不到这些调用。
+ */
+void test_compile_time_filter(void)
+{
+    LoggerStats before = logger.getStats();
+    LOG_DEBUG(MQTT, "debug %d", argument());
+    LOG_ERROR(CAMERA, "camera %d", argument());
+    LoggerStats after = logger.getStats();
+    TEST_ASSERT_EQUAL(0, evaluations);
+    TEST_ASSERT_EQUAL(before.filtered, after.filtered);
+    TEST_ASSERT_EQUAL(before.records, after.records);
+
+    LOG_INFO(MQTT, "info %d", argument());
+    TEST_ASSERT_EQUAL(1, evaluations);
+    TEST_ASSERT_EQUAL(before.records + 1, logger.getStats().records);
+}
+
+/**
+ * ### 运行时按模块过滤
+ *
+ * 低于模块级别的调用只计入 filtered，不求值参数；其他模块不受影响。
+ */
+void test_runtime_module_level(void)
+{
+    logger.setModuleLevel(LOG_MODULE_MQTT, LOG_LEVEL_WARNING);
+    LoggerStats before = logger.getStats();
+    LOG_INFO(MQTT, "info %d", argument());
+    LOG_WARNING(MQTT, "warning %d", argument());
+    LOG_INFO(WIFI, "wifi %d", argument());
+    LoggerStats after = logger.getStats();
+    TEST_ASSERT_EQUAL(2, evaluations);
+    TEST_ASSERT_EQUAL(before.filtered + 1, after.filtered);
+    TEST_ASSERT_EQUAL(before.records + 2, after.records);
+
+    logger.setModuleLevel(LOG_MODULE_MQTT, LOG_LEVEL_NONE);
+    LOG_ERROR(MQTT, "error %d", argument());
+    TEST_ASSERT_EQUAL(2, evaluations);
+}
+
+/**
+ * ### 文本配置
+ *
+ * 条目按顺序生效，模块名不区分大小写；无效条目被忽略并返回 false。
+ */
+void test_level_overrides(void)
+{
+    TEST_ASSERT_TRUE(logger.applyLevelOverrides("*=error,mqtt=info,WiFi=none"));
+    LoggerStats before = logger.getStats();
+    LOG_WARNING(QINIU, "qiniu %d", argument());
+    LOG_INFO(MQTT, "mqtt %d", argument());
+    LOG_ERROR(WIFI, "wifi %d", argument());
+    LOG_ERROR(TIME, "time %d", argument());
+    LoggerStats after = logger.getStats();
+    TEST_ASSERT_EQUAL(2, evaluations);
+    TEST_ASSERT_EQUAL(before.filtered + 2, after.filtered);
+
+    TEST_ASSERT_FALSE(logger.applyLevelOverrides("mqtt=loud,nosuch=info,time=debug"));
+    evaluations = 0;
+    LOG_INFO(TIME, "time %d", argument());
+    LOG_INFO(MQTT, "mqtt %d", argument());
+    TEST_ASSERT_EQUAL(2, evaluations);
+    TEST_ASSERT_FALSE(logger.applyLevelOverrides(nullptr));
+}
+
+/**
+ * ### 调用开销：被过滤 vs 实际记录
+ */
+void test_filtered_call_cost(void)
+{
+    logger.setModuleLevel(LOG_MODULE_SDCARD, LOG_LEVEL_ERROR);
+    uint32_t startUs = micros();
+    for (int i = 0; i < BENCH_CALLS; i++)
+    {
+        LOG_INFO(SDCARD, "写入 %d 字节", i);
+    }
+    double filteredNs = (micros() - startUs) * 1000.0 / BENCH_CALLS;
+
+    // 实际记录的调用按缓冲区容量分批，每批之后等后台任务输出完，避免测到的是丢弃路径
+    logger.setModuleLevel(LOG_MODULE_SDCARD, LOG_LEVEL_DEBUG);
+    LoggerStats before = logger.getStats();
+    uint32_t loggedUs = 0;
+    for (int batch = 0; batch < BENCH_BATCHES; batch++)
+    {
+        delay(LOG_DRAIN_INTERVAL_MS * 3);
+        startUs = micros();
+        for (int i = 0; i < LOG_RING_LENGTH; i++)
+        {
+            LOG_INFO(SDCARD, "写入 %d 字节", i);
+        }
+        loggedUs += micros() - startUs;
+    }
+    double loggedNs = loggedUs * 1000.0 / (BENCH_BATCHES * LOG_RING_LENGTH);
+    LoggerStats after = logger.getStats();
+
+    char line[120];
+    snprintf(line, sizeof(line), "filtered %.1f ns per call, logged %.1f ns per call (%u dropped)", filteredNs,
+             loggedNs, (unsigned)(after.dropped - before.dropped));
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(filteredNs < loggedNs);
+}
+
+/**
+ * ### 原来的 TimeManager::getFormattedDate()/getFormattedTime()
+ */
+static String legacyFormatted(const char *format)
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo))
+    {
+        return "";
+    }
+    char buffer[16];
+    strftime(buffer, sizeof(buffer), format, &timeinfo);
+    return String(buffer);
+}
+
+/**
+ * ### 原来的 Logger::info()：每条都取日期与时间的 String，拼接后同步写串口
+ */
+static void legacyInfo(String msg, String moduleName)
+{
+    String date = legacyFormatted("%Y-%m-%d");
+    String time = legacyFormatted("%H:%M");
+    if (date == "" || time == "")
+    {
+        Serial.println("[INFO]-[" + moduleName + "]: " + msg);
+        return;
+    }
+    Serial.println("[INFO]-" + date + " " + time + "-[" + moduleName + "]: " + msg);
+}
+
+/**
+ * ### 按原来的代码重放一帧的日志
+ */
+static void legacyFrame()
+{
+    legacyInfo("获取图像成功", "camera");
+    legacyInfo("图像保存成功: " + String(FRAME_FILE), "sdcard");
+    legacyInfo("上传成功: " + String(FRAME_URL), "Qiniu");
+    legacyInfo("发送属性 " + String(FRAME_TOPIC) + " " + String(FRAME_PAYLOAD), "MQTT");
+    legacyInfo("MQTT属性发送成功: " + String(FRAME_PAYLOAD), "MQTT");
+}
+
+/**
+ * ### 按现在的代码重放一帧的日志，与 Camera、SdCardManager、QiniuClient、IoTManager 中的调用相同
+ */
+static void frame(uint32_t id)
+{
+    LOG_INFO(CAMERA, "获取图像成功");
+    LOG_INFO(SDCARD, "图像保存成功: %s", FRAME_FILE);
+    LOG_INFO(QINIU, "上传成功: %s", FRAME_URL);
+    LOG_INFO(MQTT, "发送属性 %s %s", FRAME_TOPIC, FRAME_PAYLOAD);
+    LOG_INFO(MQTT, "MQTT属性发送成功: %lu", (unsigned long)id);
+}
+
+/**
+ * ### 每帧日志开销：原来的同步日志 vs 异步日志 vs 运行时过滤
+ *
+ * 串口按 115200 波特计时。CAMERA 在本文件中已被编译期删除；运行时级别设为 warning 后
+ * 剩下的调用只做一次级别判断，在 LOG_COMPILE_LEVEL=LOG_LEVEL_WARNING 的构建中则整体删除。
+ * 异步日志每帧之后等后台任务输出完，与实际每秒一帧的节奏相同。
+ */
+void test_per_frame_cost(void)
+{
+    struct timeval synced = {1700000000, 0};
+    settimeofday(&synced, nullptr);
+    Serial.hostUsPerByte = UART_US_PER_BYTE;
+
+    size_t bytesBefore = Serial.hostBytes;
+    uint32_t startUs = micros();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        legacyFrame();
+    }
+    double legacyUs = (double)(micros() - startUs) / BENCH_FRAMES;
+    size_t legacyBytes = (Serial.hostBytes - bytesBefore) / BENCH_FRAMES;
+
+    LoggerStats before = logger.getStats();
+    uint32_t asyncUs = 0;
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        startUs = micros();
+        frame(i);
+        asyncUs += micros() - startUs;
+        delay(LOG_DRAIN_INTERVAL_MS + legacyBytes * UART_US_PER_BYTE / 1000);
+    }
+    LoggerStats after = logger.getStats();
+    TEST_ASSERT_EQUAL(4 * BENCH_FRAMES, after.records - before.records);
+    TEST_ASSERT_EQUAL(before.dropped, after.dropped);
+
+    logger.applyLevelOverrides("*=warning");
+    startUs = micros();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        frame(i);
+    }
+    double filteredUs = (double)(micros() - startUs) / BENCH_FRAMES;
+    TEST_ASSERT_EQUAL(after.records, logger.getStats().records);
+    Serial.hostUsPerByte = 0;
+
+    char line[160];
+    snprintf(line, sizeof(line), "per frame: legacy %.1f us (%u bytes), async %.2f us, runtime filtered %.3f us",
+             legacyUs, (unsigned)legacyBytes, (double)asyncUs / BENCH_FRAMES, filteredUs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE((double)asyncUs / BENCH_FRAMES * 10 < legacyUs);
+}
+
+int main()
+{
+    logger.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_compile_time_filter);
+    RUN_TEST(test_runtime_module_level);
+    RUN_TEST(test_level_overrides);
+    RUN_TEST(test_filtered_call_cost);
+    RUN_TEST(test_per_frame_cost);
+    int failures = UNITY_END();
+    // 日志任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,193 @@
+/**
+ * @file test_logger.cpp
+ * @brief 比较同步输出与异步输出时调用方每次记录日志的耗时，并检查异步模式的输出顺序、
+ *        多任务同时写入以及缓冲区已满时的丢弃计数。
+ *
+ * 串口发送耗时由 Serial.hostUsPerByte 模拟，取 115200 波特。begin() 之前 Logger 同步输出，
+ * 因此同步用例必须最先运行。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Logger.h"
+
+Logger logger;
+
+#define UART_US_PER_BYTE 87     // 115200 波特
+#define BENCH_SYNC_CALLS 50     // 同步模式下每次调用都要等串口，次数不宜多
+#define BENCH_BURST LOG_RING_LENGTH // 异步模式下一次突发的调用数，不超过缓冲区
+#define DRAIN_TIMEOUT_MS 10000
+
+static uint32_t syncAvgUs = 0;
+
+/**
+ * ### 等待后台任务输出包含 marker 的日志
+ */
+static bool waitForOutput(const char *marker)
+{
+    uint32_t startMs = millis();
+    while (millis() - startMs < DRAIN_TIMEOUT_MS)
+    {
+        {
+            std::lock_guard<std::mutex> guard(Serial.hostLock);
+            if (Serial.hostOutput.find(marker) != std::string::npos)
+            {
+                return true;
+            }
+        }
+        delay(5);
+    }
+    return false;
+}
+
+void setUp(void)
+{
+    std::lock_guard<std::mutex> guard(Serial.hostLock);
+    Serial.hostOutput.clear();
+    Serial.hostCapture = true;
+    Serial.hostUsPerByte = UART_US_PER_BYTE;
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 同步输出：调用方等待整行发送完
+ */
+void test_sync_caller_cost(void)
+{
+    uint32_t startUs = micros();
+    for (int i = 0; i < BENCH_SYNC_CALLS; i++)
+    {
+        LOG_INFO(MQTT, "MQTT属性发送成功: %d", i);
+    }
+    syncAvgUs = (micros() - startUs) / BENCH_SYNC_CALLS;
+    TEST_ASSERT_TRUE(Serial.hostOutput.find("[INFO]-[MQTT]: MQTT属性发送成功: 49\r\n") != std::string::npos);
+
+    char line[80];
+    snprintf(line, sizeof(line), "sync : %u us per call", (unsigned)syncAvgUs);
+    TEST_MESSAGE(line);
+}
+
+/**
+ * ### 异步输出：调用方只格式化进缓冲区
+ *
+ * 一次突发不超过缓冲区容量，全部记录按调用顺序输出。
+ */
+void test_async_caller_cost(void)
+{
+    TEST_ASSERT_TRUE(logger.begin());
+    LoggerStats before = logger.getStats();
+    uint32_t startUs = micros();
+    for (int i = 0; i < BENCH_BURST; i++)
+    {
+        LOG_INFO(MQTT, "MQTT属性发送成功: %d", i);
+    }
+    double asyncAvgUs = (double)(micros() - startUs) / BENCH_BURST;
+    LoggerStats after = logger.getStats();
+
+    char line[120];
+    snprintf(line, sizeof(line), "async: %.2f us per call (%.2f us measured inside log())", asyncAvgUs,
+             (double)(after.callerMicros - before.callerMicros) / BENCH_BURST);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(BENCH_BURST, after.records - before.records);
+    TEST_ASSERT_EQUAL(before.dropped, after.dropped);
+    TEST_ASSERT_TRUE(asyncAvgUs * 10 < syncAvgUs);
+
+    char last[48];
+    snprintf(last, sizeof(last), "发送成功: %d\r\n", BENCH_BURST - 1);
+    TEST_ASSERT_TRUE(waitForOutput(last));
+    std::lock_guard<std::mutex> guard(Serial.hostLock);
+    size_t position = 0;
+    for (int i = 0; i < BENCH_BURST; i++)
+    {
+        char expected[48];
+        snprintf(expected, sizeof(expected), "发送成功: %d\r\n", i);
+        position = Serial.hostOutput.find(expected, position);
+        TEST_ASSERT_TRUE(position != std::string::npos);
+    }
+}
+
+/**
+ * ### 多任务同时写入
+ *
+ * 四个线程各写 8 条，每条记录都完整输出一次。
+ */
+void test_concurrent_writers(void)
+{
+    Serial.hostUsPerByte = 0;
+    LoggerStats before = logger.getStats();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++)
+    {
+        writers.emplace_back([t]()
+                             {
+            for (int i = 0; i < 8; i++)
+            {
+                LOG_WARNING(PIPELINE, "writer %d record %d", t, i);
+            } });
+    }
+    for (auto &writer : writers)
+    {
+        writer.join();
+    }
+    LoggerStats after = logger.getStats();
+    TEST_ASSERT_EQUAL(32, (after.records - before.records) + (after.dropped - before.dropped));
+
+    // 缓冲区可能刚被写满，重试到结束标记写入为止
+    uint32_t records = after.records;
+    while (logger.getStats().records == records)
+    {
+        LOG_ERROR(LOGGER, "concurrent done");
+        delay(1);
+    }
+    TEST_ASSERT_TRUE(waitForOutput("concurrent done"));
+    std::lock_guard<std::mutex> guard(Serial.hostLock);
+    size_t lines = 0;
+    for (size_t p = Serial.hostOutput.find("[WARNING]-[pipeline]: writer "); p != std::string::npos;
+         p = Serial.hostOutput.find("[WARNING]-[pipeline]: writer ", p + 1))
+    {
+        lines++;
+    }
+    TEST_ASSERT_EQUAL(after.records - before.records, lines);
+}
+
+/**
+ * ### 缓冲区已满时丢弃并提示
+ *
+ * 串口很慢时连续写入远超缓冲区容量的日志：调用方不等待，多出的记录被丢弃并计数，
+ * 后台任务随后输出一条丢弃提示。
+ */
+void test_overflow_dropped_and_reported(void)
+{
+    LoggerStats before = logger.getStats();
+    uint32_t startUs = micros();
+    for (int i = 0; i < 10 * LOG_RING_LENGTH; i++)
+    {
+        LOG_DEBUG(CAMERA, "frame %d", i);
+    }
+    uint32_t elapsedUs = micros() - startUs;
+    LoggerStats after = logger.getStats();
+
+    uint32_t dropped = after.dropped - before.dropped;
+    TEST_ASSERT_EQUAL(10 * LOG_RING_LENGTH, (after.records - before.records) + dropped);
+    TEST_ASSERT_TRUE(dropped > 0);
+    // 同步输出时这些调用至少要等几秒串口
+    TEST_ASSERT_TRUE(elapsedUs < 10 * LOG_RING_LENGTH * syncAvgUs / 10);
+    TEST_ASSERT_TRUE(waitForOutput("日志缓冲区已满，丢弃"));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sync_caller_cost);
+    RUN_TEST(test_async_caller_cost);
+    RUN_TEST(test_concurrent_writers);
+    RUN_TEST(test_overflow_dropped_and_reported);
+    int failures = UNITY_END();
+    // 日志任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
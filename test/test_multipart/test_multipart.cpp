@@ -0,0 +1,220 @@
+/**
+ * @file test_multipart.cpp
+ * @brief 比较表单上传的两种组包方式：整体复制到新缓冲区（改造前）与 MultipartStream 分段流式发送。
+ *
+ * 以 hostHttp 充当七牛上传服务器，分别在 QVGA/SVGA/UXGA 的典型 JPEG 大小下统计
+ * 堆占用峰值、首字节耗时（从调用上传到服务器收到第一个请求体字节）与总耗时。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include "HostHeap.h"
+#include "QiniuClient.h"
+
+_Base64 _base64;
+Logger logger;
+WiFiClient wifiClient;
+TimeManager timeManager;
+WifiManager wifiManager("ssid", "password");
+QiniuClient qiniuClient("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+
+#define BENCH_ROUNDS 20 // 每种帧大小的上传次数
+
+struct FrameSize
+{
+    const char *name;
+    size_t bytes; ///< 该分辨率下 JPEG 的典型大小
+};
+
+static const FrameSize FRAME_SIZES[] = {
+    {"QVGA", 12 * 1024},
+    {"SVGA", 48 * 1024},
+    {"UXGA", 160 * 1024},
+};
+
+struct UploadCost
+{
+    int64_t peakHeap = 0;     ///< 上传期间堆占用相对起点的最大增量
+    uint32_t firstByteUs = 0; ///< 平均首字节耗时
+    uint32_t totalUs = 0;     ///< 平均总耗时
+};
+
+static int uploadHandler(const HostHttpRequest &, String &response)
+{
+    response = "{\"url\":\"https://cdn.local/frame\"}";
+    return HTTP_CODE_OK;
+}
+
+static uint32_t lastFirstByteAt()
+{
+    std::lock_guard<std::mutex> guard(hostHttp.lock);
+    return hostHttp.log.back().firstByteAt;
+}
+
+/**
+ * ### 改造前的上传方式
+ *
+ * 与基线 QiniuClient::uploadImage 相同：表单头、图片、表单尾复制到一块新缓冲区后整体 POST。
+ * 凭证取自 qiniuClient 的缓存，两种方式只在组包上有差别。
+ */
+static int copyUpload(HTTPClient &http, const String &imageName, const uint8_t *imageData, size_t imageLength, const String &token)
+{
+    String boundary = "----WebKitFormBoundary0123456789abcdef";
+    String head = "--" + boundary + "\r\n"
+                                    "Content-Disposition: form-data; name=\"key\"\r\n\r\n" +
+                  imageName + "\r\n"
+                              "--" +
+                  boundary + "\r\n"
+                             "Content-Disposition: form-data; name=\"token\"\r\n\r\n" +
+                  token + "\r\n"
+                          "--" +
+                  boundary + "\r\n"
+                             "Content-Disposition: form-data; name=\"file\"; filename=\"" +
+                  imageName + "\"\r\n"
+                              "Content-Type: application/octet-stream\r\n\r\n";
+    String tail = "\r\n--" + boundary + "--\r\n";
+
+    size_t fullBodyLength = head.length() + imageLength + tail.length();
+    uint8_t *fullBody = new uint8_t[fullBodyLength];
+    memcpy(fullBody, head.c_str(), head.length());
+    memcpy(fullBody + head.length(), imageData, imageLength);
+    memcpy(fullBody + head.length() + imageLength, tail.c_str(), tail.length());
+
+    http.begin("http://" + qiniuClient.getUploadHost());
+    http.addHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+    http.addHeader("Content-Length", String(fullBodyLength));
+    int httpCode = http.POST(fullBody, fullBodyLength);
+    delete[] fullBody;
+    String response = http.getString();
+    http.end();
+    return httpCode;
+}
+
+static uint8_t *makeImage(size_t bytes)
+{
+    uint8_t *image = (uint8_t *)malloc(bytes);
+    for (size_t i = 0; i < bytes; i++)
+    {
+        image[i] = (uint8_t)(i * 31 + 7);
+    }
+    image[0] = 0xff;
+    image[1] = 0xd8;
+    return image;
+}
+
+static UploadCost measure(size_t bytes, bool streamed)
+{
+    uint8_t *image = makeImage(bytes);
+    String token = qiniuClient.getUploadToken();
+    String imageName = String(QINIU_KEY_PREFIX) + "1700000000000.jpg";
+    HTTPClient http;
+    UploadCost cost;
+    uint64_t firstByteUs = 0;
+    uint64_t totalUs = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        {
+            // 保留容量，避免请求记录扩容计入峰值
+            std::lock_guard<std::mutex> guard(hostHttp.lock);
+            hostHttp.log.clear();
+        }
+        int64_t base = hostHeap.resetPeak();
+        uint32_t startUs = micros();
+        if (streamed)
+        {
+            TEST_ASSERT_EQUAL_STRING("https://cdn.local/frame", qiniuClient.uploadImage(imageName, image, bytes).c_str());
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL(HTTP_CODE_OK, copyUpload(http, imageName, image, bytes, token));
+        }
+        totalUs += micros() - startUs;
+        firstByteUs += lastFirstByteAt() - startUs;
+        cost.peakHeap = max(cost.peakHeap, hostHeap.peak.load() - base);
+    }
+    free(image);
+    cost.firstByteUs = (uint32_t)(firstByteUs / BENCH_ROUNDS);
+    cost.totalUs = (uint32_t)(totalUs / BENCH_ROUNDS);
+    return cost;
+}
+
+void setUp(void)
+{
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    hostHttp.keepBodies = false;
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 流式请求体的布局与整体复制相同
+ */
+void test_streamed_body_matches_layout(void)
+{
+    hostHttp.keepBodies = true;
+    size_t bytes = 4096;
+    uint8_t *image = makeImage(bytes);
+    String url = qiniuClient.uploadImage(String(QINIU_KEY_PREFIX) + "1.jpg", image, bytes);
+    TEST_ASSERT_EQUAL_STRING("https://cdn.local/frame", url.c_str());
+
+    std::lock_guard<std::mutex> guard(hostHttp.lock);
+    const HostHttpRequest &request = hostHttp.log.back();
+    String contentType = request.header("Content-Type");
+    String boundary = contentType.substring(contentType.indexOf("boundary=") + 9);
+    TEST_ASSERT_TRUE(boundary.length() > 0);
+    const std::string &body = request.body;
+    TEST_ASSERT_EQUAL(body.size(), request.bodyLength);
+    TEST_ASSERT_EQUAL(0, body.find(std::string("--") + boundary.c_str() + "\r\n"));
+    std::string tail = std::string("\r\n--") + boundary.c_str() + "--\r\n";
+    TEST_ASSERT_EQUAL(body.size() - tail.size(), body.rfind(tail));
+    size_t imageAt = body.size() - tail.size() - bytes;
+    TEST_ASSERT_EQUAL_MEMORY(image, body.data() + imageAt, bytes);
+    TEST_ASSERT_EQUAL_STRING("application/octet-stream\r\n\r\n", body.substr(imageAt - 28, 28).c_str());
+    free(image);
+}
+
+/**
+ * ### 各分辨率下的堆峰值与耗时
+ *
+ * 整体复制的峰值至少是一帧大小，流式发送的峰值与帧大小无关。
+ */
+void test_heap_and_latency_by_frame_size(void)
+{
+    int64_t streamedPeaks[3];
+    for (size_t i = 0; i < sizeof(FRAME_SIZES) / sizeof(FRAME_SIZES[0]); i++)
+    {
+        const FrameSize &size = FRAME_SIZES[i];
+        UploadCost copied = measure(size.bytes, false);
+        UploadCost streamed = measure(size.bytes, true);
+        streamedPeaks[i] = streamed.peakHeap;
+
+        char line[200];
+        snprintf(line, sizeof(line), "%s %6u B: copy peak %7lld B ttfb %5u us total %5u us | stream peak %6lld B ttfb %5u us total %5u us",
+                 size.name, (unsigned)size.bytes,
+                 (long long)copied.peakHeap, (unsigned)copied.firstByteUs, (unsigned)copied.totalUs,
+                 (long long)streamed.peakHeap, (unsigned)streamed.firstByteUs, (unsigned)streamed.totalUs);
+        TEST_MESSAGE(line);
+
+        TEST_ASSERT_TRUE(copied.peakHeap >= (int64_t)size.bytes);
+        TEST_ASSERT_TRUE(streamed.peakHeap < (int64_t)FRAME_SIZES[0].bytes);
+    }
+    // 流式发送的峰值不随帧大小增长
+    TEST_ASSERT_INT64_WITHIN(1024, streamedPeaks[0], streamedPeaks[2]);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(1700000000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_streamed_body_matches_layout);
+    RUN_TEST(test_heap_and_latency_by_frame_size);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
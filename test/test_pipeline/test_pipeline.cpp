@@ -0,0 +1,142 @@
+/**
+ * @file test_pipeline.cpp
+ * @brief 在主机上用线程替身运行拍照 → 写卡 → 上传流水线，并与原来的串行循环比较持续帧率。
+ *
+ * 相机出帧、写卡、上传的耗时分别由 hostCamera、hostSdWriteUsPerKb、hostHttp 模拟，
+ * 串行循环的帧率约为三者之和的倒数，流水线的帧率只受最慢的一级限制。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include "FramePipeline.h"
+
+Camera camera;
+_Base64 _base64;
+Logger logger;
+WiFiClient wifiClient;
+PubSubClient mqttClient;
+SdCardManager sdcardManager;
+TimeManager timeManager;
+WifiManager wifiManager("ssid", "password");
+IoTManager iotManager("productKey", "device", "secret", "broker.local", 1883);
+QiniuClient qiniuClient("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+ResumableUploader resumableUploader(qiniuClient, 2);
+UploadBacklog uploadBacklog;
+FramePipeline framePipeline;
+
+#define BENCH_FRAME_BYTES (12 * 1024) // QVGA JPEG 的典型大小
+#define BENCH_CAPTURE_MS 30           // 相机出一帧的耗时
+#define BENCH_SD_US_PER_KB 2000       // 约 0.5 MB/s 的写卡速度
+#define BENCH_UPLOAD_MS 100           // 一次上传的往返耗时
+#define BENCH_WINDOW_MS 3000          // 每种方式的测量时长
+
+static float serialFps = 0;
+
+static int uploadHandler(const HostHttpRequest &, String &response)
+{
+    response = "{\"url\":\"https://cdn.local/frame\"}";
+    return HTTP_CODE_OK;
+}
+
+/**
+ * ### 相机因缓冲区全被占用而等待的次数
+ */
+static uint32_t cameraStalls()
+{
+    std::lock_guard<std::mutex> guard(hostCamera.lock);
+    return hostCamera.stalls;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/**
+ * ### 串行循环
+ *
+ * 与改造前 loop() 的做法相同：拍照、写卡、上传、上报依次执行。
+ */
+void test_serial_loop_fps(void)
+{
+    uint32_t frames = 0;
+    uint32_t start = millis();
+    while (millis() - start < BENCH_WINDOW_MS)
+    {
+        camera_fb_t *image = camera.capture();
+        TEST_ASSERT_NOT_NULL(image);
+        sdcardManager.saveImage(image);
+        String imageName = String(QINIU_KEY_PREFIX) + String(timeManager.getTimestamp()) + ".jpg";
+        String url = qiniuClient.uploadImage(imageName, image->buf, image->len);
+        iotManager.sendProperty("img", url != "" ? url : String("error"));
+        camera.returnFrameBuffer(image);
+        if (url != "")
+        {
+            frames++;
+        }
+    }
+    serialFps = frames * 1000.0f / (millis() - start);
+
+    char line[96];
+    snprintf(line, sizeof(line), "serial loop: %u frames, %.2f fps", (unsigned)frames, serialFps);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, frames);
+}
+
+/**
+ * ### 流水线
+ *
+ * 拍照不等待写卡和上传完成，持续帧率应明显高于串行循环；
+ * 上传比拍照慢时，排队的帧也不会占满驱动缓冲区而让拍照阻塞。
+ */
+void test_pipeline_fps(void)
+{
+    TEST_ASSERT_TRUE(sdcardManager.startWriter(SD_QUEUE_SPILL));
+    TEST_ASSERT_TRUE(framePipeline.begin(0));
+
+    // 跳过启动阶段，只统计稳定后的窗口
+    delay(500);
+    PipelineStats before = framePipeline.getStats();
+    uint32_t stallsBefore = cameraStalls();
+    delay(BENCH_WINDOW_MS);
+    PipelineStats after = framePipeline.getStats();
+    uint32_t stalls = cameraStalls() - stallsBefore;
+
+    uint32_t uploaded = after.uploaded - before.uploaded;
+    float fps = uploaded * 1000.0f / (after.elapsedMs - before.elapsedMs);
+    char line[160];
+    snprintf(line, sizeof(line), "pipeline: %u uploaded, %u captured, %u saved, %.2f fps (%.2fx serial)",
+             (unsigned)uploaded, (unsigned)(after.captured - before.captured), (unsigned)(after.saved - before.saved),
+             fps, serialFps > 0 ? fps / serialFps : 0);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL(0, after.failed);
+    TEST_ASSERT_TRUE(fps > serialFps * 1.3f);
+    // 排队的帧不能占满驱动缓冲区：拍照从不等待，且不受上传速度限制
+    TEST_ASSERT_EQUAL(0, stalls);
+    TEST_ASSERT_TRUE(after.captured - before.captured > uploaded);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(1700000000);
+
+    hostCamera.frameBytes = BENCH_FRAME_BYTES;
+    hostCamera.frameMs = BENCH_CAPTURE_MS;
+    camera.init();
+    hostSdWriteUsPerKb = BENCH_SD_US_PER_KB;
+    sdcardManager.setStorageMode(SD_STORAGE_SEGMENT);
+    sdcardManager.init();
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    hostHttp.latencyUs = BENCH_UPLOAD_MS * 1000;
+    hostHttp.keepBodies = false;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_serial_loop_fps);
+    RUN_TEST(test_pipeline_fps);
+    int failures = UNITY_END();
+    // 流水线任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,216 @@
+/**
+ * @file test_resumable.cpp
+ * @brief 用模拟的七牛分片上传 v2 服务检查 ResumableUploader：分片失败重试、
+ *        重试用尽后的断点续传、内存来源不留进度，以及文件名前缀检查。
+ *
+ * hostHttp 的 handler 按 URL 区分初始化、上传分片与合并三类请求，
+ * failuresLeft[n] 指定第 n 个分片还要失败几次（返回 503）。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <set>
+#include "ResumableUploader.h"
+
+_Base64 _base64;
+Logger logger;
+WiFiClient wifiClient;
+TimeManager timeManager;
+WifiManager wifiManager("ssid", "password");
+QiniuClient qiniuClient("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+ResumableUploader resumableUploader(qiniuClient, 2);
+
+#define TEST_PARTS 3
+#define TEST_SIZE (2 * RESUMABLE_PART_SIZE + 4096) // 最后一片不足 1MB
+
+struct MockQiniu
+{
+    int failuresLeft[TEST_PARTS + 1]; ///< 下标为分片号（从 1 开始）
+    uint32_t inits;
+    uint32_t completes;
+    uint32_t rejected;           ///< 凭证或路径不对的请求
+    std::multiset<int> partPuts; ///< 收到的分片请求（含失败的）
+    std::set<int> partsDone;     ///< 已成功的分片
+};
+
+static MockQiniu mock;
+static uint8_t *source;
+static String authorization; ///< 期望的 Authorization 头
+
+static int mockHandler(const HostHttpRequest &request, String &response)
+{
+    // 分片请求来自上传任务，这里只记录不合规的请求，由测试线程断言
+    String url = request.url;
+    int at = url.indexOf("/uploads");
+    if (at < 0 || request.header("Authorization") != authorization)
+    {
+        mock.rejected++;
+        return 401;
+    }
+    String rest = url.substring(at + 8);
+    if (rest == "")
+    {
+        mock.inits++;
+        response = "{\"uploadId\":\"u1\",\"expireAt\":" + String(1700000000 + 7 * 86400) + "}";
+        return HTTP_CODE_OK;
+    }
+    int slash = rest.indexOf('/', 1);
+    if (slash < 0)
+    {
+        mock.completes++;
+        response = "{\"url\":\"https://cdn.local/big.jpg\"}";
+        return (int)mock.partsDone.size() == TEST_PARTS ? HTTP_CODE_OK : 400;
+    }
+    int part = rest.substring(slash + 1).toInt();
+    mock.partPuts.insert(part);
+    if (mock.failuresLeft[part] > 0)
+    {
+        mock.failuresLeft[part]--;
+        response = "{\"error\":\"service unavailable\"}";
+        return 503;
+    }
+    size_t offset = (size_t)(part - 1) * RESUMABLE_PART_SIZE;
+    size_t length = min((size_t)RESUMABLE_PART_SIZE, (size_t)TEST_SIZE - offset);
+    if (request.bodyLength != length || memcmp(request.body.data(), source + offset, length) != 0)
+    {
+        return 400;
+    }
+    mock.partsDone.insert(part);
+    response = "{\"etag\":\"e" + String(part) + "\"}";
+    return HTTP_CODE_OK;
+}
+
+static void writeSource(const char *path)
+{
+    File file = SD_MMC.open(path, FILE_WRITE);
+    TEST_ASSERT_TRUE((bool)file);
+    TEST_ASSERT_EQUAL(TEST_SIZE, file.write(source, TEST_SIZE));
+    file.close();
+}
+
+static String progressFile(const String &key)
+{
+    return String(RESUMABLE_PROGRESS_DIR) + "/" + _base64.urlSafeEncode(key) + ".json";
+}
+
+void setUp(void)
+{
+    SD_MMC.hostWipe();
+    hostHttp.reset();
+    hostHttp.handler = mockHandler;
+    mock = MockQiniu();
+    authorization = "UpToken " + qiniuClient.getUploadToken();
+}
+
+void tearDown(void)
+{
+    TEST_ASSERT_EQUAL(0, mock.rejected);
+}
+
+/**
+ * ### 分片失败后重试成功
+ */
+void test_part_retry_recovers(void)
+{
+    mock.failuresLeft[2] = RESUMABLE_PART_RETRIES - 1;
+    String url = resumableUploader.uploadBuffer(String(QINIU_KEY_PREFIX) + "big.jpg", source, TEST_SIZE);
+
+    TEST_ASSERT_EQUAL_STRING("https://cdn.local/big.jpg", url.c_str());
+    TEST_ASSERT_EQUAL(1, mock.inits);
+    TEST_ASSERT_EQUAL(1, mock.completes);
+    TEST_ASSERT_EQUAL(RESUMABLE_PART_RETRIES, mock.partPuts.count(2));
+    TEST_ASSERT_EQUAL(1, mock.partPuts.count(1));
+    TEST_ASSERT_EQUAL(1, mock.partPuts.count(3));
+}
+
+/**
+ * ### 重试用尽后从断点继续
+ *
+ * 最后一次失败后不再退避等待；第二次调用只上传未完成的分片。
+ */
+void test_file_upload_resumes_after_exhausted_retries(void)
+{
+    const char *path = "/big.jpg";
+    String key = String(QINIU_KEY_PREFIX) + "big.jpg";
+    writeSource(path);
+    mock.failuresLeft[3] = RESUMABLE_PART_RETRIES;
+
+    uint32_t startMs = millis();
+    TEST_ASSERT_EQUAL_STRING("", resumableUploader.uploadFile(key, path).c_str());
+    uint32_t elapsedMs = millis() - startMs;
+    char line[64];
+    snprintf(line, sizeof(line), "failed part gave up after %u ms", (unsigned)elapsedMs);
+    TEST_MESSAGE(line);
+    // 两次退避共 500 + 1000 ms，第三次失败后直接放弃
+    TEST_ASSERT_TRUE(elapsedMs < 1500 + 1000);
+    TEST_ASSERT_EQUAL(RESUMABLE_PART_RETRIES, mock.partPuts.count(3));
+    TEST_ASSERT_EQUAL(0, mock.completes);
+    TEST_ASSERT_TRUE(SD_MMC.exists(progressFile(key)));
+
+    std::set<int> doneBefore = mock.partsDone;
+    mock.partPuts.clear();
+    String url = resumableUploader.uploadFile(key, path);
+
+    TEST_ASSERT_EQUAL_STRING("https://cdn.local/big.jpg", url.c_str());
+    TEST_ASSERT_EQUAL(1, mock.inits);
+    for (int part : doneBefore)
+    {
+        TEST_ASSERT_EQUAL(0, mock.partPuts.count(part));
+    }
+    TEST_ASSERT_EQUAL(1, mock.partPuts.count(3));
+    TEST_ASSERT_FALSE(SD_MMC.exists(progressFile(key)));
+}
+
+/**
+ * ### 内存来源不保存进度
+ *
+ * 失败后不留下进度文件，再次上传重新初始化任务。
+ */
+void test_buffer_upload_keeps_no_progress(void)
+{
+    String key = String(QINIU_KEY_PREFIX) + "buffer.jpg";
+    mock.failuresLeft[1] = RESUMABLE_PART_RETRIES;
+
+    TEST_ASSERT_EQUAL_STRING("", resumableUploader.uploadBuffer(key, source, TEST_SIZE).c_str());
+    TEST_ASSERT_FALSE(SD_MMC.exists(progressFile(key)));
+    TEST_ASSERT_FALSE(SD_MMC.exists(RESUMABLE_PROGRESS_DIR));
+
+    TEST_ASSERT_EQUAL_STRING("https://cdn.local/big.jpg", resumableUploader.uploadBuffer(key, source, TEST_SIZE).c_str());
+    TEST_ASSERT_EQUAL(2, mock.inits);
+}
+
+/**
+ * ### 文件名不在凭证前缀范围内
+ *
+ * 不发出任何请求，避免用注定被拒绝的凭证初始化任务。
+ */
+void test_key_outside_prefix_is_rejected(void)
+{
+    writeSource("/other.jpg");
+    TEST_ASSERT_EQUAL_STRING("", resumableUploader.uploadFile("other.jpg", "/other.jpg").c_str());
+    TEST_ASSERT_EQUAL_STRING("", resumableUploader.uploadBuffer("other.jpg", source, TEST_SIZE).c_str());
+    TEST_ASSERT_EQUAL(0, hostHttp.requests);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(1700000000);
+    SD_MMC.begin();
+    source = (uint8_t *)malloc(TEST_SIZE);
+    for (size_t i = 0; i < TEST_SIZE; i++)
+    {
+        source[i] = (uint8_t)(i * 7 + (i >> 12));
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_part_retry_recovers);
+    RUN_TEST(test_file_upload_resumes_after_exhausted_retries);
+    RUN_TEST(test_buffer_upload_keeps_no_progress);
+    RUN_TEST(test_key_outside_prefix_is_rejected);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,380 @@
+/**
+ * @file test_segment.cpp
+ * @brief 检查段式存储：按时间戳读回、段滚动、索引末尾残缺记录的恢复、抽稀及其替换中途掉电后的恢复，
+ *        并比较段式存储与每帧一个文件的写入耗时分位数。
+ *
+ * 每个用例开始前清空卡，用新的 SegmentStore 对象模拟重启。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "SdCardManager.h"
+
+Logger logger;
+TimeManager timeManager;
+SdCardManager sdcardManager;
+
+#define BENCH_FRAMES 300              // 每种布局写入的帧数
+#define BENCH_FRAME_BYTES (12 * 1024) // QVGA JPEG 的典型大小
+#define BENCH_FRAME_INTERVAL_MS 100   // 10 fps，同一秒内有多帧
+
+static uint8_t frame[BENCH_FRAME_BYTES];
+static const uint64_t BASE_TIMESTAMP = 1700000000000ULL;
+
+/**
+ * ### 生成与时间戳相关的帧内容
+ */
+static void fillFrame(uint64_t timestamp, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        frame[i] = (uint8_t)(timestamp * 31 + i * 7);
+    }
+}
+
+/**
+ * ### 读回一帧并与写入的内容比较
+ */
+static bool readMatches(SegmentStore &store, uint64_t timestamp, size_t len)
+{
+    uint8_t *buf = nullptr;
+    size_t readLen = 0;
+    if (!store.read(timestamp, buf, readLen))
+    {
+        return false;
+    }
+    fillFrame(timestamp, len);
+    bool same = readLen == len && memcmp(buf, frame, len) == 0;
+    free(buf);
+    return same;
+}
+
+/**
+ * ### 写入一个含 `frames` 帧的已封存段（编号 1），当前写入段为 2
+ */
+static void writeSealedSegment(uint32_t frames)
+{
+    SegmentStore store;
+    TEST_ASSERT_TRUE(store.begin());
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        uint64_t timestamp = BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS;
+        fillFrame(timestamp, 600);
+        TEST_ASSERT_TRUE(store.append(frame, 600, timestamp));
+    }
+    uint64_t late = BASE_TIMESTAMP + SEGMENT_MAX_AGE_MS + 1;
+    fillFrame(late, 600);
+    TEST_ASSERT_TRUE(store.append(frame, 600, late));
+    TEST_ASSERT_EQUAL(2, store.getSegments().size());
+}
+
+/**
+ * ### 复制文件的前 `limit` 字节
+ */
+static void copyFile(const String &from, const String &to, size_t limit)
+{
+    File src = SD_MMC.open(from, FILE_READ);
+    File dst = SD_MMC.open(to, FILE_WRITE);
+    TEST_ASSERT_TRUE(src && dst);
+    uint8_t buf[4096];
+    size_t copied = 0;
+    size_t n;
+    while (copied < limit && (n = src.read(buf, std::min(sizeof(buf), limit - copied))) > 0)
+    {
+        TEST_ASSERT_EQUAL(n, dst.write(buf, n));
+        copied += n;
+    }
+    src.close();
+    dst.close();
+}
+
+/**
+ * ### 段 1 没有留下临时文件与 .old 文件
+ */
+static void assertNoLeftovers()
+{
+    const char *suffixes[] = {SEGMENT_TMP_SUFFIX, SEGMENT_OLD_SUFFIX};
+    for (const char *suffix : suffixes)
+    {
+        TEST_ASSERT_FALSE(SD_MMC.exists(SegmentStore::segmentPath(1) + suffix));
+        TEST_ASSERT_FALSE(SD_MMC.exists(SegmentStore::indexPath(1) + suffix));
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> samples, uint32_t p)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * p / 100];
+}
+
+void setUp(void)
+{
+    SD_MMC.hostWipe();
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 按时间戳读回
+ *
+ * 同一秒内的多帧各自保留，帧从扇区对齐的偏移开始，不存在的时间戳读取失败。
+ */
+void test_append_and_read(void)
+{
+    SegmentStore store;
+    TEST_ASSERT_TRUE(store.begin());
+    for (uint64_t i = 0; i < 20; i++)
+    {
+        uint64_t timestamp = BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS;
+        fillFrame(timestamp, 1000 + i);
+        TEST_ASSERT_TRUE(store.append(frame, 1000 + i, timestamp));
+    }
+    for (uint64_t i = 0; i < 20; i++)
+    {
+        TEST_ASSERT_TRUE(readMatches(store, BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS, 1000 + i));
+    }
+    uint8_t *buf = nullptr;
+    size_t len = 0;
+    TEST_ASSERT_FALSE(store.read(BASE_TIMESTAMP + 1, buf, len));
+
+    File index = SD_MMC.open(SegmentStore::indexPath(1), FILE_READ);
+    SegmentIndexEntry entries[2];
+    TEST_ASSERT_EQUAL(sizeof(entries), index.read((uint8_t *)entries, sizeof(entries)));
+    index.close();
+    TEST_ASSERT_EQUAL(0, entries[1].offset % SEGMENT_ALIGN);
+    TEST_ASSERT_EQUAL(1001, entries[1].length);
+}
+
+/**
+ * ### 段滚动
+ *
+ * 时间跨度超限或时间戳回退时切换新段，两个段中的帧都能读回，重启后段摘要不变。
+ */
+void test_rollover_and_restart(void)
+{
+    uint64_t late = BASE_TIMESTAMP + SEGMENT_MAX_AGE_MS + 1;
+    uint64_t earlier = BASE_TIMESTAMP - 1000;
+    {
+        SegmentStore store;
+        TEST_ASSERT_TRUE(store.begin());
+        fillFrame(BASE_TIMESTAMP, 512);
+        TEST_ASSERT_TRUE(store.append(frame, 512, BASE_TIMESTAMP));
+        fillFrame(late, 512);
+        TEST_ASSERT_TRUE(store.append(frame, 512, late));
+        fillFrame(earlier, 512);
+        TEST_ASSERT_TRUE(store.append(frame, 512, earlier));
+        TEST_ASSERT_EQUAL(3, store.getSegments().size());
+    }
+
+    SegmentStore restarted;
+    TEST_ASSERT_TRUE(restarted.begin());
+    std::vector<SegmentInfo> segments = restarted.getSegments();
+    TEST_ASSERT_EQUAL(3, segments.size());
+    TEST_ASSERT_EQUAL(1, segments[0].count);
+    TEST_ASSERT_TRUE(readMatches(restarted, BASE_TIMESTAMP, 512));
+    TEST_ASSERT_TRUE(readMatches(restarted, late, 512));
+    TEST_ASSERT_TRUE(readMatches(restarted, earlier, 512));
+}
+
+/**
+ * ### 索引末尾残缺记录
+ *
+ * 模拟写索引时掉电：索引末尾只有半条记录。重启后继续写入的记录要覆盖残缺部分，
+ * 之前和之后的帧都能读回。
+ */
+void test_partial_index_entry_recovered(void)
+{
+    {
+        SegmentStore store;
+        TEST_ASSERT_TRUE(store.begin());
+        for (uint64_t i = 0; i < 3; i++)
+        {
+            uint64_t timestamp = BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS;
+            fillFrame(timestamp, 700);
+            TEST_ASSERT_TRUE(store.append(frame, 700, timestamp));
+        }
+    }
+    File index = SD_MMC.open(SegmentStore::indexPath(1), FILE_APPEND);
+    uint8_t partial[sizeof(SegmentIndexEntry) / 2];
+    memset(partial, 0xa5, sizeof(partial));
+    TEST_ASSERT_EQUAL(sizeof(partial), index.write(partial, sizeof(partial)));
+    index.close();
+
+    {
+        SegmentStore store;
+        TEST_ASSERT_TRUE(store.begin());
+        TEST_ASSERT_EQUAL(3, store.getSegments().back().count);
+        for (uint64_t i = 3; i < 6; i++)
+        {
+            uint64_t timestamp = BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS;
+            fillFrame(timestamp, 700);
+            TEST_ASSERT_TRUE(store.append(frame, 700, timestamp));
+        }
+    }
+
+    SegmentStore restarted;
+    TEST_ASSERT_TRUE(restarted.begin());
+    TEST_ASSERT_EQUAL(6, restarted.getSegments().back().count);
+    index = SD_MMC.open(SegmentStore::indexPath(1), FILE_READ);
+    TEST_ASSERT_EQUAL(6 * sizeof(SegmentIndexEntry), index.size());
+    index.close();
+    for (uint64_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT_TRUE(readMatches(restarted, BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS, 700));
+    }
+}
+
+/**
+ * ### 抽稀
+ *
+ * 保留每 keepEvery 帧中的第一帧，段文件缩小到有效数据的大小，重启后仍标记为已抽稀；
+ * 当前写入段不能抽稀。
+ */
+void test_thin_segment(void)
+{
+    writeSealedSegment(6);
+    SegmentStore store;
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_FALSE(store.thinSegment(2, 2));
+    TEST_ASSERT_TRUE(store.thinSegment(1, 2));
+    assertNoLeftovers();
+
+    SegmentStore restarted;
+    TEST_ASSERT_TRUE(restarted.begin());
+    SegmentInfo info = restarted.getSegments()[0];
+    TEST_ASSERT_EQUAL(3, info.count);
+    TEST_ASSERT_TRUE(info.thinned);
+    TEST_ASSERT_EQUAL(3 * 600, info.fileSize);
+    for (uint64_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT_EQUAL(i % 2 == 0, readMatches(restarted, BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS, 600));
+    }
+}
+
+/**
+ * ### 抽稀复制中途掉电
+ *
+ * 只留下不完整的临时文件、原文件未动：重启后删除临时文件，原段完整保留。
+ */
+void test_thinning_rolled_back(void)
+{
+    writeSealedSegment(6);
+    copyFile(SegmentStore::segmentPath(1), SegmentStore::segmentPath(1) + SEGMENT_TMP_SUFFIX, 900);
+    copyFile(SegmentStore::indexPath(1), SegmentStore::indexPath(1) + SEGMENT_TMP_SUFFIX, sizeof(SegmentIndexEntry));
+
+    SegmentStore restarted;
+    TEST_ASSERT_TRUE(restarted.begin());
+    assertNoLeftovers();
+    TEST_ASSERT_EQUAL(2, restarted.getSegments().size());
+    TEST_ASSERT_EQUAL(6, restarted.getSegments()[0].count);
+    for (uint64_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT_TRUE(readMatches(restarted, BASE_TIMESTAMP + i * BENCH_FRAME_INTERVAL_MS, 600));
+    }
+}
+
+/**
+ * ### 抽稀替换中途掉电
+ *
+ * 临时文件已写完，段文件已改名为 .old 而索引文件还没有：重启后把两个临时文件换到位、
+ * 删除 .old，段内容为抽稀后的结果。临时文件用原段的前两帧模拟抽稀结果。
+ */
+void test_thinning_rolled_forward(void)
+{
+    writeSealedSegment(6);
+    copyFile(SegmentStore::segmentPath(1), SegmentStore::segmentPath(1) + SEGMENT_TMP_SUFFIX, SEGMENT_SIZE);
+    copyFile(SegmentStore::indexPath(1), SegmentStore::indexPath(1) + SEGMENT_TMP_SUFFIX, 2 * sizeof(SegmentIndexEntry));
+    TEST_ASSERT_TRUE(SD_MMC.rename(SegmentStore::segmentPath(1), SegmentStore::segmentPath(1) + SEGMENT_OLD_SUFFIX));
+
+    SegmentStore restarted;
+    TEST_ASSERT_TRUE(restarted.begin());
+    assertNoLeftovers();
+    TEST_ASSERT_EQUAL(2, restarted.getSegments().size());
+    TEST_ASSERT_EQUAL(2, restarted.getSegments()[0].count);
+    TEST_ASSERT_TRUE(readMatches(restarted, BASE_TIMESTAMP, 600));
+    TEST_ASSERT_TRUE(readMatches(restarted, BASE_TIMESTAMP + BENCH_FRAME_INTERVAL_MS, 600));
+    TEST_ASSERT_FALSE(readMatches(restarted, BASE_TIMESTAMP + 2 * BENCH_FRAME_INTERVAL_MS, 600));
+
+    // 只剩删除 .old 时掉电
+    File old = SD_MMC.open(SegmentStore::indexPath(1) + SEGMENT_OLD_SUFFIX, FILE_WRITE);
+    old.close();
+    SegmentStore again;
+    TEST_ASSERT_TRUE(again.begin());
+    assertNoLeftovers();
+    TEST_ASSERT_EQUAL(2, again.getSegments()[0].count);
+}
+
+/**
+ * ### 写入耗时：每帧一个文件 vs 段式存储
+ *
+ * 以 10 fps 的时间戳写入同样的帧，报告每次写入耗时的分位数。
+ * 每帧一个文件时同一秒内的帧互相覆盖，段式存储保留全部帧。
+ */
+void test_write_latency_by_layout(void)
+{
+    const SdStorageMode modes[] = {SD_STORAGE_FILE, SD_STORAGE_SEGMENT};
+    const char *names[] = {"per-file", "segment"};
+    uint32_t kept[2];
+    for (int m = 0; m < 2; m++)
+    {
+        SD_MMC.hostWipe();
+        SdCardManager manager;
+        manager.setStorageMode(modes[m]);
+        manager.init();
+
+        std::vector<uint32_t> latencies;
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+        {
+            uint64_t timestamp = BASE_TIMESTAMP + (uint64_t)i * BENCH_FRAME_INTERVAL_MS;
+            fillFrame(timestamp, sizeof(frame));
+            uint32_t startUs = micros();
+            manager.saveImage(frame, sizeof(frame), timestamp);
+            latencies.push_back(micros() - startUs);
+        }
+
+        kept[m] = 0;
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+        {
+            uint64_t timestamp = BASE_TIMESTAMP + (uint64_t)i * BENCH_FRAME_INTERVAL_MS;
+            uint8_t *buf = nullptr;
+            size_t len = 0;
+            if (manager.loadImage(timestamp, buf, len))
+            {
+                fillFrame(timestamp, sizeof(frame));
+                kept[m] += len == sizeof(frame) && memcmp(buf, frame, len) == 0;
+                free(buf);
+            }
+        }
+
+        char line[160];
+        snprintf(line, sizeof(line), "%-8s: p50 %5u us p90 %5u us p99 %5u us, %u/%u frames readable",
+                 names[m], (unsigned)percentile(latencies, 50), (unsigned)percentile(latencies, 90),
+                 (unsigned)percentile(latencies, 99), (unsigned)kept[m], (unsigned)BENCH_FRAMES);
+        TEST_MESSAGE(line);
+    }
+    TEST_ASSERT_EQUAL(BENCH_FRAMES, kept[1]);
+    TEST_ASSERT_LESS_THAN(BENCH_FRAMES, kept[0]);
+}
+
+int main()
+{
+    logger.begin();
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    SD_MMC.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_append_and_read);
+    RUN_TEST(test_rollover_and_restart);
+    RUN_TEST(test_partial_index_entry_recovered);
+    RUN_TEST(test_thin_segment);
+    RUN_TEST(test_thinning_rolled_back);
+    RUN_TEST(test_thinning_rolled_forward);
+    RUN_TEST(test_write_latency_by_layout);
+    int failures = UNITY_END();
+    // 日志任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
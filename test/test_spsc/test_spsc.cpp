@@ -0,0 +1,185 @@
+/**
+ * @file test_spsc.cpp
+ * @brief 在两个线程上压测 SpscRing：生产者与消费者同时运行，检查元素不丢失、不重复、不乱序、
+ *        内容完整，队列满时丢弃的元素与溢出计数一致。
+ *
+ * 数据竞争由 ThreadSanitizer 检查：pio test -e native_tsan -f test_spsc。
+ */
+
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "SpscRing.h"
+
+#define STRESS_ITEMS 2000000 // 每个用例传递的元素数
+#define RING_SIZE 32         // 与属性队列相同的容量
+
+struct StressItem
+{
+    uint32_t sequence;
+    uint32_t words[7]; // 由 sequence 推出，检查元素是否被完整复制
+};
+
+static void fillItem(StressItem &item, uint32_t sequence)
+{
+    item.sequence = sequence;
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        item.words[i] = sequence * 2654435761u + i;
+    }
+}
+
+static bool itemIntact(const StressItem &item)
+{
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        if (item.words[i] != item.sequence * 2654435761u + i)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### 满时重试：所有元素按顺序完整送达
+ *
+ * 生产者交替使用 push() 与 claim()/commit()，消费者交替使用 peek() 与 peekAt()。
+ */
+void test_lossless_in_order(void)
+{
+    static SpscRing<StressItem, RING_SIZE> ring;
+    std::atomic<uint32_t> corrupt{0};
+    std::atomic<uint32_t> outOfOrder{0};
+
+    std::thread producer([&]()
+                         {
+        for (uint32_t sequence = 0; sequence < STRESS_ITEMS;)
+        {
+            if (sequence & 1)
+            {
+                StressItem *slot = ring.claim();
+                if (!slot)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                fillItem(*slot, sequence);
+                ring.commit();
+            }
+            else
+            {
+                StressItem item;
+                fillItem(item, sequence);
+                if (!ring.push(item))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+            sequence++;
+        } });
+
+    uint32_t expected = 0;
+    while (expected < STRESS_ITEMS)
+    {
+        size_t depth = ring.size();
+        if (depth == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // 一次取走当前可见的全部元素，与 checkMessageQueue() 的用法相同
+        for (size_t i = 0; i < depth; i++)
+        {
+            const StressItem *item = ring.peekAt(0);
+            const StressItem *last = ring.peekAt(depth - 1 - i);
+            if (!item || !last || !itemIntact(*item) || !itemIntact(*last))
+            {
+                corrupt++;
+            }
+            else if (item->sequence != expected || last->sequence != expected + depth - 1 - i)
+            {
+                outOfOrder++;
+            }
+            ring.drop();
+            expected++;
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(0, corrupt.load());
+    TEST_ASSERT_EQUAL(0, outOfOrder.load());
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_TRUE(ring.highWaterMark() <= RING_SIZE);
+    TEST_ASSERT_TRUE(ring.overflows() > 0);
+}
+
+/**
+ * ### 满时丢弃：收到的元素递增且与溢出计数对得上
+ */
+void test_drop_on_full(void)
+{
+    static SpscRing<StressItem, RING_SIZE> ring;
+    std::atomic<bool> done{false};
+
+    std::thread producer([&]()
+                         {
+        for (uint32_t sequence = 0; sequence < STRESS_ITEMS; sequence++)
+        {
+            StressItem item;
+            fillItem(item, sequence);
+            ring.push(item);
+            if (sequence % 64 == 0)
+            {
+                // 每次突发 64 个元素，超过队列容量，两端都经常在队列满与非满之间切换
+                std::this_thread::yield();
+            }
+        }
+        done = true; });
+
+    uint32_t received = 0;
+    uint32_t corrupt = 0;
+    int64_t last = -1;
+    bool increasing = true;
+    while (true)
+    {
+        bool finished = done.load();
+        const StressItem *item = ring.peek();
+        if (!item)
+        {
+            if (finished)
+            {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        corrupt += !itemIntact(*item);
+        increasing = increasing && (int64_t)item->sequence > last;
+        last = item->sequence;
+        ring.drop();
+        received++;
+    }
+    producer.join();
+
+    char line[96];
+    snprintf(line, sizeof(line), "%u received, %u dropped, high water %u", (unsigned)received,
+             (unsigned)ring.overflows(), (unsigned)ring.highWaterMark());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(0, corrupt);
+    TEST_ASSERT_TRUE(increasing);
+    TEST_ASSERT_EQUAL(STRESS_ITEMS, received + ring.overflows());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lossless_in_order);
+    RUN_TEST(test_drop_on_full);
+    return UNITY_END();
+}
@@ -0,0 +1,279 @@
+/**
+ * @file test_time_cache.cpp
+ * @brief 检查时间缓存的读取：未同步时的空结果、字符串写入调用方缓冲区并截断，同一秒内只格式化一次，
+ *        多个任务同时读取与校时时，每次得到的日期、时间与星期几互相一致，同步统计不倒退；
+ *        并比较 getter 与原来每次 getLocalTime() + strftime() 的单次耗时。
+ *
+ * 校时由 hostSntpDeliver() 模拟，在相隔数天的两个时刻之间来回切换。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TimeManager.h"
+
+Logger logger;
+TimeManager timeManager;
+
+#define TIME_A 1700000000 // 2023-11-15 06:13:20 CST，星期三
+#define TIME_B 1700300000 // 2023-11-18 17:33:20 CST，星期六
+#define READER_THREADS 3
+#define RACE_DURATION_MS 1500
+#define BENCH_CALLS 200000   // 每种 getter 的调用次数
+#define BENCH_UNSYNCED_CALLS 20 // 未同步时原实现每次至少等待 10 ms，只调用少量次数
+
+/**
+ * ### 检查一份缓存内各字段互相一致
+ */
+static bool consistent(const TimeCache &cache)
+{
+    char date[TIME_DATE_SIZE];
+    strftime(date, sizeof(date), "%Y-%m-%d", &cache.timeinfo);
+    if (strcmp(date, cache.date) != 0)
+    {
+        return false;
+    }
+    // dateAndTime 为 YYYYMMDDHHMMSS，前 8 位与日期去掉连字符相同，随后 4 位与时间去掉冒号相同
+    std::string expected = std::string(date, 4) + std::string(date + 5, 2) + std::string(date + 8, 2) +
+                           std::string(cache.time, 2) + std::string(cache.time + 3, 2);
+    if (strncmp(cache.dateAndTime, expected.c_str(), expected.size()) != 0)
+    {
+        return false;
+    }
+    const char *weekday = strcmp(cache.date, "2023-11-15") == 0 ? "星期三" : "星期六";
+    return strcmp(cache.weekday, weekday) == 0;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### 未同步
+ *
+ * 字符串 getter 写入空字符串并返回 false。
+ */
+void test_unsynced_writes_empty(void)
+{
+    char buf[TIME_DATE_AND_TIME_SIZE];
+    memset(buf, 'x', sizeof(buf));
+    TEST_ASSERT_FALSE(timeManager.isSynced());
+    TEST_ASSERT_FALSE(timeManager.getFormattedDate(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("", buf);
+    TEST_ASSERT_FALSE(timeManager.getFormattedDateAndTime(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("", buf);
+    TEST_ASSERT_EQUAL_STRING("", timeManager.getFormattedWeekday());
+    TEST_ASSERT_EQUAL(-1, timeManager.getSyncAge());
+}
+
+/**
+ * ### 同步后的字符串
+ *
+ * 结果写入调用方的缓冲区；缓冲区不足时截断并保证以 NUL 结尾。
+ */
+void test_synced_strings_copied(void)
+{
+    hostSntpDeliver(TIME_A);
+    TEST_ASSERT_TRUE(timeManager.isSynced());
+
+    char date[TIME_DATE_SIZE];
+    char time[TIME_TIME_SIZE];
+    char dateAndTime[TIME_DATE_AND_TIME_SIZE];
+    TEST_ASSERT_TRUE(timeManager.getFormattedDate(date, sizeof(date)));
+    TEST_ASSERT_TRUE(timeManager.getFormattedTime(time, sizeof(time)));
+    TEST_ASSERT_TRUE(timeManager.getFormattedDateAndTime(dateAndTime, sizeof(dateAndTime)));
+    TEST_ASSERT_EQUAL_STRING("2023-11-15", date);
+    TEST_ASSERT_EQUAL_STRING("06:13", time);
+    TEST_ASSERT_EQUAL_STRING_LEN("202311150613", dateAndTime, 12);
+    TEST_ASSERT_EQUAL_STRING("星期三", timeManager.getFormattedWeekday());
+
+    char shortBuf[5];
+    memset(shortBuf, 'x', sizeof(shortBuf));
+    TEST_ASSERT_TRUE(timeManager.getFormattedDate(shortBuf, sizeof(shortBuf)));
+    TEST_ASSERT_EQUAL_STRING("2023", shortBuf);
+
+    // 校时后之前取得的副本保持不变
+    TimeCache before;
+    TEST_ASSERT_TRUE(timeManager.getCache(before));
+    hostSntpDeliver(TIME_B);
+    TEST_ASSERT_EQUAL_STRING("2023-11-15", before.date);
+    TEST_ASSERT_TRUE(timeManager.getFormattedDate(date, sizeof(date)));
+    TEST_ASSERT_EQUAL_STRING("2023-11-18", date);
+}
+
+/**
+ * ### 同一秒内只格式化一次
+ *
+ * 从某一秒开始后不久起，在这一秒的前 800 ms 内反复读取日期，缓存只重新计算一次；
+ * 时钟走过一秒后的第一次读取再计算一次。
+ */
+void test_refresh_once_per_second(void)
+{
+    hostSntpDeliver(TIME_A);
+    while (timeManager.getTimestamp() % 1000 > 100)
+    {
+        delay(1);
+    }
+    timeManager.invalidate();
+    uint32_t before = timeManager.getCacheRefreshes();
+    uint32_t calls = 0;
+    char date[TIME_DATE_SIZE];
+    while (timeManager.getTimestamp() % 1000 < 800)
+    {
+        TEST_ASSERT_TRUE(timeManager.getFormattedDate(date, sizeof(date)));
+        calls++;
+    }
+    TEST_ASSERT_GREATER_THAN(1000, calls);
+    TEST_ASSERT_EQUAL(before + 1, timeManager.getCacheRefreshes());
+
+    hostAdvanceMillis(1000);
+    TEST_ASSERT_TRUE(timeManager.getFormattedDate(date, sizeof(date)));
+    TEST_ASSERT_TRUE(timeManager.getFormattedDate(date, sizeof(date)));
+    TEST_ASSERT_EQUAL(before + 2, timeManager.getCacheRefreshes());
+}
+
+/**
+ * ### 原来的日期 getter
+ *
+ * 每次调用都取系统时间、分解并格式化，返回 String。
+ */
+static String legacyFormattedDate()
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 0))
+    {
+        return "";
+    }
+    char buffer[16];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d", &timeinfo);
+    return String(buffer);
+}
+
+/**
+ * ### 执行 calls 次，返回每次的纳秒数
+ */
+template <typename F>
+static double nsPerCall(uint32_t calls, F call)
+{
+    uint32_t startUs = micros();
+    for (uint32_t n = 0; n < calls; n++)
+    {
+        call();
+    }
+    return (micros() - startUs) * 1000.0 / calls;
+}
+
+/**
+ * ### getter 耗时：缓存 vs getLocalTime() + strftime()
+ *
+ * 已同步与未同步各测一次。未同步时原实现的 getLocalTime() 即使超时为 0 也会等待 10 ms
+ * （默认超时 5 s），缓存的 getter 直接返回空字符串。
+ */
+void test_getter_cost(void)
+{
+    char date[TIME_DATE_SIZE];
+    size_t sink = 0;
+    hostSntpDeliver(TIME_A);
+    double syncedCached = nsPerCall(BENCH_CALLS, [&]()
+                                    { sink += timeManager.getFormattedDate(date, sizeof(date)); });
+    double syncedLegacy = nsPerCall(BENCH_CALLS, [&]()
+                                    { sink += legacyFormattedDate().length(); });
+
+    struct timeval unsynced = {0, 0};
+    settimeofday(&unsynced, nullptr);
+    timeManager.invalidate();
+    double unsyncedCached = nsPerCall(BENCH_CALLS, [&]()
+                                      { sink += timeManager.getFormattedDate(date, sizeof(date)); });
+    double unsyncedLegacy = nsPerCall(BENCH_UNSYNCED_CALLS, [&]()
+                                      { sink += legacyFormattedDate().length(); });
+    TEST_ASSERT_TRUE(sink > 0);
+
+    char line[160];
+    snprintf(line, sizeof(line), "synced  : cached %7.1f ns/call, getLocalTime+strftime %10.1f ns/call", syncedCached,
+             syncedLegacy);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "unsynced: cached %7.1f ns/call, getLocalTime+strftime %10.1f ns/call", unsyncedCached,
+             unsyncedLegacy);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN(syncedLegacy, syncedCached);
+}
+
+/**
+ * ### 读取与校时并发
+ *
+ * 多个读取线程反复取缓存，另一个线程不断在两个时刻之间校时。
+ * 每份副本的字段必须来自同一次刷新，同步次数只增不减。
+ */
+void test_concurrent_readers_and_sync(void)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> torn{0};
+    std::atomic<uint32_t> statsWentBack{0};
+    std::atomic<uint32_t> reads{0};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < READER_THREADS; i++)
+    {
+        readers.emplace_back([&]()
+                             {
+            uint32_t lastSyncs = 0;
+            while (!stop.load())
+            {
+                TimeCache cache;
+                if (timeManager.getCache(cache) && !consistent(cache))
+                {
+                    torn++;
+                }
+                TimeSyncStats stats = timeManager.getSyncStats();
+                if (stats.syncs < lastSyncs)
+                {
+                    statsWentBack++;
+                }
+                lastSyncs = stats.syncs;
+                reads++;
+            } });
+    }
+
+    uint32_t syncs = 0;
+    uint32_t startMs = millis();
+    while (millis() - startMs < RACE_DURATION_MS)
+    {
+        hostSntpDeliver(syncs % 2 == 0 ? TIME_A : TIME_B);
+        syncs++;
+        delayMicroseconds(200);
+    }
+    stop = true;
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+
+    char line[120];
+    snprintf(line, sizeof(line), "%u syncs, %u reads, %u torn copies", (unsigned)syncs, (unsigned)reads.load(),
+             (unsigned)torn.load());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(0, torn.load());
+    TEST_ASSERT_EQUAL(0, statsWentBack.load());
+    TEST_ASSERT_GREATER_OR_EQUAL(syncs, timeManager.getSyncStats().syncs);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_unsynced_writes_empty);
+    RUN_TEST(test_synced_strings_copied);
+    RUN_TEST(test_refresh_once_per_second);
+    RUN_TEST(test_concurrent_readers_and_sync);
+    RUN_TEST(test_getter_cost);
+    int failures = UNITY_END();
+    // 日志任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,287 @@
+/**
+ * @file test_time_sync.cpp
+ * @brief 用假的 NTP 源检查后台校时：begin() 不阻塞、同步后通知订阅者，
+ *        相邻两次同步测得的偏差与漂移，按间隔重新同步，MQTT 校时结果的采纳与丢弃，
+ *        IoTManager 对校时应答的解析与匹配，以及以 MQTT 为首选时超时改用 SNTP。
+ *
+ * hostSntpDeliver() 充当 NTP 服务器，代理替身充当物联网平台的 NTP 服务，
+ * hostAdvanceMillis() 让本地时钟走过任意长的时间。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "IoTManager.h"
+#include "esp_timer.h"
+
+Logger logger;
+WiFiClient wifiClient;
+PubSubClient mqttClient;
+TimeManager timeManager;
+IoTManager iotManager("productKey", "device", "secret", "broker.local", 1883);
+
+#define TOPIC_NTP_REQUEST "/ext/ntp/productKey/device/request"
+#define TOPIC_NTP_RESPONSE "/ext/ntp/productKey/device/response"
+
+#define NTP_BASE 1700000000 // 假 NTP 源给出的第一个时刻
+#define DRIFT_WINDOW_S 1000 // 两次同步之间本地时钟走过的秒数
+
+static std::atomic<uint32_t> notified{0};
+static TimeSyncStats notifiedStats;
+
+static void onSynced(const TimeSyncStats &stats)
+{
+    notifiedStats = stats;
+    notified++;
+}
+
+/**
+ * ### 让 IoTManager 发出一次校时请求
+ *
+ * #### 返回
+ *
+ * - std::string：请求中的 deviceSendTime
+ */
+static std::string requestNetworkTime()
+{
+    {
+        std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+        hostBroker.received.clear();
+    }
+    // 超过两个同步间隔没有同步，以 SNTP 为首选时也会请求 MQTT 校时
+    hostAdvanceMillis(2 * TIME_RESYNC_INTERVAL_MS);
+    iotManager.loop();
+    std::lock_guard<std::recursive_mutex> guard(hostBroker.lock);
+    for (const auto &message : hostBroker.received)
+    {
+        if (message.topic == TOPIC_NTP_REQUEST)
+        {
+            JsonDocument doc;
+            deserializeJson(doc, message.payload.c_str());
+            return (const char *)(doc["deviceSendTime"] | "");
+        }
+    }
+    return "";
+}
+
+/**
+ * ### 平台下发校时应答
+ *
+ * 服务器时间按数字下发，deviceSendTime 按请求中的字符串原样带回。
+ */
+static void respond(const std::string &deviceSendTime, int64_t serverMs)
+{
+    char payload[160];
+    snprintf(payload, sizeof(payload), "{\"deviceSendTime\":\"%s\",\"serverRecvTime\":%lld,\"serverSendTime\":%lld}",
+             deviceSendTime.c_str(), (long long)serverMs, (long long)serverMs + 3);
+    // 网络往返需要的时间要长于服务器的处理时间
+    delay(10);
+    hostBrokerDeliver(TOPIC_NTP_RESPONSE, payload);
+    iotManager.loop();
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * ### begin() 不阻塞
+ *
+ * 在 NTP 应答之前 waitForSync() 按超时返回；应答到达后等待者被唤醒，订阅者收到一次通知。
+ */
+void test_wait_and_notify(void)
+{
+    TEST_ASSERT_FALSE(timeManager.isSynced());
+    TEST_ASSERT_TRUE(timeManager.onSync(onSynced));
+
+    uint32_t startMs = millis();
+    TEST_ASSERT_FALSE(timeManager.waitForSync(50));
+    TEST_ASSERT_GREATER_OR_EQUAL(50, millis() - startMs);
+
+    std::thread server([]()
+                       {
+        delay(100);
+        hostSntpDeliver(NTP_BASE); });
+    TEST_ASSERT_TRUE(timeManager.waitForSync(5000));
+    server.join();
+
+    TEST_ASSERT_EQUAL(1, notified.load());
+    TEST_ASSERT_EQUAL(1, notifiedStats.syncs);
+    TEST_ASSERT_EQUAL(TIME_SOURCE_SNTP, notifiedStats.source);
+    TEST_ASSERT_EQUAL(0, timeManager.getSyncAge());
+}
+
+/**
+ * ### 偏差与漂移
+ *
+ * 本地时钟走过 DRIFT_WINDOW_S 秒时 NTP 源走过多 1 秒，测得约 +1000 ms 的偏差与 +1000 ppm 的漂移；
+ * 下一段两边一致，偏差回到 0 附近。
+ */
+void test_offset_and_drift(void)
+{
+    hostSntpDeliver(NTP_BASE);
+    hostAdvanceMillis(DRIFT_WINDOW_S * 1000);
+    hostSntpDeliver(NTP_BASE + DRIFT_WINDOW_S + 1);
+    TimeSyncStats stats = timeManager.getSyncStats();
+    TEST_ASSERT_INT_WITHIN(50, 1000, stats.lastOffsetMs);
+    TEST_ASSERT_INT_WITHIN(50, 1000, (int32_t)stats.driftPpm);
+
+    hostAdvanceMillis(DRIFT_WINDOW_S * 1000);
+    hostSntpDeliver(NTP_BASE + 2 * DRIFT_WINDOW_S + 1);
+    stats = timeManager.getSyncStats();
+    TEST_ASSERT_INT_WITHIN(50, 0, stats.lastOffsetMs);
+    TEST_ASSERT_INT_WITHIN(50, 0, (int32_t)stats.driftPpm);
+    TEST_ASSERT_EQUAL(notified.load(), stats.syncs);
+}
+
+/**
+ * ### 重新同步的时机
+ *
+ * 以 SNTP 为首选时，SNTP 自己按间隔重新同步；超过两个间隔仍未同步才需要 MQTT 补救。
+ */
+void test_resync_interval(void)
+{
+    hostSntpDeliver(NTP_BASE);
+    TEST_ASSERT_FALSE(timeManager.needsNetworkTime());
+    TEST_ASSERT_EQUAL(TIME_RESYNC_INTERVAL_MS, hostSntp.intervalMs);
+
+    hostAdvanceMillis(TIME_RESYNC_INTERVAL_MS);
+    TEST_ASSERT_EQUAL(TIME_RESYNC_INTERVAL_MS / 1000, timeManager.getSyncAge());
+    TEST_ASSERT_FALSE(timeManager.needsNetworkTime());
+
+    hostAdvanceMillis(TIME_RESYNC_INTERVAL_MS);
+    TEST_ASSERT_TRUE(timeManager.needsNetworkTime());
+
+    hostSntpDeliver(NTP_BASE + 2 * TIME_RESYNC_INTERVAL_MS / 1000);
+    TEST_ASSERT_FALSE(timeManager.needsNetworkTime());
+}
+
+/**
+ * ### MQTT 校时
+ *
+ * 往返时间合理的结果按 (服务器收 + 服务器发 + 往返) / 2 设置时钟；
+ * 往返过长、为负或服务器时间无效的结果被丢弃，不计入同步次数。
+ */
+void test_network_time(void)
+{
+    uint32_t syncs = timeManager.getSyncStats().syncs;
+    int64_t serverMs = (int64_t)(NTP_BASE + 86400) * 1000;
+    int64_t deviceRecvMs = esp_timer_get_time() / 1000;
+    int64_t deviceSendMs = deviceRecvMs - 40;
+
+    TEST_ASSERT_FALSE(timeManager.applyNetworkTime(serverMs, serverMs + 2, deviceRecvMs - TIME_MQTT_MAX_RTT_MS - 10, deviceRecvMs));
+    TEST_ASSERT_FALSE(timeManager.applyNetworkTime(serverMs, serverMs + 100, deviceSendMs, deviceRecvMs));
+    TEST_ASSERT_FALSE(timeManager.applyNetworkTime(1000, 1002, deviceSendMs, deviceRecvMs));
+    TEST_ASSERT_EQUAL(syncs, timeManager.getSyncStats().syncs);
+
+    TEST_ASSERT_TRUE(timeManager.applyNetworkTime(serverMs, serverMs + 2, deviceSendMs, deviceRecvMs));
+    TimeSyncStats stats = timeManager.getSyncStats();
+    TEST_ASSERT_EQUAL(syncs + 1, stats.syncs);
+    TEST_ASSERT_EQUAL(TIME_SOURCE_MQTT, stats.source);
+    TEST_ASSERT_EQUAL(38, stats.rttMs);
+    TEST_ASSERT_INT64_WITHIN(50, serverMs + 21, (int64_t)timeManager.getTimestamp());
+    TEST_ASSERT_EQUAL(TIME_SOURCE_MQTT, notifiedStats.source);
+}
+
+/**
+ * ### MQTT 校时应答的解析与匹配
+ *
+ * 与最近一次请求匹配的应答按服务器时间校时；重复投递的应答，以及带着上一次请求的
+ * deviceSendTime 的过期应答都被丢弃，不计入同步次数。
+ */
+void test_ntp_response_matching(void)
+{
+    hostWiFi.connected = true;
+    iotManager.connect();
+    int64_t serverMs = (int64_t)(NTP_BASE + 2 * 86400) * 1000;
+
+    std::string first = requestNetworkTime();
+    TEST_ASSERT_FALSE(first.empty());
+    uint32_t syncs = timeManager.getSyncStats().syncs;
+    respond(first, serverMs);
+    TimeSyncStats stats = timeManager.getSyncStats();
+    TEST_ASSERT_EQUAL(syncs + 1, stats.syncs);
+    TEST_ASSERT_EQUAL(TIME_SOURCE_MQTT, stats.source);
+    TEST_ASSERT_LESS_OR_EQUAL(50, stats.rttMs);
+    TEST_ASSERT_INT64_WITHIN(100, serverMs, (int64_t)timeManager.getTimestamp());
+
+    // 同一个应答重复投递
+    respond(first, serverMs + 60000);
+    TEST_ASSERT_EQUAL(syncs + 1, timeManager.getSyncStats().syncs);
+
+    // 新请求发出后，上一次请求的应答才到达
+    std::string second = requestNetworkTime();
+    TEST_ASSERT_TRUE(second != first);
+    respond(first, serverMs + 120000);
+    TEST_ASSERT_EQUAL(syncs + 1, timeManager.getSyncStats().syncs);
+    respond(second, serverMs + 180000);
+    TEST_ASSERT_EQUAL(syncs + 2, timeManager.getSyncStats().syncs);
+    TEST_ASSERT_INT64_WITHIN(100, serverMs + 180000, (int64_t)timeManager.getTimestamp());
+}
+
+static TimeManager mqttFirst;   // 以 MQTT 为首选、一直收不到应答
+static TimeManager mqttSynced;  // 以 MQTT 为首选、按时收到应答
+
+/**
+ * ### 等待 SNTP 被启动
+ */
+static bool sntpStartedWithin(uint32_t ms)
+{
+    uint32_t startMs = millis();
+    while (hostSntp.callback == nullptr && millis() - startMs < ms)
+    {
+        delay(1);
+    }
+    return hostSntp.callback != nullptr;
+}
+
+/**
+ * ### 以 MQTT 为首选时的 SNTP 兜底
+ *
+ * TIME_SNTP_FALLBACK_MS 内没有通过 MQTT 校时则启动 SNTP；按时校时则不启动。
+ */
+void test_mqtt_fallback_to_sntp(void)
+{
+    struct timeval unsynced = {0, 0};
+    settimeofday(&unsynced, nullptr);
+    hostSntp.callback = nullptr;
+    mqttFirst.begin(TIME_SOURCE_MQTT);
+    TEST_ASSERT_TRUE(mqttFirst.needsNetworkTime());
+    hostAdvanceMillis(TIME_SNTP_FALLBACK_MS - 1000);
+    TEST_ASSERT_FALSE(sntpStartedWithin(50));
+    hostAdvanceMillis(1000);
+    TEST_ASSERT_TRUE(sntpStartedWithin(1000));
+    hostSntpDeliver(NTP_BASE);
+    TEST_ASSERT_EQUAL(1, mqttFirst.getSyncStats().syncs);
+    TEST_ASSERT_EQUAL(TIME_SOURCE_SNTP, mqttFirst.getSyncStats().source);
+
+    settimeofday(&unsynced, nullptr);
+    hostSntp.callback = nullptr;
+    mqttSynced.begin(TIME_SOURCE_MQTT);
+    int64_t nowMs = esp_timer_get_time() / 1000;
+    int64_t serverMs = (int64_t)NTP_BASE * 1000;
+    TEST_ASSERT_TRUE(mqttSynced.applyNetworkTime(serverMs, serverMs + 2, nowMs - 20, nowMs));
+    hostAdvanceMillis(TIME_SNTP_FALLBACK_MS);
+    TEST_ASSERT_FALSE(sntpStartedWithin(100));
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostBroker.respond = nullptr;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_wait_and_notify);
+    RUN_TEST(test_offset_and_drift);
+    RUN_TEST(test_resync_interval);
+    RUN_TEST(test_network_time);
+    RUN_TEST(test_ntp_response_matching);
+    RUN_TEST(test_mqtt_fallback_to_sntp);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,210 @@
+/**
+ * @file test_token_cache.cpp
+ * @brief 检查上传凭证缓存：多次上传复用同一凭证，空闲期 maintain() 在刷新窗口内提前重新签名，
+ *        距离过期不足 QINIU_TOKEN_EXPIRY_MARGIN 时上传路径重新签名，凭证被拒绝（401）时重新签名并只重试一次。
+ *
+ * 上传端点由 hostHttp 模拟，从请求体中取出每次上传使用的凭证；时间通过 settimeofday() 直接拨动，
+ * 每个用例从 BASE_TIME 开始，使用新的 QiniuClient 对象。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <vector>
+#include "QiniuClient.h"
+
+_Base64 _base64;
+Logger logger;
+WiFiClient wifiClient;
+TimeManager timeManager;
+WifiManager wifiManager("ssid", "password");
+
+#define BASE_TIME 1700000000 // 每个用例开始时的 Unix 时间（秒）
+#define FRAME_BYTES 1024
+
+static uint8_t image[FRAME_BYTES];
+static std::vector<String> tokens; // 每次请求携带的凭证
+static uint32_t rejectRequests = 0; // 接下来要以 401 拒绝的请求数
+
+/**
+ * ### 从 multipart 请求体中取出 token 字段
+ */
+static String tokenOf(const HostHttpRequest &request)
+{
+    static const std::string field = "name=\"token\"\r\n\r\n";
+    size_t start = request.body.find(field);
+    if (start == std::string::npos)
+    {
+        return String();
+    }
+    start += field.size();
+    size_t end = request.body.find("\r\n", start);
+    return String(request.body.substr(start, end - start).c_str());
+}
+
+static int uploadHandler(const HostHttpRequest &request, String &response)
+{
+    tokens.push_back(tokenOf(request));
+    if (rejectRequests > 0)
+    {
+        rejectRequests--;
+        response = "{\"error\":\"expired token\"}";
+        return HTTP_CODE_UNAUTHORIZED;
+    }
+    response = "{\"url\":\"https://cdn.local/frame\"}";
+    return HTTP_CODE_OK;
+}
+
+static void setClock(uint32_t seconds)
+{
+    struct timeval now = {(time_t)seconds, 0};
+    settimeofday(&now, nullptr);
+}
+
+static bool upload(QiniuClient &client)
+{
+    return client.uploadImage(String(QINIU_KEY_PREFIX) + "1.jpg", image, sizeof(image)) != "";
+}
+
+void setUp(void)
+{
+    hostHttp.reset();
+    hostHttp.handler = uploadHandler;
+    tokens.clear();
+    rejectRequests = 0;
+    setClock(BASE_TIME);
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 多次上传复用凭证
+ *
+ * 只在第一次上传时签名，之后的上传都命中缓存，携带同一个凭证。
+ */
+void test_token_reused_across_uploads(void)
+{
+    QiniuClient client("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    for (int i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_TRUE(upload(client));
+    }
+
+    TEST_ASSERT_EQUAL(1, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(4, client.tokenStats.hits);
+    TEST_ASSERT_EQUAL(0, client.tokenStats.proactiveRefreshes);
+    TEST_ASSERT_EQUAL(5, tokens.size());
+    for (const String &token : tokens)
+    {
+        TEST_ASSERT_EQUAL_STRING(tokens[0].c_str(), token.c_str());
+    }
+}
+
+/**
+ * ### 空闲期提前刷新
+ *
+ * 进入 QINIU_TOKEN_REFRESH_WINDOW 之前 maintain() 不做任何事；进入之后重新签名一次，
+ * 随后的上传直接使用新凭证，不再在上传路径上签名。
+ */
+void test_maintain_refreshes_inside_window(void)
+{
+    QiniuClient client("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    client.maintain();
+    TEST_ASSERT_EQUAL(0, client.tokenStats.mints);
+
+    TEST_ASSERT_TRUE(upload(client));
+    setClock(BASE_TIME + QINIU_TOKEN_TTL - QINIU_TOKEN_REFRESH_WINDOW - 10);
+    client.maintain();
+    TEST_ASSERT_EQUAL(1, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(0, client.tokenStats.proactiveRefreshes);
+
+    setClock(BASE_TIME + QINIU_TOKEN_TTL - QINIU_TOKEN_REFRESH_WINDOW);
+    client.maintain();
+    TEST_ASSERT_EQUAL(2, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(1, client.tokenStats.proactiveRefreshes);
+
+    // 刷新后的凭证离过期还有一个完整的有效期，再调用 maintain() 不会重复签名
+    client.maintain();
+    TEST_ASSERT_EQUAL(1, client.tokenStats.proactiveRefreshes);
+
+    TEST_ASSERT_TRUE(upload(client));
+    TEST_ASSERT_EQUAL(2, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(1, client.tokenStats.hits);
+    TEST_ASSERT_EQUAL(2, tokens.size());
+    TEST_ASSERT_TRUE(tokens[0] != tokens[1]);
+}
+
+/**
+ * ### 临近过期时在上传路径上重新签名
+ *
+ * 没有调用 maintain() 时，凭证在 QINIU_TOKEN_EXPIRY_MARGIN 之外仍然复用，进入之后由上传路径重新签名。
+ */
+void test_upload_remints_near_expiry(void)
+{
+    QiniuClient client("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    TEST_ASSERT_TRUE(upload(client));
+
+    setClock(BASE_TIME + QINIU_TOKEN_TTL - QINIU_TOKEN_EXPIRY_MARGIN - 10);
+    TEST_ASSERT_TRUE(upload(client));
+    TEST_ASSERT_EQUAL(1, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(1, client.tokenStats.hits);
+
+    setClock(BASE_TIME + QINIU_TOKEN_TTL - QINIU_TOKEN_EXPIRY_MARGIN);
+    TEST_ASSERT_TRUE(upload(client));
+    TEST_ASSERT_EQUAL(2, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(1, client.tokenStats.hits);
+    TEST_ASSERT_EQUAL(0, client.tokenStats.proactiveRefreshes);
+
+    TEST_ASSERT_EQUAL(3, tokens.size());
+    TEST_ASSERT_TRUE(tokens[0] == tokens[1]);
+    TEST_ASSERT_TRUE(tokens[1] != tokens[2]);
+}
+
+/**
+ * ### 凭证被拒绝
+ *
+ * 401 后作废缓存的凭证，重新签名并重试一次；重试仍被拒绝时上传失败，不再继续重试。
+ */
+void test_unauthorized_reminted_and_retried_once(void)
+{
+    QiniuClient client("accessKey", "secretKey", "bucket", "https://cdn.local", "z0");
+    TEST_ASSERT_TRUE(upload(client));
+
+    rejectRequests = 1;
+    TEST_ASSERT_TRUE(upload(client));
+    TEST_ASSERT_EQUAL(3, hostHttp.requests);
+    TEST_ASSERT_EQUAL(1, client.tokenStats.rejections);
+    TEST_ASSERT_EQUAL(2, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(1, client.tokenStats.hits);
+
+    // 重新签名的凭证继续被后续上传复用
+    TEST_ASSERT_TRUE(upload(client));
+    TEST_ASSERT_EQUAL(2, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(2, client.tokenStats.hits);
+
+    rejectRequests = 2;
+    int httpCode = 0;
+    TEST_ASSERT_TRUE(client.uploadImage(String(QINIU_KEY_PREFIX) + "1.jpg", image, sizeof(image), httpCode) == "");
+    TEST_ASSERT_EQUAL(HTTP_CODE_UNAUTHORIZED, httpCode);
+    TEST_ASSERT_EQUAL(6, hostHttp.requests);
+    TEST_ASSERT_EQUAL(2, client.tokenStats.rejections);
+    TEST_ASSERT_EQUAL(3, client.tokenStats.mints);
+    TEST_ASSERT_EQUAL(0, rejectRequests);
+}
+
+int main()
+{
+    logger.begin();
+    timeManager.begin(TIME_SOURCE_SNTP);
+    hostSntpDeliver(BASE_TIME);
+    memset(image, 0x5a, sizeof(image));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_token_reused_across_uploads);
+    RUN_TEST(test_maintain_refreshes_inside_window);
+    RUN_TEST(test_upload_remints_near_expiry);
+    RUN_TEST(test_unauthorized_reminted_and_retried_once);
+    int failures = UNITY_END();
+    // 日志与时间同步任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}
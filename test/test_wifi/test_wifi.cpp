@@ -0,0 +1,268 @@
+/**
+ * @file test_wifi.cpp
+ * @brief 用模拟的 WiFi 事件源驱动 WifiManager：首次连接后缓存接入点与租约，断线后用缓存快速重连，
+ *        重连时缓存内容不变则不写 NVS，租期过半或时间未同步时改走 DHCP，重启后跳过扫描，
+ *        以及连接超时后的缓存清除与指数退避。
+ *
+ * 事件由 hostWiFiLinkUp()/hostWiFiLinkDown() 经 WiFi.onEvent() 注册的回调送入 handleEvent()，
+ * 状态转换在 loop() 中完成；每个用例使用新的 WifiManager 对象模拟重启。
+ * 除租约过期的用例外时间都已同步，DHCP 租期为 hostDhcp 的默认值。
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <lwip/dhcp.h>
+#include "WifiManager.h"
+
+Logger logger;
+WiFiClient wifiClient;
+
+#define SYNCED_TIME 1700000000 // 用例开始时的墙上时间
+#define LEASE_SECONDS 600      // 租约过期用例的 DHCP 租期
+
+static const HostAccessPoint AP_HOME = {"home", {0x02, 0x11, 0x22, 0x33, 0x44, 0x01}, 6, -55};
+static const HostAccessPoint AP_OFFICE = {"office", {0x02, 0x11, 0x22, 0x33, 0x44, 0x02}, 11, -60};
+
+static std::atomic<uint32_t> ups{0};
+static std::atomic<uint32_t> downs{0};
+
+static void onLink(bool up)
+{
+    (up ? ups : downs)++;
+}
+
+/**
+ * ### 模拟的接入点
+ *
+ * 在另一个线程中等待固件调用 WiFi.begin()，随后像真实的 WiFi 任务一样送出 GOT_IP 事件。
+ */
+static std::thread answerBegin(const HostAccessPoint &ap, uint32_t afterBegins)
+{
+    return std::thread([&ap, afterBegins]()
+                       {
+        while (hostWiFi.begins <= afterBegins)
+        {
+            delay(1);
+        }
+        delay(20);
+        hostWiFiLinkUp(ap); });
+}
+
+/**
+ * ### 断线后重连到同一个接入点
+ */
+static void dropAndReconnect(WifiManager &manager, const HostAccessPoint &ap)
+{
+    hostWiFiLinkDown();
+    manager.loop();
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTING, manager.getState());
+    hostWiFiLinkUp(ap);
+    manager.loop();
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTED, manager.getState());
+}
+
+void setUp(void)
+{
+    std::lock_guard<std::recursive_mutex> guard(hostWiFi.lock);
+    hostWiFi.connected = false;
+    hostWiFi.begins = 0;
+    hostWiFi.scans = 0;
+    hostWiFi.scan.clear();
+    hostWiFi.scanStarted = false;
+    hostWiFi.staticConfig = false;
+    ups = 0;
+    downs = 0;
+}
+
+void tearDown(void) {}
+
+/**
+ * ### 首次连接
+ *
+ * 只配置一个网络且没有缓存时直接连接（不指定 BSSID），成功后通知订阅者、写入缓存并计入耗时直方图。
+ */
+void test_first_connect_caches_ap(void)
+{
+    hostNvs = HostNvs();
+    WifiManager manager("home", "password");
+    TEST_ASSERT_TRUE(manager.onLinkChange(onLink));
+    std::thread ap = answerBegin(AP_HOME, 0);
+    manager.connect();
+    ap.join();
+
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTED, manager.getState());
+    TEST_ASSERT_EQUAL(1, ups.load());
+    TEST_ASSERT_FALSE(hostWiFi.lastHadBssid);
+    TEST_ASSERT_TRUE(hostNvs.entries.count(WIFI_PREFS_NAMESPACE "/cache"));
+    WifiStats stats = manager.getStats();
+    TEST_ASSERT_EQUAL(1, stats.attempts);
+    TEST_ASSERT_EQUAL(1, stats.connectHistogram[0]);
+}
+
+/**
+ * ### 断线重连
+ *
+ * 重连直接使用缓存的 BSSID、信道与静态地址；缓存内容不变时不写 NVS，
+ * 只有租约复用次数用满与重新走 DHCP 时各写一次。
+ */
+void test_reconnect_skips_unchanged_writes(void)
+{
+    WifiManager manager("home", "password");
+    TEST_ASSERT_TRUE(manager.onLinkChange(onLink));
+    std::thread ap = answerBegin(AP_HOME, hostWiFi.begins);
+    manager.connect();
+    ap.join();
+
+    // 启动时的连接已复用一次租约
+    uint32_t writes = hostNvs.writes;
+    for (uint32_t i = 2; i < WIFI_LEASE_FAST_CONNECTS; i++)
+    {
+        dropAndReconnect(manager, AP_HOME);
+        TEST_ASSERT_TRUE(hostWiFi.lastHadBssid);
+        TEST_ASSERT_EQUAL(AP_HOME.channel, hostWiFi.lastChannel);
+        TEST_ASSERT_TRUE(hostWiFi.staticConfig);
+        TEST_ASSERT_EQUAL(writes, hostNvs.writes);
+    }
+
+    // 最后一次复用租约：用满的状态要在重启后保留
+    dropAndReconnect(manager, AP_HOME);
+    TEST_ASSERT_TRUE(hostWiFi.staticConfig);
+    TEST_ASSERT_EQUAL(writes + 1, hostNvs.writes);
+
+    // 租约用满后走 DHCP 续租，复用次数清零
+    dropAndReconnect(manager, AP_HOME);
+    TEST_ASSERT_FALSE(hostWiFi.staticConfig);
+    TEST_ASSERT_EQUAL(writes + 2, hostNvs.writes);
+
+    WifiStats stats = manager.getStats();
+    TEST_ASSERT_EQUAL(WIFI_LEASE_FAST_CONNECTS, stats.drops);
+    TEST_ASSERT_EQUAL(WIFI_LEASE_FAST_CONNECTS + 1, ups.load());
+    TEST_ASSERT_EQUAL(WIFI_LEASE_FAST_CONNECTS, downs.load());
+}
+
+/**
+ * ### 租约过期
+ *
+ * 取得租约后租期过半即不再复用，改走 DHCP 并记下新的取得时间；时间未同步时无法判断租约是否
+ * 已过期，同样走 DHCP。
+ */
+void test_expired_lease_uses_dhcp(void)
+{
+    hostNvs = HostNvs();
+    hostDhcp.offered_t0_lease = LEASE_SECONDS;
+    WifiManager manager("home", "password");
+    std::thread ap = answerBegin(AP_HOME, 0);
+    manager.connect();
+    ap.join();
+    TEST_ASSERT_FALSE(hostWiFi.staticConfig);
+
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    now.tv_sec += LEASE_SECONDS / 2 - 10;
+    settimeofday(&now, nullptr);
+    dropAndReconnect(manager, AP_HOME);
+    TEST_ASSERT_TRUE(hostWiFi.staticConfig);
+
+    now.tv_sec += 10;
+    settimeofday(&now, nullptr);
+    uint32_t writes = hostNvs.writes;
+    dropAndReconnect(manager, AP_HOME);
+    TEST_ASSERT_FALSE(hostWiFi.staticConfig);
+    TEST_ASSERT_EQUAL(writes + 1, hostNvs.writes);
+
+    // 续租后的租约重新可用
+    dropAndReconnect(manager, AP_HOME);
+    TEST_ASSERT_TRUE(hostWiFi.staticConfig);
+
+    struct timeval unsynced = {0, 0};
+    settimeofday(&unsynced, nullptr);
+    dropAndReconnect(manager, AP_HOME);
+    TEST_ASSERT_FALSE(hostWiFi.staticConfig);
+
+    struct timeval synced = {SYNCED_TIME, 0};
+    settimeofday(&synced, nullptr);
+    hostDhcp = {7200};
+}
+
+/**
+ * ### 重启后跳过扫描
+ *
+ * 配置了多个网络时，没有缓存需要先扫描；有缓存时直接连接缓存的接入点。
+ */
+void test_restart_uses_cache_without_scan(void)
+{
+    WifiManager manager("home", "password");
+    manager.addNetwork("office", "password");
+    std::thread ap = answerBegin(AP_HOME, 0);
+    manager.connect();
+    ap.join();
+
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTED, manager.getState());
+    TEST_ASSERT_EQUAL(0, hostWiFi.scans);
+    TEST_ASSERT_TRUE(hostWiFi.lastHadBssid);
+    TEST_ASSERT_EQUAL_MEMORY(AP_HOME.bssid, hostWiFi.lastBssid, 6);
+    TEST_ASSERT_EQUAL(1, manager.getStats().fastAttempts);
+}
+
+/**
+ * ### 连接超时
+ *
+ * 使用缓存的尝试超时后清除缓存并很快重试；此后没有缓存的尝试按指数退避，
+ * 每次等待在 [d/2, d] 之间。缓存失败也计入连续失败次数，d 从 2 * WIFI_BACKOFF_BASE_MS 起翻倍。
+ */
+void test_timeout_clears_cache_and_backs_off(void)
+{
+    WifiManager manager("home", "password");
+    std::thread ap = answerBegin(AP_HOME, 0);
+    manager.connect();
+    ap.join();
+    hostWiFiLinkDown();
+    manager.loop();
+    TEST_ASSERT_EQUAL(2, hostWiFi.begins);
+    TEST_ASSERT_TRUE(hostWiFi.lastHadBssid);
+
+    hostAdvanceMillis(WIFI_ATTEMPT_TIMEOUT_MS);
+    manager.loop();
+    TEST_ASSERT_EQUAL(WIFI_STATE_BACKOFF, manager.getState());
+    TEST_ASSERT_FALSE(hostNvs.entries.count(WIFI_PREFS_NAMESPACE "/cache"));
+    hostAdvanceMillis(WIFI_BACKOFF_BASE_MS / 2);
+    manager.loop();
+    TEST_ASSERT_EQUAL(3, hostWiFi.begins);
+    TEST_ASSERT_FALSE(hostWiFi.lastHadBssid);
+
+    uint32_t backoffMs = 2 * WIFI_BACKOFF_BASE_MS;
+    for (uint32_t attempt = 4; attempt <= 6; attempt++)
+    {
+        hostAdvanceMillis(WIFI_ATTEMPT_TIMEOUT_MS);
+        manager.loop();
+        TEST_ASSERT_EQUAL(WIFI_STATE_BACKOFF, manager.getState());
+        hostAdvanceMillis(backoffMs / 2 - 50);
+        manager.loop();
+        TEST_ASSERT_EQUAL(attempt - 1, hostWiFi.begins);
+        hostAdvanceMillis(backoffMs / 2 + 50);
+        manager.loop();
+        TEST_ASSERT_EQUAL(attempt, hostWiFi.begins);
+        backoffMs *= 2;
+    }
+    TEST_ASSERT_EQUAL(4, manager.getStats().failures);
+}
+
+int main()
+{
+    logger.begin();
+    struct timeval synced = {SYNCED_TIME, 0};
+    settimeofday(&synced, nullptr);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_first_connect_caches_ap);
+    RUN_TEST(test_reconnect_skips_unchanged_writes);
+    RUN_TEST(test_expired_lease_uses_dhcp);
+    RUN_TEST(test_restart_uses_cache_without_scan);
+    RUN_TEST(test_timeout_clears_cache_and_backs_off);
+    int failures = UNITY_END();
+    // 日志任务不会退出，跳过全局对象的析构
+    fflush(stdout);
+    quick_exit(failures);
+}